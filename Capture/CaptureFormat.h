@@ -0,0 +1,177 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * MemCapture binary capture format
+ * ================================
+ *
+ * Designed for long captures of per-tick time series from thousands of processes. Written append-only while the
+ * capture is running so a capture that is killed part way through can still be read, and read back through mmap without
+ * copying anything.
+ *
+ * All integers are little-endian. Strings are not null terminated.
+ *
+ *  +-------------------+
+ *  | FileHeader        |
+ *  +-------------------+
+ *  | Block             |  <- any number of blocks, in the order they were written
+ *  | ...               |
+ *  +-------------------+
+ *  | Index block       |  <- only present if the capture was closed cleanly
+ *  | Trailer           |
+ *  +-------------------+
+ *
+ * Every block starts with a BlockHeader giving its type and payload length, and blocks are padded to 8 byte alignment.
+ * Readers must skip block types they don't understand, so new block types can be added without bumping the version.
+ *
+ * Strings (StringTable block)
+ *      u32 first id, u32 count, count * (u32 length, bytes)
+ *  Every name/label/cmdline is stored once and referred to by id. Ids are allocated sequentially from 0.
+ *
+ * Rows (RowTable block)
+ *      u32 first id, u32 count, count * (u32 dataset, u32 position, u16 label count, label count * (u32 column, u32 value))
+ *  A row is one line in a report table - e.g. a single process, or a single CMA region. The labels are the text columns
+ *  that identify it (PID, Name, Region etc). Position is where the row was inserted in its dataset when it first
+ *  appeared (kAppendRow to add it to the end).
+ *
+ * Series (SeriesTable block)
+ *      u32 first id, u32 count, count * (u32 row, u32 measurement, u16 column, u8 flags, i8 decimals)
+ *  A series is a single measurement for a row (e.g. the Pss of a process) sampled over time. Column is the position of
+ *  the measurement in the row, counting the labels (kAppendColumn to add it after everything else). Flags are
+ *  SeriesFlags. Decimals is the precision to show the latest value with if flagged as kSeriesLatestValue.
+ *
+ * Samples (Chunk block)
+ *      u32 series, u32 count, i64 first timestamp, i64 first value, (count - 1) * (varint timestamp delta, varint value delta)
+ *  A run of consecutive samples for one series. Timestamps are milliseconds since the epoch, values are stored as fixed
+ *  point with kValueScale (so 3 decimal places). Deltas are zigzag encoded LEB128 varints, so a slowly changing value
+ *  sampled at a fixed rate costs 2-3 bytes per sample.
+ *
+ * Metadata block
+ *      u32 count, count * (u32 key, u32 value)
+ *  Information about the device and capture (platform, image, duration etc). May appear more than once - if a key is
+ *  repeated, the last value wins.
+ *
+ * Index block
+ *      u32 definition block count, count * u64 offset
+ *      u32 series count, series count * (u32 series, u32 chunk count, chunk count * ChunkIndexEntry)
+ *  Where to find everything in the file, so a reader can go straight to the chunks for a series without scanning.
+ *  Definition blocks are the string/row/series tables and metadata blocks.
+ *
+ * Trailer
+ *  Fixed size, at the very end of the file. Points at the index block. If the trailer is missing (capture was killed)
+ *  then readers fall back to scanning the blocks from the start, ignoring any partially written block at the end.
+ */
+namespace CaptureFormat
+{
+    constexpr char kFileMagic[8] = {'M', 'E', 'M', 'C', 'A', 'P', 'T', '\0'};
+    constexpr char kTrailerMagic[8] = {'M', 'E', 'M', 'C', 'A', 'P', 'I', 'X'};
+    constexpr uint32_t kVersion = 3;
+
+    // Values are stored as fixed point integers
+    constexpr double kValueScale = 1000.0;
+
+    constexpr size_t kBlockAlignment = 8;
+
+    constexpr uint32_t kAppendRow = UINT32_MAX;
+    constexpr uint16_t kAppendColumn = UINT16_MAX;
+
+    enum SeriesFlags : uint8_t
+    {
+        // The report includes P50/P95/P99 for the series
+        kSeriesPercentiles = 1 << 0,
+        // The report shows the latest value as text rather than min/max/average
+        kSeriesLatestValue = 1 << 1,
+    };
+
+    enum class BlockType : uint32_t
+    {
+        StringTable = 1,
+        RowTable = 2,
+        SeriesTable = 3,
+        Chunk = 4,
+        Index = 5,
+        Metadata = 6,
+    };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    struct BlockHeader
+    {
+        uint32_t type;
+        uint32_t length;
+    };
+
+    struct ChunkIndexEntry
+    {
+        uint64_t offset;
+        uint32_t count;
+        uint32_t reserved;
+        int64_t firstTimestamp;
+        int64_t lastTimestamp;
+    };
+
+    struct Trailer
+    {
+        uint64_t indexOffset;
+        char magic[8];
+    };
+
+    static_assert(sizeof(FileHeader) == 16, "FileHeader must be packed");
+    static_assert(sizeof(BlockHeader) == 8, "BlockHeader must be packed");
+    static_assert(sizeof(ChunkIndexEntry) == 32, "ChunkIndexEntry must be packed");
+    static_assert(sizeof(Trailer) == 16, "Trailer must be packed");
+
+    inline uint64_t zigzagEncode(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t zigzagDecode(uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    /**
+     * @brief Decode a LEB128 varint
+     *
+     * @return Pointer to the byte after the varint, or nullptr if the varint runs past the end of the buffer
+     */
+    inline const uint8_t *readVarint(const uint8_t *pos, const uint8_t *end, uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; pos < end && shift < 64; shift += 7) {
+            uint8_t byte = *pos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return pos;
+            }
+        }
+        return nullptr;
+    }
+}
@@ -0,0 +1,313 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "CaptureImporter.h"
+#include "DatasetBuilder.h"
+#include "Log.h"
+#include "ProcessMetric.h"
+#include "MemoryMetric.h"
+#include "ProcessAggregates.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <queue>
+#include <sstream>
+
+static std::string toString(std::string_view view)
+{
+    return {view.data(), view.size()};
+}
+
+static bool parsePid(std::string_view view, pid_t &pid)
+{
+    const std::string value = toString(view);
+
+    char *end = nullptr;
+    errno = 0;
+    long result = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno != 0 || result < 0 || result > std::numeric_limits<pid_t>::max()) {
+        return false;
+    }
+
+    pid = static_cast<pid_t>(result);
+    return true;
+}
+
+CaptureImporter::CaptureImporter(const CaptureReader &reader)
+        : mReader(reader),
+          mFirstTimestamp(std::numeric_limits<int64_t>::max()),
+          mLastTimestamp(0),
+          mLastProcessTimestamp(0)
+{
+    // Work out the time span of the capture from the chunk index, no need to decode anything
+    const auto &allSeries = mReader.AllSeries();
+    for (const auto &series: allSeries) {
+        if (series.chunks.empty()) {
+            continue;
+        }
+
+        mFirstTimestamp = std::min(mFirstTimestamp, series.chunks.front().firstTimestamp);
+        mLastTimestamp = std::max(mLastTimestamp, series.chunks.back().lastTimestamp);
+
+        if (mReader.Rows()[series.row].dataset == "Processes") {
+            mLastProcessTimestamp = std::max(mLastProcessTimestamp, series.chunks.back().lastTimestamp);
+        }
+    }
+
+    if (mFirstTimestamp > mLastTimestamp) {
+        mFirstTimestamp = mLastTimestamp;
+    }
+}
+
+/**
+ * @return Metadata saved with the capture. If the capture was cut short, the duration and timestamp are worked out
+ * from the samples instead
+ */
+std::shared_ptr<Metadata> CaptureImporter::GetMetadata() const
+{
+    auto valueOr = [&](std::string_view key, const std::string &defaultValue)
+    {
+        auto value = mReader.GetMetadata(key);
+        return value.empty() ? defaultValue : toString(value);
+    };
+
+    std::string timestamp = toString(mReader.GetMetadata("timestamp"));
+    if (timestamp.empty()) {
+        std::time_t t = std::chrono::system_clock::to_time_t(
+                std::chrono::system_clock::time_point(std::chrono::milliseconds(mLastTimestamp)));
+        std::stringstream timeStream;
+        timeStream << std::put_time(std::localtime(&t), "%FT%T%z");
+        timestamp = timeStream.str();
+    }
+
+    long duration = (mLastTimestamp - mFirstTimestamp) / 1000;
+    auto savedDuration = mReader.GetMetadata("duration");
+    if (!savedDuration.empty()) {
+        duration = std::stol(toString(savedDuration));
+    }
+
+    return std::make_shared<Metadata>(valueOr("platform", "Unknown"),
+                                      valueOr("image", "Unknown"),
+                                      valueOr("mac", "Unknown"),
+                                      mReader.GetMetadata("swapEnabled") == "true",
+                                      timestamp,
+                                      duration);
+}
+
+void CaptureImporter::AddToReport(JsonReportGenerator &reportGenerator,
+                                  const std::optional<std::shared_ptr<GroupManager>> &groupManager) const
+{
+    std::vector<const CaptureReader::Row *> rows;
+    auto processes = buildProcesses(rows);
+    // Work out the per-tick totals before deduplicating, in the same way as the live capture
+    addAggregatesToReport(processes, rows, groupManager, reportGenerator);
+    ProcessMetric::AddProcessesToReport(processes, reportGenerator);
+
+    MemoryMetric::AddDatasetsToReport(buildDatasets(), reportGenerator);
+}
+
+/**
+ * @brief Rebuild the process measurements from the process rows
+ *
+ * @param[out] rows The capture row each returned process was built from, in the same order. Rows with a corrupt PID are
+ * skipped
+ */
+std::vector<processMeasurement> CaptureImporter::buildProcesses(std::vector<const CaptureReader::Row *> &rows) const
+{
+    std::vector<processMeasurement> processes;
+
+    for (const auto &row: mReader.Rows()) {
+        if (row.dataset != "Processes" || row.series.empty()) {
+            continue;
+        }
+
+        pid_t pid;
+        pid_t ppid;
+        if (!parsePid(row.label("PID"), pid) || !parsePid(row.label("PPID"), ppid)) {
+            LOG_WARN("Skipping process '%s' with invalid PID '%s' or PPID '%s'", toString(row.label("Name")).c_str(),
+                     toString(row.label("PID")).c_str(), toString(row.label("PPID")).c_str());
+            continue;
+        }
+
+        // Processes that weren't in the final sample had died by the end of the capture
+        bool dead = lastTimestamp(row.series.front()) < mLastProcessTimestamp;
+
+        Process process(pid,
+                        ppid,
+                        toString(row.label("Name")),
+                        toString(row.label("Cmdline")),
+                        toString(row.label("Systemd Service")),
+                        toString(row.label("Container")),
+                        dead);
+
+        processMeasurement measurement(process);
+        for (const auto seriesId: row.series) {
+            auto values = buildMeasurement(seriesId);
+            const auto name = values.GetName();
+
+            if (name == "Pss") {
+                measurement.Pss = values;
+            } else if (name == "Rss") {
+                measurement.Rss = values;
+            } else if (name == "Uss") {
+                measurement.Uss = values;
+            } else if (name == "Vss") {
+                measurement.Vss = values;
+            } else if (name == "Swap") {
+                measurement.Swap = values;
+            } else if (name == "SwapPss") {
+                measurement.SwapPss = values;
+            } else if (name == "SwapZram") {
+                measurement.SwapZram = values;
+            } else if (name == "Locked") {
+                measurement.Locked = values;
+            }
+        }
+
+        processes.emplace_back(measurement);
+        rows.emplace_back(&row);
+    }
+
+    return processes;
+}
+
+/**
+ * @brief Replay the process PSS samples tick by tick to rebuild the group, service and container totals
+ *
+ * The PSS series are merged by timestamp as they're decoded, so only one sample per process is held at a time
+ *
+ * @param processes Processes from buildProcesses()
+ * @param rows The capture row for each process, from buildProcesses()
+ */
+void CaptureImporter::addAggregatesToReport(const std::vector<processMeasurement> &processes,
+                                            const std::vector<const CaptureReader::Row *> &rows,
+                                            const std::optional<std::shared_ptr<GroupManager>> &groupManager,
+                                            JsonReportGenerator &reportGenerator) const
+{
+    struct cursor
+    {
+        size_t process;
+        CaptureReader::SampleIterator sample;
+        CaptureReader::SampleIterator end;
+    };
+
+    // Earliest sample first, then in process order so each tick is summed in the same order as live
+    auto later = [](const cursor &a, const cursor &b)
+    {
+        if (a.sample->timestamp != b.sample->timestamp) {
+            return a.sample->timestamp > b.sample->timestamp;
+        }
+        return a.process > b.process;
+    };
+    std::priority_queue<cursor, std::vector<cursor>, decltype(later)> pending(later);
+
+    for (size_t i = 0; i < rows.size(); i++) {
+        for (const auto seriesId: rows[i]->series) {
+            if (mReader.AllSeries()[seriesId].measurement != "Pss") {
+                continue;
+            }
+
+            auto samples = mReader.Samples(seriesId);
+            cursor next{i, samples.begin(), samples.end()};
+            if (next.sample != next.end) {
+                pending.push(std::move(next));
+            }
+        }
+    }
+
+    ProcessAggregates aggregates(groupManager);
+    while (!pending.empty()) {
+        const int64_t timestamp = pending.top().sample->timestamp;
+
+        while (!pending.empty() && pending.top().sample->timestamp == timestamp) {
+            auto next = pending.top();
+            pending.pop();
+
+            aggregates.AddSample(processes[next.process].ProcessInfo, next.sample->value);
+            if (++next.sample != next.end) {
+                pending.push(std::move(next));
+            }
+        }
+        aggregates.EndTick();
+    }
+
+    aggregates.AddToReport(reportGenerator);
+}
+
+/**
+ * @brief Rebuild the dataset rows for everything other than processes, laid out the same as on the device
+ */
+std::vector<JsonReportGenerator::dataset> CaptureImporter::buildDatasets() const
+{
+    DatasetBuilder builder;
+
+    // Rows are in the order they first appeared, so they're inserted into the datasets in the same order as live
+    for (const auto &row: mReader.Rows()) {
+        if (row.dataset == "Processes") {
+            continue;
+        }
+
+        const std::string dataset = toString(row.dataset);
+        DatasetBuilder::Labels labels;
+        for (const auto &label: row.labels) {
+            labels.emplace_back(toString(label.first), toString(label.second));
+        }
+
+        for (const auto seriesId: row.series) {
+            const auto &series = mReader.AllSeries()[seriesId];
+
+            DatasetLayout layout;
+            layout.row = row.position == CaptureFormat::kAppendRow ? DatasetLayout::kAppendRow : row.position;
+            layout.column = series.column == CaptureFormat::kAppendColumn ? DatasetLayout::kAppendColumn
+                                                                          : series.column;
+            layout.percentiles = (series.flags & CaptureFormat::kSeriesPercentiles) != 0;
+            if (series.flags & CaptureFormat::kSeriesLatestValue) {
+                layout.latestDecimals = series.decimals;
+            }
+
+            auto &measurement = builder.GetMeasurement(dataset, labels, toString(series.measurement), layout);
+            for (const auto &sample: mReader.Samples(seriesId)) {
+                measurement.AddDataPoint(sample.value);
+            }
+        }
+    }
+
+    return builder.Build();
+}
+
+Measurement CaptureImporter::buildMeasurement(uint32_t series) const
+{
+    const auto &info = mReader.AllSeries()[series];
+    Measurement measurement(toString(info.measurement), (info.flags & CaptureFormat::kSeriesPercentiles) != 0);
+
+    for (const auto &sample: mReader.Samples(series)) {
+        measurement.AddDataPoint(sample.value);
+    }
+
+    return measurement;
+}
+
+int64_t CaptureImporter::lastTimestamp(uint32_t series) const
+{
+    const auto &chunks = mReader.AllSeries()[series].chunks;
+    return chunks.empty() ? 0 : chunks.back().lastTimestamp;
+}
@@ -0,0 +1,66 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "CaptureReader.h"
+#include "GroupManager.h"
+#include "JsonReportGenerator.h"
+#include "Metadata.h"
+#include "ProcessMeasurement.h"
+
+#include <memory>
+
+/**
+ * @brief Rebuild the measurements from a saved capture so a report can be generated from it
+ *
+ * The rebuilt measurements go through the same code the live capture uses to add them to the report, so a report
+ * generated from a capture matches one generated on the device.
+ */
+class CaptureImporter
+{
+public:
+    explicit CaptureImporter(const CaptureReader &reader);
+
+    std::shared_ptr<Metadata> GetMetadata() const;
+
+    void AddToReport(JsonReportGenerator &reportGenerator,
+                     const std::optional<std::shared_ptr<GroupManager>> &groupManager) const;
+
+private:
+    std::vector<processMeasurement> buildProcesses(std::vector<const CaptureReader::Row *> &rows) const;
+
+    void addAggregatesToReport(const std::vector<processMeasurement> &processes,
+                               const std::vector<const CaptureReader::Row *> &rows,
+                               const std::optional<std::shared_ptr<GroupManager>> &groupManager,
+                               JsonReportGenerator &reportGenerator) const;
+
+    std::vector<JsonReportGenerator::dataset> buildDatasets() const;
+
+    Measurement buildMeasurement(uint32_t series) const;
+
+    int64_t lastTimestamp(uint32_t series) const;
+
+private:
+    const CaptureReader &mReader;
+
+    int64_t mFirstTimestamp;
+    int64_t mLastTimestamp;
+    int64_t mLastProcessTimestamp;
+};
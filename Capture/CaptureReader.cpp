@@ -0,0 +1,559 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "CaptureReader.h"
+#include "Log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace CaptureFormat;
+
+template<typename T>
+static bool readValue(const uint8_t *&pos, const uint8_t *end, T &out)
+{
+    if (static_cast<size_t>(end - pos) < sizeof(T)) {
+        return false;
+    }
+
+    // Use memcpy as nothing in the file is guaranteed to be aligned
+    memcpy(&out, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+static size_t alignBlock(size_t offset)
+{
+    return (offset + kBlockAlignment - 1) & ~(kBlockAlignment - 1);
+}
+
+std::string_view CaptureReader::Row::label(std::string_view column) const
+{
+    for (const auto &l: labels) {
+        if (l.first == column) {
+            return l.second;
+        }
+    }
+    return {};
+}
+
+CaptureReader::CaptureReader(const std::filesystem::path &path)
+        : mFd(-1),
+          mData(nullptr),
+          mSize(0),
+          mComplete(false)
+{
+    mFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to open capture file %s", path.string().c_str());
+        return;
+    }
+
+    struct stat s{};
+    if (fstat(mFd, &s) < 0 || s.st_size < (off_t) sizeof(FileHeader)) {
+        LOG_ERROR("Capture file %s is too small to be valid", path.string().c_str());
+        close(mFd);
+        mFd = -1;
+        return;
+    }
+
+    mSize = s.st_size;
+    void *map = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+    if (map == MAP_FAILED) {
+        LOG_SYS_ERROR(errno, "Failed to map capture file %s", path.string().c_str());
+        close(mFd);
+        mFd = -1;
+        return;
+    }
+    mData = static_cast<const uint8_t *>(map);
+
+    // We mostly walk through the file front to back
+    madvise(map, mSize, MADV_SEQUENTIAL);
+
+    FileHeader header{};
+    memcpy(&header, mData, sizeof(header));
+    if (memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0 || header.version != kVersion) {
+        LOG_ERROR("%s is not a supported capture file", path.string().c_str());
+        munmap(map, mSize);
+        mData = nullptr;
+        close(mFd);
+        mFd = -1;
+        return;
+    }
+
+    mComplete = readIndex();
+    if (!mComplete) {
+        LOG_WARN("Capture %s was not closed cleanly, scanning for data", path.string().c_str());
+        mStrings.clear();
+        mRows.clear();
+        mSeries.clear();
+        mMetadata.clear();
+        scanBlocks();
+    }
+
+    linkSeriesToRows();
+}
+
+CaptureReader::~CaptureReader()
+{
+    if (mData) {
+        munmap(const_cast<uint8_t *>(mData), mSize);
+    }
+
+    if (mFd >= 0) {
+        close(mFd);
+    }
+}
+
+bool CaptureReader::IsOpen() const
+{
+    return mData != nullptr;
+}
+
+/**
+ * @return True if the capture was closed cleanly. If false, the capture may be missing up to one flush interval of data
+ */
+bool CaptureReader::IsComplete() const
+{
+    return mComplete;
+}
+
+const std::vector<CaptureReader::Row> &CaptureReader::Rows() const
+{
+    return mRows;
+}
+
+const std::vector<CaptureReader::Series> &CaptureReader::AllSeries() const
+{
+    return mSeries;
+}
+
+std::string_view CaptureReader::String(uint32_t id) const
+{
+    if (id >= mStrings.size()) {
+        return {};
+    }
+    return mStrings[id];
+}
+
+/**
+ * @return The metadata value saved with the capture, or an empty string if it wasn't saved
+ */
+std::string_view CaptureReader::GetMetadata(std::string_view key) const
+{
+    auto itr = mMetadata.find(key);
+    if (itr == mMetadata.end()) {
+        return {};
+    }
+    return itr->second;
+}
+
+CaptureReader::SampleRange CaptureReader::Samples(uint32_t series) const
+{
+    if (series >= mSeries.size()) {
+        return {this, nullptr};
+    }
+    return {this, &mSeries[series]};
+}
+
+/**
+ * @brief Load all the definitions and chunk locations using the index at the end of the file
+ *
+ * @return False if there's no valid index
+ */
+bool CaptureReader::readIndex()
+{
+    if (mSize < sizeof(FileHeader) + sizeof(Trailer)) {
+        return false;
+    }
+
+    Trailer trailer{};
+    memcpy(&trailer, mData + mSize - sizeof(Trailer), sizeof(trailer));
+    if (memcmp(trailer.magic, kTrailerMagic, sizeof(kTrailerMagic)) != 0) {
+        return false;
+    }
+
+    BlockHeader header{};
+    const uint8_t *pos;
+    if (!blockAt(trailer.indexOffset, header, pos) || header.type != (uint32_t) BlockType::Index) {
+        return false;
+    }
+    const uint8_t *end = pos + header.length;
+
+    uint32_t definitionCount;
+    if (!readValue(pos, end, definitionCount)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < definitionCount; i++) {
+        uint64_t offset;
+        if (!readValue(pos, end, offset) || !parseDefinitionBlock(offset)) {
+            return false;
+        }
+    }
+
+    uint32_t seriesCount;
+    if (!readValue(pos, end, seriesCount) || seriesCount != mSeries.size()) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < seriesCount; i++) {
+        uint32_t seriesId;
+        uint32_t chunkCount;
+        if (!readValue(pos, end, seriesId) || !readValue(pos, end, chunkCount) || seriesId >= mSeries.size()) {
+            return false;
+        }
+
+        auto &series = mSeries[seriesId];
+        series.chunks.reserve(chunkCount);
+        for (uint32_t c = 0; c < chunkCount; c++) {
+            ChunkIndexEntry entry{};
+            if (!readValue(pos, end, entry)) {
+                return false;
+            }
+            series.chunks.emplace_back(entry);
+            series.sampleCount += entry.count;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Walk every block in the file from the start. Used when there's no index
+ *
+ * Stops at the first block that is truncated or corrupt - anything before that point is still usable
+ */
+bool CaptureReader::scanBlocks()
+{
+    uint64_t offset = sizeof(FileHeader);
+
+    while (offset < mSize) {
+        BlockHeader header{};
+        const uint8_t *pos;
+        if (!blockAt(offset, header, pos)) {
+            LOG_WARN("Capture truncated at offset %llu", (unsigned long long) offset);
+            return false;
+        }
+        const uint8_t *end = pos + header.length;
+
+        bool valid = true;
+        switch (static_cast<BlockType>(header.type)) {
+            case BlockType::StringTable:
+                valid = parseStringTable(pos, end);
+                break;
+            case BlockType::RowTable:
+                valid = parseRowTable(pos, end);
+                break;
+            case BlockType::SeriesTable:
+                valid = parseSeriesTable(pos, end);
+                break;
+            case BlockType::Metadata:
+                valid = parseMetadata(pos, end);
+                break;
+            case BlockType::Chunk:
+                valid = indexChunk(offset, pos, end);
+                break;
+            case BlockType::Index:
+                // Index is always last
+                return true;
+            default:
+                // Unknown block, skip it
+                break;
+        }
+
+        if (!valid) {
+            LOG_WARN("Corrupt block at offset %llu", (unsigned long long) offset);
+            return false;
+        }
+
+        offset = alignBlock(offset + sizeof(BlockHeader) + header.length);
+    }
+
+    return true;
+}
+
+bool CaptureReader::parseDefinitionBlock(uint64_t offset)
+{
+    BlockHeader header{};
+    const uint8_t *pos;
+    if (!blockAt(offset, header, pos)) {
+        return false;
+    }
+    const uint8_t *end = pos + header.length;
+
+    switch (static_cast<BlockType>(header.type)) {
+        case BlockType::StringTable:
+            return parseStringTable(pos, end);
+        case BlockType::RowTable:
+            return parseRowTable(pos, end);
+        case BlockType::SeriesTable:
+            return parseSeriesTable(pos, end);
+        case BlockType::Metadata:
+            return parseMetadata(pos, end);
+        default:
+            return false;
+    }
+}
+
+bool CaptureReader::parseStringTable(const uint8_t *pos, const uint8_t *end)
+{
+    uint32_t firstId;
+    uint32_t count;
+    if (!readValue(pos, end, firstId) || !readValue(pos, end, count) || firstId != mStrings.size()) {
+        return false;
+    }
+
+    mStrings.reserve(mStrings.size() + count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length;
+        if (!readValue(pos, end, length) || static_cast<size_t>(end - pos) < length) {
+            return false;
+        }
+        mStrings.emplace_back(reinterpret_cast<const char *>(pos), length);
+        pos += length;
+    }
+
+    return true;
+}
+
+bool CaptureReader::parseRowTable(const uint8_t *pos, const uint8_t *end)
+{
+    uint32_t firstId;
+    uint32_t count;
+    if (!readValue(pos, end, firstId) || !readValue(pos, end, count) || firstId != mRows.size()) {
+        return false;
+    }
+
+    mRows.reserve(mRows.size() + count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t dataset;
+        uint32_t position;
+        uint16_t labelCount;
+        if (!readValue(pos, end, dataset) || !readValue(pos, end, position) || !readValue(pos, end, labelCount)) {
+            return false;
+        }
+
+        Row row;
+        row.dataset = String(dataset);
+        row.position = position;
+        for (uint16_t l = 0; l < labelCount; l++) {
+            uint32_t column;
+            uint32_t value;
+            if (!readValue(pos, end, column) || !readValue(pos, end, value)) {
+                return false;
+            }
+            row.labels.emplace_back(String(column), String(value));
+        }
+        mRows.emplace_back(std::move(row));
+    }
+
+    return true;
+}
+
+bool CaptureReader::parseSeriesTable(const uint8_t *pos, const uint8_t *end)
+{
+    uint32_t firstId;
+    uint32_t count;
+    if (!readValue(pos, end, firstId) || !readValue(pos, end, count) || firstId != mSeries.size()) {
+        return false;
+    }
+
+    mSeries.reserve(mSeries.size() + count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t row;
+        uint32_t measurement;
+        uint16_t column;
+        uint8_t flags;
+        int8_t decimals;
+        if (!readValue(pos, end, row) || !readValue(pos, end, measurement) || !readValue(pos, end, column) ||
+            !readValue(pos, end, flags) || !readValue(pos, end, decimals) || row >= mRows.size()) {
+            return false;
+        }
+        mSeries.emplace_back(Series{row, String(measurement), column, flags, decimals, 0, {}});
+    }
+
+    return true;
+}
+
+bool CaptureReader::parseMetadata(const uint8_t *pos, const uint8_t *end)
+{
+    uint32_t count;
+    if (!readValue(pos, end, count)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t key;
+        uint32_t value;
+        if (!readValue(pos, end, key) || !readValue(pos, end, value)) {
+            return false;
+        }
+        mMetadata[String(key)] = String(value);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Add a chunk found while scanning to the series it belongs to
+ */
+bool CaptureReader::indexChunk(uint64_t offset, const uint8_t *pos, const uint8_t *end)
+{
+    uint32_t seriesId;
+    ChunkIndexEntry entry{};
+    entry.offset = offset;
+    int64_t firstValue;
+
+    if (!readValue(pos, end, seriesId) || !readValue(pos, end, entry.count) ||
+        !readValue(pos, end, entry.firstTimestamp) || !readValue(pos, end, firstValue) ||
+        seriesId >= mSeries.size() || entry.count == 0) {
+        return false;
+    }
+
+    // Walk the deltas to find the last timestamp
+    entry.lastTimestamp = entry.firstTimestamp;
+    for (uint32_t i = 1; i < entry.count; i++) {
+        uint64_t timestampDelta;
+        uint64_t valueDelta;
+        pos = readVarint(pos, end, timestampDelta);
+        if (!pos) {
+            return false;
+        }
+        pos = readVarint(pos, end, valueDelta);
+        if (!pos) {
+            return false;
+        }
+        entry.lastTimestamp += zigzagDecode(timestampDelta);
+    }
+
+    auto &series = mSeries[seriesId];
+    series.chunks.emplace_back(entry);
+    series.sampleCount += entry.count;
+    return true;
+}
+
+/**
+ * @brief Get the header and payload of the block at the given offset, checking it fits in the file
+ */
+bool CaptureReader::blockAt(uint64_t offset, BlockHeader &header, const uint8_t *&payload) const
+{
+    if (offset < sizeof(FileHeader) || offset > mSize || mSize - offset < sizeof(BlockHeader)) {
+        return false;
+    }
+
+    memcpy(&header, mData + offset, sizeof(header));
+    if (mSize - offset - sizeof(BlockHeader) < header.length) {
+        return false;
+    }
+
+    payload = mData + offset + sizeof(BlockHeader);
+    return true;
+}
+
+void CaptureReader::linkSeriesToRows()
+{
+    for (uint32_t i = 0; i < mSeries.size(); i++) {
+        mRows[mSeries[i].row].series.emplace_back(i);
+    }
+}
+
+CaptureReader::SampleIterator::SampleIterator(const CaptureReader *reader, const Series *series)
+        : mReader(reader),
+          mSeries(series)
+{
+    if (!mSeries || mSeries->chunks.empty()) {
+        *this = SampleIterator();
+        return;
+    }
+
+    loadChunk();
+}
+
+CaptureReader::SampleIterator &CaptureReader::SampleIterator::operator++()
+{
+    if (!mSeries) {
+        return *this;
+    }
+
+    if (--mRemaining == 0) {
+        // Move on to the next chunk
+        mChunk++;
+        if (mChunk >= mSeries->chunks.size()) {
+            *this = SampleIterator();
+        } else {
+            loadChunk();
+        }
+        return *this;
+    }
+
+    uint64_t timestampDelta;
+    uint64_t valueDelta;
+    const uint8_t *pos = readVarint(mPos, mEnd, timestampDelta);
+    if (pos) {
+        pos = readVarint(pos, mEnd, valueDelta);
+    }
+
+    if (!pos) {
+        // Chunk is corrupt, give up on the series
+        LOG_WARN("Corrupt chunk in capture");
+        *this = SampleIterator();
+        return *this;
+    }
+
+    mPos = pos;
+    mSample.timestamp += zigzagDecode(timestampDelta);
+    mRawValue += zigzagDecode(valueDelta);
+    mSample.value = mRawValue / kValueScale;
+
+    return *this;
+}
+
+/**
+ * @brief Position the iterator at the first sample in the current chunk
+ */
+void CaptureReader::SampleIterator::loadChunk()
+{
+    const auto &entry = mSeries->chunks[mChunk];
+
+    BlockHeader header{};
+    const uint8_t *pos;
+    uint32_t seriesId;
+    uint32_t count;
+
+    if (!mReader->blockAt(entry.offset, header, pos) || header.type != (uint32_t) BlockType::Chunk) {
+        *this = SampleIterator();
+        return;
+    }
+    mEnd = pos + header.length;
+
+    if (!readValue(pos, mEnd, seriesId) || !readValue(pos, mEnd, count) ||
+        !readValue(pos, mEnd, mSample.timestamp) || !readValue(pos, mEnd, mRawValue) || count == 0) {
+        *this = SampleIterator();
+        return;
+    }
+
+    mPos = pos;
+    mRemaining = count;
+    mSample.value = mRawValue / kValueScale;
+}
@@ -0,0 +1,197 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "CaptureFormat.h"
+
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Read a capture file written by CaptureWriter
+ *
+ * The file is mapped into memory and nothing is copied out of it - strings are returned as views into the mapping and
+ * samples are decoded on the fly as a series is iterated. The reader (and anything returned from it) must outlive any
+ * string_views taken from it.
+ *
+ * Captures that were not closed cleanly (no index) are still readable, the reader scans the file instead.
+ */
+class CaptureReader
+{
+public:
+    struct Row
+    {
+        std::string_view dataset;
+        uint32_t position;
+        std::vector<std::pair<std::string_view, std::string_view>> labels;
+        std::vector<uint32_t> series;
+
+        std::string_view label(std::string_view column) const;
+    };
+
+    struct Series
+    {
+        uint32_t row;
+        std::string_view measurement;
+        uint16_t column;
+        uint8_t flags;
+        int8_t decimals;
+        uint64_t sampleCount;
+        std::vector<CaptureFormat::ChunkIndexEntry> chunks;
+    };
+
+    struct Sample
+    {
+        int64_t timestamp;
+        double value;
+    };
+
+    /**
+     * @brief Decodes the samples in a series one at a time, straight from the mapped file
+     */
+    class SampleIterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Sample;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Sample *;
+        using reference = const Sample &;
+
+        SampleIterator() = default;
+
+        SampleIterator(const CaptureReader *reader, const Series *series);
+
+        reference operator*() const
+        {
+            return mSample;
+        }
+
+        pointer operator->() const
+        {
+            return &mSample;
+        }
+
+        SampleIterator &operator++();
+
+        bool operator==(const SampleIterator &rhs) const
+        {
+            return mSeries == rhs.mSeries && mChunk == rhs.mChunk && mRemaining == rhs.mRemaining;
+        }
+
+        bool operator!=(const SampleIterator &rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+    private:
+        void loadChunk();
+
+        const CaptureReader *mReader = nullptr;
+        const Series *mSeries = nullptr;
+        size_t mChunk = 0;
+        uint32_t mRemaining = 0;
+        const uint8_t *mPos = nullptr;
+        const uint8_t *mEnd = nullptr;
+        int64_t mRawValue = 0;
+        Sample mSample{};
+    };
+
+    class SampleRange
+    {
+    public:
+        SampleRange(const CaptureReader *reader, const Series *series) : mReader(reader), mSeries(series)
+        {
+        }
+
+        SampleIterator begin() const
+        {
+            return {mReader, mSeries};
+        }
+
+        SampleIterator end() const
+        {
+            return {};
+        }
+
+    private:
+        const CaptureReader *mReader;
+        const Series *mSeries;
+    };
+
+public:
+    explicit CaptureReader(const std::filesystem::path &path);
+
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader &) = delete;
+
+    CaptureReader &operator=(const CaptureReader &) = delete;
+
+    bool IsOpen() const;
+
+    bool IsComplete() const;
+
+    const std::vector<Row> &Rows() const;
+
+    const std::vector<Series> &AllSeries() const;
+
+    std::string_view String(uint32_t id) const;
+
+    std::string_view GetMetadata(std::string_view key) const;
+
+    SampleRange Samples(uint32_t series) const;
+
+private:
+    bool readIndex();
+
+    bool scanBlocks();
+
+    bool parseDefinitionBlock(uint64_t offset);
+
+    bool parseStringTable(const uint8_t *pos, const uint8_t *end);
+
+    bool parseRowTable(const uint8_t *pos, const uint8_t *end);
+
+    bool parseSeriesTable(const uint8_t *pos, const uint8_t *end);
+
+    bool parseMetadata(const uint8_t *pos, const uint8_t *end);
+
+    bool indexChunk(uint64_t offset, const uint8_t *pos, const uint8_t *end);
+
+    bool blockAt(uint64_t offset, CaptureFormat::BlockHeader &header, const uint8_t *&payload) const;
+
+    void linkSeriesToRows();
+
+private:
+    int mFd;
+    const uint8_t *mData;
+    size_t mSize;
+    bool mComplete;
+
+    std::vector<std::string_view> mStrings;
+    std::vector<Row> mRows;
+    std::vector<Series> mSeries;
+    std::map<std::string_view, std::string_view> mMetadata;
+};
@@ -0,0 +1,557 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "CaptureWriter.h"
+#include "Log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace CaptureFormat;
+
+// Write the buffer out once it gets this big, even if the flush interval hasn't expired
+static constexpr size_t kWriteThreshold = 64 * 1024;
+
+// Column labels and measurement names used for process rows. Measurement names match processMeasurement
+static const std::vector<std::string> kProcessMeasurements = {"Pss", "Rss", "Uss", "Vss", "Swap", "SwapPss",
+                                                              "SwapZram", "Locked"};
+
+CaptureWriter::CaptureWriter(std::filesystem::path path,
+                             std::chrono::milliseconds flushInterval,
+                             uint32_t maxChunkSamples)
+        : mPath(std::move(path)),
+          mFlushInterval(flushInterval),
+          mMaxChunkSamples(maxChunkSamples),
+          mFd(-1),
+          mQuit(false),
+          mCv(),
+          mWrittenBytes(0),
+          mUnsynced(false),
+          mWriteFailed(false),
+          mFinished(false),
+          mPendingRowCount(0),
+          mPendingSeriesCount(0)
+{
+    mFd = open(mPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to open capture file %s", mPath.string().c_str());
+        return;
+    }
+
+    mBuffer.reserve(kWriteThreshold * 2);
+
+    FileHeader header{};
+    memcpy(header.magic, kFileMagic, sizeof(header.magic));
+    header.version = kVersion;
+    append(header);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    Stop();
+
+    if (mFd >= 0) {
+        close(mFd);
+    }
+}
+
+bool CaptureWriter::IsOpen() const
+{
+    return mFd >= 0;
+}
+
+void CaptureWriter::Start()
+{
+    if (!IsOpen()) {
+        return;
+    }
+
+    mQuit = false;
+    mWriterThread = std::thread(&CaptureWriter::WriteData, this);
+}
+
+/**
+ * @brief Write out everything still queued, then finish the capture file with the index and trailer
+ */
+void CaptureWriter::Stop()
+{
+    std::unique_lock<std::mutex> locker(mLock);
+    mQuit = true;
+    mCv.notify_all();
+    locker.unlock();
+
+    if (mWriterThread.joinable()) {
+        LOG_INFO("Waiting for capture writer thread to terminate");
+        mWriterThread.join();
+    }
+}
+
+/**
+ * @brief Queue a tick to be written to disk. Does not block on any IO
+ */
+void CaptureWriter::AddTick(const std::shared_ptr<const TickSamples> &tick)
+{
+    if (!IsOpen()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> locker(mLock);
+    mQueue.emplace_back(tick);
+    mCv.notify_all();
+}
+
+/**
+ * @brief Save a piece of information about the capture (e.g. platform). Setting the same key again overrides it
+ */
+void CaptureWriter::AddMetadata(const std::string &key, const std::string &value)
+{
+    if (!IsOpen()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> locker(mLock);
+    mMetadataQueue.emplace_back(key, value);
+    mCv.notify_all();
+}
+
+void CaptureWriter::WriteData()
+{
+    auto lastFlush = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mLock);
+
+    while (true) {
+        mCv.wait_for(lock, mFlushInterval, [&]
+        {
+            return mQuit || !mQueue.empty() || !mMetadataQueue.empty();
+        });
+
+        // Take everything queued so far and serialise it without holding the lock
+        std::deque<std::shared_ptr<const TickSamples>> pending;
+        pending.swap(mQueue);
+        std::vector<std::pair<std::string, std::string>> metadata;
+        metadata.swap(mMetadataQueue);
+        bool quit = mQuit;
+        lock.unlock();
+
+        if (!metadata.empty()) {
+            writeMetadata(metadata);
+        }
+
+        for (const auto &tick: pending) {
+            writeTick(*tick);
+        }
+        pending.clear();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastFlush >= mFlushInterval || quit) {
+            writeAllChunks();
+            flush();
+            sync();
+            lastFlush = now;
+        } else if (mBuffer.size() >= kWriteThreshold) {
+            flush();
+        }
+
+        lock.lock();
+        if (quit && mQueue.empty() && mMetadataQueue.empty()) {
+            break;
+        }
+    }
+
+    lock.unlock();
+
+    if (!mFinished) {
+        writeIndex();
+        flush();
+        sync();
+        mFinished = true;
+    }
+
+    LOG_INFO("Capture writer thread quit");
+}
+
+void CaptureWriter::writeTick(const TickSamples &tick)
+{
+    const int64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            tick.timestamp.time_since_epoch()).count();
+
+    for (const auto &process: tick.processes) {
+        // Same identity as Process::operator== so a recycled PID is treated as a new process
+        auto key = std::make_pair(process.process.pid(), process.process.cmdline());
+        auto itr = mProcessSeries.find(key);
+
+        if (itr == mProcessSeries.end()) {
+            const std::vector<std::pair<std::string, std::string>> labels{
+                    {"PID",             std::to_string(process.process.pid())},
+                    {"PPID",            std::to_string(process.process.ppid())},
+                    {"Name",            process.process.name()},
+                    {"Cmdline",         process.process.cmdline()},
+                    {"Systemd Service", process.process.systemdService().value_or("")},
+                    {"Container",       process.process.container().value_or("")}
+            };
+            uint32_t row = internRow("Processes", labels);
+
+            std::array<uint32_t, 8> series{};
+            for (size_t i = 0; i < series.size(); i++) {
+                series[i] = internSeries(row, kProcessMeasurements[i]);
+            }
+            itr = mProcessSeries.emplace(std::move(key), series).first;
+        }
+
+        const auto &series = itr->second;
+        addSample(series[0], timestamp, process.pss);
+        addSample(series[1], timestamp, process.rss);
+        addSample(series[2], timestamp, process.uss);
+        addSample(series[3], timestamp, process.vss);
+        addSample(series[4], timestamp, process.swap);
+        addSample(series[5], timestamp, process.swap_pss);
+        addSample(series[6], timestamp, process.swap_zram);
+        addSample(series[7], timestamp, process.locked);
+    }
+
+    for (const auto &sample: tick.datasets) {
+        uint32_t row = internRow(sample.dataset, sample.labels, sample.layout);
+        addSample(internSeries(row, sample.measurement, sample.layout), timestamp, sample.value);
+    }
+}
+
+/**
+ * @return The id of the string in the string table, adding it to the table if this is the first time we've seen it
+ */
+uint32_t CaptureWriter::internString(const std::string &value)
+{
+    auto itr = mStrings.find(value);
+    if (itr != mStrings.end()) {
+        return itr->second;
+    }
+
+    auto id = static_cast<uint32_t>(mStrings.size());
+    itr = mStrings.emplace(value, id).first;
+    mPendingStrings.emplace_back(&itr->first);
+
+    return id;
+}
+
+/**
+ * @param layout Where the row goes in its dataset. Only the position when the row is first seen is kept
+ */
+uint32_t CaptureWriter::internRow(const std::string &dataset,
+                                  const std::vector<std::pair<std::string, std::string>> &labels,
+                                  const DatasetLayout &layout)
+{
+    std::string key = dataset;
+    for (const auto &label: labels) {
+        key += '\x1f' + label.first + '\x1e' + label.second;
+    }
+
+    auto itr = mRows.find(key);
+    if (itr != mRows.end()) {
+        return itr->second;
+    }
+
+    auto id = static_cast<uint32_t>(mRows.size());
+    mRows.emplace(std::move(key), id);
+
+    // Serialise the definition now, it's written out before any chunk that could refer to it
+    auto appendU32 = [&](uint32_t v)
+    {
+        mPendingRows.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    };
+
+    appendU32(internString(dataset));
+    appendU32(layout.row == DatasetLayout::kAppendRow ? kAppendRow : layout.row);
+    auto labelCount = static_cast<uint16_t>(labels.size());
+    mPendingRows.append(reinterpret_cast<const char *>(&labelCount), sizeof(labelCount));
+    for (const auto &label: labels) {
+        appendU32(internString(label.first));
+        appendU32(internString(label.second));
+    }
+    mPendingRowCount++;
+
+    return id;
+}
+
+uint32_t CaptureWriter::internSeries(uint32_t row, const std::string &measurement, const DatasetLayout &layout)
+{
+    auto key = std::make_pair(row, measurement);
+    auto itr = mSeriesIds.find(key);
+    if (itr != mSeriesIds.end()) {
+        return itr->second;
+    }
+
+    auto id = static_cast<uint32_t>(mSeries.size());
+    mSeriesIds.emplace(std::move(key), id);
+    mSeries.emplace_back();
+
+    uint32_t measurementId = internString(measurement);
+    mPendingSeries.append(reinterpret_cast<const char *>(&row), sizeof(row));
+    mPendingSeries.append(reinterpret_cast<const char *>(&measurementId), sizeof(measurementId));
+
+    const uint16_t column = layout.column == DatasetLayout::kAppendColumn ? kAppendColumn : layout.column;
+    uint8_t flags = layout.percentiles ? kSeriesPercentiles : 0;
+    if (layout.latestDecimals >= 0) {
+        flags |= kSeriesLatestValue;
+    }
+    const int8_t decimals = std::max<int8_t>(layout.latestDecimals, 0);
+    mPendingSeries.append(reinterpret_cast<const char *>(&column), sizeof(column));
+    mPendingSeries.append(reinterpret_cast<const char *>(&flags), sizeof(flags));
+    mPendingSeries.append(reinterpret_cast<const char *>(&decimals), sizeof(decimals));
+    mPendingSeriesCount++;
+
+    return id;
+}
+
+void CaptureWriter::addSample(uint32_t series, int64_t timestamp, long double value)
+{
+    auto &s = mSeries[series];
+    s.pending.emplace_back(timestamp, static_cast<int64_t>(std::llround(value * kValueScale)));
+
+    if (s.pending.size() >= mMaxChunkSamples) {
+        writeChunk(series);
+    }
+}
+
+/**
+ * @brief Write out any strings, rows and series that have been added since the last time
+ *
+ * Must be called before writing a chunk so readers scanning the file always see a series before its samples
+ */
+void CaptureWriter::writeDefinitions()
+{
+    if (!mPendingStrings.empty()) {
+        mDefinitionOffsets.emplace_back(currentOffset());
+        size_t block = beginBlock(BlockType::StringTable);
+
+        append<uint32_t>(mStrings.size() - mPendingStrings.size());
+        append<uint32_t>(mPendingStrings.size());
+        for (const auto *str: mPendingStrings) {
+            append<uint32_t>(str->size());
+            mBuffer.append(*str);
+        }
+        endBlock(block);
+        mPendingStrings.clear();
+    }
+
+    if (mPendingRowCount > 0) {
+        mDefinitionOffsets.emplace_back(currentOffset());
+        size_t block = beginBlock(BlockType::RowTable);
+
+        append<uint32_t>(mRows.size() - mPendingRowCount);
+        append<uint32_t>(mPendingRowCount);
+        mBuffer.append(mPendingRows);
+        endBlock(block);
+
+        mPendingRows.clear();
+        mPendingRowCount = 0;
+    }
+
+    if (mPendingSeriesCount > 0) {
+        mDefinitionOffsets.emplace_back(currentOffset());
+        size_t block = beginBlock(BlockType::SeriesTable);
+
+        append<uint32_t>(mSeries.size() - mPendingSeriesCount);
+        append<uint32_t>(mPendingSeriesCount);
+        mBuffer.append(mPendingSeries);
+        endBlock(block);
+
+        mPendingSeries.clear();
+        mPendingSeriesCount = 0;
+    }
+}
+
+void CaptureWriter::writeMetadata(const std::vector<std::pair<std::string, std::string>> &metadata)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> ids;
+    for (const auto &item: metadata) {
+        ids.emplace_back(internString(item.first), internString(item.second));
+    }
+    writeDefinitions();
+
+    mDefinitionOffsets.emplace_back(currentOffset());
+    size_t block = beginBlock(BlockType::Metadata);
+    append<uint32_t>(ids.size());
+    for (const auto &id: ids) {
+        append(id.first);
+        append(id.second);
+    }
+    endBlock(block);
+}
+
+void CaptureWriter::writeChunk(uint32_t seriesId)
+{
+    auto &series = mSeries[seriesId];
+    if (series.pending.empty()) {
+        return;
+    }
+
+    writeDefinitions();
+
+    ChunkIndexEntry entry{};
+    entry.offset = currentOffset();
+    entry.count = series.pending.size();
+    entry.firstTimestamp = series.pending.front().first;
+    entry.lastTimestamp = series.pending.back().first;
+
+    size_t block = beginBlock(BlockType::Chunk);
+    append(seriesId);
+    append<uint32_t>(series.pending.size());
+    append(series.pending.front().first);
+    append(series.pending.front().second);
+
+    for (size_t i = 1; i < series.pending.size(); i++) {
+        appendVarint(zigzagEncode(series.pending[i].first - series.pending[i - 1].first));
+        appendVarint(zigzagEncode(series.pending[i].second - series.pending[i - 1].second));
+    }
+    endBlock(block);
+
+    series.chunks.emplace_back(entry);
+    series.pending.clear();
+
+    if (mBuffer.size() >= kWriteThreshold) {
+        flush();
+    }
+}
+
+void CaptureWriter::writeAllChunks()
+{
+    writeDefinitions();
+
+    for (uint32_t i = 0; i < mSeries.size(); i++) {
+        writeChunk(i);
+    }
+}
+
+void CaptureWriter::writeIndex()
+{
+    writeAllChunks();
+
+    uint64_t indexOffset = currentOffset();
+    size_t block = beginBlock(BlockType::Index);
+
+    append<uint32_t>(mDefinitionOffsets.size());
+    for (const auto offset: mDefinitionOffsets) {
+        append(offset);
+    }
+
+    append<uint32_t>(mSeries.size());
+    for (uint32_t i = 0; i < mSeries.size(); i++) {
+        append(i);
+        append<uint32_t>(mSeries[i].chunks.size());
+        for (const auto &chunk: mSeries[i].chunks) {
+            append(chunk);
+        }
+    }
+    endBlock(block);
+
+    Trailer trailer{};
+    trailer.indexOffset = indexOffset;
+    memcpy(trailer.magic, kTrailerMagic, sizeof(trailer.magic));
+    append(trailer);
+}
+
+size_t CaptureWriter::beginBlock(BlockType type)
+{
+    size_t start = mBuffer.size();
+
+    // Length is filled in by endBlock
+    BlockHeader header{static_cast<uint32_t>(type), 0};
+    append(header);
+    return start;
+}
+
+void CaptureWriter::endBlock(size_t blockStart)
+{
+    auto length = static_cast<uint32_t>(mBuffer.size() - blockStart - sizeof(BlockHeader));
+    memcpy(&mBuffer[blockStart + offsetof(BlockHeader, length)], &length, sizeof(length));
+
+    // Pad so the next block is aligned
+    size_t padding = (kBlockAlignment - (mBuffer.size() % kBlockAlignment)) % kBlockAlignment;
+    mBuffer.append(padding, '\0');
+}
+
+void CaptureWriter::appendVarint(uint64_t value)
+{
+    while (value >= 0x80) {
+        mBuffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    mBuffer.push_back(static_cast<char>(value));
+}
+
+/**
+ * @return Offset in the file that the next byte appended to the buffer will end up at
+ */
+uint64_t CaptureWriter::currentOffset() const
+{
+    return mWrittenBytes + mBuffer.size();
+}
+
+/**
+ * @brief Write the current buffer to disk
+ *
+ * @return False if the write failed. We keep collecting if this happens - the in-memory report is still generated
+ */
+bool CaptureWriter::flush()
+{
+    if (mWriteFailed) {
+        mBuffer.clear();
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < mBuffer.size()) {
+        ssize_t ret = write(mFd, mBuffer.data() + written, mBuffer.size() - written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Anything written after a partial block would be unreadable, so give up on the file entirely. The
+            // capture up to this point can still be read
+            LOG_SYS_ERROR(errno, "Failed to write to capture file %s", mPath.string().c_str());
+            mWriteFailed = true;
+            break;
+        }
+        written += ret;
+    }
+
+    if (written > 0) {
+        mUnsynced = true;
+    }
+
+    mWrittenBytes += written;
+    mBuffer.clear();
+    return !mWriteFailed;
+}
+
+void CaptureWriter::sync()
+{
+    if (!mUnsynced) {
+        return;
+    }
+
+    if (fdatasync(mFd) < 0) {
+        LOG_SYS_WARN(errno, "Failed to sync capture file %s", mPath.string().c_str());
+    }
+    mUnsynced = false;
+}
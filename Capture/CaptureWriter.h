@@ -0,0 +1,150 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ISampleSink.h"
+#include "CaptureFormat.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * @brief Streams every sample to disk as it is collected, so a capture survives MemCapture being killed part way through
+ *
+ * Ticks are queued by the collection threads and handed to a dedicated writer thread, which appends them to a capture
+ * file (see CaptureFormat.h). Samples are buffered per series and written out as delta-encoded chunks when a chunk
+ * fills up or the flush interval expires, after which the file is fdatasync'd - so at most one flush interval of data is
+ * lost if the device loses power.
+ *
+ * The index and trailer are only written when the writer is stopped cleanly.
+ */
+class CaptureWriter : public ISampleSink
+{
+public:
+    explicit CaptureWriter(std::filesystem::path path,
+                           std::chrono::milliseconds flushInterval = std::chrono::seconds(30),
+                           uint32_t maxChunkSamples = 1024);
+
+    ~CaptureWriter() override;
+
+    bool IsOpen() const;
+
+    void Start();
+
+    void Stop();
+
+    void AddTick(const std::shared_ptr<const TickSamples> &tick) override;
+
+    void AddMetadata(const std::string &key, const std::string &value);
+
+private:
+    struct Series
+    {
+        std::vector<std::pair<int64_t, int64_t>> pending;
+        std::vector<CaptureFormat::ChunkIndexEntry> chunks;
+    };
+
+    void WriteData();
+
+    void writeTick(const TickSamples &tick);
+
+    uint32_t internString(const std::string &value);
+
+    uint32_t internRow(const std::string &dataset, const std::vector<std::pair<std::string, std::string>> &labels,
+                       const DatasetLayout &layout = {});
+
+    uint32_t internSeries(uint32_t row, const std::string &measurement, const DatasetLayout &layout = {});
+
+    void addSample(uint32_t series, int64_t timestamp, long double value);
+
+    void writeDefinitions();
+
+    void writeMetadata(const std::vector<std::pair<std::string, std::string>> &metadata);
+
+    void writeChunk(uint32_t seriesId);
+
+    void writeAllChunks();
+
+    void writeIndex();
+
+    size_t beginBlock(CaptureFormat::BlockType type);
+
+    void endBlock(size_t blockStart);
+
+    template<typename T>
+    void append(T value)
+    {
+        mBuffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void appendVarint(uint64_t value);
+
+    uint64_t currentOffset() const;
+
+    bool flush();
+
+    void sync();
+
+private:
+    const std::filesystem::path mPath;
+    const std::chrono::milliseconds mFlushInterval;
+    const uint32_t mMaxChunkSamples;
+
+    int mFd;
+
+    std::thread mWriterThread;
+    bool mQuit;
+    std::condition_variable mCv;
+    std::mutex mLock;
+
+    std::deque<std::shared_ptr<const TickSamples>> mQueue;
+    std::vector<std::pair<std::string, std::string>> mMetadataQueue;
+
+    // Everything below is only touched by the writer thread
+    std::string mBuffer;
+    uint64_t mWrittenBytes;
+    bool mUnsynced;
+    bool mWriteFailed;
+    bool mFinished;
+
+    std::unordered_map<std::string, uint32_t> mStrings;
+    std::vector<const std::string *> mPendingStrings;
+
+    std::unordered_map<std::string, uint32_t> mRows;
+    std::string mPendingRows;
+    uint32_t mPendingRowCount;
+
+    std::map<std::pair<uint32_t, std::string>, uint32_t> mSeriesIds;
+    std::string mPendingSeries;
+    uint32_t mPendingSeriesCount;
+
+    std::vector<Series> mSeries;
+    std::vector<uint64_t> mDefinitionOffsets;
+
+    // Series ids for each process, in the order the values appear in ProcessMemoryUsage
+    std::map<std::pair<pid_t, std::string>, std::array<uint32_t, 8>> mProcessSeries;
+};
@@ -0,0 +1,160 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "CaptureSession.h"
+#include "Log.h"
+#include "MemoryMetric.h"
+#include "ProcessMetric.h"
+
+#ifdef ON_DEVICE_REPORT
+#include "HtmlReportRenderer.h"
+#endif
+
+#include <algorithm>
+#include <fstream>
+
+CaptureSession::CaptureSession(std::string name, std::shared_ptr<const Metadata> deviceMetadata,
+                               std::optional<std::shared_ptr<GroupManager>> groupManager)
+        : mName(std::move(name)),
+          mDeviceMetadata(std::move(deviceMetadata)),
+          mGroupManager(groupManager),
+          mStart(std::chrono::steady_clock::now()),
+          mAggregates(std::move(groupManager))
+{
+}
+
+void CaptureSession::AddTick(const std::shared_ptr<const TickSamples> &tick)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (!tick->processes.empty()) {
+        addProcesses(tick->processes);
+    }
+
+    for (const auto &sample: tick->datasets) {
+        mDatasets.AddSample(sample);
+    }
+}
+
+/**
+ * @brief Throw away everything collected so far and start the session again from now
+ */
+void CaptureSession::Reset()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    mStart = std::chrono::steady_clock::now();
+    mProcesses.clear();
+    mAggregates.Reset();
+    mDatasets.Clear();
+}
+
+/**
+ * @brief Save the report for everything collected so far. The session keeps running
+ *
+ * @param directory Directory to save report.json (and report.html if supported) in
+ */
+bool CaptureSession::SaveReport(const std::filesystem::path &directory)
+{
+    std::unique_lock<std::mutex> locker(mLock);
+
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - mStart);
+    auto metadata = std::make_shared<Metadata>(mDeviceMetadata->Platform(),
+                                               mDeviceMetadata->Image(),
+                                               mDeviceMetadata->Mac(),
+                                               mDeviceMetadata->SwapEnabled(),
+                                               "",
+                                               duration.count());
+
+    // Copy everything so we don't hold up collection while writing the report
+    auto processes = mProcesses;
+    auto datasets = mDatasets.Build();
+
+    JsonReportGenerator reportGenerator(metadata, mGroupManager);
+    mAggregates.AddToReport(reportGenerator);
+    locker.unlock();
+
+    for (auto &process: processes) {
+        process.ProcessInfo.updateAliveStatus();
+    }
+    ProcessMetric::AddProcessesToReport(processes, reportGenerator);
+    MemoryMetric::AddDatasetsToReport(datasets, reportGenerator);
+
+    try {
+        std::filesystem::create_directories(directory);
+    } catch (std::filesystem::filesystem_error &e) {
+        LOG_ERROR("Failed to create directory %s to save session %s in: '%s'", directory.string().c_str(),
+                  mName.c_str(), e.what());
+        return false;
+    }
+
+    std::filesystem::path jsonFilepath = directory / "report.json";
+    std::ofstream outputJson(jsonFilepath, std::ios::trunc | std::ios::binary);
+    outputJson << reportGenerator.getJson().dump(4);
+    outputJson.close();
+
+    if (outputJson.fail()) {
+        LOG_ERROR("Failed to save session %s JSON to %s", mName.c_str(), jsonFilepath.string().c_str());
+        return false;
+    }
+
+    LOG_INFO("Saved session %s JSON data to %s", mName.c_str(), jsonFilepath.string().c_str());
+
+#ifdef ON_DEVICE_REPORT
+    if (!HtmlReportRenderer::Render(reportGenerator, directory / "report.html")) {
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+std::string CaptureSession::Name() const
+{
+    return mName;
+}
+
+void CaptureSession::addProcesses(const std::vector<Procrank::ProcessMemoryUsage> &processes)
+{
+    for (const auto &procrankMeasurement: processes) {
+        mAggregates.AddSample(procrankMeasurement.process, procrankMeasurement.pss);
+
+        auto itr = std::find_if(mProcesses.begin(), mProcesses.end(), [&](const processMeasurement &p)
+        {
+            return p.ProcessInfo == procrankMeasurement.process;
+        });
+
+        if (itr == mProcesses.end()) {
+            mProcesses.emplace_back(procrankMeasurement.process);
+            itr = std::prev(mProcesses.end());
+        }
+
+        auto &measurement = *itr;
+        measurement.Pss.AddDataPoint(procrankMeasurement.pss);
+        measurement.Rss.AddDataPoint(procrankMeasurement.rss);
+        measurement.Uss.AddDataPoint(procrankMeasurement.uss);
+        measurement.Vss.AddDataPoint(procrankMeasurement.vss);
+        measurement.Swap.AddDataPoint(procrankMeasurement.swap);
+        measurement.SwapPss.AddDataPoint(procrankMeasurement.swap_pss);
+        measurement.SwapZram.AddDataPoint(procrankMeasurement.swap_zram);
+        measurement.Locked.AddDataPoint(procrankMeasurement.locked);
+    }
+
+    mAggregates.EndTick();
+}
@@ -0,0 +1,74 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ISampleSink.h"
+#include "DatasetBuilder.h"
+#include "GroupManager.h"
+#include "JsonReportGenerator.h"
+#include "Metadata.h"
+#include "ProcessAggregates.h"
+#include "ProcessMeasurement.h"
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A named capture started over the daemon control socket
+ *
+ * Builds up its own measurements from the samples the (always running) metrics publish, so several sessions can run at
+ * once and each one only contains the data collected while it was running. The report is built with the same code as
+ * a normal capture.
+ */
+class CaptureSession : public ISampleSink
+{
+public:
+    CaptureSession(std::string name, std::shared_ptr<const Metadata> deviceMetadata,
+                   std::optional<std::shared_ptr<GroupManager>> groupManager);
+
+    void AddTick(const std::shared_ptr<const TickSamples> &tick) override;
+
+    void Reset();
+
+    bool SaveReport(const std::filesystem::path &directory);
+
+    std::string Name() const;
+
+private:
+    void addProcesses(const std::vector<Procrank::ProcessMemoryUsage> &processes);
+
+private:
+    const std::string mName;
+    const std::shared_ptr<const Metadata> mDeviceMetadata;
+    const std::optional<std::shared_ptr<GroupManager>> mGroupManager;
+
+    std::mutex mLock;
+
+    std::chrono::steady_clock::time_point mStart;
+
+    std::vector<processMeasurement> mProcesses;
+    ProcessAggregates mAggregates;
+
+    DatasetBuilder mDatasets;
+};
@@ -0,0 +1,147 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "CgroupMemory.h"
+#include "FileSystem/FileSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+// The v1 "no limit" value is the largest page counter rounded down to a page, anything this large isn't a real limit
+constexpr unsigned long long kUnlimited = 1ULL << 62;
+
+long double toKb(unsigned long long bytes)
+{
+    return bytes >= kUnlimited ? 0 : bytes / 1024.0L;
+}
+}
+
+CgroupMemory::Version CgroupMemory::DetectVersion(IFileSystem &fileSystem)
+{
+    // On a hybrid system the unified hierarchy is mounted under /sys/fs/cgroup/unified without the memory controller,
+    // so only treat it as v2 if the root itself is cgroup2 and has memory enabled
+    std::string controllers;
+    if (fileSystem.ReadFile("/sys/fs/cgroup/cgroup.controllers", controllers) &&
+        controllers.find("memory") != std::string::npos) {
+        return Version::V2;
+    }
+
+    if (fileSystem.Exists("/sys/fs/cgroup/memory/memory.usage_in_bytes")) {
+        return Version::V1;
+    }
+
+    return Version::None;
+}
+
+std::string CgroupMemory::RootPath(Version version)
+{
+    switch (version) {
+        case Version::V1:
+            return "/sys/fs/cgroup/memory";
+        case Version::V2:
+            return "/sys/fs/cgroup";
+        default:
+            return "";
+    }
+}
+
+bool CgroupMemory::IsContainer(const IFileSystem::DirectoryEntry &entry)
+{
+    // List of system containers which we are not interested in.
+    static const std::string ignoreList[] = {"init.scope", "system.slice"};
+
+    return entry.isDirectory &&
+           std::find(std::begin(ignoreList), std::end(ignoreList), entry.name) == std::end(ignoreList);
+}
+
+CgroupMemory::CgroupMemory(Version version, const std::string &path)
+        : mVersion(version)
+{
+    auto &fileSystem = FileSystem::Get();
+
+    if (mVersion == Version::V2) {
+        mCurrent = fileSystem.OpenFile(path + "/memory.current");
+        mPeak = fileSystem.OpenFile(path + "/memory.peak");
+        mSwap = fileSystem.OpenFile(path + "/memory.swap.current");
+        mMax = fileSystem.OpenFile(path + "/memory.max");
+        mHigh = fileSystem.OpenFile(path + "/memory.high");
+    } else if (mVersion == Version::V1) {
+        mCurrent = fileSystem.OpenFile(path + "/memory.usage_in_bytes");
+        mPeak = fileSystem.OpenFile(path + "/memory.max_usage_in_bytes");
+        // memsw is memory + swap combined, only there if the kernel was booted with swap accounting
+        mSwap = fileSystem.OpenFile(path + "/memory.memsw.usage_in_bytes");
+        mMax = fileSystem.OpenFile(path + "/memory.limit_in_bytes");
+        mHigh = fileSystem.OpenFile(path + "/memory.soft_limit_in_bytes");
+    }
+}
+
+bool CgroupMemory::Read(Usage &usage)
+{
+    unsigned long long current = 0;
+    if (!readBytes(mCurrent.get(), current)) {
+        return false;
+    }
+
+    unsigned long long peak = 0;
+    unsigned long long swap = 0;
+    unsigned long long max = kUnlimited;
+    unsigned long long high = kUnlimited;
+
+    readBytes(mPeak.get(), peak);
+    readBytes(mMax.get(), max);
+    readBytes(mHigh.get(), high);
+
+    if (readBytes(mSwap.get(), swap) && mVersion == Version::V1) {
+        swap = swap > current ? swap - current : 0;
+    }
+
+    usage.currentKb = toKb(current);
+    usage.peakKb = toKb(peak);
+    usage.swapKb = toKb(swap);
+    usage.maxKb = toKb(max);
+    usage.highKb = toKb(high);
+    return true;
+}
+
+bool CgroupMemory::readBytes(IFileHandle *handle, unsigned long long &bytes)
+{
+    if (!handle) {
+        return false;
+    }
+
+    char buffer[32];
+    auto length = handle->Read(buffer, sizeof(buffer) - 1);
+    if (length <= 0) {
+        return false;
+    }
+    buffer[length] = '\0';
+
+    // cgroup v2 limits are "max" when not set
+    if (strncmp(buffer, "max", 3) == 0) {
+        bytes = kUnlimited;
+        return true;
+    }
+
+    char *end = nullptr;
+    bytes = strtoull(buffer, &end, 10);
+    return end != buffer;
+}
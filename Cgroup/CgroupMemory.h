@@ -0,0 +1,88 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "FileSystem/IFileSystem.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * @brief Memory usage and limits of a single memory cgroup, on either the legacy (v1) or unified (v2) hierarchy
+ *
+ * The files are opened once when the object is created and re-read from the start on every call to Read(), since they
+ * are read every tick for every container
+ */
+class CgroupMemory
+{
+public:
+    enum class Version
+    {
+        None,
+        V1,
+        V2
+    };
+
+    struct Usage
+    {
+        long double currentKb;
+        // Highest usage since the cgroup was created. Needs Linux 5.19 on cgroup v2
+        long double peakKb;
+        // 0 if swap accounting is disabled
+        long double swapKb;
+        // Hard limit, 0 if there is no limit
+        long double maxKb;
+        // Throttling limit (the soft limit on cgroup v1), 0 if there is no limit
+        long double highKb;
+    };
+
+    /**
+     * @brief Work out which hierarchy the memory controller is mounted on
+     */
+    static Version DetectVersion(IFileSystem &fileSystem);
+
+    /**
+     * @brief Directory the memory cgroups are created under for the given hierarchy
+     */
+    static std::string RootPath(Version version);
+
+    /**
+     * @brief Whether a directory under the root is a container, rather than one of the cgroups systemd always creates
+     */
+    static bool IsContainer(const IFileSystem::DirectoryEntry &entry);
+
+    CgroupMemory(Version version, const std::string &path);
+
+    /**
+     * @return False if the cgroup is no longer there
+     */
+    bool Read(Usage &usage);
+
+private:
+    static bool readBytes(IFileHandle *handle, unsigned long long &bytes);
+
+private:
+    const Version mVersion;
+
+    std::unique_ptr<IFileHandle> mCurrent;
+    std::unique_ptr<IFileHandle> mPeak;
+    std::unique_ptr<IFileHandle> mSwap;
+    std::unique_ptr<IFileHandle> mMax;
+    std::unique_ptr<IFileHandle> mHigh;
+};
@@ -0,0 +1,193 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "CgroupMemoryStat.h"
+#include "FileSystem/FileSystem.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+namespace
+{
+struct statKey
+{
+    std::string_view name;
+    CgroupMemoryStat::Field field;
+};
+
+constexpr statKey kV2Keys[] = {
+        {"anon",          CgroupMemoryStat::Field::Anon},
+        {"file",          CgroupMemoryStat::Field::File},
+        {"kernel",        CgroupMemoryStat::Field::Kernel},
+        {"shmem",         CgroupMemoryStat::Field::Shmem},
+        {"slab",          CgroupMemoryStat::Field::Slab},
+        {"sock",          CgroupMemoryStat::Field::Sock},
+        {"active_anon",   CgroupMemoryStat::Field::ActiveAnon},
+        {"inactive_anon", CgroupMemoryStat::Field::InactiveAnon},
+        {"active_file",   CgroupMemoryStat::Field::ActiveFile},
+        {"inactive_file", CgroupMemoryStat::Field::InactiveFile},
+};
+
+constexpr statKey kV1Keys[] = {
+        {"total_rss",           CgroupMemoryStat::Field::Anon},
+        {"total_cache",         CgroupMemoryStat::Field::File},
+        {"total_shmem",         CgroupMemoryStat::Field::Shmem},
+        {"total_active_anon",   CgroupMemoryStat::Field::ActiveAnon},
+        {"total_inactive_anon", CgroupMemoryStat::Field::InactiveAnon},
+        {"total_active_file",   CgroupMemoryStat::Field::ActiveFile},
+        {"total_inactive_file", CgroupMemoryStat::Field::InactiveFile},
+};
+
+// Kernels before 5.18 don't have the "kernel" total on v2, so add up the parts it is made of instead
+constexpr std::string_view kV2KernelParts[] = {"kernel_stack", "pagetables", "sec_pagetables", "percpu", "vmalloc"};
+}
+
+const char *CgroupMemoryStat::FieldName(Field field)
+{
+    switch (field) {
+        case Field::Anon:
+            return "Anon";
+        case Field::File:
+            return "File";
+        case Field::Kernel:
+            return "Kernel";
+        case Field::Shmem:
+            return "Shmem";
+        case Field::Slab:
+            return "Slab";
+        case Field::Sock:
+            return "Sock";
+        case Field::ActiveAnon:
+            return "Active_Anon";
+        case Field::InactiveAnon:
+            return "Inactive_Anon";
+        case Field::ActiveFile:
+            return "Active_File";
+        case Field::InactiveFile:
+            return "Inactive_File";
+        default:
+            return "";
+    }
+}
+
+CgroupMemoryStat::CgroupMemoryStat(CgroupMemory::Version version, const std::string &path)
+        : mVersion(version),
+          mValues{}
+{
+    auto &fileSystem = FileSystem::Get();
+
+    mStat = fileSystem.OpenFile(path + "/memory.stat");
+    if (mVersion == CgroupMemory::Version::V1) {
+        mKmem = fileSystem.OpenFile(path + "/memory.kmem.usage_in_bytes");
+        mKmemTcp = fileSystem.OpenFile(path + "/memory.kmem.tcp.usage_in_bytes");
+    }
+}
+
+bool CgroupMemoryStat::Read()
+{
+    if (!mStat) {
+        return false;
+    }
+
+    // v1 memory.stat has both local and total_* copies of every value, so is about twice the size of v2
+    char buffer[8192];
+    auto length = mStat->Read(buffer, sizeof(buffer));
+    if (length <= 0) {
+        return false;
+    }
+
+    mValues.fill(0);
+    parseStat(buffer, static_cast<size_t>(length));
+
+    if (mVersion == CgroupMemory::Version::V1) {
+        mValues[static_cast<size_t>(Field::Kernel)] = readBytes(mKmem.get());
+        mValues[static_cast<size_t>(Field::Sock)] = readBytes(mKmemTcp.get());
+    }
+
+    return true;
+}
+
+void CgroupMemoryStat::parseStat(const char *buffer, size_t length)
+{
+    bool hasKernel = false;
+    unsigned long long kernelParts = 0;
+
+    const char *end = buffer + length;
+    const char *line = buffer;
+
+    while (line < end) {
+        auto *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        auto *space = static_cast<const char *>(memchr(line, ' ', lineEnd - line));
+        if (space) {
+            const std::string_view key(line, space - line);
+            const auto value = strtoull(space + 1, nullptr, 10);
+
+            if (mVersion == CgroupMemory::Version::V2) {
+                for (const auto &statKey: kV2Keys) {
+                    if (statKey.name == key) {
+                        mValues[static_cast<size_t>(statKey.field)] = value;
+                        hasKernel |= statKey.field == Field::Kernel;
+                        break;
+                    }
+                }
+
+                for (const auto &part: kV2KernelParts) {
+                    if (part == key) {
+                        kernelParts += value;
+                        break;
+                    }
+                }
+            } else {
+                for (const auto &statKey: kV1Keys) {
+                    if (statKey.name == key) {
+                        mValues[static_cast<size_t>(statKey.field)] = value;
+                        break;
+                    }
+                }
+            }
+        }
+
+        line = lineEnd + 1;
+    }
+
+    if (mVersion == CgroupMemory::Version::V2 && !hasKernel) {
+        mValues[static_cast<size_t>(Field::Kernel)] = kernelParts + mValues[static_cast<size_t>(Field::Slab)];
+    }
+}
+
+unsigned long long CgroupMemoryStat::readBytes(IFileHandle *handle)
+{
+    if (!handle) {
+        return 0;
+    }
+
+    char buffer[32];
+    auto length = handle->Read(buffer, sizeof(buffer) - 1);
+    if (length <= 0) {
+        return 0;
+    }
+    buffer[length] = '\0';
+
+    return strtoull(buffer, nullptr, 10);
+}
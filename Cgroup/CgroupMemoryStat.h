@@ -0,0 +1,92 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "CgroupMemory.h"
+#include "FileSystem/IFileSystem.h"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Breakdown of what kind of memory is charged to a cgroup, from its memory.stat file
+ *
+ * Values always include every cgroup below this one. On cgroup v1 that means the total_* fields are used, and the
+ * kernel and socket memory come from the kmem counters as memory.stat doesn't have them. Slab isn't reported on v1.
+ *
+ * Like CgroupMemory, the files are opened once and re-read each time Read() is called
+ */
+class CgroupMemoryStat
+{
+public:
+    enum class Field
+    {
+        Anon,
+        File,
+        Kernel,
+        Shmem,
+        Slab,
+        Sock,
+        ActiveAnon,
+        InactiveAnon,
+        ActiveFile,
+        InactiveFile,
+        Count
+    };
+
+    static constexpr size_t kFieldCount = static_cast<size_t>(Field::Count);
+
+    static const char *FieldName(Field field);
+
+    CgroupMemoryStat(CgroupMemory::Version version, const std::string &path);
+
+    /**
+     * @return False if there was no memory.stat to open, like the v2 root. Read() will never succeed
+     */
+    bool HasStat() const
+    {
+        return mStat != nullptr;
+    }
+
+    /**
+     * @return False if the cgroup is no longer there (or doesn't have memory.stat, like the v2 root on older kernels)
+     */
+    bool Read();
+
+    long double GetKb(Field field) const
+    {
+        return mValues[static_cast<size_t>(field)] / 1024.0L;
+    }
+
+private:
+    void parseStat(const char *buffer, size_t length);
+
+    static unsigned long long readBytes(IFileHandle *handle);
+
+private:
+    const CgroupMemory::Version mVersion;
+
+    std::unique_ptr<IFileHandle> mStat;
+    std::unique_ptr<IFileHandle> mKmem;
+    std::unique_ptr<IFileHandle> mKmemTcp;
+
+    std::array<unsigned long long, kFieldCount> mValues;
+};
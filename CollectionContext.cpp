@@ -0,0 +1,97 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "CollectionContext.h"
+#include "FileSystem/FileSystem.h"
+#include "Log.h"
+
+#include <unistd.h>
+
+CollectionContext::CollectionContext() : CollectionContext(MemInfo())
+{
+}
+
+CollectionContext::CollectionContext(const MemInfo &memInfo)
+        : mSwapEnabled(memInfo.SwapTotal() > 0),
+          mSmapsRollupSupported(FileSystem::Get().Exists("/proc/self/smaps_rollup")),
+          mPageSize(sysconf(_SC_PAGESIZE)),
+          mZramDeviceNames(ZramDevice::FindDevices()),
+          mLatest{memInfo, 0, 0, 0}
+{
+    // Only needed to work out how much of swap is really using memory
+    if (mSwapEnabled) {
+        for (const auto &name: mZramDeviceNames) {
+            mZramDevices.emplace_back(name);
+        }
+    }
+
+    LOG_INFO("Swap %s, %zu zram device(s), smaps_rollup %s, page size %zu",
+             mSwapEnabled ? "enabled" : "disabled", mZramDeviceNames.size(),
+             mSmapsRollupSupported ? "supported" : "not supported", mPageSize);
+
+    // So there's something to use before the first tick
+    readSwapUsage(mLatest);
+}
+
+/**
+ * @brief Read the values that change from tick to tick. Only the memory metric's collection thread calls this
+ */
+CollectionContext::TickValues CollectionContext::Refresh()
+{
+    TickValues values{MemInfo(), 0, 0, 0};
+    readSwapUsage(values);
+
+    std::lock_guard<std::mutex> locker(mLock);
+    mLatest = values;
+    return values;
+}
+
+/**
+ * @return Values from the latest Refresh(). Safe to call from any thread
+ */
+CollectionContext::TickValues CollectionContext::Latest() const
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    return mLatest;
+}
+
+/**
+ * @brief Work out how much memory swap is really using from the tick's meminfo and the zram devices
+ */
+void CollectionContext::readSwapUsage(TickValues &values)
+{
+    if (!mSwapEnabled) {
+        return;
+    }
+
+    values.swapUsedKb = values.memInfo.SwapUsed();
+
+    unsigned long long zramUsed = 0;
+    for (auto &device: mZramDevices) {
+        if (device.ReadMmStat()) {
+            zramUsed += device.GetMmStat().memUsedTotal;
+        }
+    }
+    values.zramUsedKb = zramUsed / 1024;
+
+    if (values.zramUsedKb > 0 && values.swapUsedKb > 0) {
+        values.zramCompressionRatio = static_cast<double>(values.zramUsedKb) / values.swapUsedKb;
+        LOG_DEBUG("Zram compression is %f", values.zramCompressionRatio);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "FileParsers/MemInfo.h"
+#include "FileParsers/Zram.h"
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief What the collectors need to know about the system, worked out once when the capture starts
+ *
+ * Swap, the zram devices, smaps_rollup support and the page size don't change during a capture, so are probed once
+ * here instead of by every tick. The memory metric calls Refresh() at the start of each of its ticks to re-read the few
+ * values that do change, and hands them to all its collectors. Other collectors use the values from the latest
+ * refresh with Latest(), so /proc/meminfo is only read once per tick and only ever from one thread (which keeps
+ * replaying a recording deterministic)
+ */
+class CollectionContext
+{
+public:
+    struct TickValues
+    {
+        // Parsed once per tick and shared by everything that needs it
+        MemInfo memInfo;
+
+        long swapUsedKb;
+
+        // Physical memory used by zram for all devices, including allocator overhead
+        unsigned long long zramUsedKb;
+
+        // KB of physical memory used per KB of swap, 0 if swap isn't backed by zram
+        double zramCompressionRatio;
+    };
+
+    CollectionContext();
+
+    bool SwapEnabled() const
+    {
+        return mSwapEnabled;
+    }
+
+    /**
+     * @return True if /proc/<pid>/smaps_rollup exists (Linux 4.14+), so the full smaps file doesn't need parsing
+     */
+    bool SmapsRollupSupported() const
+    {
+        return mSmapsRollupSupported;
+    }
+
+    size_t PageSize() const
+    {
+        return mPageSize;
+    }
+
+    const std::vector<std::string> &ZramDeviceNames() const
+    {
+        return mZramDeviceNames;
+    }
+
+    TickValues Refresh();
+
+    TickValues Latest() const;
+
+private:
+    explicit CollectionContext(const MemInfo &memInfo);
+
+    void readSwapUsage(TickValues &values);
+
+private:
+    const bool mSwapEnabled;
+    const bool mSmapsRollupSupported;
+    const size_t mPageSize;
+    const std::vector<std::string> mZramDeviceNames;
+
+    std::vector<ZramDevice> mZramDevices;
+
+    mutable std::mutex mLock;
+    TickValues mLatest;
+};
@@ -0,0 +1,383 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "Daemon.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sstream>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+Daemon::Daemon(std::filesystem::path socketPath,
+               std::filesystem::path outputDirectory,
+               std::map<std::string, std::shared_ptr<IMetric>> metrics,
+               std::shared_ptr<SamplePublisher> samplePublisher,
+               std::shared_ptr<const Metadata> metadata,
+               std::optional<std::shared_ptr<GroupManager>> groupManager,
+               std::function<void()> quitCallback)
+        : mSocketPath(std::move(socketPath)),
+          mOutputDirectory(std::move(outputDirectory)),
+          mMetrics(std::move(metrics)),
+          mSamplePublisher(std::move(samplePublisher)),
+          mMetadata(std::move(metadata)),
+          mGroupManager(std::move(groupManager)),
+          mQuitCallback(std::move(quitCallback)),
+          mListenFd(-1),
+          mWakeFd(-1)
+{
+}
+
+Daemon::~Daemon()
+{
+    Stop();
+}
+
+bool Daemon::Start()
+{
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+
+    if (mSocketPath.string().size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Control socket path %s is too long", mSocketPath.string().c_str());
+        return false;
+    }
+    strncpy(addr.sun_path, mSocketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mWakeFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to create eventfd");
+        return false;
+    }
+
+    mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (mListenFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to create control socket");
+        return false;
+    }
+
+    // Clean up after a previous instance that didn't exit cleanly
+    unlink(mSocketPath.c_str());
+
+    if (bind(mListenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        LOG_SYS_ERROR(errno, "Failed to bind control socket to %s", mSocketPath.string().c_str());
+        return false;
+    }
+
+    if (listen(mListenFd, 4) < 0) {
+        LOG_SYS_ERROR(errno, "Failed to listen on control socket");
+        return false;
+    }
+
+    LOG_INFO("Listening for commands on %s", mSocketPath.string().c_str());
+    mServerThread = std::thread(&Daemon::Serve, this);
+    return true;
+}
+
+/**
+ * @brief Stop listening for commands, then stop all running sessions and save their reports
+ */
+void Daemon::Stop()
+{
+    if (mServerThread.joinable()) {
+        uint64_t wake = 1;
+        if (write(mWakeFd, &wake, sizeof(wake)) < 0) {
+            LOG_SYS_ERROR(errno, "Failed to wake control socket thread");
+        }
+
+        LOG_INFO("Waiting for control socket thread to terminate");
+        mServerThread.join();
+    }
+
+    if (mListenFd >= 0) {
+        close(mListenFd);
+        mListenFd = -1;
+        unlink(mSocketPath.c_str());
+    }
+
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+        mWakeFd = -1;
+    }
+
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+        for (const auto &session: mSessions) {
+            names.emplace_back(session.first);
+        }
+    }
+
+    for (const auto &name: names) {
+        LOG_INFO("Stopping session %s: %s", name.c_str(), stopSession(name).c_str());
+    }
+}
+
+void Daemon::Serve()
+{
+    struct pollfd fds[2] = {
+            {mWakeFd,   POLLIN, 0},
+            {mListenFd, POLLIN, 0}
+    };
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_SYS_ERROR(errno, "Control socket poll failed");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int clientFd = accept4(mListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (clientFd < 0) {
+                if (errno != EINTR && errno != EAGAIN) {
+                    LOG_SYS_ERROR(errno, "Failed to accept control connection");
+                }
+                continue;
+            }
+
+            handleClient(clientFd);
+            close(clientFd);
+        }
+    }
+
+    LOG_INFO("Control socket thread quit");
+}
+
+/**
+ * @brief Run each command the client sends until it disconnects
+ */
+void Daemon::handleClient(int clientFd)
+{
+    // Don't let a client that goes quiet block other clients forever
+    struct timeval timeout = {5, 0};
+    setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string buffer;
+    char data[256];
+
+    while (true) {
+        ssize_t ret = recv(clientFd, data, sizeof(data), 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            break;
+        }
+        buffer.append(data, ret);
+
+        if (buffer.size() > 4096) {
+            LOG_WARN("Control command too long, disconnecting client");
+            break;
+        }
+
+        size_t newline;
+        while ((newline = buffer.find('\n')) != std::string::npos) {
+            auto command = buffer.substr(0, newline);
+            buffer.erase(0, newline + 1);
+
+            if (!command.empty() && command.back() == '\r') {
+                command.pop_back();
+            }
+
+            auto response = handleCommand(command) + "\n";
+            if (send(clientFd, response.data(), response.size(), MSG_NOSIGNAL) < 0) {
+                LOG_SYS_ERROR(errno, "Failed to send control response");
+                return;
+            }
+        }
+    }
+}
+
+std::string Daemon::handleCommand(const std::string &command)
+{
+    std::istringstream stream(command);
+    std::string verb;
+    std::string arg1;
+    std::string arg2;
+    stream >> verb >> arg1 >> arg2;
+
+    LOG_INFO("Control command: %s", command.c_str());
+
+    if (verb == "start") {
+        return startSession(arg1);
+    } else if (verb == "stop") {
+        return stopSession(arg1);
+    } else if (verb == "snapshot") {
+        return snapshotSession(arg1);
+    } else if (verb == "reset") {
+        return resetSessions(arg1);
+    } else if (verb == "period") {
+        return setPeriod(arg1, arg2);
+    } else if (verb == "list") {
+        return listSessions();
+    } else if (verb == "quit") {
+        if (mQuitCallback) {
+            mQuitCallback();
+        }
+        return "OK";
+    }
+
+    return "ERROR unknown command '" + verb + "'";
+}
+
+std::string Daemon::startSession(const std::string &name)
+{
+    if (!isValidSessionName(name)) {
+        return "ERROR invalid session name";
+    }
+
+    std::lock_guard<std::mutex> locker(mLock);
+    if (mSessions.find(name) != mSessions.end()) {
+        return "ERROR session " + name + " already running";
+    }
+
+    auto session = std::make_shared<CaptureSession>(name, mMetadata, mGroupManager);
+    mSessions.emplace(name, session);
+    mSamplePublisher->AddSink(session);
+
+    return "OK";
+}
+
+std::string Daemon::stopSession(const std::string &name)
+{
+    std::unique_lock<std::mutex> locker(mLock);
+    auto itr = mSessions.find(name);
+    if (itr == mSessions.end()) {
+        return "ERROR no session " + name;
+    }
+
+    auto session = itr->second;
+    mSamplePublisher->RemoveSink(session);
+    mSessions.erase(itr);
+    bool lastSession = mSessions.empty();
+    locker.unlock();
+
+    auto directory = mOutputDirectory / name;
+    bool saved = session->SaveReport(directory);
+
+    // Nothing is using the metrics' own results when running as a daemon, so don't let them grow forever
+    if (lastSession) {
+        for (const auto &metric: mMetrics) {
+            metric.second->ResetResults();
+        }
+    }
+
+    return saved ? "OK " + directory.string() : "ERROR failed to save report for " + name;
+}
+
+std::string Daemon::snapshotSession(const std::string &name)
+{
+    std::unique_lock<std::mutex> locker(mLock);
+    auto itr = mSessions.find(name);
+    if (itr == mSessions.end()) {
+        return "ERROR no session " + name;
+    }
+    auto session = itr->second;
+    locker.unlock();
+
+    auto directory = mOutputDirectory / name;
+    return session->SaveReport(directory) ? "OK " + directory.string() : "ERROR failed to save report for " + name;
+}
+
+std::string Daemon::resetSessions(const std::string &name)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (name.empty()) {
+        for (const auto &session: mSessions) {
+            session.second->Reset();
+        }
+
+        for (const auto &metric: mMetrics) {
+            metric.second->ResetResults();
+        }
+        return "OK";
+    }
+
+    auto itr = mSessions.find(name);
+    if (itr == mSessions.end()) {
+        return "ERROR no session " + name;
+    }
+
+    itr->second->Reset();
+    return "OK";
+}
+
+std::string Daemon::setPeriod(const std::string &metric, const std::string &seconds)
+{
+    auto itr = mMetrics.find(metric);
+    if (itr == mMetrics.end()) {
+        std::string known;
+        for (const auto &m: mMetrics) {
+            known += " " + m.first;
+        }
+        return "ERROR unknown metric '" + metric + "', expected one of:" + known;
+    }
+
+    char *end = nullptr;
+    long period = std::strtol(seconds.c_str(), &end, 10);
+    if (seconds.empty() || *end != '\0' || period <= 0) {
+        return "ERROR period must be a number of seconds > 0";
+    }
+
+    // Restarting collection is enough - the results collected so far are kept
+    itr->second->StopCollection();
+    itr->second->StartCollection(std::chrono::seconds(period));
+
+    return "OK";
+}
+
+std::string Daemon::listSessions()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    std::string response = "OK";
+    for (const auto &session: mSessions) {
+        response += " " + session.first;
+    }
+    return response;
+}
+
+/**
+ * @brief Session names are used as directory names, so keep them simple
+ */
+bool Daemon::isValidSessionName(const std::string &name)
+{
+    if (name.empty() || name.size() > 64 || name == "." || name == "..") {
+        return false;
+    }
+
+    return std::all_of(name.begin(), name.end(), [](char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+    });
+}
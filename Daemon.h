@@ -0,0 +1,106 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "CaptureSession.h"
+#include "IMetric.h"
+#include "SamplePublisher.h"
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Keeps MemCapture running in the background and lets captures be controlled over a Unix socket
+ *
+ * The metrics run continuously, so the groups, metadata and any other caches stay warm and a new capture session
+ * can start immediately. Commands are sent one per line and each gets a single line response starting with "OK" or
+ * "ERROR":
+ *
+ *     start <name>                  Start a new capture session
+ *     stop <name>                   Stop a session and save its report in <output dir>/<name>
+ *     snapshot <name>               Save the report for a session so far without stopping it
+ *     reset [name]                  Reset the statistics for one session, or all sessions
+ *     period <metric> <seconds>     Change how often a metric collects data
+ *     list                          List running sessions
+ *     quit                          Stop all sessions, saving their reports, and exit
+ *
+ * e.g. echo "start boot" | socat - UNIX-CONNECT:/tmp/memcapture.sock
+ */
+class Daemon
+{
+public:
+    Daemon(std::filesystem::path socketPath,
+           std::filesystem::path outputDirectory,
+           std::map<std::string, std::shared_ptr<IMetric>> metrics,
+           std::shared_ptr<SamplePublisher> samplePublisher,
+           std::shared_ptr<const Metadata> metadata,
+           std::optional<std::shared_ptr<GroupManager>> groupManager,
+           std::function<void()> quitCallback);
+
+    ~Daemon();
+
+    bool Start();
+
+    void Stop();
+
+private:
+    void Serve();
+
+    void handleClient(int clientFd);
+
+    std::string handleCommand(const std::string &command);
+
+    std::string startSession(const std::string &name);
+
+    std::string stopSession(const std::string &name);
+
+    std::string snapshotSession(const std::string &name);
+
+    std::string resetSessions(const std::string &name);
+
+    std::string setPeriod(const std::string &metric, const std::string &seconds);
+
+    std::string listSessions();
+
+    static bool isValidSessionName(const std::string &name);
+
+private:
+    const std::filesystem::path mSocketPath;
+    const std::filesystem::path mOutputDirectory;
+    const std::map<std::string, std::shared_ptr<IMetric>> mMetrics;
+    const std::shared_ptr<SamplePublisher> mSamplePublisher;
+    const std::shared_ptr<const Metadata> mMetadata;
+    const std::optional<std::shared_ptr<GroupManager>> mGroupManager;
+    const std::function<void()> mQuitCallback;
+
+    int mListenFd;
+    int mWakeFd;
+
+    std::thread mServerThread;
+
+    std::mutex mLock;
+    std::map<std::string, std::shared_ptr<CaptureSession>> mSessions;
+};
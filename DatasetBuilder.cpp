@@ -0,0 +1,146 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "DatasetBuilder.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void DatasetBuilder::AddSample(const DatasetSample &sample)
+{
+    GetMeasurement(sample.dataset, sample.labels, sample.measurement, sample.layout).AddDataPoint(sample.value);
+}
+
+Measurement &DatasetBuilder::GetMeasurement(const std::string &dataset, const Labels &labels,
+                                            const std::string &measurement, const DatasetLayout &layout)
+{
+    auto datasetItr = std::find_if(mDatasets.begin(), mDatasets.end(), [&](const datasetRows &d)
+    {
+        return d.name == dataset;
+    });
+
+    if (datasetItr == mDatasets.end()) {
+        mDatasets.emplace_back();
+        datasetItr = std::prev(mDatasets.end());
+        datasetItr->name = dataset;
+    }
+    auto &rows = *datasetItr;
+
+    auto key = rowKey(labels);
+    auto rowItr = rows.rowIndex.find(key);
+    if (rowItr == rows.rowIndex.end()) {
+        // Rows are inserted into the metric's dataset in the same way, so replaying the insertions gives the same order
+        const auto index = rows.rows.size();
+        rows.rows.push_back(row{labels, {}});
+        rows.order.insert(rows.order.begin() + std::min<size_t>(layout.row, rows.order.size()), index);
+        rowItr = rows.rowIndex.emplace(std::move(key), index).first;
+    }
+
+    auto columnItr = std::find_if(rows.columns.begin(), rows.columns.end(), [&](const column &c)
+    {
+        return c.name == measurement;
+    });
+    if (columnItr == rows.columns.end()) {
+        rows.columns.push_back(column{measurement, layout, rows.columns.size()});
+    }
+
+    auto &measurements = rows.rows[rowItr->second].measurements;
+    auto itr = measurements.find(measurement);
+    if (itr == measurements.end()) {
+        itr = measurements.emplace(measurement, Measurement(measurement, layout.percentiles)).first;
+    }
+
+    return itr->second;
+}
+
+void DatasetBuilder::Clear()
+{
+    mDatasets.clear();
+}
+
+std::vector<JsonReportGenerator::dataset> DatasetBuilder::Build() const
+{
+    std::vector<JsonReportGenerator::dataset> datasets;
+
+    for (const auto &rows: mDatasets) {
+        auto columns = rows.columns;
+        std::sort(columns.begin(), columns.end(), [](const column &a, const column &b)
+        {
+            return std::make_pair(a.layout.column, a.firstSeen) < std::make_pair(b.layout.column, b.firstSeen);
+        });
+
+        std::vector<JsonReportGenerator::dataItems> data;
+        data.reserve(rows.order.size());
+
+        for (const auto index: rows.order) {
+            const auto &row = rows.rows[index];
+
+            // Every row gets every column, even if it has no values for it, the same as the rows the metric builds
+            JsonReportGenerator::dataItems items;
+            size_t label = 0;
+            for (const auto &column: columns) {
+                while (label < row.labels.size() && items.size() < column.layout.column) {
+                    items.emplace_back(row.labels[label++]);
+                }
+
+                auto itr = row.measurements.find(column.name);
+                const auto measurement = itr != row.measurements.end() ? itr->second
+                                                                       : Measurement(column.name,
+                                                                                     column.layout.percentiles);
+
+                if (column.layout.latestDecimals >= 0) {
+                    items.emplace_back(std::make_pair(column.name,
+                                                      formatLatest(measurement, column.layout.latestDecimals)));
+                } else {
+                    items.emplace_back(measurement);
+                }
+            }
+
+            while (label < row.labels.size()) {
+                items.emplace_back(row.labels[label++]);
+            }
+
+            data.emplace_back(std::move(items));
+        }
+
+        datasets.emplace_back(rows.name, std::move(data));
+    }
+
+    return datasets;
+}
+
+std::string DatasetBuilder::rowKey(const Labels &labels)
+{
+    std::string key;
+    for (const auto &label: labels) {
+        key.append(label.first).append(1, '\0').append(label.second).append(1, '\0');
+    }
+    return key;
+}
+
+std::string DatasetBuilder::formatLatest(const Measurement &measurement, int decimals)
+{
+    if (measurement.GetCount() == 0) {
+        return "";
+    }
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, static_cast<double>(measurement.GetLastValue()));
+    return buffer;
+}
@@ -0,0 +1,89 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ISampleSink.h"
+#include "JsonReportGenerator.h"
+#include "Measurement.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Rebuild report datasets from published samples
+ *
+ * Used wherever the report is built from samples rather than from the metrics themselves (daemon sessions and saved
+ * captures). The layout sent with each sample puts every row and column back where the metric had it, so the datasets
+ * come out the same as the ones the metric adds to the report on the device.
+ */
+class DatasetBuilder
+{
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    void AddSample(const DatasetSample &sample);
+
+    /**
+     * @return Measurement to add the values of one series to, created if this is the first time it has been seen
+     */
+    Measurement &GetMeasurement(const std::string &dataset, const Labels &labels, const std::string &measurement,
+                                const DatasetLayout &layout);
+
+    void Clear();
+
+    /**
+     * @return Datasets in the order they were first seen
+     */
+    std::vector<JsonReportGenerator::dataset> Build() const;
+
+private:
+    struct column
+    {
+        std::string name;
+        DatasetLayout layout;
+        // Tie breaker for columns without a position
+        size_t firstSeen;
+    };
+
+    struct row
+    {
+        Labels labels;
+        std::unordered_map<std::string, Measurement> measurements;
+    };
+
+    struct datasetRows
+    {
+        std::string name;
+        std::vector<column> columns;
+        std::vector<row> rows;
+        // Indexes into rows, in report order
+        std::vector<size_t> order;
+        std::unordered_map<std::string, size_t> rowIndex;
+    };
+
+    static std::string rowKey(const Labels &labels);
+
+    static std::string formatLatest(const Measurement &measurement, int decimals);
+
+private:
+    std::vector<datasetRows> mDatasets;
+};
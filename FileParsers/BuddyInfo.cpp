@@ -0,0 +1,76 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "BuddyInfo.h"
+
+#include <sstream>
+#include "Log.h"
+#include "FileSystem/FileSystem.h"
+
+BuddyInfo::BuddyInfo(size_t columnCount) : mColumnCount(columnCount)
+{
+    std::istringstream buddyInfo;
+    if (!FileSystem::Open("/proc/buddyinfo", buddyInfo)) {
+        LOG_WARN("Could not open buddyinfo");
+        return;
+    }
+
+    parseBuddyInfo(buddyInfo);
+}
+
+/**
+ * @brief Parse buddyinfo contents from somewhere other than /proc/buddyinfo (e.g. a saved copy)
+ */
+BuddyInfo::BuddyInfo(std::istream &stream, size_t columnCount) : mColumnCount(columnCount)
+{
+    parseBuddyInfo(stream);
+}
+
+void BuddyInfo::parseBuddyInfo(std::istream &stream)
+{
+    std::string line;
+    std::string segment;
+
+    // Each line is "Node <n>, zone <name> <free blocks of order 0> ... <free blocks of order n>"
+    while (std::getline(stream, line)) {
+        std::stringstream lineStream(line);
+        std::vector<std::string> segments;
+        // Split line on space
+        while (std::getline(lineStream, segment, ' ')) {
+            if (!segment.empty()) {
+                segments.emplace_back(segment);
+            }
+        }
+
+        if (segments.size() != mColumnCount) {
+            LOG_WARN("Failed to parse buddyinfo - invalid number of columns (got %zd, expected %zd)", segments.size(),
+                     mColumnCount);
+            continue;
+        }
+
+        Zone zone;
+        zone.name = segments[3];
+
+        for (size_t i = 4; i < mColumnCount; i++) {
+            zone.freePages.emplace_back(std::stoi(segments[i]));
+        }
+
+        mZones.emplace_back(std::move(zone));
+    }
+}
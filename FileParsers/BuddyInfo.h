@@ -0,0 +1,56 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Utility wrapper over the /proc/buddyinfo file to pull the free page counts for each zone
+ */
+class BuddyInfo
+{
+public:
+    struct Zone
+    {
+        std::string name;
+
+        // Number of free blocks of each order, indexed by order
+        std::vector<int> freePages;
+    };
+
+    explicit BuddyInfo(size_t columnCount);
+
+    BuddyInfo(std::istream &stream, size_t columnCount);
+
+    const std::vector<Zone> &Zones() const
+    {
+        return mZones;
+    }
+
+private:
+    void parseBuddyInfo(std::istream &stream);
+
+private:
+    // Number of columns expected on each line, depends on the max order the kernel was built with
+    const size_t mColumnCount;
+
+    std::vector<Zone> mZones;
+};
@@ -0,0 +1,96 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "GpuMemory.h"
+
+#include <cstdio>
+#include <string>
+#include "Log.h"
+
+/**
+ * @brief Parse the per-process allocations from /sys/kernel/debug/mali0/gpu_memory
+ *
+ * @param stream Contents of the gpu_memory file
+ * @param format Which vendor's layout the file is in
+ * @param pageSize Size of a page in bytes, allocations are reported in pages
+ *
+ * @return Allocation for each GPU context, in the order they appear (a process may have more than one)
+ */
+std::vector<GpuMemory::Allocation> GpuMemory::ParseMali(std::istream &stream, MaliFormat format, size_t pageSize)
+{
+    std::vector<Allocation> allocations;
+
+    std::string line;
+    long gpuPages;
+    pid_t pid;
+
+    while (std::getline(stream, line)) {
+        int matched;
+        if (format == MaliFormat::Amlogic) {
+            matched = sscanf(line.c_str(), "%*x %d %ld", &pid, &gpuPages);
+        } else {
+            matched = sscanf(line.c_str(), "  kctx-0x%*x %ld %d", &gpuPages, &pid);
+        }
+
+        if (matched == 2) {
+            allocations.emplace_back(Allocation{pid, gpuPages * pageSize});
+        }
+    }
+
+    return allocations;
+}
+
+/**
+ * @brief Parse the memory used by a client from its /sys/kernel/debug/dri/0/<tid>-<n>/client file
+ *
+ * @return Size in bytes of each allocation listed
+ */
+std::vector<unsigned long> GpuMemory::ParseBroadcomClient(std::istream &stream)
+{
+    std::vector<unsigned long> allocations;
+
+    std::string line;
+    while (std::getline(stream, line)) {
+        char processName[32];
+        unsigned int objectsNum;
+        unsigned long virtualMemNum;
+        char virtualMemNumUnit[3];
+
+        // Scan as far as we need to.
+        if (sscanf(line.c_str(), " %s %d %ld%2c", processName, &objectsNum, &virtualMemNum,
+                   virtualMemNumUnit) == 4) {
+
+            virtualMemNumUnit[2] = 0;
+
+            std::string virtualMemNumUnitStr(virtualMemNumUnit);
+
+            if (virtualMemNumUnitStr == "KB") {
+                allocations.emplace_back(virtualMemNum * 1024);
+            } else if (virtualMemNumUnitStr == "MB") {
+                allocations.emplace_back(virtualMemNum * 1024 * 1024);
+            } else if (virtualMemNumUnitStr == "GB") {
+                allocations.emplace_back(virtualMemNum * 1024 * 1024 * 1024);
+            } else {
+                LOG_WARN("Could not parse this line: \'%s\'", line.c_str());
+            }
+        }
+    }
+
+    return allocations;
+}
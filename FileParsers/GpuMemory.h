@@ -0,0 +1,49 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <sys/types.h>
+#include <istream>
+#include <vector>
+
+/**
+ * @brief Parsers for the various GPU memory debug files exposed by the SoC vendors' drivers
+ */
+class GpuMemory
+{
+public:
+    struct Allocation
+    {
+        pid_t pid;
+        unsigned long bytes;
+    };
+
+    // Layout of the Mali gpu_memory file differs between vendor kernels
+    enum class MaliFormat
+    {
+        // <kctx address> <pid> <pages>
+        Amlogic,
+        //   kctx-0x<address> <pages> <pid>
+        Realtek
+    };
+
+    static std::vector<Allocation> ParseMali(std::istream &stream, MaliFormat format, size_t pageSize);
+
+    static std::vector<unsigned long> ParseBroadcomClient(std::istream &stream);
+};
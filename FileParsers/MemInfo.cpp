@@ -19,55 +19,172 @@
 
 #include "MemInfo.h"
 
-#include <fstream>
+#include <cstring>
+#include <string_view>
 #include "Log.h"
+#include "FileSystem/FileSystem.h"
 
-MemInfo::MemInfo() : mTotal(0), mFree(0), mAvailable(0), mUsed(0), mBuffers(0), mCached(0), mSlab(0), mSReclaimable(0),
-                     mSUnreclaimable(0), mSwapTotal(0), mSwapFree(0), mCmaTotal(0), mCmaFree(0)
+namespace
 {
-    parseMemInfo();
+    // Indexed by MemInfo::Field
+    constexpr std::array<std::string_view, MemInfo::kFieldCount> kFieldNames = {
+            "MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "SwapCached", "Active", "Inactive",
+            "Active(anon)", "Inactive(anon)", "Active(file)", "Inactive(file)", "Unevictable", "Mlocked",
+            "HighTotal", "HighFree", "LowTotal", "LowFree", "MmapCopy", "SwapTotal", "SwapFree", "Zswap", "Zswapped",
+            "Dirty", "Writeback", "AnonPages", "Mapped", "Shmem", "KReclaimable", "Slab", "SReclaimable",
+            "SUnreclaim", "KernelStack", "ShadowCallStack", "PageTables", "SecPageTables", "NFS_Unstable", "Bounce",
+            "WritebackTmp", "CommitLimit", "Committed_AS", "VmallocTotal", "VmallocUsed", "VmallocChunk", "Percpu",
+            "HardwareCorrupted", "AnonHugePages", "ShmemHugePages", "ShmemPmdMapped", "FileHugePages",
+            "FilePmdMapped", "CmaTotal", "CmaFree", "Unaccepted", "Balloon", "Quicklists", "HugePages_Total",
+            "HugePages_Free", "HugePages_Rsvd", "HugePages_Surp", "Hugepagesize", "Hugetlb", "DirectMap4k",
+            "DirectMap2M", "DirectMap4M", "DirectMap1G"
+    };
+
+    static_assert(kFieldNames.back() == "DirectMap1G", "Every MemInfo::Field needs a name");
+
+    // /proc/meminfo is around 1.5KB, so this leaves plenty of room for vendor additions
+    constexpr size_t kBufferSize = 8192;
+
+    constexpr size_t kTableSize = 512;
+
+    constexpr uint32_t hashKey(std::string_view key, uint32_t seed)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u ^ seed;
+        for (char c: key) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 16777619u;
+        }
+
+        return hash & (kTableSize - 1);
+    }
+
+    struct hashTable
+    {
+        bool valid;
+        uint32_t seed;
+        // Field index + 1 for each slot, or 0 if no field hashes to it
+        std::array<uint8_t, kTableSize> slots;
+    };
+
+    /**
+     * Find a seed that gives every field its own slot, so a lookup is one hash and one string compare
+     */
+    constexpr hashTable buildTable()
+    {
+        for (uint32_t seed = 0; seed < 10000; seed++) {
+            hashTable table{true, seed, {}};
+
+            for (size_t i = 0; i < kFieldNames.size() && table.valid; i++) {
+                auto &slot = table.slots[hashKey(kFieldNames[i], seed)];
+                if (slot != 0) {
+                    table.valid = false;
+                } else {
+                    slot = static_cast<uint8_t>(i + 1);
+                }
+            }
+
+            if (table.valid) {
+                return table;
+            }
+        }
+
+        return hashTable{false, 0, {}};
+    }
+
+    constexpr hashTable kTable = buildTable();
+    static_assert(kTable.valid, "No perfect hash for the meminfo field names, increase kTableSize");
+
+    /**
+     * @return Index of the field, or -1 if it's not one we know about
+     */
+    int lookup(std::string_view key)
+    {
+        const auto slot = kTable.slots[hashKey(key, kTable.seed)];
+        if (slot == 0 || kFieldNames[slot - 1] != key) {
+            return -1;
+        }
+
+        return slot - 1;
+    }
 }
 
-void MemInfo::parseMemInfo()
+MemInfo::MemInfo() : mValues{}, mPresent(), mUsed(0)
 {
-    std::ifstream meminfo("/proc/meminfo");
-    if (!meminfo) {
+    char buffer[kBufferSize];
+    const auto length = FileSystem::Get().ReadFileInto("/proc/meminfo", buffer, sizeof(buffer));
+    if (length < 0) {
         LOG_WARN("Failed to open /proc/meminfo");
         return;
     }
 
-    std::string line;
-    long value;
-    while (std::getline(meminfo, line)) {
-        if (sscanf(line.c_str(), "MemTotal: %ld kB", &value) != 0) {
-            mTotal = value;
-        } else if (sscanf(line.c_str(), "MemFree: %ld kB", &value) != 0) {
-            mFree = value;
-        } else if (sscanf(line.c_str(), "MemAvailable: %ld kB", &value) != 0) {
-            mAvailable = value;
-        } else if (sscanf(line.c_str(), "Buffers: %ld kB", &value) != 0) {
-            mBuffers = value;
-        } else if (sscanf(line.c_str(), "Cached: %ld kB", &value) != 0) {
-            mCached = value;
-        } else if (sscanf(line.c_str(), "Slab: %ld kB", &value) != 0) {
-            mSlab = value;
-        } else if (sscanf(line.c_str(), "SReclaimable: %ld kB", &value) != 0) {
-            mSReclaimable = value;
-        } else if (sscanf(line.c_str(), "SUnreclaim: %ld kB", &value) != 0) {
-            mSUnreclaimable = value;
-        } else if (sscanf(line.c_str(), "SwapTotal: %ld kB", &value) != 0) {
-            mSwapTotal = value;
-        } else if (sscanf(line.c_str(), "SwapFree: %ld kB", &value) != 0) {
-            mSwapFree = value;
-        } else if (sscanf(line.c_str(), "CmaTotal: %ld kB", &value) != 0) {
-            mCmaTotal = value;
+    parseMemInfo(buffer, static_cast<size_t>(length));
+}
+
+/**
+ * @brief Parse meminfo contents from somewhere other than /proc/meminfo (e.g. a saved copy)
+ */
+MemInfo::MemInfo(std::istream &stream) : mValues{}, mPresent(), mUsed(0)
+{
+    char buffer[kBufferSize];
+    stream.read(buffer, sizeof(buffer));
+    parseMemInfo(buffer, static_cast<size_t>(stream.gcount()));
+}
+
+const char *MemInfo::FieldName(Field field)
+{
+    // All names are literals, so are NUL terminated
+    return kFieldNames[static_cast<size_t>(field)].data();
+}
+
+/**
+ * @return True if the field is a number of huge pages rather than a size in KB
+ */
+bool MemInfo::IsPageCount(Field field)
+{
+    return field == Field::HugePagesTotal || field == Field::HugePagesFree || field == Field::HugePagesRsvd ||
+           field == Field::HugePagesSurp;
+}
+
+void MemInfo::parseMemInfo(const char *data, size_t length)
+{
+    const char *end = data + length;
+    const char *line = data;
+
+    while (line < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
         }
+
+        // Each line is "Key:    value kB"
+        const char *colon = static_cast<const char *>(memchr(line, ':', lineEnd - line));
+        if (colon) {
+            const int field = lookup(std::string_view(line, colon - line));
+            if (field >= 0) {
+                const char *p = colon + 1;
+                while (p < lineEnd && *p == ' ') {
+                    p++;
+                }
+
+                long value = 0;
+                while (p < lineEnd && *p >= '0' && *p <= '9') {
+                    value = (value * 10) + (*p - '0');
+                    p++;
+                }
+
+                mValues[field] = value;
+                mPresent.set(field);
+            }
+        }
+
+        line = lineEnd + 1;
     }
 
-    if (mTotal < (mFree + mBuffers + mCached + mSlab)) {
+    if (MemTotalKb() < (MemFreeKb() + BuffersKb() + CachedKb() + SlabKb())) {
         LOG_WARN("MemTotal too small, something went wrong calculating memory");
         return;
     }
 
-    mUsed = mTotal - (mFree + mBuffers + mCached + mSReclaimable);
+    mUsed = MemTotalKb() - (MemFreeKb() + BuffersKb() + CachedKb() + SlabReclaimable());
 }
@@ -19,27 +19,132 @@
 
 #pragma once
 
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <istream>
+
 /**
  * @brief Utility wrapper over the /proc/meminfo file to pull data from it easily
+ *
+ * Every field the kernel reports is available with Get(). The file is read into a stack buffer and each key is looked
+ * up in a perfect hash table built at compile time, so parsing doesn't allocate and is cheap enough to do every tick
  */
 class MemInfo
 {
 public:
+    // In the order the kernel prints them. Fields that depend on kernel version or config may not be present
+    enum class Field : uint8_t
+    {
+        MemTotal,
+        MemFree,
+        MemAvailable,
+        Buffers,
+        Cached,
+        SwapCached,
+        Active,
+        Inactive,
+        ActiveAnon,
+        InactiveAnon,
+        ActiveFile,
+        InactiveFile,
+        Unevictable,
+        Mlocked,
+        HighTotal,
+        HighFree,
+        LowTotal,
+        LowFree,
+        MmapCopy,
+        SwapTotal,
+        SwapFree,
+        Zswap,
+        Zswapped,
+        Dirty,
+        Writeback,
+        AnonPages,
+        Mapped,
+        Shmem,
+        KReclaimable,
+        Slab,
+        SReclaimable,
+        SUnreclaim,
+        KernelStack,
+        ShadowCallStack,
+        PageTables,
+        SecPageTables,
+        NfsUnstable,
+        Bounce,
+        WritebackTmp,
+        CommitLimit,
+        CommittedAs,
+        VmallocTotal,
+        VmallocUsed,
+        VmallocChunk,
+        Percpu,
+        HardwareCorrupted,
+        AnonHugePages,
+        ShmemHugePages,
+        ShmemPmdMapped,
+        FileHugePages,
+        FilePmdMapped,
+        CmaTotal,
+        CmaFree,
+        Unaccepted,
+        Balloon,
+        Quicklists,
+        HugePagesTotal,
+        HugePagesFree,
+        HugePagesRsvd,
+        HugePagesSurp,
+        Hugepagesize,
+        Hugetlb,
+        DirectMap4k,
+        DirectMap2M,
+        DirectMap4M,
+        DirectMap1G,
+
+        Count
+    };
+
+    static constexpr size_t kFieldCount = static_cast<size_t>(Field::Count);
+
     MemInfo();
 
+    explicit MemInfo(std::istream &stream);
+
+    /**
+     * @return True if the kernel reported the field
+     */
+    bool Has(Field field) const
+    {
+        return mPresent.test(static_cast<size_t>(field));
+    }
+
+    /**
+     * @return Value of the field (KB for everything except the HugePages_* counts), or 0 if it wasn't reported
+     */
+    long Get(Field field) const
+    {
+        return mValues[static_cast<size_t>(field)];
+    }
+
+    static const char *FieldName(Field field);
+
+    static bool IsPageCount(Field field);
+
     long MemTotalKb() const
     {
-        return mTotal;
+        return Get(Field::MemTotal);
     }
 
     long MemFreeKb() const
     {
-        return mFree;
+        return Get(Field::MemFree);
     }
 
     long MemAvailableKb() const
     {
-        return mAvailable;
+        return Get(Field::MemAvailable);
     }
 
     long MemUsedKb() const
@@ -49,69 +154,59 @@ public:
 
     long BuffersKb() const
     {
-        return mBuffers;
+        return Get(Field::Buffers);
     }
 
     long CachedKb() const
     {
-        return mCached;
+        return Get(Field::Cached);
     }
 
     long SlabKb() const
     {
-        return mSlab;
+        return Get(Field::Slab);
     }
 
     long SlabReclaimable() const
     {
-        return mSReclaimable;
+        return Get(Field::SReclaimable);
     }
 
     long SlabUnreclaimable() const
     {
-        return mSUnreclaimable;
+        return Get(Field::SUnreclaim);
     }
 
     long SwapTotal() const
     {
-        return mSwapTotal;
+        return Get(Field::SwapTotal);
     }
 
     long SwapFree() const
     {
-        return mSwapFree;
+        return Get(Field::SwapFree);
     }
 
     long SwapUsed() const {
-        return mSwapTotal - mSwapFree;
+        return SwapTotal() - SwapFree();
     }
 
     long CmaTotal() const
     {
-        return mCmaTotal;
+        return Get(Field::CmaTotal);
     }
 
     long CmaFree() const
     {
-        return mCmaFree;
+        return Get(Field::CmaFree);
     }
 
 private:
-    void parseMemInfo();
+    void parseMemInfo(const char *data, size_t length);
 
 
 private:
-    long mTotal;
-    long mFree;
-    long mAvailable;
+    std::array<long, kFieldCount> mValues;
+    std::bitset<kFieldCount> mPresent;
     long mUsed;
-    long mBuffers;
-    long mCached;
-    long mSlab;
-    long mSReclaimable;
-    long mSUnreclaimable;
-    long mSwapTotal;
-    long mSwapFree;
-    long mCmaTotal;
-    long mCmaFree;
 };
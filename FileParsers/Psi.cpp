@@ -0,0 +1,65 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "Psi.h"
+
+#include <cstdio>
+#include <sstream>
+#include "FileSystem/FileSystem.h"
+
+Psi::Psi(const std::string &path) : mValid(false), mHasFull(false), mSome{}, mFull{}
+{
+    std::istringstream pressure;
+    if (!FileSystem::Open(path, pressure)) {
+        return;
+    }
+
+    parsePsi(pressure);
+}
+
+/**
+ * @brief Parse pressure contents from somewhere other than the filesystem (e.g. a saved copy, or a file read without
+ * going through FileSystem)
+ */
+Psi::Psi(std::istream &stream) : mValid(false), mHasFull(false), mSome{}, mFull{}
+{
+    parsePsi(stream);
+}
+
+void Psi::parsePsi(std::istream &stream)
+{
+    std::string line;
+    while (std::getline(stream, line)) {
+        // e.g. "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+        char type[5];
+        Stall stall{};
+        if (sscanf(line.c_str(), "%4s avg10=%lf avg60=%lf avg300=%lf total=%llu", type, &stall.avg10, &stall.avg60,
+                   &stall.avg300, &stall.totalUs) != 5) {
+            continue;
+        }
+
+        if (std::string(type) == "some") {
+            mSome = stall;
+            mValid = true;
+        } else if (std::string(type) == "full") {
+            mFull = stall;
+            mHasFull = true;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <istream>
+#include <string>
+
+/**
+ * @brief Utility wrapper over a pressure stall information file (/proc/pressure/<resource> or
+ * <cgroup>/<resource>.pressure)
+ *
+ * See https://docs.kernel.org/accounting/psi.html
+ */
+class Psi
+{
+public:
+    struct Stall
+    {
+        // Percentage of time stalled over the last 10, 60 and 300 seconds
+        double avg10;
+        double avg60;
+        double avg300;
+
+        // Total time stalled since boot (or the cgroup was created)
+        unsigned long long totalUs;
+    };
+
+    explicit Psi(const std::string &path);
+
+    explicit Psi(std::istream &stream);
+
+    bool IsValid() const
+    {
+        return mValid;
+    }
+
+    /**
+     * @return Time at least one task was stalled
+     */
+    const Stall &Some() const
+    {
+        return mSome;
+    }
+
+    /**
+     * @return Time all non-idle tasks were stalled at the same time. Not reported for CPU on older kernels
+     */
+    const Stall &Full() const
+    {
+        return mFull;
+    }
+
+    bool HasFull() const
+    {
+        return mHasFull;
+    }
+
+private:
+    void parsePsi(std::istream &stream);
+
+private:
+    bool mValid;
+    bool mHasFull;
+    Stall mSome;
+    Stall mFull;
+};
@@ -18,38 +18,49 @@
 */
 
 #include "Smaps.h"
+#include "FileSystem/FileSystem.h"
 
-#include <filesystem>
-#include <fstream>
+#include <sstream>
 #include <climits>
 #include <cstring>
 
-Smaps::Smaps(pid_t pid) : mPid(pid), mRss(0), mPss(0), mSwap(0), mSwapPss(0), mLocked(0), mPrivateClean(0), mPrivateDirty(0),
-                          mSize(0)
+Smaps::Smaps(pid_t pid, bool rollupSupported) : mPid(pid), mRss(0), mPss(0), mSwap(0), mSwapPss(0), mLocked(0),
+                                                 mPrivateClean(0), mPrivateDirty(0), mSize(0)
 {
+    // Only need the full smaps if the kernel is too old for smaps_rollup
     char buffer[PATH_MAX];
-    snprintf(buffer, sizeof(buffer), "/proc/%d/smaps_rollup", mPid);
+    snprintf(buffer, sizeof(buffer), rollupSupported ? "/proc/%d/smaps_rollup" : "/proc/%d/smaps", mPid);
 
-    if (std::filesystem::exists(buffer)) {
-        parseSmapsRollup();
+    std::istringstream smapsFile;
+    if (!FileSystem::Open(buffer, smapsFile)) {
+        // Process might have died, don't log anything
+        return;
+    }
+
+    if (rollupSupported) {
+        parseSmapsRollup(smapsFile);
     } else {
-        parseSmaps();
+        parseSmaps(smapsFile);
     }
 }
 
-void Smaps::parseSmaps()
+/**
+ * @brief Parse smaps or smaps_rollup contents from somewhere other than procfs (e.g. a saved copy)
+ */
+Smaps::Smaps(std::istream &stream, bool rollup) : mPid(0), mRss(0), mPss(0), mSwap(0), mSwapPss(0), mLocked(0),
+                                                  mPrivateClean(0), mPrivateDirty(0), mSize(0)
 {
-    char filePath[PATH_MAX];
-    snprintf(filePath, sizeof(filePath), "/proc/%d/smaps", mPid);
-
-    std::ifstream smapsFile(filePath);
-    if (!smapsFile) {
-        // Process might have died, don't log anything
-        return;
+    if (rollup) {
+        parseSmapsRollup(stream);
+    } else {
+        parseSmaps(stream);
     }
+}
 
+void Smaps::parseSmaps(std::istream &stream)
+{
     std::string line;
-    while (std::getline(smapsFile, line)) {
+    while (std::getline(stream, line)) {
         auto entry = parseSmapsLine(line);
 
         switch (entry.first) {
@@ -84,19 +95,10 @@ void Smaps::parseSmaps()
     }
 }
 
-void Smaps::parseSmapsRollup()
+void Smaps::parseSmapsRollup(std::istream &stream)
 {
-    char filePath[PATH_MAX];
-    snprintf(filePath, sizeof(filePath), "/proc/%d/smaps_rollup", mPid);
-
-    std::ifstream smapsFile(filePath);
-    if (!smapsFile) {
-        // Process might have died, don't log anything
-        return;
-    }
-
     std::string line;
-    while (std::getline(smapsFile, line)) {
+    while (std::getline(stream, line)) {
         auto entry = parseSmapsLine(line);
 
         switch (entry.first) {
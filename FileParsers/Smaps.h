@@ -21,6 +21,7 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <istream>
 #include <string_view>
 
 /**
@@ -29,7 +30,13 @@
 class Smaps
 {
 public:
-    Smaps(pid_t pid);
+    /**
+     * @param rollupSupported Whether the kernel has smaps_rollup, probed once up front so old kernels don't pay for a
+     * failed open per process
+     */
+    Smaps(pid_t pid, bool rollupSupported);
+
+    Smaps(std::istream &stream, bool rollup);
 
     long Rss() const
     {
@@ -81,9 +88,9 @@ private:
     };
 
 private:
-    void parseSmaps();
+    void parseSmaps(std::istream &stream);
 
-    void parseSmapsRollup();
+    void parseSmapsRollup(std::istream &stream);
 
     std::pair<SmapsField, long> parseSmapsLine(std::string_view line);
 
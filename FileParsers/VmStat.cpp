@@ -0,0 +1,95 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "VmStat.h"
+
+#include <cstring>
+#include "Log.h"
+#include "FileSystem/FileSystem.h"
+
+VmStat::VmStat() : mBuffer{}, mCounters()
+{
+    const auto length = FileSystem::Get().ReadFileInto("/proc/vmstat", mBuffer, sizeof(mBuffer));
+    if (length < 0) {
+        LOG_WARN("Failed to open /proc/vmstat");
+        return;
+    }
+
+    parseVmStat(static_cast<size_t>(length));
+}
+
+/**
+ * @brief Parse vmstat contents from somewhere other than /proc/vmstat (e.g. a saved copy)
+ */
+VmStat::VmStat(std::istream &stream) : mBuffer{}, mCounters()
+{
+    stream.read(mBuffer, sizeof(mBuffer));
+    parseVmStat(static_cast<size_t>(stream.gcount()));
+}
+
+/**
+ * @brief Work out whether a counter counts events since boot (so is only interesting as a rate), or is the current
+ * value of something
+ *
+ * The nr_* counters are current page counts, apart from a handful that count events
+ */
+bool VmStat::IsEventCounter(std::string_view name)
+{
+    if (name == "workingset_nodes") {
+        return false;
+    }
+
+    if (name.compare(0, 3, "nr_") != 0) {
+        return true;
+    }
+
+    return name == "nr_dirtied" || name == "nr_written" || name == "nr_foll_pin_acquired" ||
+           name == "nr_foll_pin_released" || name.compare(0, 7, "nr_tlb_") == 0;
+}
+
+void VmStat::parseVmStat(size_t length)
+{
+    // Roughly the number of counters on a recent kernel
+    mCounters.reserve(200);
+
+    const char *end = mBuffer + length;
+    const char *line = mBuffer;
+
+    while (line < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        // Each line is "name value"
+        const char *space = static_cast<const char *>(memchr(line, ' ', lineEnd - line));
+        if (space && space != line) {
+            unsigned long long value = 0;
+            const char *p = space + 1;
+            while (p < lineEnd && *p >= '0' && *p <= '9') {
+                value = (value * 10) + (*p - '0');
+                p++;
+            }
+
+            mCounters.emplace_back(Counter{std::string_view(line, space - line), value});
+        }
+
+        line = lineEnd + 1;
+    }
+}
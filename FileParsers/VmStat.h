@@ -0,0 +1,65 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <istream>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Utility wrapper over the /proc/vmstat file to pull every counter from it in one pass
+ *
+ * Which counters exist depends on the kernel version and config, so they're returned in the order the kernel prints
+ * them rather than as fixed fields. Names point into the buffer the file was read into, so they're only valid for as
+ * long as the VmStat object
+ */
+class VmStat
+{
+public:
+    struct Counter
+    {
+        std::string_view name;
+        unsigned long long value;
+    };
+
+    VmStat();
+
+    explicit VmStat(std::istream &stream);
+
+    VmStat(const VmStat &) = delete;
+
+    VmStat &operator=(const VmStat &) = delete;
+
+    const std::vector<Counter> &Counters() const
+    {
+        return mCounters;
+    }
+
+    static bool IsEventCounter(std::string_view name);
+
+private:
+    void parseVmStat(size_t length);
+
+private:
+    // /proc/vmstat is around 5KB on recent kernels
+    static constexpr size_t kBufferSize = 16384;
+
+    char mBuffer[kBufferSize];
+    std::vector<Counter> mCounters;
+};
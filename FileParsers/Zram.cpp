@@ -0,0 +1,135 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "Zram.h"
+#include "Log.h"
+#include "FileSystem/FileSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+std::vector<std::string> ZramDevice::FindDevices()
+{
+    std::vector<std::string> devices;
+
+    std::vector<IFileSystem::DirectoryEntry> entries;
+    if (!FileSystem::Get().ListDirectory("/sys/block", entries)) {
+        return devices;
+    }
+
+    // /sys/block entries are symlinks, so the type can't be used
+    for (const auto &entry: entries) {
+        if (entry.name.compare(0, 4, "zram") == 0) {
+            devices.emplace_back(entry.name);
+        }
+    }
+
+    std::sort(devices.begin(), devices.end());
+    return devices;
+}
+
+ZramDevice::ZramDevice(std::string name)
+        : mName(std::move(name)),
+          mDiskSize(0),
+          mMmStat{},
+          mIoStat{},
+          mBdStat{},
+          mHasBdStat(false)
+{
+    const std::string path = "/sys/block/" + mName;
+    auto &fileSystem = FileSystem::Get();
+
+    mDiskSizeFile = fileSystem.OpenFile(path + "/disksize");
+    mMmStatFile = fileSystem.OpenFile(path + "/mm_stat");
+    mIoStatFile = fileSystem.OpenFile(path + "/io_stat");
+    mBdStatFile = fileSystem.OpenFile(path + "/bd_stat");
+}
+
+bool ZramDevice::Read()
+{
+    unsigned long long values[8] = {};
+    if (readValues(mDiskSizeFile.get(), values, 1) != 1) {
+        LOG_WARN("Failed to read disksize for %s", mName.c_str());
+        return false;
+    }
+    mDiskSize = values[0];
+
+    if (!ReadMmStat()) {
+        return false;
+    }
+
+    std::fill(std::begin(values), std::end(values), 0);
+    readValues(mIoStatFile.get(), values, 4);
+    mIoStat = IoStat{values[0], values[1], values[2], values[3]};
+
+    std::fill(std::begin(values), std::end(values), 0);
+    mHasBdStat = readValues(mBdStatFile.get(), values, 3) == 3;
+    mBdStat = BdStat{values[0], values[1], values[2]};
+
+    return true;
+}
+
+bool ZramDevice::ReadMmStat()
+{
+    unsigned long long values[8] = {};
+    const auto count = readValues(mMmStatFile.get(), values, 8);
+
+    // huge_pages was only added in 5.1, everything before it has been there since 4.7
+    if (count < 7) {
+        LOG_WARN("Failed to read mm_stat for %s", mName.c_str());
+        return false;
+    }
+    mMmStat = MmStat{values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]};
+
+    return true;
+}
+
+/**
+ * @brief Read up to count whitespace separated numbers from the start of a file
+ *
+ * @return How many numbers were read
+ */
+size_t ZramDevice::readValues(IFileHandle *handle, unsigned long long *values, size_t count)
+{
+    if (!handle) {
+        return 0;
+    }
+
+    char buffer[256];
+    auto length = handle->Read(buffer, sizeof(buffer) - 1);
+    if (length <= 0) {
+        return 0;
+    }
+    buffer[length] = '\0';
+
+    size_t read = 0;
+    char *position = buffer;
+    while (read < count) {
+        char *end = nullptr;
+        const auto value = strtoull(position, &end, 10);
+        if (end == position) {
+            break;
+        }
+
+        values[read++] = value;
+        position = end;
+    }
+
+    return read;
+}
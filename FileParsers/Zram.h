@@ -0,0 +1,134 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "FileSystem/IFileSystem.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Statistics of a single zram device, from the files in /sys/block/zramN
+ *
+ * See https://docs.kernel.org/admin-guide/blockdev/zram.html. The files are opened once and re-read each time Read()
+ * is called
+ */
+class ZramDevice
+{
+public:
+    // All sizes in bytes
+    struct MmStat
+    {
+        unsigned long long origDataSize;
+        unsigned long long comprDataSize;
+        // Including the allocator's own overhead and fragmentation
+        unsigned long long memUsedTotal;
+        // 0 if there is no limit
+        unsigned long long memLimit;
+        unsigned long long memUsedMax;
+        unsigned long long samePages;
+        unsigned long long pagesCompacted;
+        // Pages that didn't compress, so are stored as they are. Needs Linux 5.1
+        unsigned long long hugePages;
+    };
+
+    struct IoStat
+    {
+        unsigned long long failedReads;
+        unsigned long long failedWrites;
+        unsigned long long invalidIo;
+        unsigned long long notifyFree;
+    };
+
+    // Writeback to a backing device, in 4K units. Only there with CONFIG_ZRAM_WRITEBACK
+    struct BdStat
+    {
+        unsigned long long count;
+        unsigned long long reads;
+        unsigned long long writes;
+    };
+
+    /**
+     * @brief Names of the zram devices that exist right now (e.g. zram0)
+     */
+    static std::vector<std::string> FindDevices();
+
+    explicit ZramDevice(std::string name);
+
+    const std::string &Name() const
+    {
+        return mName;
+    }
+
+    /**
+     * @return False if the device's statistics couldn't be read (e.g. it has been hot removed)
+     */
+    bool Read();
+
+    /**
+     * @brief Only re-read mm_stat, for when the memory usage is all that's needed
+     */
+    bool ReadMmStat();
+
+    /**
+     * @return Size of the device in bytes, 0 if it hasn't been set up yet
+     */
+    unsigned long long DiskSize() const
+    {
+        return mDiskSize;
+    }
+
+    const MmStat &GetMmStat() const
+    {
+        return mMmStat;
+    }
+
+    const IoStat &GetIoStat() const
+    {
+        return mIoStat;
+    }
+
+    bool HasBdStat() const
+    {
+        return mHasBdStat;
+    }
+
+    const BdStat &GetBdStat() const
+    {
+        return mBdStat;
+    }
+
+private:
+    static size_t readValues(IFileHandle *handle, unsigned long long *values, size_t count);
+
+private:
+    const std::string mName;
+
+    std::unique_ptr<IFileHandle> mDiskSizeFile;
+    std::unique_ptr<IFileHandle> mMmStatFile;
+    std::unique_ptr<IFileHandle> mIoStatFile;
+    std::unique_ptr<IFileHandle> mBdStatFile;
+
+    unsigned long long mDiskSize;
+    MmStat mMmStat;
+    IoStat mIoStat;
+    BdStat mBdStat;
+    bool mHasBdStat;
+};
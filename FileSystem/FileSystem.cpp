@@ -0,0 +1,50 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "FileSystem.h"
+#include "RealFileSystem.h"
+
+std::shared_ptr<IFileSystem> FileSystem::sFileSystem = std::make_shared<RealFileSystem>();
+
+IFileSystem &FileSystem::Get()
+{
+    return *sFileSystem;
+}
+
+void FileSystem::Set(std::shared_ptr<IFileSystem> fileSystem)
+{
+    sFileSystem = std::move(fileSystem);
+}
+
+/**
+ * @brief Read a file into a stream, for parsers that work line by line
+ *
+ * @return False if the file could not be opened
+ */
+bool FileSystem::Open(const std::string &path, std::istringstream &stream)
+{
+    std::string contents;
+    if (!Get().ReadFile(path, contents)) {
+        return false;
+    }
+
+    stream.str(contents);
+    stream.clear();
+    return true;
+}
@@ -0,0 +1,44 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "IFileSystem.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Holds the filesystem all the collectors read through
+ *
+ * Defaults to the real filesystem. Replace it with Set() before starting any collection (e.g. to record or replay
+ * the reads) - it must not be changed while collection is running
+ */
+class FileSystem
+{
+public:
+    static IFileSystem &Get();
+
+    static void Set(std::shared_ptr<IFileSystem> fileSystem);
+
+    static bool Open(const std::string &path, std::istringstream &stream);
+
+private:
+    static std::shared_ptr<IFileSystem> sFileSystem;
+};
@@ -0,0 +1,174 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * @brief A file kept open so it can be cheaply re-read every tick, for small files like cgroup counters that are read
+ * over and over again
+ */
+class IFileHandle
+{
+public:
+    virtual ~IFileHandle() = default;
+
+    /**
+     * @brief Read up to size bytes from the start of the file
+     *
+     * @return Number of bytes read, or -1 if the file can no longer be read (e.g. the cgroup has been removed)
+     */
+    virtual ssize_t Read(char *buffer, size_t size) = 0;
+};
+
+/**
+ * @brief Access to the procfs/sysfs/debugfs files the collectors read from
+ *
+ * Everything the collectors read goes through this interface instead of the filesystem directly, so the reads can be
+ * recorded on a device and replayed somewhere else
+ */
+class IFileSystem
+{
+public:
+    struct DirectoryEntry
+    {
+        std::string name;
+        bool isDirectory;
+    };
+
+    virtual ~IFileSystem() = default;
+
+    /**
+     * @brief Read the entire contents of a file
+     *
+     * @return False if the file could not be opened
+     */
+    virtual bool ReadFile(const std::string &path, std::string &contents) = 0;
+
+    /**
+     * @brief Read up to size bytes of a file into a buffer supplied by the caller, for hot paths that shouldn't allocate
+     *
+     * @return Number of bytes read, or -1 if the file could not be opened
+     */
+    virtual ssize_t ReadFileInto(const std::string &path, char *buffer, size_t size)
+    {
+        std::string contents;
+        if (!ReadFile(path, contents)) {
+            return -1;
+        }
+
+        const auto length = std::min(size, contents.size());
+        memcpy(buffer, contents.data(), length);
+        return static_cast<ssize_t>(length);
+    }
+
+    /**
+     * @brief List the entries in a directory (not including . and ..), in the order the kernel returns them
+     *
+     * @return False if the directory could not be opened
+     */
+    virtual bool ListDirectory(const std::string &path, std::vector<DirectoryEntry> &entries) = 0;
+
+    virtual bool Exists(const std::string &path) = 0;
+
+    /**
+     * @brief Open a file to be read repeatedly with IFileHandle::Read
+     *
+     * By default every read goes back through ReadFileInto by path, implementations that can keep the file open
+     * should override this
+     *
+     * @return nullptr if the file does not exist
+     */
+    virtual std::unique_ptr<IFileHandle> OpenFile(const std::string &path)
+    {
+        if (!Exists(path)) {
+            return nullptr;
+        }
+
+        return std::make_unique<PathFileHandle>(*this, path);
+    }
+
+    /**
+     * @brief Called by each collector at the start of every tick, before it reads anything
+     *
+     * @param collector Name of the collector starting a tick
+     * @return False if there is nothing left to collect (e.g. the end of a replay), so the collector should stop
+     */
+    virtual bool BeginTick(const std::string &/* collector */)
+    {
+        return true;
+    }
+
+    /**
+     * @return Number of files and directories the calling thread has opened on the device, so collectors can see what
+     * they cost. Re-reading a file kept open with OpenFile() doesn't open it again
+     */
+    static uint64_t FilesOpened()
+    {
+        return sFilesOpened;
+    }
+
+    /**
+     * @return Same as FilesOpened(), but for every thread
+     */
+    static uint64_t TotalFilesOpened()
+    {
+        return sTotalFilesOpened.load(std::memory_order_relaxed);
+    }
+
+protected:
+    /**
+     * @brief Implementations that open files on the device call this every time they do
+     */
+    static void countOpen()
+    {
+        sFilesOpened++;
+        sTotalFilesOpened.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    class PathFileHandle : public IFileHandle
+    {
+    public:
+        PathFileHandle(IFileSystem &fileSystem, std::string path)
+                : mFileSystem(fileSystem),
+                  mPath(std::move(path))
+        {
+        }
+
+        ssize_t Read(char *buffer, size_t size) override
+        {
+            return mFileSystem.ReadFileInto(mPath, buffer, size);
+        }
+
+    private:
+        IFileSystem &mFileSystem;
+        const std::string mPath;
+    };
+
+private:
+    static inline thread_local uint64_t sFilesOpened = 0;
+    static inline std::atomic<uint64_t> sTotalFilesOpened{0};
+};
@@ -0,0 +1,185 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "RealFileSystem.h"
+
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+/**
+ * @brief Keeps the file descriptor open and re-reads it from the start with pread, which avoids the path lookup and
+ * open/close on every read
+ */
+class FdFileHandle : public IFileHandle
+{
+public:
+    explicit FdFileHandle(int fd)
+            : mFd(fd)
+    {
+    }
+
+    ~FdFileHandle() override
+    {
+        close(mFd);
+    }
+
+    FdFileHandle(const FdFileHandle &) = delete;
+
+    FdFileHandle &operator=(const FdFileHandle &) = delete;
+
+    ssize_t Read(char *buffer, size_t size) override
+    {
+        size_t length = 0;
+        while (length < size) {
+            auto ret = pread(mFd, buffer + length, size - length, static_cast<off_t>(length));
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (ret < 0) {
+                // Files in a removed cgroup return ENODEV
+                return length > 0 ? static_cast<ssize_t>(length) : -1;
+            }
+
+            if (ret == 0) {
+                break;
+            }
+
+            length += ret;
+        }
+
+        return static_cast<ssize_t>(length);
+    }
+
+private:
+    const int mFd;
+};
+}
+
+bool RealFileSystem::ReadFile(const std::string &path, std::string &contents)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    countOpen();
+
+    // procfs/sysfs files report a size of 0, so just keep reading until there's nothing left
+    contents.resize(4096);
+    size_t length = 0;
+
+    while (true) {
+        if (length == contents.size()) {
+            contents.resize(contents.size() * 2);
+        }
+
+        auto ret = read(fd, &contents[length], contents.size() - length);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret <= 0) {
+            // Treat a failed read (e.g. process died part way through) the same as reaching the end
+            break;
+        }
+
+        length += ret;
+    }
+
+    close(fd);
+    contents.resize(length);
+    return true;
+}
+
+ssize_t RealFileSystem::ReadFileInto(const std::string &path, char *buffer, size_t size)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    countOpen();
+
+    size_t length = 0;
+    while (length < size) {
+        auto ret = read(fd, buffer + length, size - length);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret <= 0) {
+            break;
+        }
+
+        length += ret;
+    }
+
+    close(fd);
+    return static_cast<ssize_t>(length);
+}
+
+bool RealFileSystem::ListDirectory(const std::string &path, std::vector<DirectoryEntry> &entries)
+{
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        return false;
+    }
+    countOpen();
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name(entry->d_name);
+        if (name == "." || name == "..") {
+            continue;
+        }
+
+        bool isDirectory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            // Not all filesystems fill in the type
+            struct stat s{};
+            isDirectory = stat((path + "/" + name).c_str(), &s) == 0 && S_ISDIR(s.st_mode);
+        }
+
+        entries.emplace_back(DirectoryEntry{std::move(name), isDirectory});
+    }
+
+    closedir(dir);
+    return true;
+}
+
+bool RealFileSystem::Exists(const std::string &path)
+{
+    struct stat s{};
+    return stat(path.c_str(), &s) == 0;
+}
+
+std::unique_ptr<IFileHandle> RealFileSystem::OpenFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    countOpen();
+
+    return std::make_unique<FdFileHandle>(fd);
+}
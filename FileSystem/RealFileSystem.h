@@ -0,0 +1,40 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "IFileSystem.h"
+
+/**
+ * @brief Reads straight from the filesystem of the device we're running on
+ */
+class RealFileSystem : public IFileSystem
+{
+public:
+    RealFileSystem() = default;
+
+    bool ReadFile(const std::string &path, std::string &contents) override;
+
+    ssize_t ReadFileInto(const std::string &path, char *buffer, size_t size) override;
+
+    bool ListDirectory(const std::string &path, std::vector<DirectoryEntry> &entries) override;
+
+    bool Exists(const std::string &path) override;
+
+    std::unique_ptr<IFileHandle> OpenFile(const std::string &path) override;
+};
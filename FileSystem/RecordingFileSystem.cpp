@@ -0,0 +1,164 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "RecordingFileSystem.h"
+#include "Log.h"
+
+RecordingFileSystem::RecordingFileSystem(std::shared_ptr<IFileSystem> fileSystem, std::string path)
+        : mFileSystem(std::move(fileSystem)),
+          mPath(std::move(path))
+{
+
+}
+
+RecordingFileSystem::~RecordingFileSystem()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    if (mFile.is_open()) {
+        mFile.close();
+    }
+}
+
+bool RecordingFileSystem::Open()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    mFile.open(mPath, std::ios::binary | std::ios::trunc);
+    if (!mFile) {
+        LOG_ERROR("Failed to open %s to record to", mPath.c_str());
+        return false;
+    }
+
+    mFile.write(RecordingFormat::kMagic, sizeof(RecordingFormat::kMagic));
+    mFile.write(reinterpret_cast<const char *>(&RecordingFormat::kVersion), sizeof(RecordingFormat::kVersion));
+    return true;
+}
+
+bool RecordingFileSystem::ReadFile(const std::string &path, std::string &contents)
+{
+    bool success = mFileSystem->ReadFile(path, contents);
+    writeRecord(RecordingFormat::RecordType::File, success, path, success ? contents : std::string());
+    return success;
+}
+
+ssize_t RecordingFileSystem::ReadFileInto(const std::string &path, char *buffer, size_t size)
+{
+    auto length = mFileSystem->ReadFileInto(path, buffer, size);
+    writeRecord(RecordingFormat::RecordType::File, length >= 0, path,
+                length >= 0 ? std::string(buffer, length) : std::string());
+    return length;
+}
+
+bool RecordingFileSystem::ListDirectory(const std::string &path, std::vector<DirectoryEntry> &entries)
+{
+    std::vector<DirectoryEntry> listed;
+    bool success = mFileSystem->ListDirectory(path, listed);
+
+    std::string data;
+    for (const auto &entry: listed) {
+        data += entry.isDirectory ? 'd' : 'f';
+        data += entry.name;
+        data += '\0';
+    }
+
+    writeRecord(RecordingFormat::RecordType::Directory, success, path, data);
+
+    entries.insert(entries.end(), listed.begin(), listed.end());
+    return success;
+}
+
+bool RecordingFileSystem::Exists(const std::string &path)
+{
+    bool exists = mFileSystem->Exists(path);
+    writeRecord(RecordingFormat::RecordType::Exists, exists, path, std::string());
+    return exists;
+}
+
+bool RecordingFileSystem::BeginTick(const std::string &collector)
+{
+    writeRecord(RecordingFormat::RecordType::Tick, true, collector, std::string());
+    return mFileSystem->BeginTick(collector);
+}
+
+/**
+ * @brief Saves every read of a handle as a normal file read, so the replay doesn't need to know the file was held open
+ */
+class RecordingFileSystem::RecordingFileHandle : public IFileHandle
+{
+public:
+    RecordingFileHandle(RecordingFileSystem &fileSystem, std::unique_ptr<IFileHandle> handle, std::string path)
+            : mFileSystem(fileSystem),
+              mHandle(std::move(handle)),
+              mPath(std::move(path))
+    {
+    }
+
+    ssize_t Read(char *buffer, size_t size) override
+    {
+        auto length = mHandle->Read(buffer, size);
+        mFileSystem.writeRecord(RecordingFormat::RecordType::File, length >= 0, mPath,
+                                length >= 0 ? std::string(buffer, length) : std::string());
+        return length;
+    }
+
+private:
+    RecordingFileSystem &mFileSystem;
+    const std::unique_ptr<IFileHandle> mHandle;
+    const std::string mPath;
+};
+
+std::unique_ptr<IFileHandle> RecordingFileSystem::OpenFile(const std::string &path)
+{
+    // Replay opens files with the default implementation, which checks the file exists first
+    auto handle = mFileSystem->OpenFile(path);
+    writeRecord(RecordingFormat::RecordType::Exists, handle != nullptr, path, std::string());
+
+    if (!handle) {
+        return nullptr;
+    }
+
+    return std::make_unique<RecordingFileHandle>(*this, std::move(handle), path);
+}
+
+void RecordingFileSystem::writeRecord(RecordingFormat::RecordType type, bool success, const std::string &path,
+                                      const std::string &data)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (!mFile.is_open()) {
+        return;
+    }
+
+    auto typeByte = static_cast<uint8_t>(type);
+    auto successByte = static_cast<uint8_t>(success ? 1 : 0);
+    auto pathLength = static_cast<uint32_t>(path.size());
+    auto dataLength = static_cast<uint32_t>(data.size());
+
+    mFile.write(reinterpret_cast<const char *>(&typeByte), sizeof(typeByte));
+    mFile.write(reinterpret_cast<const char *>(&successByte), sizeof(successByte));
+    mFile.write(reinterpret_cast<const char *>(&pathLength), sizeof(pathLength));
+    mFile.write(path.data(), pathLength);
+    mFile.write(reinterpret_cast<const char *>(&dataLength), sizeof(dataLength));
+    mFile.write(data.data(), dataLength);
+
+    if (!mFile) {
+        LOG_ERROR("Failed to write to recording %s, no longer recording", mPath.c_str());
+        mFile.close();
+    }
+}
@@ -0,0 +1,67 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "IFileSystem.h"
+#include "RecordingFormat.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Passes reads through to another filesystem, saving the raw bytes of every read so they can be replayed
+ * later with ReplayFileSystem
+ */
+class RecordingFileSystem : public IFileSystem
+{
+public:
+    RecordingFileSystem(std::shared_ptr<IFileSystem> fileSystem, std::string path);
+
+    ~RecordingFileSystem() override;
+
+    bool Open();
+
+    bool ReadFile(const std::string &path, std::string &contents) override;
+
+    ssize_t ReadFileInto(const std::string &path, char *buffer, size_t size) override;
+
+    bool ListDirectory(const std::string &path, std::vector<DirectoryEntry> &entries) override;
+
+    bool Exists(const std::string &path) override;
+
+    bool BeginTick(const std::string &collector) override;
+
+    std::unique_ptr<IFileHandle> OpenFile(const std::string &path) override;
+
+private:
+    class RecordingFileHandle;
+
+
+    void writeRecord(RecordingFormat::RecordType type, bool success, const std::string &path,
+                     const std::string &data);
+
+private:
+    const std::shared_ptr<IFileSystem> mFileSystem;
+    const std::string mPath;
+
+    std::mutex mLock;
+    std::ofstream mFile;
+};
@@ -0,0 +1,51 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Layout of a recording of filesystem reads (.memrec)
+ *
+ * File starts with the magic and version, followed by one record per read in the order they happened:
+ *
+ *  uint8_t  type      (RecordType)
+ *  uint8_t  success   (1 if the file/directory could be read or the path exists)
+ *  uint32_t pathLength
+ *  char     path[pathLength]
+ *  uint32_t dataLength
+ *  char     data[dataLength]
+ *
+ * For files the data is the raw file contents. For directories it is each entry as a 'd' or 'f' followed by the name
+ * and a NUL terminator. Exists checks have no data. The start of each collector tick is recorded with the collector
+ * name as the path and no data. All integers are little-endian.
+ */
+namespace RecordingFormat
+{
+    constexpr char kMagic[8] = {'M', 'E', 'M', 'C', 'R', 'E', 'C', '\0'};
+    constexpr uint32_t kVersion = 1;
+
+    enum class RecordType : uint8_t
+    {
+        File = 1,
+        Directory = 2,
+        Exists = 3,
+        Tick = 4
+    };
+}
@@ -0,0 +1,198 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ReplayFileSystem.h"
+#include "Log.h"
+
+#include <cstring>
+#include <fstream>
+
+ReplayFileSystem::ReplayFileSystem(std::string path)
+        : mPath(std::move(path)),
+          mRecordCount(0),
+          mExhausted(false)
+{
+
+}
+
+/**
+ * @brief Load the recording
+ *
+ * @return False if the file can't be read or isn't a recording
+ */
+bool ReplayFileSystem::Open()
+{
+    std::ifstream file(mPath, std::ios::binary);
+    if (!file) {
+        LOG_ERROR("Failed to open recording %s", mPath.c_str());
+        return false;
+    }
+
+    char magic[sizeof(RecordingFormat::kMagic)];
+    uint32_t version = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+    if (!file || memcmp(magic, RecordingFormat::kMagic, sizeof(magic)) != 0) {
+        LOG_ERROR("%s is not a recording", mPath.c_str());
+        return false;
+    }
+
+    if (version != RecordingFormat::kVersion) {
+        LOG_ERROR("Unsupported recording version %u (expected %u)", version, RecordingFormat::kVersion);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    while (true) {
+        uint8_t type;
+        uint8_t success;
+        uint32_t length;
+
+        if (!file.read(reinterpret_cast<char *>(&type), sizeof(type))) {
+            // Clean end of file
+            break;
+        }
+
+        file.read(reinterpret_cast<char *>(&success), sizeof(success));
+        file.read(reinterpret_cast<char *>(&length), sizeof(length));
+
+        std::string path(length, '\0');
+        file.read(&path[0], length);
+
+        file.read(reinterpret_cast<char *>(&length), sizeof(length));
+        std::string data(length, '\0');
+        file.read(&data[0], length);
+
+        if (!file) {
+            // Recording was probably cut short when the device was killed - everything before this is still good
+            LOG_WARN("Recording %s is truncated", mPath.c_str());
+            break;
+        }
+
+        if (static_cast<RecordingFormat::RecordType>(type) == RecordingFormat::RecordType::Tick) {
+            mTicksRemaining[path]++;
+            continue;
+        }
+
+        mRecords[std::make_pair(static_cast<RecordingFormat::RecordType>(type), path)].emplace_back(
+                record{success != 0, std::move(data)});
+        mRecordCount++;
+    }
+
+    if (mTicksRemaining.empty()) {
+        LOG_ERROR("Recording %s has no collection ticks", mPath.c_str());
+        return false;
+    }
+
+    for (const auto &ticks: mTicksRemaining) {
+        LOG_INFO("Recording has %zu %s ticks", ticks.second, ticks.first.c_str());
+    }
+
+    LOG_INFO("Loaded %zu reads of %zu paths from %s", mRecordCount, mRecords.size(), mPath.c_str());
+    return true;
+}
+
+bool ReplayFileSystem::ReadFile(const std::string &path, std::string &contents)
+{
+    record result;
+    if (!next(RecordingFormat::RecordType::File, path, result) || !result.success) {
+        return false;
+    }
+
+    contents = std::move(result.data);
+    return true;
+}
+
+bool ReplayFileSystem::ListDirectory(const std::string &path, std::vector<DirectoryEntry> &entries)
+{
+    record result;
+    if (!next(RecordingFormat::RecordType::Directory, path, result) || !result.success) {
+        return false;
+    }
+
+    size_t start = 0;
+    while (start < result.data.size()) {
+        auto end = result.data.find('\0', start);
+        if (end == std::string::npos) {
+            break;
+        }
+
+        entries.emplace_back(DirectoryEntry{result.data.substr(start + 1, end - start - 1), result.data[start] == 'd'});
+        start = end + 1;
+    }
+
+    return true;
+}
+
+bool ReplayFileSystem::Exists(const std::string &path)
+{
+    record result;
+    return next(RecordingFormat::RecordType::Exists, path, result) && result.success;
+}
+
+/**
+ * @return False once the collector has had all the ticks it had when recording
+ */
+bool ReplayFileSystem::BeginTick(const std::string &collector)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    auto itr = mTicksRemaining.find(collector);
+    if (itr != mTicksRemaining.end() && itr->second > 0) {
+        itr->second--;
+        return true;
+    }
+
+    mFinishedCollectors.insert(collector);
+    if (mFinishedCollectors.size() >= mTicksRemaining.size()) {
+        mExhausted = true;
+    }
+
+    return false;
+}
+
+/**
+ * @return True once every collector has had all of its recorded ticks
+ */
+bool ReplayFileSystem::IsExhausted() const
+{
+    return mExhausted;
+}
+
+bool ReplayFileSystem::next(RecordingFormat::RecordType type, const std::string &path, record &out)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    auto itr = mRecords.find(std::make_pair(type, path));
+    if (itr == mRecords.end()) {
+        // Never read when recording
+        return false;
+    }
+
+    if (itr->second.empty()) {
+        LOG_WARN("Read %s more times than when recording", path.c_str());
+        return false;
+    }
+
+    out = std::move(itr->second.front());
+    itr->second.pop_front();
+    return true;
+}
@@ -0,0 +1,78 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "IFileSystem.h"
+#include "RecordingFormat.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+/**
+ * @brief Serves the reads saved by RecordingFileSystem instead of reading from the real filesystem
+ *
+ * Each read of a path gets the next recorded result for that path, so as long as the collectors read the same paths
+ * in the same order they did when recording, they see exactly what they saw on the device. Paths that were never
+ * recorded don't exist.
+ *
+ * Each collector gets as many ticks as it had when recording. Once they've all had them the replay is exhausted
+ */
+class ReplayFileSystem : public IFileSystem
+{
+public:
+    explicit ReplayFileSystem(std::string path);
+
+    bool Open();
+
+    bool ReadFile(const std::string &path, std::string &contents) override;
+
+    bool ListDirectory(const std::string &path, std::vector<DirectoryEntry> &entries) override;
+
+    bool Exists(const std::string &path) override;
+
+    bool BeginTick(const std::string &collector) override;
+
+    bool IsExhausted() const;
+
+private:
+    struct record
+    {
+        bool success;
+        std::string data;
+    };
+
+    bool next(RecordingFormat::RecordType type, const std::string &path, record &out);
+
+private:
+    const std::string mPath;
+
+    std::mutex mLock;
+    std::map<std::pair<RecordingFormat::RecordType, std::string>, std::deque<record>> mRecords;
+    size_t mRecordCount;
+
+    // Number of ticks left for each collector, and the collectors that have used them all
+    std::map<std::string, size_t> mTicksRemaining;
+    std::set<std::string> mFinishedCollectors;
+    std::atomic<bool> mExhausted;
+};
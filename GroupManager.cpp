@@ -20,7 +20,8 @@
 #include "GroupManager.h"
 #include "Log.h"
 
-GroupManager::GroupManager(nlohmann::json groupList) : mProcessGroups(), mContainerGroups()
+GroupManager::GroupManager(nlohmann::json groupList)
+        : mProcessGroups(), mContainerGroups(), mProcessMatcher(), mContainerMatcher()
 {
     // Attempt to parse group JSON
 
@@ -42,18 +43,17 @@ GroupManager::GroupManager(nlohmann::json groupList) : mProcessGroups(), mContai
             }
             std::vector<std::string> processList = group["processes"];
 
-            // Got valid group info, parse process names into regexes and add to list
-            std::vector<std::regex> processRegexes{};
-            std::for_each(processList.begin(), processList.end(), [&](const std::string &name)
-            {
-                processRegexes.emplace_back(name);
-            });
+            // Got valid group info, add the process names to the matcher
+            for (const auto &name: processList) {
+                mProcessMatcher.AddPattern(mProcessGroups.size(), name);
+            }
 
-            Group processGroup(groupName, processRegexes);
-            mProcessGroups.emplace_back(processGroup);
+            mProcessGroups.emplace_back(groupName);
         }
 
-        LOG_INFO("Loaded %zu process groups", mProcessGroups.size());
+        mProcessMatcher.Compile();
+        LOG_INFO("Loaded %zu process groups (%zu literal patterns, %zu regexes)", mProcessGroups.size(),
+                 mProcessMatcher.LiteralCount(), mProcessMatcher.RegexCount());
     }
 
     // Get container groups
@@ -75,16 +75,14 @@ GroupManager::GroupManager(nlohmann::json groupList) : mProcessGroups(), mContai
             }
             std::vector<std::string> containerList = group["containers"];
 
-            std::vector<std::regex> containerRegexes{};
-            std::for_each(containerList.begin(), containerList.end(), [&](const std::string &name)
-            {
-                containerRegexes.emplace_back(name);
-            });
+            for (const auto &name: containerList) {
+                mContainerMatcher.AddPattern(mContainerGroups.size(), name);
+            }
 
-            Group containerGroup(groupName, containerRegexes);
-            mContainerGroups.emplace_back(containerGroup);
+            mContainerGroups.emplace_back(groupName);
         }
 
+        mContainerMatcher.Compile();
         LOG_INFO("Loaded %zu container groups", mContainerGroups.size());
     }
 }
@@ -102,22 +100,80 @@ std::optional<std::string> GroupManager::getGroup(groupType type, const std::str
 {
     switch (type) {
         case groupType::PROCESS: {
-            for (const auto &group: mProcessGroups) {
-                if (group.isMatch(name)) {
-                    return group.name();
-                }
+            auto match = mProcessMatcher.Match(name);
+            if (match.has_value()) {
+                return mProcessGroups[match.value()];
             }
             return std::nullopt;
         }
         case groupType::CONTAINER: {
-            for (const auto &group: mContainerGroups) {
-                if (group.isMatch(name)) {
-                    return group.name();
-                }
+            auto match = mContainerMatcher.Match(name);
+            if (match.has_value()) {
+                return mContainerGroups[match.value()];
             }
             return std::nullopt;
         }
         default:
             return std::nullopt;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Work out which group a process belongs to. The result is cached, so processes with the same container, name and
+ * cmdline are only resolved once while they're in use
+ *
+ * @param container Container the process is running in (empty if not containerised)
+ * @param name Name of the process without the path
+ * @param cmdline Full cmdline of the process
+ *
+ * @return If the group can be resolved, return the name of the group. Otherwise returns nullopt
+ */
+std::optional<std::string> GroupManager::getProcessGroup(const std::string &container, const std::string &name,
+                                                         const std::string &cmdline)
+{
+    std::string key;
+    key.reserve(container.size() + name.size() + cmdline.size() + 2);
+    key.append(container).append(1, '\0').append(name).append(1, '\0').append(cmdline);
+
+    std::lock_guard<std::mutex> locker(mCacheLock);
+
+    auto itr = mProcessGroupCache.find(key);
+    if (itr != mProcessGroupCache.end()) {
+        mProcessGroupCacheOrder.splice(mProcessGroupCacheOrder.begin(), mProcessGroupCacheOrder, itr->second);
+        return itr->second->second;
+    }
+
+    auto group = resolveProcessGroup(container, name, cmdline);
+    mProcessGroupCacheOrder.emplace_front(std::move(key), group);
+    mProcessGroupCache.emplace(mProcessGroupCacheOrder.front().first, mProcessGroupCacheOrder.begin());
+
+    if (mProcessGroupCacheOrder.size() > kProcessGroupCacheSize) {
+        mProcessGroupCache.erase(mProcessGroupCacheOrder.back().first);
+        mProcessGroupCacheOrder.pop_back();
+    }
+
+    return group;
+}
+
+std::optional<std::string> GroupManager::resolveProcessGroup(const std::string &container, const std::string &name,
+                                                             const std::string &cmdline)
+{
+    // WARNING:: Container is intentionally prioritised over everything else to allow a "WPEWebProcess" rule to capture JSPP
+    // processes without capturing containerised browsers
+    if (!container.empty()) {
+        auto group = getGroup(groupType::CONTAINER, container);
+
+        if (group.has_value()) {
+            return group;
+        }
+    }
+
+    auto group = getGroup(groupType::PROCESS, name);
+
+    if (group.has_value()) {
+        return group;
+    }
+
+    // Didn't get group by name or container, try cmdline
+    return getGroup(groupType::PROCESS, cmdline);
+}
@@ -20,11 +20,15 @@
 #pragma once
 
 #include "nlohmann/json.hpp"
+#include <list>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <optional>
-#include "Group.h"
+#include <mutex>
+#include <unordered_map>
+#include "GroupMatcher.h"
 
 
 /**
@@ -44,7 +48,30 @@ public:
 
     std::optional<std::string> getGroup(groupType type, const std::string& name);
 
+    std::optional<std::string> getProcessGroup(const std::string &container, const std::string &name,
+                                               const std::string &cmdline);
+
+private:
+    std::optional<std::string> resolveProcessGroup(const std::string &container, const std::string &name,
+                                                   const std::string &cmdline);
+
 private:
-    std::vector<Group> mProcessGroups;
-    std::vector<Group> mContainerGroups;
+    // Group names, in priority order. The matchers return an index into these
+    std::vector<std::string> mProcessGroups;
+    std::vector<std::string> mContainerGroups;
+
+    GroupMatcher mProcessMatcher;
+    GroupMatcher mContainerMatcher;
+
+    // Resolved groups keyed by container, name and cmdline. Many processes share the same details (e.g. worker
+    // processes) so we only run the regexes once for each. Processes with a unique cmdline each get an entry, so
+    // only the most recently used are kept
+    static constexpr size_t kProcessGroupCacheSize = 4096;
+
+    using cacheEntry = std::pair<std::string, std::optional<std::string>>;
+
+    std::mutex mCacheLock;
+    // Most recently used first. The map keys point at the keys in the list
+    std::list<cacheEntry> mProcessGroupCacheOrder;
+    std::unordered_map<std::string_view, std::list<cacheEntry>::iterator> mProcessGroupCache;
 };
@@ -0,0 +1,338 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "GroupMatcher.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <queue>
+
+GroupMatcher::GroupMatcher() : mNodes(1, node{{}, 0, NO_GROUP}), mLiteralCount(0), mRegexes()
+{
+}
+
+/**
+ * Add a pattern to the matcher. Compile() must be called after all patterns have been added
+ *
+ * @param groupIndex Priority of the group the pattern belongs to (lower is higher priority)
+ * @param pattern Regex for the pattern. Plain strings are matched with the automaton instead of a regex
+ *
+ * @return False if the pattern was not a valid regex
+ */
+bool GroupMatcher::AddPattern(size_t groupIndex, const std::string &pattern)
+{
+    std::string literal;
+    if (!isLiteral(pattern, literal)) {
+        try {
+            mRegexes.push_back(regexRule{groupIndex, requiredLiteral(pattern), std::regex(pattern)});
+        } catch (const std::regex_error &e) {
+            LOG_WARN("Invalid regex '%s' - %s", pattern.c_str(), e.what());
+            return false;
+        }
+        return true;
+    }
+
+    // Add the literal to the trie
+    uint32_t current = 0;
+    for (const auto c: literal) {
+        auto next = findChild(current, static_cast<unsigned char>(c));
+        if (next == NO_NODE) {
+            next = static_cast<uint32_t>(mNodes.size());
+            mNodes.push_back(node{{}, 0, NO_GROUP});
+
+            auto &children = mNodes[current].children;
+            auto itr = std::lower_bound(children.begin(), children.end(), static_cast<unsigned char>(c),
+                                        [](const std::pair<unsigned char, uint32_t> &child, unsigned char value)
+                                        {
+                                            return child.first < value;
+                                        });
+            children.emplace(itr, static_cast<unsigned char>(c), next);
+        }
+        current = next;
+    }
+
+    mNodes[current].bestGroup = std::min(mNodes[current].bestGroup, groupIndex);
+    mLiteralCount++;
+
+    return true;
+}
+
+/**
+ * Build the failure links for the automaton and sort the regexes by priority
+ */
+void GroupMatcher::Compile()
+{
+    // Breadth first so a node's failure target is always complete before the node itself
+    std::queue<uint32_t> queue;
+    for (const auto &child: mNodes[0].children) {
+        mNodes[child.second].fail = 0;
+        mNodes[child.second].bestGroup = std::min(mNodes[child.second].bestGroup, mNodes[0].bestGroup);
+        queue.push(child.second);
+    }
+
+    while (!queue.empty()) {
+        auto current = queue.front();
+        queue.pop();
+
+        for (const auto &child: mNodes[current].children) {
+            auto fail = mNodes[current].fail;
+            auto target = findChild(fail, child.first);
+            while (target == NO_NODE && fail != 0) {
+                fail = mNodes[fail].fail;
+                target = findChild(fail, child.first);
+            }
+
+            mNodes[child.second].fail = target == NO_NODE ? 0 : target;
+            mNodes[child.second].bestGroup = std::min(mNodes[child.second].bestGroup,
+                                                      mNodes[mNodes[child.second].fail].bestGroup);
+            queue.push(child.second);
+        }
+    }
+
+    std::stable_sort(mRegexes.begin(), mRegexes.end(),
+                     [](const regexRule &a, const regexRule &b)
+                     {
+                         return a.group < b.group;
+                     });
+}
+
+/**
+ * Find the highest priority group that matches the provided string
+ *
+ * @return Index of the group passed to AddPattern, or nullopt if nothing matched
+ */
+std::optional<size_t> GroupMatcher::Match(const std::string &name) const
+{
+    size_t best = mNodes[0].bestGroup;
+
+    uint32_t current = 0;
+    for (const auto c: name) {
+        auto next = findChild(current, static_cast<unsigned char>(c));
+        while (next == NO_NODE && current != 0) {
+            current = mNodes[current].fail;
+            next = findChild(current, static_cast<unsigned char>(c));
+        }
+        current = next == NO_NODE ? 0 : next;
+
+        best = std::min(best, mNodes[current].bestGroup);
+        if (best == 0) {
+            // Can't do any better than the first group
+            break;
+        }
+    }
+
+    // Only need to try regexes belonging to a higher priority group than the best literal match
+    for (const auto &rule: mRegexes) {
+        if (rule.group >= best) {
+            break;
+        }
+
+        if (!rule.required.empty() && name.find(rule.required) == std::string::npos) {
+            continue;
+        }
+
+        if (std::regex_search(name, rule.regex)) {
+            best = rule.group;
+            break;
+        }
+    }
+
+    if (best == NO_GROUP) {
+        return std::nullopt;
+    }
+    return best;
+}
+
+size_t GroupMatcher::LiteralCount() const
+{
+    return mLiteralCount;
+}
+
+size_t GroupMatcher::RegexCount() const
+{
+    return mRegexes.size();
+}
+
+/**
+ * Check if a pattern can be matched as a plain string. Escaped punctuation (e.g. "\.") is allowed and unescaped
+ *
+ * @param[in] pattern Regex pattern
+ * @param[out] literal String to search for if the pattern is a literal
+ * @return True if the pattern contains no regex operators
+ */
+bool GroupMatcher::isLiteral(const std::string &pattern, std::string &literal)
+{
+    static const char *specialChars = ".^$|()[]{}*+?\\";
+
+    literal.clear();
+    literal.reserve(pattern.size());
+
+    for (size_t i = 0; i < pattern.size(); i++) {
+        const char c = pattern[i];
+
+        if (c == '\\') {
+            // Escaped punctuation is still a literal character, but things like \d or \b are not
+            if (i + 1 < pattern.size() && std::ispunct(static_cast<unsigned char>(pattern[i + 1]))) {
+                literal += pattern[++i];
+                continue;
+            }
+            return false;
+        }
+
+        if (c == '\0' || strchr(specialChars, c) != nullptr) {
+            return false;
+        }
+
+        literal += c;
+    }
+
+    return true;
+}
+
+/**
+ * Find the longest run of plain text that must appear in any string the regex matches. This is deliberately
+ * conservative - if the regex uses alternation we don't try and work it out
+ *
+ * @return Required text, or an empty string if there isn't any
+ */
+std::string GroupMatcher::requiredLiteral(const std::string &pattern)
+{
+    if (pattern.find('|') != std::string::npos) {
+        return {};
+    }
+
+    std::string longest;
+    std::string current;
+    // Groups might be optional, so ignore anything inside them
+    int groupDepth = 0;
+
+    auto endRun = [&]()
+    {
+        if (current.size() > longest.size()) {
+            longest = current;
+        }
+        current.clear();
+    };
+
+    for (size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+
+        if (c == '[') {
+            // Skip character classes, allowing for a ']' as the first character
+            endRun();
+            i++;
+            if (i < pattern.size() && pattern[i] == '^') {
+                i++;
+            }
+            if (i < pattern.size() && pattern[i] == ']') {
+                i++;
+            }
+            while (i < pattern.size() && pattern[i] != ']') {
+                if (pattern[i] == '\\') {
+                    i++;
+                }
+                i++;
+            }
+            continue;
+        }
+
+        if (c == '{') {
+            // Everything up to the closing brace is the repeat count (e.g. {2,3}), not text to match
+            endRun();
+            while (i < pattern.size() && pattern[i] != '}') {
+                i++;
+            }
+            continue;
+        }
+
+        if (c == '\\') {
+            if (i + 1 < pattern.size() && std::ispunct(static_cast<unsigned char>(pattern[i + 1]))) {
+                c = pattern[++i];
+            } else {
+                // Character class escape such as \d, a backreference or a character code such as \x41. None of it is
+                // text that has to appear as written, so skip the whole escape sequence
+                endRun();
+                i++;
+                if (i >= pattern.size()) {
+                    continue;
+                }
+
+                // How many characters follow the escape letter, and what they can be
+                size_t length = 0;
+                int (*isPart)(int) = nullptr;
+                if (pattern[i] == 'x' || pattern[i] == 'u') {
+                    length = pattern[i] == 'x' ? 2 : 4;
+                    isPart = ::isxdigit;
+                } else if (pattern[i] == 'c') {
+                    length = 1;
+                    isPart = ::isalpha;
+                } else if (std::isdigit(static_cast<unsigned char>(pattern[i]))) {
+                    length = std::string::npos;
+                    isPart = ::isdigit;
+                }
+
+                while (length > 0 && i + 1 < pattern.size() && isPart(static_cast<unsigned char>(pattern[i + 1]))) {
+                    i++;
+                    length--;
+                }
+                continue;
+            }
+        } else if (c == '(' || c == ')') {
+            endRun();
+            groupDepth += c == '(' ? 1 : -1;
+            continue;
+        } else if (c == '\0' || strchr(".^$|()[]{}*+?", c) != nullptr) {
+            // Anything else with a special meaning we don't model - safer to give up on the current run
+            endRun();
+            continue;
+        }
+
+        if (groupDepth > 0) {
+            continue;
+        }
+
+        // Characters that are followed by a quantifier which allows zero repeats are optional
+        if (i + 1 < pattern.size() && strchr("?*{", pattern[i + 1]) != nullptr) {
+            endRun();
+            continue;
+        }
+
+        current += c;
+    }
+    endRun();
+
+    return longest;
+}
+
+uint32_t GroupMatcher::findChild(uint32_t node, unsigned char c) const
+{
+    const auto &children = mNodes[node].children;
+    auto itr = std::lower_bound(children.begin(), children.end(), c,
+                                [](const std::pair<unsigned char, uint32_t> &child, unsigned char value)
+                                {
+                                    return child.first < value;
+                                });
+
+    if (itr == children.end() || itr->first != c) {
+        return NO_NODE;
+    }
+    return itr->second;
+}
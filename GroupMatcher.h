@@ -0,0 +1,88 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Matches a string against a full set of group rules in one go
+ *
+ * Each rule is a pattern belonging to a group, and the groups are ordered by priority (the order they appear in the
+ * groups file). A lookup returns the highest priority group with a pattern that matches anywhere in the string, the same
+ * as running std::regex_search over each group's patterns in turn.
+ *
+ * Most patterns are plain strings (e.g. "syslog-ng"), so these are compiled into a single Aho-Corasick automaton and
+ * found with one pass over the string. Patterns that really need a regex are kept in priority order and only tried if
+ * they could beat the best literal match and the string contains the plain text the regex requires.
+ */
+class GroupMatcher
+{
+public:
+    GroupMatcher();
+
+    bool AddPattern(size_t groupIndex, const std::string &pattern);
+
+    void Compile();
+
+    std::optional<size_t> Match(const std::string &name) const;
+
+    size_t LiteralCount() const;
+
+    size_t RegexCount() const;
+
+private:
+    static bool isLiteral(const std::string &pattern, std::string &literal);
+
+    static std::string requiredLiteral(const std::string &pattern);
+
+    uint32_t findChild(uint32_t node, unsigned char c) const;
+
+private:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+    static constexpr size_t NO_GROUP = SIZE_MAX;
+
+    struct node
+    {
+        // Sorted by character so we can binary search
+        std::vector<std::pair<unsigned char, uint32_t>> children;
+        uint32_t fail;
+        // Highest priority group of any literal ending at this node or any of its suffixes
+        size_t bestGroup;
+    };
+
+    std::vector<node> mNodes;
+    size_t mLiteralCount;
+
+    struct regexRule
+    {
+        size_t group;
+        // Some string the regex can't match without, so we can skip the (slow) regex search for most strings
+        std::string required;
+        std::regex regex;
+    };
+
+    // Regexes sorted by group priority
+    std::vector<regexRule> mRegexes;
+};
@@ -0,0 +1,85 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "HtmlReportRenderer.h"
+#include "Log.h"
+
+#include <fstream>
+
+#include "inja/inja.hpp"
+
+#define INCBIN_STYLE INCBIN_STYLE_SNAKE
+#define INCBIN_PREFIX g_
+
+#include <incbin.h>
+
+INCBIN(templateHtml, "./templates/template.html");
+
+/**
+ * @brief Render the HTML report and stream it straight to the specified file
+ *
+ * The template only gets the report summary as data. Processes and dataset rows are copied out of the report one at a
+ * time through callbacks as they're written, so memory use doesn't grow with the size of the report
+ *
+ * @return True if the report was saved successfully
+ */
+bool HtmlReportRenderer::Render(const JsonReportGenerator &report, const std::filesystem::path &outputFile)
+{
+    inja::Environment env;
+    // Make the output a bit tidier
+    env.set_trim_blocks(true);
+    env.set_lstrip_blocks(true);
+
+    env.add_callback("process", 1, [&report](inja::Arguments &args)
+    {
+        return report.getProcess(args.at(0)->get<size_t>());
+    });
+    env.add_callback("row", 2, [&report](inja::Arguments &args)
+    {
+        return report.getRow(args.at(0)->get<size_t>(), args.at(1)->get<size_t>());
+    });
+    env.add_callback("rows", 1, [&report](inja::Arguments &args)
+    {
+        return report.getRows(args.at(0)->get<size_t>());
+    });
+
+    std::ofstream outputHtml(outputFile, std::ios::trunc | std::ios::binary);
+    if (!outputHtml) {
+        LOG_ERROR("Failed to open %s", outputFile.string().c_str());
+        return false;
+    }
+
+    try {
+        auto htmlTemplate = env.parse(std::string_view(reinterpret_cast<const char *>(g_templateHtml_data),
+                                                       g_templateHtml_size));
+        env.render_to(outputHtml, htmlTemplate, report.getRenderSummary());
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to save HTML report with exception %s", e.what());
+        return false;
+    }
+
+    outputHtml.close();
+    if (outputHtml.fail()) {
+        LOG_ERROR("Failed to write HTML report to %s", outputFile.string().c_str());
+        return false;
+    }
+
+    LOG_INFO("Saved report to %s", outputFile.string().c_str());
+    return true;
+}
@@ -48,6 +48,13 @@ public:
      * Expected to format results ina table
      */
     virtual void SaveResults() = 0;
+
+    /**
+     * @brief Discard everything collected so far, without stopping collection
+     *
+     * Used when running as a daemon so results don't build up forever
+     */
+    virtual void ResetResults() = 0;
 };
 
 
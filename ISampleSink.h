@@ -0,0 +1,108 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Procrank.h"
+
+/**
+ * @brief Where a sample's value goes in the report and how it is shown there
+ *
+ * Lets anything that only sees the samples (a saved capture, a daemon session) rebuild the dataset with the same rows
+ * and columns as the report generated on the device
+ */
+struct DatasetLayout
+{
+    static constexpr uint32_t kAppendRow = UINT32_MAX;
+    static constexpr uint16_t kAppendColumn = UINT16_MAX;
+
+    // Index of the row in the dataset when it first appeared. Rows already at or after it have moved down one
+    uint32_t row = kAppendRow;
+
+    // Index of the value in the row, counting the labels
+    uint16_t column = kAppendColumn;
+
+    // Report P50/P95/P99 as well as min/max/average
+    bool percentiles = false;
+
+    // If 0 or more, the report shows the latest value as text with this many decimal places instead of min/max/average
+    int8_t latestDecimals = -1;
+};
+
+/**
+ * @brief A single value collected for one row of a dataset during a tick
+ *
+ * The dataset name, labels and measurement name match the values the dataset is given in the report, so a sample can
+ * always be matched back up to the row/column it belongs to
+ */
+struct DatasetSample
+{
+    std::string dataset;
+    std::vector<std::pair<std::string, std::string>> labels;
+    std::string measurement;
+    long double value;
+    DatasetLayout layout;
+};
+
+/**
+ * @brief The collector a tick came from. Collectors run on their own threads and schedules, so each publishes its own
+ * ticks and a tick only ever holds what one of them collected
+ */
+enum class TickSource : uint32_t
+{
+    Unknown = 0,
+    Processes = 1,
+    Memory = 2,
+    Pressure = 3,
+    PressureEvents = 4,
+    MemoryEvents = 5,
+};
+
+/**
+ * @brief Everything a metric collected during a single collection tick
+ */
+struct TickSamples
+{
+    std::chrono::system_clock::time_point timestamp;
+    TickSource source = TickSource::Unknown;
+
+    std::vector<Procrank::ProcessMemoryUsage> processes;
+    std::vector<DatasetSample> datasets;
+};
+
+/**
+ * @brief Receives the raw samples from each collection tick as they are produced
+ *
+ * Called from the metric collection threads, so implementations should hand the samples off and return as quickly as
+ * possible
+ */
+class ISampleSink
+{
+public:
+    virtual ~ISampleSink() = default;
+
+    virtual void AddTick(const std::shared_ptr<const TickSamples> &tick) = 0;
+};
@@ -20,6 +20,8 @@
 
 #include "JsonReportGenerator.h"
 
+#include <cstdio>
+#include <ctime>
 #include <utility>
 
 JsonReportGenerator::JsonReportGenerator(std::shared_ptr<Metadata> metadata,
@@ -40,56 +42,61 @@ void JsonReportGenerator::addDataset(const std::string &name, const std::vector<
         return;
     }
 
-    nlohmann::ordered_json dataSet;
-
-    dataSet["name"] = name;
-    dataSet["data"] = nlohmann::json::array();
-    dataSet["_columnOrder"] = nlohmann::json::array();
-
-    bool setColumnOrder = false;
-
-    // Inja uses the unordered JSON format, and changing to ordered_json breaks things, see
-    // https://github.com/pantor/inja/pull/214. To work around this, add an array that defines the order
-    // of the columns. The _columnOrder array will also be responsible for generating the table headings
+    table dataSet;
+    dataSet.name = name;
+    dataSet.columnOrder = nlohmann::json::array();
+    dataSet.rows.reserve(data.size());
 
+    // Store the rows with the values in column order so the HTML renderer can loop over them directly. The
+    // _columnOrder array is also responsible for generating the table headings
     for (const auto& item : data) {
-        nlohmann::ordered_json tmp;
+        nlohmann::json row = nlohmann::json::array();
+        const bool setColumnOrder = dataSet.columns.empty();
 
         for (const auto& value : item) {
             std::visit(overload{
                     [&](const std::pair<std::string, std::string> &v)
                     {
-                        tmp[v.first] = v.second;
+                        row.emplace_back(v.second);
 
-                        if (!setColumnOrder) {
-                            dataSet["_columnOrder"].emplace_back(v.first);
+                        if (setColumnOrder) {
+                            dataSet.columns.push_back({v.first, {}});
+                            dataSet.columnOrder.emplace_back(v.first);
                         }
                     },
                     [&](const Measurement &v)
                     {
-                        tmp[v.GetName()]["Min"] = v.GetMinRounded();
-                        tmp[v.GetName()]["Max"] = v.GetMaxRounded();
-                        tmp[v.GetName()]["Average"] = v.GetAverageRounded();
-
-                        if (!setColumnOrder) {
-                            dataSet["_columnOrder"].emplace_back(v.GetName() + " (Min)");
-                            dataSet["_columnOrder"].emplace_back(v.GetName() + " (Max)");
-                            dataSet["_columnOrder"].emplace_back(v.GetName() + " (Average)");
+                        row.emplace_back(v.GetMinRounded());
+                        row.emplace_back(v.GetMaxRounded());
+                        row.emplace_back(v.GetAverageRounded());
+
+                        column col{v.GetName(), {"Min", "Max", "Average"}};
+
+                        if (v.HasPercentiles()) {
+                            for (const auto percentile: {50, 95, 99}) {
+                                row.emplace_back(v.GetPercentileRounded(percentile));
+                                col.stats.emplace_back("P" + std::to_string(percentile));
+                            }
+                        }
+
+                        if (setColumnOrder) {
+                            for (const auto &stat: col.stats) {
+                                dataSet.columnOrder.emplace_back(v.GetName() + " (" + stat + ")");
+                            }
+                            dataSet.columns.emplace_back(std::move(col));
                         }
                     }
             }, value);
         }
-        dataSet["data"].emplace_back(tmp);
-        setColumnOrder = true;
+        dataSet.rows.emplace_back(std::move(row));
     }
 
-    mJson["data"].emplace_back(dataSet);
+    mTables.emplace_back(std::move(dataSet));
 }
 
-
-nlohmann::ordered_json JsonReportGenerator::getJson()
+nlohmann::ordered_json JsonReportGenerator::getMetadata() const
 {
-    mJson["metadata"] = {
+    return {
             {"image",     mMetadata->Image()},
             {"platform",  mMetadata->Platform()},
             {"mac",       mMetadata->Mac()},
@@ -97,8 +104,100 @@ nlohmann::ordered_json JsonReportGenerator::getJson()
             {"duration",  mMetadata->Duration()},
             {"swapEnabled",  mMetadata->SwapEnabled()}
     };
+}
 
-    return mJson;
+/**
+ * @brief Build the full report JSON. Dataset rows are saved as objects keyed by column name
+ */
+nlohmann::ordered_json JsonReportGenerator::getJson() const
+{
+    nlohmann::ordered_json json = mJson;
+    json["metadata"] = getMetadata();
+
+    if (mTables.empty()) {
+        return json;
+    }
+
+    auto &data = json["data"];
+    data = nlohmann::ordered_json::array();
+    for (const auto &dataSet : mTables) {
+        nlohmann::ordered_json tableJson;
+        tableJson["name"] = dataSet.name;
+        tableJson["data"] = nlohmann::ordered_json::array();
+
+        for (const auto &row : dataSet.rows) {
+            nlohmann::ordered_json tmp;
+
+            size_t i = 0;
+            for (const auto &col : dataSet.columns) {
+                if (col.stats.empty()) {
+                    tmp[col.name] = row[i++];
+                } else {
+                    for (const auto &stat: col.stats) {
+                        tmp[col.name][stat] = row[i++];
+                    }
+                }
+            }
+
+            tableJson["data"].emplace_back(std::move(tmp));
+        }
+
+        tableJson["_columnOrder"] = dataSet.columnOrder;
+        data.emplace_back(std::move(tableJson));
+    }
+
+    return json;
+}
+
+/**
+ * @brief Everything the HTML report needs apart from the processes and dataset rows, which are fetched one at a time
+ * with getProcess() and getRow() while rendering so the whole report never has to be held in memory twice
+ *
+ * Datasets only carry their name, column headings, index and row count
+ */
+nlohmann::json JsonReportGenerator::getRenderSummary() const
+{
+    nlohmann::json json;
+    json["metadata"] = getMetadata();
+    json["grandTotal"] = mJson["grandTotal"];
+    json["pssByGroup"] = mJson.contains("pssByGroup") ? nlohmann::json(mJson["pssByGroup"]) : nlohmann::json();
+    json["processCount"] = mJson["processes"].size();
+
+    json["data"] = nlohmann::json::array();
+    for (size_t i = 0; i < mTables.size(); i++) {
+        json["data"].push_back({
+                {"index", i},
+                {"name", mTables[i].name},
+                {"_columnOrder", mTables[i].columnOrder},
+                {"rowCount", mTables[i].rows.size()}
+        });
+    }
+
+    return json;
+}
+
+/**
+ * @brief A single process from the report, in descending PSS order
+ */
+nlohmann::json JsonReportGenerator::getProcess(size_t index) const
+{
+    return mJson["processes"].at(index);
+}
+
+/**
+ * @brief A single dataset row as an array of values in _columnOrder order
+ */
+nlohmann::json JsonReportGenerator::getRow(size_t dataset, size_t index) const
+{
+    return mTables.at(dataset).rows.at(index);
+}
+
+/**
+ * @brief Every row of a dataset, for tables the report embeds whole as a script
+ */
+nlohmann::json JsonReportGenerator::getRows(size_t dataset) const
+{
+    return mTables.at(dataset).rows;
 }
 
 void JsonReportGenerator::addProcesses(std::vector<processMeasurement> &processes)
@@ -122,13 +221,11 @@ void JsonReportGenerator::addProcesses(std::vector<processMeasurement> &processe
         processJson["container"] = process.ProcessInfo.container().has_value() ? process.ProcessInfo.container().value()
                                                                                : "";
 
+        std::optional<std::string> group;
         if (mGroupManager.has_value()) {
-            processJson["group"] = process.ProcessInfo.group(mGroupManager.value()).has_value()
-                                   ? process.ProcessInfo.group(
-                            mGroupManager.value()).value() : "";
-        } else {
-            processJson["group"] = "";
+            group = process.ProcessInfo.group(mGroupManager.value());
         }
+        processJson["group"] = group.value_or("");
 
         processJson["rss"] = process.Rss.ToJson();
         processJson["pss"] = process.Pss.ToJson();
@@ -196,4 +293,16 @@ void JsonReportGenerator::addToAccumulatedMemoryUsage(long double valueKb)
     mJson["grandTotal"]["calculatedUsage"] = usage;
 }
 
+std::string JsonReportGenerator::FormatTimestamp(std::chrono::system_clock::time_point timestamp)
+{
+    const auto time = std::chrono::system_clock::to_time_t(timestamp);
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(timestamp.time_since_epoch()).count() % 1000;
+
+    struct tm local{};
+    localtime_r(&time, &local);
 
+    char buffer[64];
+    const auto length = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    snprintf(buffer + length, sizeof(buffer) - length, ".%03lld", static_cast<long long>(ms));
+    return buffer;
+}
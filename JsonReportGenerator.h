@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <string>
 #include <variant>
 
 #include "nlohmann/json.hpp"
@@ -42,6 +44,8 @@ public:
 
     using dataItems = std::vector<std::variant<std::pair<std::string, std::string>, Measurement>>;
 
+    using dataset = std::pair<std::string, std::vector<dataItems>>;
+
     JsonReportGenerator(std::shared_ptr<Metadata> metadata, std::optional<std::shared_ptr<GroupManager>> groupManager);
 
     void addDataset(const std::string& name, const std::vector<dataItems>& data);
@@ -52,13 +56,45 @@ public:
 
     void addToAccumulatedMemoryUsage(long double valueKb);
 
-    nlohmann::ordered_json getJson();
+    nlohmann::ordered_json getJson() const;
+
+    nlohmann::json getRenderSummary() const;
+
+    nlohmann::json getProcess(size_t index) const;
+
+    nlohmann::json getRow(size_t dataset, size_t index) const;
+
+    nlohmann::json getRows(size_t dataset) const;
+
+    /**
+     * @brief Local time with milliseconds, for datasets that record when individual events happened
+     */
+    static std::string FormatTimestamp(std::chrono::system_clock::time_point timestamp);
+
+private:
+    struct column
+    {
+        std::string name;
+        // Measurements take up one value in each row per statistic (min, max, average and optionally percentiles).
+        // Empty for plain string columns
+        std::vector<std::string> stats;
+    };
+
+    struct table
+    {
+        std::string name;
+        std::vector<column> columns;
+        nlohmann::json columnOrder;
+        // Each row is an array of values already laid out in columnOrder order
+        std::vector<nlohmann::json> rows;
+    };
+
+    nlohmann::ordered_json getMetadata() const;
 
 private:
     const std::shared_ptr<Metadata> mMetadata;
     const std::optional<std::shared_ptr<GroupManager>> mGroupManager;
 
     nlohmann::ordered_json mJson;
-
-    std::vector<Process> mProcesses;
+    std::vector<table> mTables;
 };
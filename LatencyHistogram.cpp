@@ -0,0 +1,106 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+        : mBuckets{},
+          mCount(0),
+          mMaxUs(0)
+{
+
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency)
+{
+    auto valueUs = static_cast<uint64_t>(
+            std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+
+    mBuckets[bucketIndex(valueUs)]++;
+    mCount++;
+    mMaxUs = std::max(mMaxUs, valueUs);
+}
+
+uint64_t LatencyHistogram::GetCount() const
+{
+    return mCount;
+}
+
+/**
+ * @brief Get the latency at the given percentile (nearest-rank)
+ *
+ * @param percentile Percentile to calculate (0-100)
+ * @return Upper bound of the bucket the percentile falls in (never more than the max value seen), or 0 if empty
+ */
+std::chrono::microseconds LatencyHistogram::GetPercentile(double percentile) const
+{
+    if (mCount == 0) {
+        return std::chrono::microseconds(0);
+    }
+
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * mCount)));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < mBuckets.size(); i++) {
+        seen += mBuckets[i];
+        if (seen >= rank) {
+            return std::chrono::microseconds(std::min(bucketUpperBound(i), mMaxUs));
+        }
+    }
+
+    return std::chrono::microseconds(mMaxUs);
+}
+
+std::chrono::microseconds LatencyHistogram::GetMax() const
+{
+    return std::chrono::microseconds(mMaxUs);
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t valueUs)
+{
+    // First range is linear with 1us resolution
+    if (valueUs < kSubBuckets) {
+        return valueUs;
+    }
+
+    // Position of the highest set bit gives the power of two range, the next few bits give the linear bucket in it
+    int exponent = 63 - __builtin_clzll(valueUs);
+    if (exponent >= kMaxExponent) {
+        return kBucketCount - 1;
+    }
+
+    auto subBucket = (valueUs >> (exponent - kSubBucketBits)) - kSubBuckets;
+    return kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if (index < kSubBuckets) {
+        return index;
+    }
+
+    auto exponent = (index - kSubBuckets) / kSubBuckets + kSubBucketBits;
+    auto subBucket = (index - kSubBuckets) % kSubBuckets;
+    auto width = uint64_t(1) << (exponent - kSubBucketBits);
+
+    return ((kSubBuckets + subBucket) << (exponent - kSubBucketBits)) + width - 1;
+}
@@ -0,0 +1,59 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Fixed size log-linear histogram of latencies, for working out percentiles without keeping every value
+ *
+ * Each power of two range of microseconds is split into 16 linear buckets, so any percentile is accurate to within
+ * ~6% whether the value is a few microseconds or several seconds. Recording is O(1) and never allocates
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Record(std::chrono::nanoseconds latency);
+
+    uint64_t GetCount() const;
+
+    std::chrono::microseconds GetPercentile(double percentile) const;
+
+    std::chrono::microseconds GetMax() const;
+
+private:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+    // Enough to cover ~2^40us (12 days), anything longer ends up in the last bucket
+    static constexpr int kMaxExponent = 40;
+    static constexpr size_t kBucketCount = kSubBuckets + (kMaxExponent - kSubBucketBits) * kSubBuckets;
+
+    static size_t bucketIndex(uint64_t valueUs);
+
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    std::array<uint64_t, kBucketCount> mBuckets;
+    uint64_t mCount;
+    uint64_t mMaxUs;
+};
@@ -18,17 +18,22 @@
 */
 
 #include "Measurement.h"
+#include <algorithm>
 #include <limits>
 #include <utility>
 #include <cmath>
 
-Measurement::Measurement(std::string name)
+Measurement::Measurement(std::string name, bool trackPercentiles)
         : mName(std::move(name)),
           mCount(0),
           mMin(std::numeric_limits<double>::max()),
           mMax(std::numeric_limits<double>::min()),
           mAverage(0),
-          mTotal(0)
+          mTotal(0),
+          mLastValue(0),
+          mTrackPercentiles(trackPercentiles),
+          mValueCount(0),
+          mValueChunks()
 {
 
 }
@@ -52,6 +57,20 @@ void Measurement::AddDataPoint(long double value)
     mCount++;
 
     mAverage = mTotal / mCount;
+
+    mLastValue = value;
+
+    if (mTrackPercentiles) {
+        if (mValueChunks.empty() || mValueChunks.back()->size() == kValuesPerChunk) {
+            mValueChunks.emplace_back(std::make_shared<std::vector<double>>());
+        } else if (mValueChunks.back().use_count() > 1) {
+            // Chunk is shared with a copy of this measurement, don't modify it underneath them
+            mValueChunks.back() = std::make_shared<std::vector<double>>(*mValueChunks.back());
+        }
+
+        mValueChunks.back()->emplace_back(static_cast<double>(value));
+        mValueCount++;
+    }
 }
 
 long double Measurement::GetMin() const
@@ -84,6 +103,61 @@ int Measurement::GetAverageRounded() const
     return (int) std::round(mAverage);
 }
 
+/**
+ * @return The most recent data point added
+ */
+long double Measurement::GetLastValue() const
+{
+    return mLastValue;
+}
+
+/**
+ * @return How many data points have been added
+ */
+int Measurement::GetCount() const
+{
+    return mCount;
+}
+
+/**
+ * @return True if this measurement keeps enough data to calculate percentiles
+ */
+bool Measurement::HasPercentiles() const
+{
+    return mTrackPercentiles;
+}
+
+/**
+ * @brief Calculate the value at the specified percentile using the nearest-rank method
+ *
+ * @param percentile Percentile to calculate (0-100)
+ * @return Value at the percentile, or 0 if percentiles are not tracked for this measurement
+ */
+long double Measurement::GetPercentile(double percentile) const
+{
+    if (mValueCount == 0) {
+        return 0;
+    }
+
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    auto rank = static_cast<size_t>(std::ceil(percentile / 100.0 * mValueCount));
+    rank = rank == 0 ? 0 : rank - 1;
+
+    std::vector<double> values;
+    values.reserve(mValueCount);
+    for (const auto &chunk: mValueChunks) {
+        values.insert(values.end(), chunk->begin(), chunk->end());
+    }
+
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+int Measurement::GetPercentileRounded(double percentile) const
+{
+    return (int) std::round(GetPercentile(percentile));
+}
+
 std::string Measurement::GetName() const
 {
     return mName;
@@ -18,7 +18,9 @@
 */
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 #include "nlohmann/json.hpp"
 
 /**
@@ -30,7 +32,7 @@
 class Measurement
 {
 public:
-    explicit Measurement(std::string name);
+    explicit Measurement(std::string name, bool trackPercentiles = false);
 
 public:
     void AddDataPoint(long double value);
@@ -44,6 +46,15 @@ public:
     long double GetAverage() const;
     int GetAverageRounded() const;
 
+    long double GetLastValue() const;
+
+    int GetCount() const;
+
+    bool HasPercentiles() const;
+
+    long double GetPercentile(double percentile) const;
+    int GetPercentileRounded(double percentile) const;
+
     std::string GetName() const;
 
     nlohmann::json ToJson() const;
@@ -57,4 +68,15 @@ private:
 
     long double mAverage;
     long double mTotal;
+
+    long double mLastValue;
+
+    // Only kept if percentiles are needed, since we need every value to work them out.
+    // Stored in fixed size chunks so copies (e.g. published snapshots) share the full chunks rather than
+    // duplicating every value - only the partially filled chunk is copied, and only when it's written to
+    static constexpr size_t kValuesPerChunk = 1024;
+
+    bool mTrackPercentiles;
+    size_t mValueCount;
+    std::vector<std::shared_ptr<std::vector<double>>> mValueChunks;
 };
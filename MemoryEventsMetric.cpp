@@ -0,0 +1,510 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MemoryEventsMetric.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+MemoryEventsMetric::MemoryEventsMetric(std::shared_ptr<JsonReportGenerator> reportGenerator,
+                                       std::shared_ptr<SamplePublisher> samplePublisher,
+                                       std::shared_ptr<ProcessMetric> processMetric)
+        : mVersion(CgroupMemory::Version::None),
+          mWakeFd(-1),
+          mInotifyFd(-1),
+          mRootWatch(-1),
+          mReportGenerator(std::move(reportGenerator)),
+          mSamplePublisher(std::move(samplePublisher)),
+          mProcessMetric(std::move(processMetric))
+{
+
+}
+
+MemoryEventsMetric::~MemoryEventsMetric()
+{
+    StopCollection();
+}
+
+/**
+ * @brief Start watching every container for memory events
+ *
+ * Events are raised by the kernel as they happen, so the frequency isn't used
+ */
+void MemoryEventsMetric::StartCollection(std::chrono::seconds /* frequency */)
+{
+    mVersion = CgroupMemory::DetectVersion(mFileSystem);
+    if (mVersion == CgroupMemory::Version::None) {
+        LOG_WARN("No memory cgroup hierarchy, container memory events will not be recorded");
+        return;
+    }
+    mRoot = CgroupMemory::RootPath(mVersion);
+
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mWakeFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to create eventfd");
+        closeAll();
+        return;
+    }
+
+    mInotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (mInotifyFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to create inotify instance");
+        closeAll();
+        return;
+    }
+
+    // Watch for containers starting and stopping, as well as the events in each one
+    mRootWatch = inotify_add_watch(mInotifyFd, mRoot.c_str(), IN_CREATE | IN_DELETE | IN_ONLYDIR);
+    if (mRootWatch < 0) {
+        LOG_SYS_WARN(errno, "Failed to watch %s, containers started during the capture will not be watched",
+                     mRoot.c_str());
+    }
+
+    std::vector<IFileSystem::DirectoryEntry> entries;
+    mFileSystem.ListDirectory(mRoot, entries);
+    for (const auto &entry: entries) {
+        if (CgroupMemory::IsContainer(entry)) {
+            addCgroup(entry.name);
+        }
+    }
+
+    mWatchThread = std::thread(&MemoryEventsMetric::WatchEvents, this);
+}
+
+void MemoryEventsMetric::StopCollection()
+{
+    if (mWatchThread.joinable()) {
+        uint64_t wake = 1;
+        if (write(mWakeFd, &wake, sizeof(wake)) < 0) {
+            LOG_SYS_ERROR(errno, "Failed to wake memory events thread");
+        }
+
+        LOG_INFO("Waiting for MemoryEventsMetric watch thread to terminate");
+        mWatchThread.join();
+    }
+
+    closeAll();
+}
+
+void MemoryEventsMetric::SaveResults()
+{
+    for (const auto &dataset: buildDatasets()) {
+        mReportGenerator->addDataset(dataset.first, dataset.second);
+    }
+}
+
+void MemoryEventsMetric::ResetResults()
+{
+    std::lock_guard<std::mutex> locker(mEventsLock);
+    mEvents.clear();
+}
+
+void MemoryEventsMetric::WatchEvents()
+{
+    std::vector<struct pollfd> fds;
+    std::vector<std::string> eventFdCgroups;
+
+    while (true) {
+        // Containers come and go, so work out what to wait on each time round
+        fds.clear();
+        eventFdCgroups.clear();
+
+        fds.emplace_back(pollfd{mWakeFd, POLLIN, 0});
+        fds.emplace_back(pollfd{mInotifyFd, POLLIN, 0});
+        for (const auto &cgroup: mCgroups) {
+            if (cgroup.second.eventFd >= 0) {
+                fds.emplace_back(pollfd{cgroup.second.eventFd, POLLIN, 0});
+                eventFdCgroups.emplace_back(cgroup.first);
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_SYS_ERROR(errno, "Memory events poll failed");
+            break;
+        }
+
+        // Only woken up to quit
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+
+            auto &cgroup = mCgroups.at(eventFdCgroups[i - 2]);
+
+            uint64_t notifications = 0;
+            if (read(cgroup.eventFd, &notifications, sizeof(notifications)) == sizeof(notifications)) {
+                cgroup.oomNotifications += notifications;
+            }
+            checkCounters(eventFdCgroups[i - 2], cgroup);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            handleInotify();
+        }
+    }
+}
+
+void MemoryEventsMetric::handleInotify()
+{
+    alignas(struct inotify_event) char buffer[4096];
+
+    while (true) {
+        auto length = read(mInotifyFd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (length <= 0) {
+            // EAGAIN once everything has been read
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+            if (event->wd == mRootWatch) {
+                const IFileSystem::DirectoryEntry entry{event->len > 0 ? event->name : "",
+                                                        (event->mask & IN_ISDIR) != 0};
+                if (!CgroupMemory::IsContainer(entry)) {
+                    continue;
+                }
+
+                if (event->mask & IN_CREATE) {
+                    addCgroup(entry.name);
+                } else if (event->mask & IN_DELETE) {
+                    removeCgroup(entry.name);
+                }
+                continue;
+            }
+
+            if (!(event->mask & IN_MODIFY)) {
+                continue;
+            }
+
+            auto cgroup = std::find_if(mCgroups.begin(), mCgroups.end(), [event](const auto &cgroup)
+            {
+                return cgroup.second.watch == event->wd;
+            });
+            if (cgroup != mCgroups.end()) {
+                checkCounters(cgroup->first, cgroup->second);
+            }
+        }
+    }
+}
+
+void MemoryEventsMetric::addCgroup(const std::string &name)
+{
+    if (mCgroups.count(name) != 0) {
+        return;
+    }
+
+    watchedCgroup cgroup;
+    cgroup.path = mRoot + "/" + name;
+
+    if (mVersion == CgroupMemory::Version::V2) {
+        const auto eventsPath = cgroup.path + "/memory.events";
+        cgroup.watch = inotify_add_watch(mInotifyFd, eventsPath.c_str(), IN_MODIFY);
+        if (cgroup.watch < 0) {
+            // Memory controller not enabled for this cgroup
+            return;
+        }
+    } else {
+        cgroup.eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (cgroup.eventFd < 0) {
+            LOG_SYS_WARN(errno, "Failed to create eventfd for %s", name.c_str());
+            return;
+        }
+
+        // The kernel keeps its own reference to both files, so they can be closed as soon as the eventfd is
+        // registered
+        const int oomControl = open((cgroup.path + "/memory.oom_control").c_str(), O_RDONLY | O_CLOEXEC);
+        const int eventControl = open((cgroup.path + "/cgroup.event_control").c_str(), O_WRONLY | O_CLOEXEC);
+
+        bool registered = false;
+        if (oomControl >= 0 && eventControl >= 0) {
+            const auto control = std::to_string(cgroup.eventFd) + " " + std::to_string(oomControl);
+            registered = write(eventControl, control.c_str(), control.size()) >= 0;
+        }
+
+        if (!registered) {
+            LOG_SYS_WARN(errno, "Failed to register for OOM notifications in %s", name.c_str());
+        }
+
+        if (oomControl >= 0) {
+            close(oomControl);
+        }
+        if (eventControl >= 0) {
+            close(eventControl);
+        }
+
+        if (!registered) {
+            close(cgroup.eventFd);
+            return;
+        }
+    }
+
+    // Counters start from when the cgroup was created, so only changes from now on are events
+    readCounters(cgroup, cgroup.counters);
+
+    LOG_DEBUG("Watching %s for memory events", cgroup.path.c_str());
+    mCgroups.emplace(name, std::move(cgroup));
+}
+
+void MemoryEventsMetric::removeCgroup(const std::string &name)
+{
+    auto itr = mCgroups.find(name);
+    if (itr == mCgroups.end()) {
+        return;
+    }
+
+    // The kernel removes the inotify watch itself when the file goes
+    if (itr->second.eventFd >= 0) {
+        close(itr->second.eventFd);
+    }
+
+    mCgroups.erase(itr);
+}
+
+bool MemoryEventsMetric::readCounters(const watchedCgroup &cgroup, std::map<std::string, unsigned long long> &counters)
+{
+    if (mVersion == CgroupMemory::Version::V2) {
+        std::string contents;
+        if (!mFileSystem.ReadFile(cgroup.path + "/memory.events", contents)) {
+            return false;
+        }
+
+        // Every counter the kernel reports - low, high, max, oom, oom_kill and anything newer kernels add
+        std::istringstream stream(contents);
+        std::string name;
+        unsigned long long value;
+        while (stream >> name >> value) {
+            counters[name] = value;
+        }
+        return true;
+    }
+
+    // v1 has no equivalent of memory.events, so make the closest counters out of the limit failure count and the OOM
+    // notifications
+    std::string contents;
+    if (!mFileSystem.ReadFile(cgroup.path + "/memory.failcnt", contents)) {
+        return false;
+    }
+    counters["max"] = strtoull(contents.c_str(), nullptr, 10);
+    counters["oom"] = cgroup.oomNotifications;
+
+    if (mFileSystem.ReadFile(cgroup.path + "/memory.oom_control", contents)) {
+        std::istringstream stream(contents);
+        std::string name;
+        unsigned long long value;
+        while (stream >> name >> value) {
+            if (name == "oom_kill") {
+                counters[name] = value;
+            }
+        }
+    }
+
+    return true;
+}
+
+void MemoryEventsMetric::checkCounters(const std::string &name, watchedCgroup &cgroup)
+{
+    std::map<std::string, unsigned long long> counters;
+    if (!readCounters(cgroup, counters)) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, unsigned long long>> changed;
+    for (const auto &counter: counters) {
+        auto &previous = cgroup.counters[counter.first];
+        if (counter.second > previous) {
+            changed.emplace_back(counter);
+        }
+        previous = counter.second;
+    }
+
+    if (changed.empty()) {
+        return;
+    }
+
+    auto tick = std::make_shared<TickSamples>();
+    tick->timestamp = std::chrono::system_clock::now();
+    tick->source = TickSource::MemoryEvents;
+
+    const auto processes = sampleProcesses(name, cgroup);
+
+    std::lock_guard<std::mutex> locker(mEventsLock);
+    for (const auto &counter: changed) {
+        LOG_INFO("Container %s memory event: %s (now %llu)", name.c_str(), counter.first.c_str(), counter.second);
+
+        mEvents.emplace_back(memoryEvent{tick->timestamp, name, counter.first, counter.second, processes});
+        tick->datasets.emplace_back(DatasetSample{"Memory Events", {{"Cgroup", name}, {"Event", counter.first}},
+                                                  "Count", static_cast<long double>(counter.second), {}});
+    }
+
+    if (mSamplePublisher && mSamplePublisher->HasSinks()) {
+        mSamplePublisher->Publish(tick);
+    }
+}
+
+/**
+ * @brief Latest sample of every process in the container
+ *
+ * Processes are matched on the PIDs in the cgroup right now, as well as the container the process metric put them
+ * in - so a process that has just been OOM killed is still included
+ */
+std::vector<MemoryEventsMetric::processSample> MemoryEventsMetric::sampleProcesses(const std::string &name,
+                                                                                   const watchedCgroup &cgroup)
+{
+    std::vector<processSample> samples;
+    if (!mProcessMetric) {
+        return samples;
+    }
+
+    std::vector<pid_t> pidList;
+    listCgroupPids(cgroup.path, pidList);
+    const std::set<pid_t> pids(pidList.begin(), pidList.end());
+
+    const auto snapshot = mProcessMetric->GetSnapshot();
+    for (const auto &process: snapshot->processes) {
+        if (process.Pss.GetCount() == 0) {
+            continue;
+        }
+
+        const auto container = process.ProcessInfo.container();
+        if (pids.count(process.ProcessInfo.pid()) == 0 && container.value_or("") != name) {
+            continue;
+        }
+
+        samples.emplace_back(processSample{process.ProcessInfo.pid(), process.ProcessInfo.name(),
+                                           process.Pss.GetLastValue(), process.Rss.GetLastValue(),
+                                           process.Uss.GetLastValue(), process.Swap.GetLastValue()});
+    }
+
+    std::sort(samples.begin(), samples.end(), [](const processSample &a, const processSample &b)
+    {
+        return a.pssKb > b.pssKb;
+    });
+
+    return samples;
+}
+
+/**
+ * @brief Every PID in a cgroup and all the cgroups below it
+ */
+void MemoryEventsMetric::listCgroupPids(const std::string &path, std::vector<pid_t> &pids)
+{
+    std::string contents;
+    if (mFileSystem.ReadFile(path + "/cgroup.procs", contents)) {
+        std::istringstream stream(contents);
+        pid_t pid;
+        while (stream >> pid) {
+            pids.emplace_back(pid);
+        }
+    }
+
+    std::vector<IFileSystem::DirectoryEntry> entries;
+    mFileSystem.ListDirectory(path, entries);
+    for (const auto &entry: entries) {
+        if (entry.isDirectory) {
+            listCgroupPids(path + "/" + entry.name, pids);
+        }
+    }
+}
+
+void MemoryEventsMetric::closeAll()
+{
+    for (const auto &cgroup: mCgroups) {
+        if (cgroup.second.eventFd >= 0) {
+            close(cgroup.second.eventFd);
+        }
+    }
+    mCgroups.clear();
+
+    if (mInotifyFd >= 0) {
+        close(mInotifyFd);
+        mInotifyFd = -1;
+        mRootWatch = -1;
+    }
+
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+        mWakeFd = -1;
+    }
+}
+
+std::vector<JsonReportGenerator::dataset> MemoryEventsMetric::buildDatasets() const
+{
+    std::vector<JsonReportGenerator::dataset> datasets;
+    std::vector<JsonReportGenerator::dataItems> data{};
+
+    std::lock_guard<std::mutex> locker(mEventsLock);
+
+    for (const auto &event: mEvents) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Time", JsonReportGenerator::FormatTimestamp(event.timestamp)),
+                std::make_pair("Cgroup", event.cgroup),
+                std::make_pair("Event", event.event),
+                std::make_pair("Count", std::to_string(event.count)),
+                std::make_pair("Processes", std::to_string(event.processes.size()))
+        });
+    }
+    datasets.emplace_back("Memory Events", std::move(data));
+    data.clear();
+
+    // Processes attached to each event, matched back up to the event by its time, cgroup and name
+    for (const auto &event: mEvents) {
+        const auto time = JsonReportGenerator::FormatTimestamp(event.timestamp);
+        for (const auto &process: event.processes) {
+            data.emplace_back(JsonReportGenerator::dataItems{
+                    std::make_pair("Time", time),
+                    std::make_pair("Cgroup", event.cgroup),
+                    std::make_pair("Event", event.event),
+                    std::make_pair("PID", std::to_string(process.pid)),
+                    std::make_pair("Process", process.name),
+                    std::make_pair("PSS_KB", std::to_string(std::llround(process.pssKb))),
+                    std::make_pair("RSS_KB", std::to_string(std::llround(process.rssKb))),
+                    std::make_pair("USS_KB", std::to_string(std::llround(process.ussKb))),
+                    std::make_pair("Swap_KB", std::to_string(std::llround(process.swapKb)))
+            });
+        }
+    }
+    datasets.emplace_back("Memory Event Processes", std::move(data));
+    data.clear();
+
+    return datasets;
+}
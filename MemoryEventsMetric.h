@@ -0,0 +1,137 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "IMetric.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+#include "Cgroup/CgroupMemory.h"
+#include "FileSystem/RealFileSystem.h"
+#include "JsonReportGenerator.h"
+#include "ProcessMetric.h"
+#include "SamplePublisher.h"
+
+/**
+ * @brief Record when a container hits a memory limit or has something OOM killed
+ *
+ * Rather than polling, waits for the kernel to say a container's memory event counters have changed - memory.events
+ * on cgroup v2, or an OOM notification through cgroup.event_control on v1 (v1 only reports the limit being hit
+ * alongside an OOM). Every change is recorded as an event along with the last sample of each process in the container
+ */
+class MemoryEventsMetric : public IMetric
+{
+public:
+    MemoryEventsMetric(std::shared_ptr<JsonReportGenerator> reportGenerator,
+                       std::shared_ptr<SamplePublisher> samplePublisher,
+                       std::shared_ptr<ProcessMetric> processMetric);
+
+    ~MemoryEventsMetric();
+
+    void StartCollection(std::chrono::seconds frequency) override;
+
+    void StopCollection() override;
+
+    void SaveResults() override;
+
+    void ResetResults() override;
+
+private:
+    struct processSample
+    {
+        pid_t pid;
+        std::string name;
+        long double pssKb;
+        long double rssKb;
+        long double ussKb;
+        long double swapKb;
+    };
+
+    struct memoryEvent
+    {
+        std::chrono::system_clock::time_point timestamp;
+        std::string cgroup;
+        std::string event;
+        // Value of the counter after the event
+        unsigned long long count;
+        std::vector<processSample> processes;
+    };
+
+    struct watchedCgroup
+    {
+        std::string path;
+        // inotify watch on memory.events (v2)
+        int watch = -1;
+        // Registered for OOM notifications with cgroup.event_control (v1)
+        int eventFd = -1;
+        unsigned long long oomNotifications = 0;
+
+        std::map<std::string, unsigned long long> counters;
+    };
+
+    void WatchEvents();
+
+    void handleInotify();
+
+    void addCgroup(const std::string &name);
+
+    void removeCgroup(const std::string &name);
+
+    bool readCounters(const watchedCgroup &cgroup, std::map<std::string, unsigned long long> &counters);
+
+    void checkCounters(const std::string &name, watchedCgroup &cgroup);
+
+    std::vector<processSample> sampleProcesses(const std::string &name, const watchedCgroup &cgroup);
+
+    void listCgroupPids(const std::string &path, std::vector<pid_t> &pids);
+
+    void closeAll();
+
+    std::vector<JsonReportGenerator::dataset> buildDatasets() const;
+
+private:
+    // Events come from the running kernel and can't be replayed, so read straight from the device rather than through
+    // FileSystem to keep them out of any recording
+    RealFileSystem mFileSystem;
+
+    CgroupMemory::Version mVersion;
+    std::string mRoot;
+
+    std::thread mWatchThread;
+    int mWakeFd;
+    int mInotifyFd;
+    int mRootWatch;
+
+    // Only touched by the watch thread once it has started
+    std::map<std::string, watchedCgroup> mCgroups;
+
+    mutable std::mutex mEventsLock;
+    std::vector<memoryEvent> mEvents;
+
+    const std::shared_ptr<JsonReportGenerator> mReportGenerator;
+    const std::shared_ptr<SamplePublisher> mSamplePublisher;
+    const std::shared_ptr<ProcessMetric> mProcessMetric;
+};
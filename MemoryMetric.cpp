@@ -18,29 +18,45 @@
 */
 
 #include "MemoryMetric.h"
+#include "FileParsers/BuddyInfo.h"
+#include "FileParsers/GpuMemory.h"
 #include "FileParsers/MemInfo.h"
+#include "FileParsers/VmStat.h"
+#include "FileParsers/Zram.h"
+#include "FileSystem/FileSystem.h"
 #include <thread>
 #include <fstream>
-#include <filesystem>
+#include <set>
+#include <sstream>
 #include <unistd.h>
 #include <cmath>
 
-MemoryMetric::MemoryMetric(Platform platform, std::shared_ptr<JsonReportGenerator> reportGenerator)
+MemoryMetric::MemoryMetric(Platform platform, std::shared_ptr<JsonReportGenerator> reportGenerator,
+                           std::shared_ptr<SamplePublisher> samplePublisher,
+                           std::shared_ptr<OverheadTracker> overheadTracker, std::shared_ptr<CollectionContext> context)
         : mQuit(false),
           mCv(),
+          mContext(std::move(context)),
           mLinuxMemoryMeasurements{},
+          mVmStatPreviousUptime(0),
+          mCgroupVersion(CgroupMemory::DetectVersion(FileSystem::Get())),
+          mZswapEnabled(false),
           mCmaFree("Value_KB"),
           mCmaBorrowed("Value_KB"),
           mMemoryBandwidth("Memory_Bandwidth_kbps"),
           mMemoryBandwidthSupported(false),
           mMemoryFragmentation{},
           mPlatform(platform),
-          mReportGenerator(std::move(reportGenerator))
+          mReportGenerator(std::move(reportGenerator)),
+          mSamplePublisher(std::move(samplePublisher)),
+          mOverheadTracker(std::move(overheadTracker)),
+          mResetRequested(false),
+          mSnapshot(std::make_shared<Snapshot>())
 {
 
     // Some metrics are returned as a number of pages instead of bytes, so get page size to be able to calculate
     // human-readable values
-    mPageSize = sysconf(_SC_PAGESIZE);
+    mPageSize = mContext->PageSize();
 
     // Create a map of CMA regions that converts the directories in /sys/kernel/debug/cma/ to a human-readable name
     // based on the kernel DTS file
@@ -86,7 +102,7 @@ MemoryMetric::MemoryMetric(Platform platform, std::shared_ptr<JsonReportGenerato
     switch (platform) {
         case Platform::AMLOGIC: {
             // Amlogic should allow reporting memory bandwidth
-            if (std::filesystem::exists("/sys/class/aml_ddr/mode")) {
+            if (FileSystem::Get().Exists("/sys/class/aml_ddr/mode")) {
                 mMemoryBandwidthSupported = true;
                 std::ofstream ddrMode("/sys/class/aml_ddr/mode", std::ios::binary);
                 ddrMode << "1";
@@ -112,6 +128,25 @@ MemoryMetric::MemoryMetric(Platform platform, std::shared_ptr<JsonReportGenerato
             break;
     }
 
+    // Compressed memory. zram devices can be hot added, but in practice are set up once at boot
+    for (const auto &device: mContext->ZramDeviceNames()) {
+        mZramDevices.emplace_back(device);
+    }
+
+    std::vector<IFileSystem::DirectoryEntry> zswapFiles;
+    if (FileSystem::Get().ListDirectory("/sys/kernel/debug/zswap", zswapFiles)) {
+        for (const auto &file: zswapFiles) {
+            auto handle = FileSystem::Get().OpenFile("/sys/kernel/debug/zswap/" + file.name);
+            if (!file.isDirectory && handle) {
+                mZswapFiles.emplace(file.name, std::move(handle));
+            }
+        }
+    }
+
+    std::string zswapEnabled;
+    mZswapEnabled = !mZswapFiles.empty() ||
+                    (FileSystem::Get().ReadFile("/sys/module/zswap/parameters/enabled", zswapEnabled) &&
+                     zswapEnabled.compare(0, 1, "Y") == 0);
 }
 
 MemoryMetric::~MemoryMetric()
@@ -146,35 +181,104 @@ void MemoryMetric::StopCollection()
 
 void MemoryMetric::CollectData(std::chrono::seconds frequency)
 {
-    std::unique_lock<std::mutex> lock(mLock);
+    // Ticks run to a fixed schedule, so a slow tick doesn't push back all the ones after it
+    auto next = std::chrono::steady_clock::now();
+
+    while (true) {
+        if (!FileSystem::Get().BeginTick("memory")) {
+            LOG_INFO("Nothing left to collect");
+            break;
+        }
+
+        if (mResetRequested.exchange(false)) {
+            resetMeasurements();
+        }
 
-    do {
         auto start = std::chrono::high_resolution_clock::now();
+        auto timestamp = std::chrono::system_clock::now();
+
+        mTickValues = mContext->Refresh();
 
-        GetLinuxMemoryUsage();
-        GetCmaMemoryUsage();
-        GetGpuMemoryUsage();
-        GetContainerMemoryUsage();
-        GetMemoryBandwidth();
-        CalculateFragmentation();
+        collect("Linux Memory", &MemoryMetric::GetLinuxMemoryUsage);
+        collect("VmStat", &MemoryMetric::GetVmStatRates);
+        collect("CMA", &MemoryMetric::GetCmaMemoryUsage);
+        collect("GPU", &MemoryMetric::GetGpuMemoryUsage);
+        collect("Containers", &MemoryMetric::GetContainerMemoryUsage);
+        collect("Cgroup Tree", &MemoryMetric::GetCgroupMemoryStats);
+        collect("Compressed Memory", &MemoryMetric::GetCompressedMemoryUsage);
+        collect("Memory Bandwidth", &MemoryMetric::GetMemoryBandwidth);
+        collect("Fragmentation", &MemoryMetric::CalculateFragmentation);
 
         if (mPlatform == Platform::BROADCOM) {
-            GetBroadcomBmemUsage();
+            collect("BMEM", &MemoryMetric::GetBroadcomBmemUsage);
         }
 
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->timestamp = timestamp;
+        std::vector<DatasetSample> latencySamples;
+        snapshot->datasets = buildDatasets(&latencySamples);
+
+        publishSamples(*snapshot, latencySamples);
+        std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+
         auto end = std::chrono::high_resolution_clock::now();
         LOG_INFO("MemoryMetric completed in %lld ms",
                  (long long) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
 
-        // Wait for period before doing collection again, or until cancelled
-        mCv.wait_for(lock, frequency);
-    } while (!mQuit);
+        // Wait for period before doing collection again, or until cancelled. Only hold the lock while waiting so
+        // nothing is blocked behind a slow collection
+        std::unique_lock<std::mutex> lock(mLock);
+        next += frequency;
+
+        // If collection overran into the next tick, skip the slots that have already passed rather than running
+        // them back to back to catch up
+        const auto now = std::chrono::steady_clock::now();
+        if (frequency.count() > 0 && next < now) {
+            const auto missed = (now - next) / frequency + 1;
+            next += missed * frequency;
+
+            LOG_WARN("MemoryMetric overran, skipping %lld tick(s)", (long long) missed);
+            if (mOverheadTracker) {
+                mOverheadTracker->RecordMissedTicks("Memory", missed);
+            }
+        }
+
+        if (mCv.wait_until(lock, next, [this]() { return mQuit; })) {
+            break;
+        }
+
+        // How late this tick started compared to the schedule. There's no schedule when replaying as fast as possible
+        if (mOverheadTracker && frequency.count() > 0) {
+            mOverheadTracker->RecordLatency("Memory Tick Jitter", std::chrono::steady_clock::now() - next);
+        }
+    }
 
     LOG_INFO("Collection thread quit");
 }
 
-void MemoryMetric::SaveResults()
+/**
+ * @brief Run one of the collectors, counting its CPU time and I/O against it
+ */
+void MemoryMetric::collect(const std::string &collector, void (MemoryMetric::*collectFunction)())
 {
+    if (mOverheadTracker) {
+        auto overhead = mOverheadTracker->Track(collector);
+        (this->*collectFunction)();
+    } else {
+        (this->*collectFunction)();
+    }
+}
+
+/**
+ * @brief Build the datasets to report from the measurements collected so far
+ *
+ * @param[out] latencySamples If set, filled with the collection latencies in the datasets as samples to publish
+ *
+ * @return Pairs of dataset name -> rows, in the order they should appear in the report
+ */
+std::vector<JsonReportGenerator::dataset> MemoryMetric::buildDatasets(std::vector<DatasetSample> *latencySamples) const
+{
+    std::vector<JsonReportGenerator::dataset> datasets;
     std::vector<JsonReportGenerator::dataItems> data{};
 
     for (const auto &result: mLinuxMemoryMeasurements) {
@@ -183,13 +287,28 @@ void MemoryMetric::SaveResults()
                 result.second
         });
     }
-    mReportGenerator->addDataset("Linux Memory", data);
+    datasets.emplace_back("Linux Memory", std::move(data));
+    data.clear();
+
+    // *** Raw /proc/meminfo ***
+    for (const auto &result: mMeminfoMeasurements) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Field", MemInfo::FieldName(result.first)),
+                std::make_pair("Unit", MemInfo::IsPageCount(result.first) ? "pages" : "KB"),
+                result.second
+        });
+    }
+    datasets.emplace_back("Meminfo", std::move(data));
+    data.clear();
 
-    // Set the average Used memory value
-    auto it = mLinuxMemoryMeasurements.find("Used");
-    if (it != mLinuxMemoryMeasurements.end()) {
-        mReportGenerator->setAverageLinuxMemoryUsage(it->second.GetAverageRounded());
+    // *** Reclaim/fault/swap activity from /proc/vmstat ***
+    for (const auto &result: mVmStatRates) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Counter", result.first),
+                result.second
+        });
     }
+    datasets.emplace_back("VmStat Rates", std::move(data));
     data.clear();
 
     // *** GPU Memory Usage ***
@@ -205,16 +324,7 @@ void MemoryMetric::SaveResults()
                     result.second.Used
             });
         }
-        mReportGenerator->addDataset("GPU Memory", data);
-
-        // Add all GPU memory to accumulated total
-        long double gpuSum = 0;
-        std::for_each(mGpuMeasurements.begin(), mGpuMeasurements.end(), [&](const std::pair<pid_t, gpuMeasurement> &m)
-        {
-            gpuSum += m.second.Used.GetAverage();
-        });
-        mReportGenerator->addToAccumulatedMemoryUsage(gpuSum);
-
+        datasets.emplace_back("GPU Memory", std::move(data));
         data.clear();
     }
 
@@ -227,48 +337,117 @@ void MemoryMetric::SaveResults()
                 result.second.Unused
         });
     }
-    mReportGenerator->addDataset("CMA Regions", data);
-
-    // Add all CMA memory to accumulated total
-    long double cmaSum = 0;
-    std::for_each(mCmaMeasurements.begin(), mCmaMeasurements.end(), [&](const std::pair<std::string, cmaMeasurement> &m)
-    {
-        cmaSum += m.second.Used.GetAverage();
-    });
-    mReportGenerator->addToAccumulatedMemoryUsage(cmaSum);
-
+    datasets.emplace_back("CMA Regions", std::move(data));
     data.clear();
 
-
     // *** CMA Summary ***
-    data.emplace_back(JsonReportGenerator::dataItems{
-            std::make_pair("Value", "CMA Free"),
-            mCmaFree
-    });
-    data.emplace_back(JsonReportGenerator::dataItems{
-            std::make_pair("Value", "CMA Borrowed by Kernel"),
-            mCmaBorrowed
-    });
-    mReportGenerator->addDataset("CMA Summary", data);
+    // Nothing to summarise if the kernel has no CMA (or it hasn't been read yet)
+    if (mCmaFree.GetCount() > 0) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Value", "CMA Free"),
+                mCmaFree
+        });
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Value", "CMA Borrowed by Kernel"),
+                mCmaBorrowed
+        });
+    }
+    datasets.emplace_back("CMA Summary", std::move(data));
     data.clear();
 
     // *** Per-container memory usage ***
     for (const auto &result: mContainerMeasurements) {
+        if (result.second.Used.GetCount() == 0) {
+            continue;
+        }
+
         data.emplace_back(JsonReportGenerator::dataItems{
                 std::make_pair("Container", result.first),
-                result.second
+                result.second.Used,
+                result.second.Peak,
+                result.second.Swap,
+                result.second.Max,
+                result.second.High
         });
     }
-    mReportGenerator->addDataset("Containers", data);
+    datasets.emplace_back("Containers", std::move(data));
+    data.clear();
+
+    // *** Per-cgroup memory.stat breakdown, one row per cgroup and type of memory ***
+    for (const auto &node: mCgroupNodes) {
+        if (node.second.Total.front().GetCount() == 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < CgroupMemoryStat::kFieldCount; i++) {
+            data.emplace_back(JsonReportGenerator::dataItems{
+                    std::make_pair("Cgroup", node.first),
+                    std::make_pair("Type", CgroupMemoryStat::FieldName(static_cast<CgroupMemoryStat::Field>(i))),
+                    node.second.Total[i],
+                    node.second.Self[i]
+            });
+        }
+    }
+    datasets.emplace_back("Cgroup Memory", std::move(data));
+    data.clear();
+
+    // *** zram devices ***
+    for (const auto &result: mZramMeasurements) {
+        const auto &zram = result.second;
+        // Nothing worth showing until something has been swapped out to it
+        if (zram.Ratio.GetCount() == 0) {
+            continue;
+        }
+
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Device", result.first),
+                zram.Original,
+                zram.Compressed,
+                zram.Used,
+                zram.Limit,
+                zram.SamePages,
+                zram.HugePages,
+                zram.Ratio,
+                zram.Saved,
+                zram.Overhead
+        });
+    }
+    datasets.emplace_back("Zram", std::move(data));
+    data.clear();
+
+    for (const auto &result: mZramMeasurements) {
+        const auto &zram = result.second;
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Device", result.first),
+                zram.FailedReads,
+                zram.FailedWrites,
+                zram.InvalidIo,
+                zram.NotifyFree,
+                zram.Writeback,
+                zram.WritebackReads,
+                zram.WritebackWrites
+        });
+    }
+    datasets.emplace_back("Zram IO", std::move(data));
+    data.clear();
+
+    // *** zswap ***
+    for (const auto &result: mZswapMeasurements) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Stat", result.first),
+                std::make_pair("Unit", result.second.unit),
+                result.second.value
+        });
+    }
+    datasets.emplace_back("Zswap", std::move(data));
     data.clear();
 
     // *** Memory bandwidth (if supported) ***
     if (mMemoryBandwidthSupported) {
-
         data.emplace_back(JsonReportGenerator::dataItems{
                 mMemoryBandwidth
         });
-        mReportGenerator->addDataset("Memory Bandwidth", data);
+        datasets.emplace_back("Memory Bandwidth", std::move(data));
         data.clear();
     }
 
@@ -285,7 +464,7 @@ void MemoryMetric::SaveResults()
             });
             i++;
         }
-        mReportGenerator->addDataset(reportName, data);
+        datasets.emplace_back(reportName, std::move(data));
         data.clear();
     }
 
@@ -296,15 +475,208 @@ void MemoryMetric::SaveResults()
                     std::make_pair("Region", measurement.first),
                     measurement.second});
         }
-        mReportGenerator->addDataset("BMEM", data);
+        datasets.emplace_back("BMEM", std::move(data));
+        data.clear();
+    }
 
-        // Add all BMEM memory to accumulated total
-        long double bmemSum = 0;
-        std::for_each(mBroadcomBmemMeasurements.begin(), mBroadcomBmemMeasurements.end(), [&](const auto &m)
-        {
-            bmemSum += m.second.GetAverage();
-        });
-        mReportGenerator->addToAccumulatedMemoryUsage(bmemSum);
+    // *** Cost of running MemCapture itself ***
+    if (mOverheadTracker) {
+        auto overhead = mOverheadTracker->GetDatasets(latencySamples);
+        datasets.insert(datasets.end(), std::make_move_iterator(overhead.begin()),
+                        std::make_move_iterator(overhead.end()));
+    }
+
+    return datasets;
+}
+
+/**
+ * @brief Publish the values collected during this tick to anything listening for raw samples
+ *
+ * Only values that were actually updated this tick are published, so a GPU allocation or container that has gone away
+ * doesn't keep repeating its last value
+ */
+void MemoryMetric::publishSamples(const Snapshot &snapshot, const std::vector<DatasetSample> &latencySamples)
+{
+    if (!mSamplePublisher || !mSamplePublisher->HasSinks()) {
+        return;
+    }
+
+    auto tick = std::make_shared<TickSamples>();
+    tick->timestamp = snapshot.timestamp;
+    tick->source = TickSource::Memory;
+
+    for (const auto &dataset: snapshot.datasets) {
+        // Rows that have never had a value haven't been published, so don't count towards the position of the others
+        uint32_t publishedRows = 0;
+
+        for (const auto &row: dataset.second) {
+            std::vector<std::pair<std::string, std::string>> labels;
+            for (const auto &item: row) {
+                if (std::holds_alternative<std::pair<std::string, std::string>>(item)) {
+                    labels.emplace_back(std::get<std::pair<std::string, std::string>>(item));
+                }
+            }
+
+            std::string rowKey = dataset.first;
+            for (const auto &label: labels) {
+                rowKey += '\x1f' + label.second;
+            }
+
+            bool hasValues = false;
+            for (size_t column = 0; column < row.size(); column++) {
+                if (!std::holds_alternative<Measurement>(row[column])) {
+                    continue;
+                }
+
+                const auto &measurement = std::get<Measurement>(row[column]);
+                hasValues = hasValues || measurement.GetCount() > 0;
+                auto &publishedCount = mPublishedCounts[rowKey + '\x1f' + measurement.GetName()];
+
+                if (measurement.GetCount() != publishedCount) {
+                    publishedCount = measurement.GetCount();
+
+                    DatasetLayout layout;
+                    layout.row = publishedRows;
+                    layout.column = static_cast<uint16_t>(column);
+                    layout.percentiles = measurement.HasPercentiles();
+                    tick->datasets.emplace_back(DatasetSample{dataset.first, labels, measurement.GetName(),
+                                                              measurement.GetLastValue(), layout});
+                }
+            }
+
+            if (hasValues) {
+                publishedRows++;
+            }
+        }
+    }
+
+    // Latency percentiles are always current, so go out every tick
+    tick->datasets.insert(tick->datasets.end(), latencySamples.begin(), latencySamples.end());
+
+    mSamplePublisher->Publish(tick);
+}
+
+void MemoryMetric::SaveResults()
+{
+    AddDatasetsToReport(GetSnapshot()->datasets, *mReportGenerator);
+}
+
+/**
+ * @brief Discard the results collected so far
+ *
+ * The collection thread owns the measurements, so this just asks it to clear them before the next tick. Readers see
+ * an empty snapshot straight away
+ */
+void MemoryMetric::ResetResults()
+{
+    mResetRequested = true;
+    std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(std::make_shared<Snapshot>()));
+}
+
+/**
+ * @brief Get the results as of the last completed tick
+ *
+ * Safe to call from any thread at any time without blocking collection. The returned snapshot never changes
+ */
+std::shared_ptr<const MemoryMetric::Snapshot> MemoryMetric::GetSnapshot() const
+{
+    return std::atomic_load(&mSnapshot);
+}
+
+void MemoryMetric::resetMeasurements()
+{
+    for (auto &measurement: mLinuxMemoryMeasurements) {
+        measurement.second = Measurement(measurement.second.GetName());
+    }
+
+    // Everything else is created the first time it's seen
+    mMeminfoMeasurements.clear();
+    mVmStatRates.clear();
+    mCmaMeasurements.clear();
+    mGpuMeasurements.clear();
+    mBroadcomBmemMeasurements.clear();
+    mMemoryFragmentation.clear();
+
+    // Keep the cgroup files open, only the values need to start again
+    for (auto &container: mContainerMeasurements) {
+        auto &measurement = container.second;
+        for (auto *value: {&measurement.Used, &measurement.Peak, &measurement.Swap, &measurement.Max,
+                           &measurement.High}) {
+            *value = Measurement(value->GetName());
+        }
+    }
+
+    for (auto &node: mCgroupNodes) {
+        for (auto *measurements: {&node.second.Total, &node.second.Self}) {
+            for (auto &measurement: *measurements) {
+                measurement = Measurement(measurement.GetName());
+            }
+        }
+    }
+
+    mZramMeasurements.clear();
+    mZswapMeasurements.clear();
+
+    mCmaFree = Measurement(mCmaFree.GetName());
+    mCmaBorrowed = Measurement(mCmaBorrowed.GetName());
+    mMemoryBandwidth = Measurement(mMemoryBandwidth.GetName());
+
+    if (mOverheadTracker) {
+        mOverheadTracker->Reset();
+    }
+
+    // Counts restart from 0, so everything needs publishing again
+    mPublishedCounts.clear();
+}
+
+/**
+ * @brief Add the datasets to the report, and add the memory they account for to the grand totals
+ *
+ * Static so the same rules apply when rebuilding a report from a saved capture
+ */
+void MemoryMetric::AddDatasetsToReport(const std::vector<JsonReportGenerator::dataset> &datasets,
+                                       JsonReportGenerator &reportGenerator)
+{
+    // Sum the average of the named measurement (or all measurements if no name given) across all rows of a dataset
+    auto sumAverages = [](const std::vector<JsonReportGenerator::dataItems> &rows, const std::string &name)
+    {
+        long double sum = 0;
+        for (const auto &row: rows) {
+            for (const auto &item: row) {
+                if (std::holds_alternative<Measurement>(item)) {
+                    const auto &measurement = std::get<Measurement>(item);
+                    if (name.empty() || measurement.GetName() == name) {
+                        sum += measurement.GetAverage();
+                    }
+                }
+            }
+        }
+        return sum;
+    };
+
+    for (const auto &dataset: datasets) {
+        reportGenerator.addDataset(dataset.first, dataset.second);
+
+        if (dataset.first == "Linux Memory") {
+            // Set the average Used memory value
+            for (const auto &row: dataset.second) {
+                auto isUsedRow = std::any_of(row.begin(), row.end(), [](const auto &item)
+                {
+                    return std::holds_alternative<std::pair<std::string, std::string>>(item) &&
+                           std::get<std::pair<std::string, std::string>>(item).second == "Used";
+                });
+
+                if (isUsedRow) {
+                    reportGenerator.setAverageLinuxMemoryUsage((int) std::round(sumAverages({row}, "")));
+                }
+            }
+        } else if (dataset.first == "GPU Memory" || dataset.first == "BMEM") {
+            // Add all GPU/BMEM memory to accumulated total
+            reportGenerator.addToAccumulatedMemoryUsage(sumAverages(dataset.second, ""));
+        } else if (dataset.first == "CMA Regions") {
+            // Add all used CMA memory to accumulated total
+            reportGenerator.addToAccumulatedMemoryUsage(sumAverages(dataset.second, "Used_KB"));
+        }
     }
 }
 
@@ -312,7 +684,7 @@ void MemoryMetric::GetLinuxMemoryUsage()
 {
     //LOG_INFO("Getting memory usage");
 
-    MemInfo memInfoFile;
+    const auto &memInfoFile = mTickValues->memInfo;
     mLinuxMemoryMeasurements.at("Total").AddDataPoint(memInfoFile.MemTotalKb());
     mLinuxMemoryMeasurements.at("Used").AddDataPoint(memInfoFile.MemUsedKb());
     mLinuxMemoryMeasurements.at("Buffered").AddDataPoint(memInfoFile.BuffersKb());
@@ -323,6 +695,69 @@ void MemoryMetric::GetLinuxMemoryUsage()
     mLinuxMemoryMeasurements.at("Slab Reclaimable").AddDataPoint(memInfoFile.SlabReclaimable());
     mLinuxMemoryMeasurements.at("Slab Unreclaimable").AddDataPoint(memInfoFile.SlabUnreclaimable());
     mLinuxMemoryMeasurements.at("Swap Used").AddDataPoint(memInfoFile.SwapUsed());
+
+    for (size_t i = 0; i < MemInfo::kFieldCount; i++) {
+        const auto field = static_cast<MemInfo::Field>(i);
+        if (!memInfoFile.Has(field)) {
+            continue;
+        }
+
+        auto itr = mMeminfoMeasurements.find(field);
+        if (itr == mMeminfoMeasurements.end()) {
+            itr = mMeminfoMeasurements.emplace(field, Measurement("Value")).first;
+        }
+        itr->second.AddDataPoint(memInfoFile.Get(field));
+    }
+}
+
+/**
+ * @brief Turn the event counters in /proc/vmstat (page scans, steals, allocation stalls, faults, swapping, refaults
+ * etc.) into per second rates since the last tick
+ *
+ * The time between ticks comes from /proc/uptime rather than a clock, so replaying a recording gives the same rates
+ * as when it was recorded. Uptime only has 10ms resolution, which is plenty at our collection frequency
+ */
+void MemoryMetric::GetVmStatRates()
+{
+    char uptimeBuffer[64];
+    const auto uptimeLength = FileSystem::Get().ReadFileInto("/proc/uptime", uptimeBuffer, sizeof(uptimeBuffer) - 1);
+    if (uptimeLength <= 0) {
+        LOG_WARN("Failed to read /proc/uptime");
+        return;
+    }
+    uptimeBuffer[uptimeLength] = '\0';
+    const double uptime = strtod(uptimeBuffer, nullptr);
+
+    VmStat vmStat;
+    const double elapsed = uptime - mVmStatPreviousUptime;
+
+    for (const auto &counter: vmStat.Counters()) {
+        if (!VmStat::IsEventCounter(counter.name)) {
+            continue;
+        }
+
+        std::string name(counter.name);
+        auto previous = mVmStatPrevious.find(name);
+
+        if (previous == mVmStatPrevious.end()) {
+            // First time we've seen it, so nothing to work out a rate from yet
+            mVmStatPrevious.emplace(std::move(name), counter.value);
+            continue;
+        }
+
+        // Counters only go backwards if they wrap, in which case skip this interval
+        if (elapsed > 0 && counter.value >= previous->second) {
+            auto itr = mVmStatRates.find(name);
+            if (itr == mVmStatRates.end()) {
+                itr = mVmStatRates.emplace(name, Measurement("Per_Second", true)).first;
+            }
+            itr->second.AddDataPoint((counter.value - previous->second) / elapsed);
+        }
+
+        previous->second = counter.value;
+    }
+
+    mVmStatPreviousUptime = uptime;
 }
 
 void MemoryMetric::GetCmaMemoryUsage()
@@ -337,71 +772,75 @@ void MemoryMetric::GetCmaMemoryUsage()
     long double cmaTotalUsed = 0;
 
     // Start by getting CMA breakdown
-    try {
-        for (const auto &dirEntry: std::filesystem::directory_iterator(
-                "/sys/kernel/debug/cma")) {
-
-            // Read CMA metrics
-            // Total size of the CMA region
-            auto countFile = std::ifstream(dirEntry.path() / "count");
-            countFile >> countKb;
-            countKb = (countKb * mPageSize) / (long double) 1024;
-
-            // Amount of pages used
-            auto usedPagesFile = std::ifstream(dirEntry.path() / "used");
-            usedPagesFile >> usedKb;
-            usedKb = (usedKb * mPageSize) / (long double) 1024;
-
-            // Calculate how much of that region is unused
-            unusedKb = countKb - usedKb;
-
-            // Calculate some totals
-            cmaTotalKb += countKb;
-            cmaTotalUsed += usedKb;
-
-            std::string cmaName;
-            try {
-                cmaName = mCmaNames.at(dirEntry.path().filename());
-            }
-            catch (const std::exception &ex) {
-                LOG_ERROR("Could not find CMA name for directory %s", dirEntry.path().filename().string().c_str());
-                break;
-            }
+    std::vector<IFileSystem::DirectoryEntry> cmaRegions;
+    if (!FileSystem::Get().ListDirectory("/sys/kernel/debug/cma", cmaRegions)) {
+        LOG_WARN("Failed to open CMA debug directory");
+        return;
+    }
 
-            // Add to measurements
-            auto itr = mCmaMeasurements.find(cmaName);
+    for (const auto &dirEntry: cmaRegions) {
+        const std::string regionPath = "/sys/kernel/debug/cma/" + dirEntry.name;
 
-            if (itr != mCmaMeasurements.end()) {
-                // If we have previous measurements for this region, add new data points
-                auto &measurement = itr->second;
+        // Read CMA metrics
+        // Total size of the CMA region
+        std::istringstream countFile;
+        FileSystem::Open(regionPath + "/count", countFile);
+        countFile >> countKb;
+        countKb = (countKb * mPageSize) / (long double) 1024;
 
-                measurement.sizeKb = countKb;
-                measurement.Used.AddDataPoint(usedKb);
-                measurement.Unused.AddDataPoint(unusedKb);
-            } else {
-                // New CMA region, create measurements
-                auto used = Measurement("Used_KB");
-                used.AddDataPoint(usedKb);
+        // Amount of pages used
+        std::istringstream usedPagesFile;
+        FileSystem::Open(regionPath + "/used", usedPagesFile);
+        usedPagesFile >> usedKb;
+        usedKb = (usedKb * mPageSize) / (long double) 1024;
 
-                auto unused = Measurement("Unused_KB");
-                unused.AddDataPoint(unusedKb);
+        // Calculate how much of that region is unused
+        unusedKb = countKb - usedKb;
 
-                auto measurement = cmaMeasurement(countKb, used, unused);
-                mCmaMeasurements.insert(std::make_pair(cmaName, measurement));
-            }
+        // Calculate some totals
+        cmaTotalKb += countKb;
+        cmaTotalUsed += usedKb;
+
+        std::string cmaName;
+        try {
+            cmaName = mCmaNames.at(dirEntry.name);
+        }
+        catch (const std::exception &ex) {
+            LOG_ERROR("Could not find CMA name for directory %s", dirEntry.name.c_str());
+            break;
         }
 
-        // Work out how much CMA is borrowed by the kernel (this can occur under memory pressure scenarios where
-        // there is not enough memory elsewhere for userspace processes)
-        MemInfo memInfoFile;
-        mCmaFree.AddDataPoint(memInfoFile.CmaFree());
+        // Add to measurements
+        auto itr = mCmaMeasurements.find(cmaName);
+
+        if (itr != mCmaMeasurements.end()) {
+            // If we have previous measurements for this region, add new data points
+            auto &measurement = itr->second;
 
-        long double totalUnused = cmaTotalKb - cmaTotalUsed;
-        long double borrowed = totalUnused - memInfoFile.CmaFree();
-        mCmaBorrowed.AddDataPoint(borrowed);
-    } catch (std::filesystem::filesystem_error &error) {
-        LOG_WARN("Failed to open CMA debug file with error %s", error.what());
+            measurement.sizeKb = countKb;
+            measurement.Used.AddDataPoint(usedKb);
+            measurement.Unused.AddDataPoint(unusedKb);
+        } else {
+            // New CMA region, create measurements
+            auto used = Measurement("Used_KB");
+            used.AddDataPoint(usedKb);
+
+            auto unused = Measurement("Unused_KB");
+            unused.AddDataPoint(unusedKb);
+
+            auto measurement = cmaMeasurement(countKb, used, unused);
+            mCmaMeasurements.insert(std::make_pair(cmaName, measurement));
+        }
     }
+
+    // Work out how much CMA is borrowed by the kernel (this can occur under memory pressure scenarios where
+    // there is not enough memory elsewhere for userspace processes)
+    const auto &memInfoFile = mTickValues->memInfo;
+    mCmaFree.AddDataPoint(memInfoFile.CmaFree());
+
+    long double totalUnused = cmaTotalKb - cmaTotalUsed;
+    long double borrowed = totalUnused - memInfoFile.CmaFree();
+    mCmaBorrowed.AddDataPoint(borrowed);
 }
 
 void MemoryMetric::GetGpuMemoryUsage()
@@ -430,41 +869,278 @@ void MemoryMetric::GetContainerMemoryUsage()
 {
     //LOG_INFO("Getting Container memory usage");
 
-    long double memoryUsageKb = 0;
-    // List of system containers which we are not interested in.
-    std::string ignore_list[] = {"init.scope", "system.slice"};
+    if (mCgroupVersion == CgroupMemory::Version::None) {
+        return;
+    }
 
-    std::string memoryCgroupDir = "/sys/fs/cgroup/memory";
+    const std::string memoryCgroupDir = CgroupMemory::RootPath(mCgroupVersion);
 
-    if (!std::filesystem::exists(memoryCgroupDir)) {
+    std::vector<IFileSystem::DirectoryEntry> cgroups;
+    if (!FileSystem::Get().ListDirectory(memoryCgroupDir, cgroups)) {
         return;
     }
 
+    std::set<std::string> listed;
+    for (const auto &dirEntry: cgroups) {
+        if (CgroupMemory::IsContainer(dirEntry)) {
+            listed.emplace(dirEntry.name);
+        }
+    }
+
+    // Containers that have gone away keep what they've collected for the report, but stop holding their files open.
+    // Ones that never collected anything are forgotten
+    for (auto itr = mContainerMeasurements.begin(); itr != mContainerMeasurements.end();) {
+        if (listed.count(itr->first) > 0) {
+            ++itr;
+        } else if (itr->second.Used.GetCount() > 0) {
+            itr->second.Cgroup.reset();
+            ++itr;
+        } else {
+            itr = mContainerMeasurements.erase(itr);
+        }
+    }
+
     // Simplest way is to report memory usage by each cgroup, although this can result in some results that don't
     // correspond to a container if something else created that cgroup
-    for (const auto &dirEntry: std::filesystem::directory_iterator(
-            "/sys/fs/cgroup/memory")) {
-        if (!dirEntry.is_directory()) {
+    for (const auto &containerName: listed) {
+        // Files are only opened the first time the cgroup is seen, then re-read every tick after that
+        auto itr = mContainerMeasurements.find(containerName);
+        if (itr == mContainerMeasurements.end()) {
+            itr = mContainerMeasurements.emplace(std::piecewise_construct, std::forward_as_tuple(containerName),
+                                                 std::forward_as_tuple(mCgroupVersion,
+                                                                       memoryCgroupDir + "/" + containerName)).first;
+        }
+
+        auto &measurement = itr->second;
+        if (!measurement.Cgroup) {
+            // Was removed, and has been created again since
+            measurement.Cgroup = std::make_unique<CgroupMemory>(mCgroupVersion, memoryCgroupDir + "/" + containerName);
+        }
+
+        CgroupMemory::Usage usage{};
+        if (!measurement.Cgroup->Read(usage)) {
+            // Cgroups on v2 without the memory controller enabled don't have any memory files. If the cgroup has been
+            // removed and created again, open it again next time
+            measurement.Cgroup = std::make_unique<CgroupMemory>(mCgroupVersion, memoryCgroupDir + "/" + containerName);
             continue;
         }
 
-        auto containerName = dirEntry.path().filename().string();
-        if (std::find(std::begin(ignore_list), std::end(ignore_list), containerName.c_str()) == std::end(ignore_list)) {
-            auto memoryUsageFile = std::ifstream(dirEntry.path() / "memory.usage_in_bytes");
-            memoryUsageFile >> memoryUsageKb;
-            memoryUsageKb /= (long double) 1024.0;
+        measurement.Used.AddDataPoint(usage.currentKb);
+        measurement.Peak.AddDataPoint(usage.peakKb);
+        measurement.Swap.AddDataPoint(usage.swapKb);
+        measurement.Max.AddDataPoint(usage.maxKb);
+        measurement.High.AddDataPoint(usage.highKb);
+    }
+}
 
-            auto itr = mContainerMeasurements.find(containerName);
+/**
+ * Walks the whole cgroup hierarchy and reads the memory.stat breakdown of every cgroup in it. memory.stat values
+ * include all the cgroups below, so each cgroup's children are taken off its total to work out what is charged to
+ * the cgroup itself
+ */
+void MemoryMetric::GetCgroupMemoryStats()
+{
+    if (mCgroupVersion == CgroupMemory::Version::None) {
+        return;
+    }
 
-            if (itr != mContainerMeasurements.end()) {
-                auto &measurement = itr->second;
-                measurement.AddDataPoint(memoryUsageKb);
+    const std::string root = CgroupMemory::RootPath(mCgroupVersion);
+
+    // Breadth first, so every cgroup is listed after its parent
+    std::vector<std::string> cgroups{"/"};
+    for (size_t i = 0; i < cgroups.size(); i++) {
+        const auto parent = cgroups[i];
+
+        std::vector<IFileSystem::DirectoryEntry> entries;
+        if (!FileSystem::Get().ListDirectory(parent == "/" ? root : root + parent, entries)) {
+            continue;
+        }
+
+        for (const auto &entry: entries) {
+            if (entry.isDirectory) {
+                cgroups.emplace_back(parent == "/" ? "/" + entry.name : parent + "/" + entry.name);
+            }
+        }
+    }
+
+    // Cgroups that have gone away keep what they've collected for the report, but stop holding their files open.
+    // Ones that never collected anything are forgotten
+    const std::set<std::string> listed(cgroups.begin(), cgroups.end());
+    for (auto itr = mCgroupNodes.begin(); itr != mCgroupNodes.end();) {
+        if (listed.count(itr->first) > 0) {
+            ++itr;
+        } else if (itr->second.Total.front().GetCount() > 0) {
+            itr->second.Stat.reset();
+            ++itr;
+        } else {
+            itr = mCgroupNodes.erase(itr);
+        }
+    }
+
+    using values = std::array<long double, CgroupMemoryStat::kFieldCount>;
+    std::map<std::string, values> totals;
+
+    for (const auto &cgroup: cgroups) {
+        const auto path = cgroup == "/" ? root : root + cgroup;
+
+        auto itr = mCgroupNodes.find(cgroup);
+        if (itr == mCgroupNodes.end()) {
+            itr = mCgroupNodes.emplace(std::piecewise_construct, std::forward_as_tuple(cgroup),
+                                       std::forward_as_tuple(mCgroupVersion, path)).first;
+        }
+
+        auto &node = itr->second;
+        if (!node.Stat) {
+            // Was removed, and has been created again since
+            node.Stat = std::make_unique<CgroupMemoryStat>(mCgroupVersion, path);
+        }
+
+        if (!node.Stat->HasStat()) {
+            // Nothing to read (e.g. the v2 root), so don't keep trying to open it every tick
+            continue;
+        }
+
+        if (!node.Stat->Read()) {
+            // Removed since we listed it, or removed and created again. Open it again next time it's listed
+            node.Stat.reset();
+            continue;
+        }
+
+        values total{};
+        for (size_t i = 0; i < CgroupMemoryStat::kFieldCount; i++) {
+            total[i] = node.Stat->GetKb(static_cast<CgroupMemoryStat::Field>(i));
+            node.Total[i].AddDataPoint(total[i]);
+        }
+        totals.emplace(cgroup, total);
+    }
+
+    // Take every cgroup off its parent, leaving what's charged to the parent itself
+    auto selfValues = totals;
+    for (const auto &total: totals) {
+        if (total.first == "/") {
+            continue;
+        }
+
+        const auto separator = total.first.find_last_of('/');
+        auto parent = selfValues.find(separator == 0 ? "/" : total.first.substr(0, separator));
+        if (parent == selfValues.end()) {
+            continue;
+        }
+
+        for (size_t i = 0; i < CgroupMemoryStat::kFieldCount; i++) {
+            parent->second[i] -= total.second[i];
+        }
+    }
+
+    for (const auto &self: selfValues) {
+        auto &node = mCgroupNodes.at(self.first);
+        for (size_t i = 0; i < CgroupMemoryStat::kFieldCount; i++) {
+            // The kernel updates the counters in per-cpu batches, so a parent can briefly be behind its children
+            node.Self[i].AddDataPoint(std::max(self.second[i], 0.0L));
+        }
+    }
+}
+
+/**
+ * @brief Record how much memory zram and zswap are saving by compressing swapped out pages, and what it costs them to
+ * do it
+ */
+void MemoryMetric::GetCompressedMemoryUsage()
+{
+    for (auto &device: mZramDevices) {
+        // Devices that haven't been given a size yet can't hold anything
+        if (!device.Read() || device.DiskSize() == 0) {
+            continue;
+        }
+
+        auto &zram = mZramMeasurements[device.Name()];
+        const auto &mmStat = device.GetMmStat();
+
+        zram.Original.AddDataPoint(mmStat.origDataSize / 1024.0L);
+        zram.Compressed.AddDataPoint(mmStat.comprDataSize / 1024.0L);
+        zram.Used.AddDataPoint(mmStat.memUsedTotal / 1024.0L);
+        zram.Limit.AddDataPoint(mmStat.memLimit / 1024.0L);
+        zram.SamePages.AddDataPoint(mmStat.samePages);
+        zram.HugePages.AddDataPoint(mmStat.hugePages);
+        if (mmStat.comprDataSize > 0) {
+            zram.Ratio.AddDataPoint(100.0L * mmStat.origDataSize / mmStat.comprDataSize);
+        }
+        zram.Saved.AddDataPoint((static_cast<long double>(mmStat.origDataSize) - mmStat.memUsedTotal) / 1024.0L);
+        zram.Overhead.AddDataPoint((static_cast<long double>(mmStat.memUsedTotal) - mmStat.comprDataSize) / 1024.0L);
+
+        const auto &ioStat = device.GetIoStat();
+        zram.FailedReads.AddDataPoint(ioStat.failedReads);
+        zram.FailedWrites.AddDataPoint(ioStat.failedWrites);
+        zram.InvalidIo.AddDataPoint(ioStat.invalidIo);
+        zram.NotifyFree.AddDataPoint(ioStat.notifyFree);
+
+        // Backing device stats are in 4K units regardless of page size
+        const auto &bdStat = device.GetBdStat();
+        zram.Writeback.AddDataPoint(bdStat.count * 4);
+        zram.WritebackReads.AddDataPoint(bdStat.reads * 4);
+        zram.WritebackWrites.AddDataPoint(bdStat.writes * 4);
+    }
+
+    if (!mZswapEnabled) {
+        return;
+    }
+
+    auto addZswap = [this](const std::string &stat, const std::string &unit, long double value)
+    {
+        auto itr = mZswapMeasurements.find(stat);
+        if (itr == mZswapMeasurements.end()) {
+            itr = mZswapMeasurements.emplace(stat, zswapStat{unit, Measurement("Value")}).first;
+        }
+        itr->second.value.AddDataPoint(value);
+    };
+
+    long double storedKb = -1;
+    long double poolKb = -1;
+
+    if (!mZswapFiles.empty()) {
+        for (const auto &file: mZswapFiles) {
+            char buffer[32];
+            auto length = file.second->Read(buffer, sizeof(buffer) - 1);
+            if (length <= 0) {
+                continue;
+            }
+            buffer[length] = '\0';
+            const auto value = strtoull(buffer, nullptr, 10);
+
+            // Pools are in bytes, pages in the system page size and everything else is a count of events
+            if (file.first == "pool_total_size") {
+                poolKb = value / 1024.0L;
+                addZswap(file.first, "KB", poolKb);
+            } else if (file.first.size() > 6 && file.first.compare(file.first.size() - 6, 6, "_pages") == 0) {
+                const auto kb = value * mPageSize / 1024.0L;
+                if (file.first == "stored_pages") {
+                    storedKb = kb;
+                }
+                addZswap(file.first, "KB", kb);
             } else {
-                Measurement measurement("Memory_Used_KB");
-                measurement.AddDataPoint(memoryUsageKb);
-                mContainerMeasurements.insert(std::make_pair(containerName, measurement));
+                addZswap(file.first, "Count", value);
             }
         }
+    } else {
+        // Linux 5.19 and later report the pool size and how much was put in it in /proc/meminfo, which was read
+        // earlier this tick
+        auto pool = mMeminfoMeasurements.find(MemInfo::Field::Zswap);
+        auto stored = mMeminfoMeasurements.find(MemInfo::Field::Zswapped);
+        if (pool == mMeminfoMeasurements.end() || stored == mMeminfoMeasurements.end()) {
+            return;
+        }
+
+        poolKb = pool->second.GetLastValue();
+        storedKb = stored->second.GetLastValue();
+        addZswap("pool_total_size", "KB", poolKb);
+        addZswap("stored", "KB", storedKb);
+    }
+
+    if (poolKb > 0 && storedKb >= 0) {
+        addZswap("compression_ratio", "Ratio x100", 100.0L * storedKb / poolKb);
+    }
+    if (poolKb >= 0 && storedKb >= 0) {
+        addZswap("saved", "KB", storedKb - poolKb);
     }
 }
 
@@ -475,9 +1151,9 @@ void MemoryMetric::GetMemoryBandwidth()
         //LOG_INFO("Getting memory bandwidth usage");
 
         if (mPlatform == Platform::AMLOGIC) {
-            std::ifstream memBandwidthFile("/sys/class/aml_ddr/bandwidth");
+            std::istringstream memBandwidthFile;
 
-            if (!memBandwidthFile) {
+            if (!FileSystem::Open("/sys/class/aml_ddr/bandwidth", memBandwidthFile)) {
                 LOG_WARN("Cannot get DDR usage");
                 return;
             }
@@ -501,9 +1177,9 @@ void MemoryMetric::GetBroadcomBmemUsage()
 {
     // LOG_INFO("Getting BMEM Usage");
 
-    std::ifstream broadcomCoreInfo("/proc/brcm/core");
+    std::istringstream broadcomCoreInfo;
 
-    if (!broadcomCoreInfo) {
+    if (!FileSystem::Open("/proc/brcm/core", broadcomCoreInfo)) {
         LOG_WARN("Could not open /proc/brcm/core");
         return;
     }
@@ -540,92 +1216,69 @@ void MemoryMetric::CalculateFragmentation()
 {
     //LOG_INFO("Getting memory fragmentation");
 
-    std::ifstream buddyInfo("/proc/buddyinfo");
-
-    if (!buddyInfo) {
-        LOG_WARN("Could not open buddyinfo");
-        return;
+    size_t columnCount = 0;
+    if (mPlatform == Platform::AMLOGIC) {
+        columnCount = 15;
+    } else if (mPlatform == Platform::REALTEK) {
+        columnCount = 17;
+    } else if (mPlatform == Platform::BROADCOM) {
+        columnCount = 15;
     }
 
-    std::string line;
-    std::string segment;
-    // Get fragmentation for all zones
-    while (std::getline(buddyInfo, line)) {
-        std::stringstream lineStream(line);
-        std::vector<std::string> segments;
-        // Split line on space
-        while (std::getline(lineStream, segment, ' ')) {
-            if (!segment.empty()) {
-                segments.emplace_back(segment);
-            }
-        }
+    BuddyInfo buddyInfo(columnCount);
 
-        std::string zoneName = segments[3];
+    // Get fragmentation for all zones
+    for (const auto &zone: buddyInfo.Zones()) {
+        const std::string &zoneName = zone.name;
         std::map<int, int> freePages;
         std::map<int, double> fragmentationPercent;
 
-        size_t columnCount = 0;
-        if (mPlatform == Platform::AMLOGIC) {
-            columnCount = 15;
-        } else if (mPlatform == Platform::REALTEK) {
-            columnCount = 17;
-        } else if (mPlatform == Platform::BROADCOM) {
-            columnCount = 15;
-        }
+        // Calculate fragmentation % for this node
+        int totalFreePages = 0;
 
-        if (segments.size() != columnCount) {
-            LOG_WARN("Failed to parse buddyinfo - invalid number of columns (got %zd, expected %zd)", segments.size(),
-                     columnCount);
-        } else {
-            // Calculate fragmentation % for this node
-            int totalFreePages = 0;
+        //  Get all free page values, and work out total free pages
+        for (int order = 0; order < (int) zone.freePages.size(); order++) {
+            int freeCount = zone.freePages[order];
+            totalFreePages += std::pow(2, order) * freeCount;
+            freePages[order] = freeCount;
+        }
 
-            //  Get all free page values, and work out total free pages
-            for (int i = 4; i < (int) columnCount; i++) {
-                int order = i - 4;
+        // Now find out the fragmentation percentages (see https://github.com/dsanders11/scripts/blob/master/Linux_Memory_Fragmentation.pdf and
+        // http://thomas.enix.org/pub/rmll2005/rmll2005-gorman.pdf)
+        double fragPercentage;
+        for (int i = 0; i < (int) freePages.size(); i++) {
+            fragPercentage = 0;
 
-                int freeCount = std::stoi(segments[i]);
-                totalFreePages += std::pow(2, order) * freeCount;
-                freePages[order] = freeCount;
+            // Seems inefficient...
+            for (int j = i; j < (int) freePages.size(); j++) {
+                fragPercentage += (std::pow(2, j)) * freePages[j];
             }
+            fragPercentage = (totalFreePages - fragPercentage) / totalFreePages;
+            fragmentationPercent[i] = fragPercentage;
+        }
 
-            // Now find out the fragmentation percentages (see https://github.com/dsanders11/scripts/blob/master/Linux_Memory_Fragmentation.pdf and
-            // http://thomas.enix.org/pub/rmll2005/rmll2005-gorman.pdf)
-            double fragPercentage;
-            for (int i = 0; i < (int) freePages.size(); i++) {
-                fragPercentage = 0;
+        // Update measurements
+        auto itr = mMemoryFragmentation.find(zoneName);
+        if (itr != mMemoryFragmentation.end()) {
+            auto &measurements = itr->second;
 
-                // Seems inefficient...
-                for (int j = i; j < (int) freePages.size(); j++) {
-                    fragPercentage += (std::pow(2, j)) * freePages[j];
-                }
-                fragPercentage = (totalFreePages - fragPercentage) / totalFreePages;
-                fragmentationPercent[i] = fragPercentage;
+            for (int i = 0; i < (int) freePages.size(); i++) {
+                measurements[i].FreePages.AddDataPoint(freePages[i]);
+                measurements[i].Fragmentation.AddDataPoint(fragmentationPercent[i] * 100);
             }
+        } else {
+            std::vector<memoryFragmentation> measurements = {};
+            for (int i = 0; i < (int) freePages.size(); i++) {
+                Measurement fp("Free_Pages");
+                fp.AddDataPoint(freePages[i]);
 
-            // Update measurements
-            auto itr = mMemoryFragmentation.find(zoneName);
-            if (itr != mMemoryFragmentation.end()) {
-                auto &measurements = itr->second;
-
-                for (int i = 0; i < (int) freePages.size(); i++) {
-                    measurements[i].FreePages.AddDataPoint(freePages[i]);
-                    measurements[i].Fragmentation.AddDataPoint(fragmentationPercent[i] * 100);
-                }
-            } else {
-                std::vector<memoryFragmentation> measurements = {};
-                for (int i = 0; i < (int) freePages.size(); i++) {
-                    Measurement fp("Free_Pages");
-                    fp.AddDataPoint(freePages[i]);
-
-                    Measurement frag("Fragmentation_%");
-                    frag.AddDataPoint(fragmentationPercent[i]);
-                    memoryFragmentation fragMeasurement(fp, frag);
-                    measurements.emplace_back(fragMeasurement);
-                }
-
-                mMemoryFragmentation.insert(std::make_pair(zoneName, measurements));
+                Measurement frag("Fragmentation_%");
+                frag.AddDataPoint(fragmentationPercent[i]);
+                memoryFragmentation fragMeasurement(fp, frag);
+                measurements.emplace_back(fragMeasurement);
             }
+
+            mMemoryFragmentation.insert(std::make_pair(zoneName, measurements));
         }
     }
 }
@@ -665,12 +1318,17 @@ void MemoryMetric::CalculateFragmentation()
 */
 void MemoryMetric::GetGpuMemoryUsageBroadcom()
 {
-    std::string line;
     pid_t tid;
 
-    for (const auto &entry: std::filesystem::directory_iterator("/sys/kernel/debug/dri/0/")) {
-        const auto entryStr = entry.path().filename().string();
-        if (entry.is_directory()) {
+    std::vector<IFileSystem::DirectoryEntry> clients;
+    if (!FileSystem::Get().ListDirectory("/sys/kernel/debug/dri/0", clients)) {
+        LOG_WARN("Could not open /sys/kernel/debug/dri/0");
+        return;
+    }
+
+    for (const auto &entry: clients) {
+        const auto &entryStr = entry.name;
+        if (entry.isDirectory) {
             // Scan as far as we need to.
             if (sscanf(entryStr.c_str(), "%d-", &tid) != 1) {
                 // Not interested in this directory.
@@ -678,57 +1336,19 @@ void MemoryMetric::GetGpuMemoryUsageBroadcom()
             }
 
             std::string pathStr = std::string("/sys/kernel/debug/dri/0/") + entryStr + "/client";
-            std::ifstream gpuMem(pathStr.c_str());
-            if (!gpuMem) {
+            std::istringstream gpuMem;
+            if (!FileSystem::Open(pathStr, gpuMem)) {
                 LOG_WARN("Could not open gpu_memory file %s", pathStr.c_str());
                 continue;
             }
 
-            while (std::getline(gpuMem, line)) {
-                char processName[32];
-                unsigned int objectsNum;
-                unsigned long virtualMemNum;
-                char virtualMemNumUnit[3];
-                unsigned long virtualMemNumBytes;
-
-                // Scan as far as we need to.
-                if (sscanf(line.c_str(), " %s %d %ld%2c", processName, &objectsNum, &virtualMemNum,
-                           virtualMemNumUnit) == 4) {
-
-                    virtualMemNumUnit[2] = 0;
-
-                    std::string virtualMemNumUnitStr(virtualMemNumUnit);
-
-                    if (virtualMemNumUnitStr == "KB") {
-                        virtualMemNumBytes = virtualMemNum * 1024;
-                    } else if (virtualMemNumUnitStr == "MB") {
-                        virtualMemNumBytes = virtualMemNum * 1024 * 1024;
-                    } else if (virtualMemNumUnitStr == "GB") {
-                        virtualMemNumBytes = virtualMemNum * 1024 * 1024 * 1024;
-                    } else {
-                        LOG_WARN("Could not parse this line: \'%s\'", line.c_str());
-                        continue;
-                    }
-
-                    // Convert TID to parent PID (TGID) to make things easier to correlate later on
-                    pid_t pid = tidToParentPid(tid);
-
-                    auto itr = mGpuMeasurements.find(pid);
-
-                    if (itr != mGpuMeasurements.end()) {
-                        // Already got a measurement for this PID
-                        auto &measurement = itr->second;
-                        measurement.Used.AddDataPoint(virtualMemNumBytes / (long double) 1024.0);
-                    } else {
-                        Process process(pid);
-                        Measurement used("Memory_Usage_KB");
-                        used.AddDataPoint(virtualMemNumBytes / (long double) 1024.0);
-
-                        auto measurement = gpuMeasurement(process, used);
-                        mGpuMeasurements.insert(std::make_pair(pid, measurement));
-                    }
-                }
+            // Convert TID to parent PID (TGID) to make things easier to correlate later on
+            std::vector<GpuMemory::Allocation> allocations;
+            for (const auto bytes: GpuMemory::ParseBroadcomClient(gpuMem)) {
+                allocations.emplace_back(GpuMemory::Allocation{tidToParentPid(tid), bytes});
             }
+
+            addGpuAllocations(allocations, "Memory_Usage_KB");
         }
     }
 }
@@ -749,38 +1369,14 @@ void MemoryMetric::GetGpuMemoryUsageBroadcom()
 */
 void MemoryMetric::GetGpuMemoryUsageAmlogic()
 {
-    std::ifstream gpuMem("/sys/kernel/debug/mali0/gpu_memory");
+    std::istringstream gpuMem;
 
-    if (!gpuMem) {
+    if (!FileSystem::Open("/sys/kernel/debug/mali0/gpu_memory", gpuMem)) {
         LOG_WARN("Could not open gpu_memory file");
         return;
     }
 
-    std::string line;
-    long gpuPages;
-    pid_t pid;
-
-    while (std::getline(gpuMem, line)) {
-        if (sscanf(line.c_str(), "%*x %d %ld", &pid, &gpuPages) != 0) {
-            unsigned long gpuBytes = gpuPages * mPageSize;
-
-            auto itr = mGpuMeasurements.find(pid);
-
-            if (itr != mGpuMeasurements.end()) {
-                // Already got a measurement for this PID
-                auto &measurement = itr->second;
-                measurement.Used.AddDataPoint(gpuBytes / (long double) 1024.0);
-            } else {
-                Process process(pid);
-
-                Measurement used("Memory_Usage_KB");
-                used.AddDataPoint(gpuBytes / (long double) 1024.0);
-
-                auto measurement = gpuMeasurement(process, used);
-                mGpuMeasurements.insert(std::make_pair(pid, measurement));
-            }
-        }
-    }
+    addGpuAllocations(GpuMemory::ParseMali(gpuMem, GpuMemory::MaliFormat::Amlogic, mPageSize), "Memory_Usage_KB");
 }
 
 
@@ -801,36 +1397,37 @@ void MemoryMetric::GetGpuMemoryUsageAmlogic()
 */
 void MemoryMetric::GetGpuMemoryUsageRealtek()
 {
-    std::ifstream gpuMem("/sys/kernel/debug/mali0/gpu_memory");
+    std::istringstream gpuMem;
 
-    if (!gpuMem) {
+    if (!FileSystem::Open("/sys/kernel/debug/mali0/gpu_memory", gpuMem)) {
         LOG_WARN("Could not open gpu_memory file");
         return;
     }
 
-    std::string line;
-    long gpuPages;
-    pid_t pid;
-
-    while (std::getline(gpuMem, line)) {
-        if (sscanf(line.c_str(), "  kctx-0x%*x %ld %d", &gpuPages, &pid) != 0) {
-            unsigned long gpuBytes = gpuPages * mPageSize;
+    addGpuAllocations(GpuMemory::ParseMali(gpuMem, GpuMemory::MaliFormat::Realtek, mPageSize), "Memory Usage KB");
+}
 
-            auto itr = mGpuMeasurements.find(pid);
+/**
+ * @brief Add a data point for each GPU allocation to the measurement for the process that owns it
+ */
+void MemoryMetric::addGpuAllocations(const std::vector<GpuMemory::Allocation> &allocations,
+                                     const std::string &measurementName)
+{
+    for (const auto &allocation: allocations) {
+        auto itr = mGpuMeasurements.find(allocation.pid);
 
-            if (itr != mGpuMeasurements.end()) {
-                // Already got a measurement for this PID
-                auto &measurement = itr->second;
-                measurement.Used.AddDataPoint(gpuBytes / (long double) 1024.0);
-            } else {
-                Process process(pid);
+        if (itr != mGpuMeasurements.end()) {
+            // Already got a measurement for this PID
+            auto &measurement = itr->second;
+            measurement.Used.AddDataPoint(allocation.bytes / (long double) 1024.0);
+        } else {
+            Process process(allocation.pid);
 
-                Measurement used("Memory Usage KB");
-                used.AddDataPoint(gpuBytes / (long double) 1024.0);
+            Measurement used(measurementName);
+            used.AddDataPoint(allocation.bytes / (long double) 1024.0);
 
-                auto measurement = gpuMeasurement(process, used);
-                mGpuMeasurements.insert(std::make_pair(pid, measurement));
-            }
+            auto measurement = gpuMeasurement(process, used);
+            mGpuMeasurements.insert(std::make_pair(allocation.pid, measurement));
         }
     }
 }
@@ -843,9 +1440,9 @@ pid_t MemoryMetric::tidToParentPid(pid_t tid)
 {
     std::string statusFilePath = "/proc/" + std::to_string(tid) + "/status";
 
-    std::ifstream statusFile(statusFilePath);
+    std::istringstream statusFile;
 
-    if (!statusFile) {
+    if (!FileSystem::Open(statusFilePath, statusFile)) {
         LOG_WARN("Failed to open file %s", statusFilePath.c_str());
         return -1;
     }
@@ -21,21 +21,33 @@
 
 #include "IMetric.h"
 
+#include <atomic>
 #include <thread>
 #include <condition_variable>
 #include <map>
 #include <mutex>
+#include <optional>
 #include "Platform.h"
+#include "CollectionContext.h"
+#include "Cgroup/CgroupMemory.h"
+#include "Cgroup/CgroupMemoryStat.h"
+#include "FileParsers/GpuMemory.h"
+#include "FileParsers/MemInfo.h"
+#include "FileParsers/Zram.h"
 #include "GroupManager.h"
 
 #include "Procrank.h"
 #include "JsonReportGenerator.h"
+#include "OverheadTracker.h"
+#include "SamplePublisher.h"
 
 
 class MemoryMetric : public IMetric
 {
 public:
-    MemoryMetric(Platform platform, std::shared_ptr<JsonReportGenerator> reportGenerator);
+    MemoryMetric(Platform platform, std::shared_ptr<JsonReportGenerator> reportGenerator,
+                 std::shared_ptr<SamplePublisher> samplePublisher,
+                 std::shared_ptr<OverheadTracker> overheadTracker, std::shared_ptr<CollectionContext> context);
 
     ~MemoryMetric();
 
@@ -45,17 +57,47 @@ public:
 
     void SaveResults() override;
 
+    void ResetResults() override;
+
+    static void AddDatasetsToReport(const std::vector<JsonReportGenerator::dataset> &datasets,
+                                    JsonReportGenerator &reportGenerator);
+
+    /**
+     * @brief Immutable copy of the results collected so far, published by the collection thread after each tick
+     */
+    struct Snapshot
+    {
+        std::chrono::system_clock::time_point timestamp;
+        std::vector<JsonReportGenerator::dataset> datasets;
+    };
+
+    std::shared_ptr<const Snapshot> GetSnapshot() const;
+
 private:
     void CollectData(std::chrono::seconds frequency);
 
+    std::vector<JsonReportGenerator::dataset> buildDatasets(std::vector<DatasetSample> *latencySamples = nullptr) const;
+
+    void publishSamples(const Snapshot &snapshot, const std::vector<DatasetSample> &latencySamples);
+
+    void resetMeasurements();
+
+    void collect(const std::string &collector, void (MemoryMetric::*collectFunction)());
+
     void GetLinuxMemoryUsage();
 
+    void GetVmStatRates();
+
     void GetCmaMemoryUsage();
 
     void GetGpuMemoryUsage();
 
     void GetContainerMemoryUsage();
 
+    void GetCgroupMemoryStats();
+
+    void GetCompressedMemoryUsage();
+
     void GetMemoryBandwidth();
 
     void GetBroadcomBmemUsage();
@@ -69,6 +111,8 @@ private:
 
     void GetGpuMemoryUsageRealtek();
 
+    void addGpuAllocations(const std::vector<GpuMemory::Allocation> &allocations, const std::string &measurementName);
+
     pid_t tidToParentPid(pid_t tid);
 
 private:
@@ -121,13 +165,110 @@ private:
 
     size_t mPageSize;
 
+    // Refreshed at the start of each tick, and shared by every collector in that tick
+    const std::shared_ptr<CollectionContext> mContext;
+    std::optional<CollectionContext::TickValues> mTickValues;
+
     std::map<std::string, cmaMeasurement> mCmaMeasurements;
     std::map<std::string, Measurement> mLinuxMemoryMeasurements;
+    // Every field in /proc/meminfo the kernel reports, in the order the kernel prints them
+    std::map<MemInfo::Field, Measurement> mMeminfoMeasurements;
+
+    // Per second rate of each /proc/vmstat event counter, worked out from the values at the previous tick
+    std::map<std::string, Measurement> mVmStatRates;
+    std::map<std::string, unsigned long long> mVmStatPrevious;
+    double mVmStatPreviousUptime;
     std::map<pid_t, gpuMeasurement> mGpuMeasurements;
-    std::map<std::string, Measurement> mContainerMeasurements;
+
+    // Usage and limits of each top level memory cgroup, with the cgroup files kept open between ticks
+    struct containerMeasurement
+    {
+        containerMeasurement(CgroupMemory::Version version, const std::string &path)
+                : Cgroup(std::make_unique<CgroupMemory>(version, path)),
+                  Used("Memory_Used_KB"),
+                  Peak("Peak_KB"),
+                  Swap("Swap_KB"),
+                  Max("Limit_KB"),
+                  High("High_KB")
+        {
+
+        }
+
+        std::unique_ptr<CgroupMemory> Cgroup;
+        Measurement Used;
+        Measurement Peak;
+        Measurement Swap;
+        Measurement Max;
+        Measurement High;
+    };
+
+    CgroupMemory::Version mCgroupVersion;
+    std::map<std::string, containerMeasurement> mContainerMeasurements;
+
+    // memory.stat breakdown of every cgroup in the hierarchy, not just the top level
+    struct cgroupNode
+    {
+        cgroupNode(CgroupMemory::Version version, const std::string &path)
+                : Stat(std::make_unique<CgroupMemoryStat>(version, path))
+        {
+            for (size_t i = 0; i < CgroupMemoryStat::kFieldCount; i++) {
+                Total.emplace_back("Total_KB");
+                Self.emplace_back("Self_KB");
+            }
+        }
+
+        // Null once the cgroup has been removed
+        std::unique_ptr<CgroupMemoryStat> Stat;
+        // Indexed by CgroupMemoryStat::Field. Total includes every cgroup below this one, Self is what's left once
+        // the children have been taken off
+        std::vector<Measurement> Total;
+        std::vector<Measurement> Self;
+    };
+
+    // Keyed by path relative to the root of the hierarchy, with the root itself as "/"
+    std::map<std::string, cgroupNode> mCgroupNodes;
 
     std::map<std::string, Measurement> mBroadcomBmemMeasurements;
 
+    // zram devices are only looked for once at startup
+    struct zramMeasurement
+    {
+        Measurement Original = Measurement("Original_KB");
+        Measurement Compressed = Measurement("Compressed_KB");
+        Measurement Used = Measurement("Memory_Used_KB");
+        Measurement Limit = Measurement("Memory_Limit_KB");
+        Measurement SamePages = Measurement("Same_Pages");
+        Measurement HugePages = Measurement("Huge_Pages");
+        // Reports are rounded to whole numbers, so scaled up to keep two decimal places
+        Measurement Ratio = Measurement("Compression_Ratio_x100");
+        // Memory that would be needed without zram, minus what zram is actually using
+        Measurement Saved = Measurement("Saved_KB");
+        // Used by the allocator on top of the compressed data itself
+        Measurement Overhead = Measurement("Overhead_KB");
+
+        Measurement FailedReads = Measurement("Failed_Reads");
+        Measurement FailedWrites = Measurement("Failed_Writes");
+        Measurement InvalidIo = Measurement("Invalid_IO");
+        Measurement NotifyFree = Measurement("Notify_Free");
+        Measurement Writeback = Measurement("Writeback_KB");
+        Measurement WritebackReads = Measurement("Writeback_Reads_KB");
+        Measurement WritebackWrites = Measurement("Writeback_Writes_KB");
+    };
+
+    std::vector<ZramDevice> mZramDevices;
+    std::map<std::string, zramMeasurement> mZramMeasurements;
+
+    // zswap statistics come from debugfs if it's mounted, otherwise just the totals from /proc/meminfo
+    struct zswapStat
+    {
+        std::string unit;
+        Measurement value;
+    };
+
+    bool mZswapEnabled;
+    std::map<std::string, std::unique_ptr<IFileHandle>> mZswapFiles;
+    std::map<std::string, zswapStat> mZswapMeasurements;
+
     Measurement mCmaFree;
     Measurement mCmaBorrowed;
     Measurement mMemoryBandwidth;
@@ -143,4 +284,14 @@ private:
     std::map<std::string, std::string> mCmaNames;
 
     std::shared_ptr<JsonReportGenerator> mReportGenerator;
+    std::shared_ptr<SamplePublisher> mSamplePublisher;
+    std::shared_ptr<OverheadTracker> mOverheadTracker;
+
+    // Number of data points each series had when last published, used to only publish values updated this tick
+    std::map<std::string, int> mPublishedCounts;
+
+    // Measurements above are only ever touched by the collection thread - everyone else reads the published
+    // snapshot, which is swapped atomically after each tick and freed when the last reader drops it
+    std::atomic<bool> mResetRequested;
+    std::shared_ptr<const Snapshot> mSnapshot;
 };
@@ -19,14 +19,35 @@
 
 
 #include "Metadata.h"
-#include "Procrank.h"
+#include "CollectionContext.h"
+#include "FileSystem/FileSystem.h"
 
-#include <fstream>
+#include <algorithm>
 #include <sstream>
 #include <chrono>
 #include <iomanip>
 
-Metadata::Metadata() : mDuration(0)
+Metadata::Metadata(const CollectionContext &context)
+        : mPlatform(readPlatform()),
+          mImage(readImage()),
+          mMac(readMac()),
+          mSwapEnabled(context.SwapEnabled()),
+          mDuration(0)
+{
+
+}
+
+/**
+ * @brief Metadata for a capture that was saved previously and is being reported on elsewhere
+ */
+Metadata::Metadata(std::string platform, std::string image, std::string mac, bool swapEnabled,
+                   std::string reportTimestamp, long duration)
+        : mPlatform(std::move(platform)),
+          mImage(std::move(image)),
+          mMac(std::move(mac)),
+          mSwapEnabled(swapEnabled),
+          mReportTimestamp(std::move(reportTimestamp)),
+          mDuration(duration)
 {
 
 }
@@ -38,8 +59,23 @@ void Metadata::SetDuration(long seconds)
 
 std::string Metadata::Platform() const
 {
-    std::ifstream deviceProperties("/etc/device.properties");
-    if (!deviceProperties) {
+    return mPlatform;
+}
+
+std::string Metadata::Image() const
+{
+    return mImage;
+}
+
+std::string Metadata::Mac() const
+{
+    return mMac;
+}
+
+std::string Metadata::readPlatform()
+{
+    std::istringstream deviceProperties;
+    if (!FileSystem::Open("/etc/device.properties", deviceProperties)) {
         return "Unknown";
     }
 
@@ -61,10 +97,10 @@ std::string Metadata::Platform() const
     return "Unknown";
 }
 
-std::string Metadata::Image() const
+std::string Metadata::readImage()
 {
-    std::ifstream versionFile("/version.txt");
-    if (!versionFile) {
+    std::istringstream versionFile;
+    if (!FileSystem::Open("/version.txt", versionFile)) {
         return "Unknown";
     }
 
@@ -80,17 +116,13 @@ std::string Metadata::Image() const
     return "Unknown";
 }
 
-std::string Metadata::Mac() const
+std::string Metadata::readMac()
 {
-    std::ifstream macFile("/sys/class/net/eth0/address");
-    if (!macFile) {
+    std::string macStr;
+    if (!FileSystem::Get().ReadFile("/sys/class/net/eth0/address", macStr)) {
         return "Unknown";
     }
 
-    std::stringstream buffer;
-    buffer << macFile.rdbuf();
-
-    std::string macStr = buffer.str();
     // Remove trailing \n
     macStr.erase(std::remove(macStr.begin(), macStr.end(), '\n'), macStr.cend());
     return macStr;
@@ -98,6 +130,10 @@ std::string Metadata::Mac() const
 
 std::string Metadata::ReportTimestamp() const
 {
+    if (!mReportTimestamp.empty()) {
+        return mReportTimestamp;
+    }
+
     std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
     std::stringstream timeStream;
     timeStream << std::put_time( std::localtime( &t ), "%FT%T%z" );
@@ -112,6 +148,5 @@ long Metadata::Duration() const
 
 bool Metadata::SwapEnabled() const
 {
-    Procrank procrank;
-    return procrank.swapTotalKb() > 0;
+    return mSwapEnabled;
 }
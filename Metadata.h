@@ -22,6 +22,8 @@
 
 #include <string>
 
+class CollectionContext;
+
 /**
  * @brief Information about the device we're running on and the capture session.
  *
@@ -30,7 +32,10 @@
 class Metadata
 {
 public:
-    Metadata();
+    explicit Metadata(const CollectionContext &context);
+
+    Metadata(std::string platform, std::string image, std::string mac, bool swapEnabled, std::string reportTimestamp,
+             long duration);
 
     void SetDuration(long seconds);
 
@@ -42,5 +47,19 @@ public:
     long Duration() const;
 
 private:
+    static std::string readPlatform();
+    static std::string readImage();
+    static std::string readMac();
+
+private:
+    // Doesn't change during a capture, so read once up front
+    std::string mPlatform;
+    std::string mImage;
+    std::string mMac;
+    bool mSwapEnabled;
+
+    // Empty if the report is being generated live, so the current time is used
+    std::string mReportTimestamp;
+
     long mDuration;
 };
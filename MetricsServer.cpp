@@ -0,0 +1,546 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MetricsServer.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const std::string gNotFoundResponse = "HTTP/1.1 404 Not Found\r\n"
+                                             "Content-Type: text/plain\r\n"
+                                             "Content-Length: 10\r\n"
+                                             "Connection: close\r\n\r\n"
+                                             "Not Found\n";
+
+static std::shared_ptr<const std::string> buildResponse(const std::string &body)
+{
+    std::string response = "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n";
+    response += body;
+
+    return std::make_shared<const std::string>(std::move(response));
+}
+
+/**
+ * @param listenAddress Either a TCP port number to listen on localhost, or the path to a Unix socket
+ * @param groupManager If set, also export the total PSS for each group
+ */
+MetricsServer::MetricsServer(std::string listenAddress, std::optional<std::shared_ptr<GroupManager>> groupManager)
+        : mListenAddress(std::move(listenAddress)),
+          mGroupManager(std::move(groupManager)),
+          mListenFd(-1),
+          mWakeFd(-1),
+          mIsUnixSocket(false),
+          mQuit(false),
+          mResponse(buildResponse(""))
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    Stop();
+}
+
+bool MetricsServer::Start()
+{
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mWakeFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to create eventfd");
+        return false;
+    }
+
+    if (!listen()) {
+        return false;
+    }
+
+    mQuit = false;
+    mServerThread = std::thread(&MetricsServer::Serve, this);
+    return true;
+}
+
+void MetricsServer::Stop()
+{
+    std::unique_lock<std::mutex> locker(mLock);
+    mQuit = true;
+    locker.unlock();
+
+    if (mServerThread.joinable()) {
+        LOG_INFO("Waiting for metrics server thread to terminate");
+        uint64_t wake = 1;
+        if (write(mWakeFd, &wake, sizeof(wake)) < 0) {
+            LOG_SYS_ERROR(errno, "Failed to wake metrics server thread");
+        }
+        mServerThread.join();
+    }
+
+    if (mListenFd >= 0) {
+        close(mListenFd);
+        mListenFd = -1;
+
+        if (mIsUnixSocket) {
+            unlink(mListenAddress.c_str());
+        }
+    }
+
+    locker.lock();
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+        mWakeFd = -1;
+    }
+}
+
+/**
+ * @brief Queue a tick to be merged into the served metrics. Does not block on any IO
+ */
+void MetricsServer::AddTick(const std::shared_ptr<const TickSamples> &tick)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    if (mWakeFd < 0) {
+        return;
+    }
+    mQueue.emplace_back(tick);
+
+    uint64_t wake = 1;
+    if (write(mWakeFd, &wake, sizeof(wake)) < 0 && errno != EAGAIN) {
+        LOG_SYS_ERROR(errno, "Failed to wake metrics server thread");
+    }
+}
+
+bool MetricsServer::listen()
+{
+    // Anything that's entirely digits is a port number, anything else is a socket path
+    mIsUnixSocket = mListenAddress.empty() ||
+                    mListenAddress.find_first_not_of("0123456789") != std::string::npos;
+
+    if (mIsUnixSocket) {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+
+        if (mListenAddress.empty() || mListenAddress.size() >= sizeof(addr.sun_path)) {
+            LOG_ERROR("Invalid metrics socket path '%s'", mListenAddress.c_str());
+            return false;
+        }
+        strncpy(addr.sun_path, mListenAddress.c_str(), sizeof(addr.sun_path) - 1);
+
+        mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (mListenFd < 0) {
+            LOG_SYS_ERROR(errno, "Failed to create metrics socket");
+            return false;
+        }
+
+        // Clean up after a previous instance that didn't exit cleanly
+        unlink(mListenAddress.c_str());
+
+        if (bind(mListenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+            LOG_SYS_ERROR(errno, "Failed to bind metrics socket to %s", mListenAddress.c_str());
+            return false;
+        }
+    } else {
+        int port = std::stoi(mListenAddress);
+        if (port <= 0 || port > 65535) {
+            LOG_ERROR("Invalid metrics port %d", port);
+            return false;
+        }
+
+        mListenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (mListenFd < 0) {
+            LOG_SYS_ERROR(errno, "Failed to create metrics socket");
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        // Only listen on localhost - this isn't meant to be exposed off the device
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(mListenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+            LOG_SYS_ERROR(errno, "Failed to bind metrics server to port %d", port);
+            return false;
+        }
+    }
+
+    if (::listen(mListenFd, 8) < 0) {
+        LOG_SYS_ERROR(errno, "Failed to listen on metrics socket");
+        return false;
+    }
+
+    LOG_INFO("Serving metrics on %s%s", mIsUnixSocket ? "" : "127.0.0.1:", mListenAddress.c_str());
+    return true;
+}
+
+void MetricsServer::Serve()
+{
+    struct pollfd fds[2] = {
+            {mWakeFd,   POLLIN, 0},
+            {mListenFd, POLLIN, 0}
+    };
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_SYS_ERROR(errno, "Metrics server poll failed");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(mWakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                LOG_SYS_ERROR(errno, "Failed to read metrics server eventfd");
+            }
+
+            std::unique_lock<std::mutex> locker(mLock);
+            if (mQuit) {
+                break;
+            }
+            auto queue = std::move(mQueue);
+            mQueue.clear();
+            locker.unlock();
+
+            if (!queue.empty()) {
+                for (const auto &tick: queue) {
+                    updateState(*tick);
+                }
+
+                std::atomic_store(&mResponse, serialise());
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int clientFd = accept4(mListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (clientFd < 0) {
+                if (errno != EINTR && errno != EAGAIN) {
+                    LOG_SYS_ERROR(errno, "Failed to accept metrics connection");
+                }
+                continue;
+            }
+
+            handleClient(clientFd);
+            close(clientFd);
+        }
+    }
+
+    LOG_INFO("Metrics server thread quit");
+}
+
+/**
+ * @brief Read the request line and send the current metrics (or a 404)
+ */
+void MetricsServer::handleClient(int clientFd)
+{
+    // Don't let a client that never sends anything hold up the next scrape
+    struct timeval timeout = {1, 0};
+    setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[1024];
+    size_t received = 0;
+
+    while (received < sizeof(request) - 1) {
+        ssize_t ret = recv(clientFd, request + received, sizeof(request) - 1 - received, 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            break;
+        }
+        received += ret;
+        request[received] = '\0';
+
+        // Only care about the request line
+        if (strstr(request, "\r\n") != nullptr) {
+            break;
+        }
+    }
+    request[received] = '\0';
+
+    const std::string *toSend = &gNotFoundResponse;
+
+    auto response = std::atomic_load(&mResponse);
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        toSend = response.get();
+    }
+
+    size_t sent = 0;
+    while (sent < toSend->size()) {
+        ssize_t ret = send(clientFd, toSend->data() + sent, toSend->size() - sent, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            LOG_WARN("Failed to send metrics to client");
+            break;
+        }
+        sent += ret;
+    }
+}
+
+// How many publishes of a dataset a series can be missing from before it's treated as gone
+static constexpr int kMissedPublishes = 3;
+
+/**
+ * @brief Merge a tick into the latest values. Process ticks replace the full process list.
+ *
+ * Metrics only publish the measurements that were sampled in the tick, which isn't every row every time (e.g. a counter
+ * that wrapped, or a stall total that needs two reads), so each series is merged in on its own. A series is only
+ * dropped once its dataset has been published several times without it - the process exited, the cgroup was removed
+ * etc. Appended rows (events) don't describe the current state of a table, so are kept until a new value arrives
+ */
+void MetricsServer::updateState(const TickSamples &tick)
+{
+    if (!tick.processes.empty()) {
+        mProcesses = tick.processes;
+    }
+
+    mLatestTick = std::max(mLatestTick, tick.timestamp);
+
+    std::map<std::string, bool> seenDatasets;
+    for (const auto &sample: tick.datasets) {
+        std::string key;
+        for (const auto &label: sample.labels) {
+            key.append(label.second).append(1, '\0');
+        }
+        key.append(sample.measurement);
+
+        auto &values = mDatasetValues[sample.dataset];
+        values.series[key] = seriesValue{sample, tick.timestamp};
+        seenDatasets[sample.dataset] = sample.layout.row == DatasetLayout::kAppendRow;
+    }
+
+    for (const auto &dataset: seenDatasets) {
+        auto &values = mDatasetValues[dataset.first];
+        if (values.lastSeen.time_since_epoch().count() > 0 && tick.timestamp > values.lastSeen) {
+            values.interval = tick.timestamp - values.lastSeen;
+        }
+        values.lastSeen = std::max(values.lastSeen, tick.timestamp);
+
+        // Events never go stale
+        if (dataset.second) {
+            values.interval = std::chrono::system_clock::duration::zero();
+        }
+    }
+
+    // Checked on every tick rather than just ticks carrying the dataset, so a dataset that stops being published
+    // entirely (the last container went away) still gets cleared out
+    for (auto dataset = mDatasetValues.begin(); dataset != mDatasetValues.end();) {
+        auto &values = dataset->second;
+        if (values.interval.count() > 0) {
+            const auto cutoff = mLatestTick - kMissedPublishes * values.interval;
+            for (auto series = values.series.begin(); series != values.series.end();) {
+                if (series->second.lastSeen < cutoff) {
+                    series = values.series.erase(series);
+                } else {
+                    ++series;
+                }
+            }
+        }
+
+        if (values.series.empty()) {
+            dataset = mDatasetValues.erase(dataset);
+        } else {
+            ++dataset;
+        }
+    }
+}
+
+/**
+ * @brief Build the full scrape response from the latest values
+ */
+std::shared_ptr<const std::string> MetricsServer::serialise() const
+{
+    std::ostringstream body;
+    body.precision(15);
+
+    auto writeProcessMetric = [&](const char *name, const char *help,
+                                  uint64_t Procrank::ProcessMemoryUsage::*value)
+    {
+        body << "# HELP memcapture_process_" << name << "_bytes " << help << "\n";
+        body << "# TYPE memcapture_process_" << name << "_bytes gauge\n";
+
+        for (const auto &process: mProcesses) {
+            std::string group;
+            if (mGroupManager.has_value()) {
+                group = process.process.group(mGroupManager.value()).value_or("");
+            }
+
+            body << "memcapture_process_" << name << "_bytes{pid=\"" << process.process.pid()
+                 << "\",name=\"" << escapeLabelValue(process.process.name())
+                 << "\",group=\"" << escapeLabelValue(group)
+                 << "\",service=\"" << escapeLabelValue(process.process.systemdService().value_or(""))
+                 << "\",container=\"" << escapeLabelValue(process.process.container().value_or(""))
+                 << "\"} " << (process.*value) * 1024 << "\n";
+        }
+    };
+
+    writeProcessMetric("pss", "Proportional set size of the process", &Procrank::ProcessMemoryUsage::pss);
+    writeProcessMetric("rss", "Resident set size of the process", &Procrank::ProcessMemoryUsage::rss);
+    writeProcessMetric("uss", "Unique set size of the process", &Procrank::ProcessMemoryUsage::uss);
+    writeProcessMetric("vss", "Virtual set size of the process", &Procrank::ProcessMemoryUsage::vss);
+    writeProcessMetric("swap", "Swap used by the process", &Procrank::ProcessMemoryUsage::swap);
+    writeProcessMetric("swap_pss", "Proportional swap used by the process", &Procrank::ProcessMemoryUsage::swap_pss);
+    writeProcessMetric("swap_zram", "Zram used by the process", &Procrank::ProcessMemoryUsage::swap_zram);
+    writeProcessMetric("locked", "Locked memory of the process", &Procrank::ProcessMemoryUsage::locked);
+
+    if (mGroupManager.has_value()) {
+        std::map<std::string, uint64_t> groupPss;
+        for (const auto &process: mProcesses) {
+            auto group = process.process.group(mGroupManager.value());
+            if (group.has_value()) {
+                groupPss[group.value()] += process.pss;
+            }
+        }
+
+        body << "# HELP memcapture_group_pss_bytes Total proportional set size of all processes in the group\n";
+        body << "# TYPE memcapture_group_pss_bytes gauge\n";
+        for (const auto &group: groupPss) {
+            body << "memcapture_group_pss_bytes{group=\"" << escapeLabelValue(group.first) << "\"} "
+                 << group.second * 1024 << "\n";
+        }
+    }
+
+    // Everything else comes from the metric datasets (meminfo, CMA, GPU, fragmentation etc). Group by metric name so
+    // each metric only has a single TYPE line
+    std::map<std::string, std::string> families;
+    for (const auto &dataset: mDatasetValues) {
+        for (const auto &item: dataset.second.series) {
+            const auto &sample = item.second.sample;
+
+            double scale = 1;
+            const std::string name = metricName(sample.dataset, sample.measurement, scale);
+
+            std::ostringstream line;
+            line.precision(15);
+            line << name;
+
+            if (!sample.labels.empty()) {
+                line << "{";
+                for (size_t i = 0; i < sample.labels.size(); i++) {
+                    // Rows with a unit column (meminfo, zswap) are converted to bytes below, same as the _KB columns
+                    std::string value = sample.labels[i].second;
+                    if (sample.labels[i].first == "Unit" && value == "KB") {
+                        value = "bytes";
+                        scale = 1024;
+                    }
+
+                    line << (i > 0 ? "," : "") << labelName(sample.labels[i].first) << "=\""
+                         << escapeLabelValue(value) << "\"";
+                }
+                line << "}";
+            }
+            line << " " << static_cast<double>(sample.value) * scale << "\n";
+
+            families[name] += line.str();
+        }
+    }
+
+    for (const auto &family: families) {
+        body << "# TYPE " << family.first << " gauge\n" << family.second;
+    }
+
+    return buildResponse(body.str());
+}
+
+/**
+ * @brief Convert a dataset and measurement name into a valid Prometheus metric name
+ *
+ * Everything is exported in bytes to match the process metrics, so KB measurements are renamed and scaled
+ * e.g. "Linux Memory" + "Value_KB" -> "memcapture_linux_memory_value_bytes"
+ *
+ * @param[out] scale What to multiply the values by
+ */
+std::string MetricsServer::metricName(const std::string &dataset, const std::string &measurement, double &scale)
+{
+    std::string name = "memcapture_" + labelName(dataset) + "_" + labelName(measurement);
+
+    static const std::string kbSuffix = "_kb";
+    if (name.size() > kbSuffix.size() && name.compare(name.size() - kbSuffix.size(), kbSuffix.size(), kbSuffix) == 0) {
+        name.replace(name.size() - kbSuffix.size(), kbSuffix.size(), "_bytes");
+        scale = 1024;
+    } else {
+        scale = 1;
+    }
+
+    return name;
+}
+
+/**
+ * @brief Convert a name into something valid as a Prometheus label name (lowercase letters, numbers and underscores)
+ */
+std::string MetricsServer::labelName(const std::string &name)
+{
+    std::string result;
+    result.reserve(name.size());
+
+    for (const auto c: name) {
+        if (std::isalnum(static_cast<unsigned char>(c))) {
+            result += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        } else if (!result.empty() && result.back() != '_') {
+            result += '_';
+        }
+    }
+
+    while (!result.empty() && result.back() == '_') {
+        result.pop_back();
+    }
+
+    if (result.empty() || std::isdigit(static_cast<unsigned char>(result.front()))) {
+        result.insert(0, "_");
+    }
+
+    return result;
+}
+
+std::string MetricsServer::escapeLabelValue(const std::string &value)
+{
+    std::string result;
+    result.reserve(value.size());
+
+    for (const auto c: value) {
+        switch (c) {
+            case '\\':
+                result += "\\\\";
+                break;
+            case '"':
+                result += "\\\"";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            default:
+                result += c;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,110 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ISampleSink.h"
+#include "GroupManager.h"
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Serves the most recent values collected by MemCapture in the Prometheus text exposition format
+ *
+ * Listens on either a localhost TCP port or a Unix socket. Every tick is handed off to the server thread, which merges
+ * it into the latest known values and serialises the complete HTTP response into a new buffer, then swaps it in
+ * atomically. Scrapes just send whatever buffer is current, so they never wait for (or slow down) collection.
+ *
+ * Can be tested with curl:
+ *     curl http://127.0.0.1:<port>/metrics
+ *     curl --unix-socket <path> http://localhost/metrics
+ */
+class MetricsServer : public ISampleSink
+{
+public:
+    MetricsServer(std::string listenAddress, std::optional<std::shared_ptr<GroupManager>> groupManager);
+
+    ~MetricsServer() override;
+
+    bool Start();
+
+    void Stop();
+
+    void AddTick(const std::shared_ptr<const TickSamples> &tick) override;
+
+private:
+    void Serve();
+
+    bool listen();
+
+    void handleClient(int clientFd);
+
+    void updateState(const TickSamples &tick);
+
+    std::shared_ptr<const std::string> serialise() const;
+
+    static std::string metricName(const std::string &dataset, const std::string &measurement, double &scale);
+
+    static std::string labelName(const std::string &name);
+
+    static std::string escapeLabelValue(const std::string &value);
+
+private:
+    const std::string mListenAddress;
+    const std::optional<std::shared_ptr<GroupManager>> mGroupManager;
+
+    int mListenFd;
+    int mWakeFd;
+    bool mIsUnixSocket;
+
+    std::thread mServerThread;
+    std::mutex mLock;
+    bool mQuit;
+    std::deque<std::shared_ptr<const TickSamples>> mQueue;
+
+    // Latest values, only touched by the server thread
+    std::vector<Procrank::ProcessMemoryUsage> mProcesses;
+    struct seriesValue
+    {
+        DatasetSample sample;
+        std::chrono::system_clock::time_point lastSeen;
+    };
+
+    struct datasetValues
+    {
+        std::chrono::system_clock::time_point lastSeen;
+        // Time between the last two ticks that carried this dataset
+        std::chrono::system_clock::duration interval{0};
+        // Series key -> latest sample
+        std::map<std::string, seriesValue> series;
+    };
+
+    std::chrono::system_clock::time_point mLatestTick;
+    std::map<std::string, datasetValues> mDatasetValues;
+
+    // Complete HTTP response for a scrape. Only ever replaced with std::atomic_store, never modified
+    std::shared_ptr<const std::string> mResponse;
+};
@@ -0,0 +1,353 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "OverheadTracker.h"
+#include "FileSystem/IFileSystem.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+
+OverheadTracker::OverheadTracker()
+        : mHaveProcessSample(false),
+          mLastProcessCpu(0),
+          mLastProcessReadBytes(0),
+          mLastProcessReadSyscalls(0),
+          mLastProcessFilesOpened(0),
+          mPss("Value_KB"),
+          mRss("Value_KB")
+{
+
+}
+
+OverheadTracker::collectorOverhead::collectorOverhead()
+        : CpuTime("CPU_ms"),
+          ReadKb("Read_KB"),
+          ReadSyscalls("Read_Syscalls"),
+          FilesOpened("Files_Opened")
+{
+
+}
+
+OverheadTracker::Scope::Scope(OverheadTracker &tracker, std::string collector)
+        : mTracker(tracker),
+          mCollector(std::move(collector)),
+          mStart(std::chrono::steady_clock::now()),
+          mCpuStart(threadCpuTime()),
+          mIoValid(false),
+          mReadBytesStart(0),
+          mReadSyscallsStart(0),
+          mFilesOpenedStart(IFileSystem::FilesOpened())
+{
+    size_t fileSize = 0;
+    mIoValid = readIoCounters(threadIoPath(), mReadBytesStart, mReadSyscallsStart, &fileSize);
+
+    // Reading the counters is itself a read - don't count it against the collector
+    mReadBytesStart += fileSize;
+    mReadSyscallsStart += 1;
+}
+
+OverheadTracker::Scope::~Scope()
+{
+    uint64_t readBytes = 0;
+    uint64_t readSyscalls = 0;
+
+    // The kernel may not have been built with task I/O accounting, in which case only CPU time is known
+    if (mIoValid && readIoCounters(threadIoPath(), readBytes, readSyscalls)) {
+        readBytes -= mReadBytesStart;
+        readSyscalls -= mReadSyscallsStart;
+    } else {
+        readBytes = 0;
+        readSyscalls = 0;
+    }
+
+    mTracker.addSample(mCollector, std::chrono::steady_clock::now() - mStart, threadCpuTime() - mCpuStart,
+                       readBytes, readSyscalls, IFileSystem::FilesOpened() - mFilesOpenedStart);
+}
+
+/**
+ * @brief Start tracking the overhead of a collector. Everything done on this thread until the returned scope is
+ * destroyed is counted against the collector
+ */
+OverheadTracker::Scope OverheadTracker::Track(std::string collector)
+{
+    return Scope(*this, std::move(collector));
+}
+
+/**
+ * @brief Record MemCapture's own memory usage, along with the CPU and I/O used by the whole process since the last
+ * time this was called
+ *
+ * @param pssKb PSS of the MemCapture process
+ * @param rssKb RSS of the MemCapture process
+ */
+void OverheadTracker::RecordProcess(long double pssKb, long double rssKb)
+{
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    auto cpu = std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+               std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+
+    uint64_t readBytes = 0;
+    uint64_t readSyscalls = 0;
+    readIoCounters("/proc/self/io", readBytes, readSyscalls);
+    const uint64_t filesOpened = IFileSystem::TotalFilesOpened();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    mPss.AddDataPoint(pssKb);
+    mRss.AddDataPoint(rssKb);
+
+    // Need two samples to work out how much was used in between
+    if (mHaveProcessSample) {
+        mProcess.CpuTime.AddDataPoint(
+                std::chrono::duration<long double, std::milli>(cpu - mLastProcessCpu).count());
+        mProcess.ReadKb.AddDataPoint((readBytes - mLastProcessReadBytes) / 1024.0L);
+        mProcess.ReadSyscalls.AddDataPoint(readSyscalls - mLastProcessReadSyscalls);
+        mProcess.FilesOpened.AddDataPoint(filesOpened - mLastProcessFilesOpened);
+    }
+
+    mHaveProcessSample = true;
+    mLastProcessCpu = cpu;
+    mLastProcessReadBytes = readBytes;
+    mLastProcessReadSyscalls = readSyscalls;
+    mLastProcessFilesOpened = filesOpened;
+}
+
+/**
+ * @brief Record how long something took, to include in the latency percentiles
+ *
+ * @param source Name of the thing that was timed. Collectors tracked with Track() are timed automatically
+ * @param latency How long it took
+ */
+void OverheadTracker::RecordLatency(const std::string &source, std::chrono::nanoseconds latency)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    mLatencies[source].Record(latency);
+}
+
+/**
+ * @brief Count ticks a collector skipped because it was still busy with an earlier one when they were due
+ */
+void OverheadTracker::RecordMissedTicks(const std::string &source, uint64_t count)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    mMissedTicks[source] += count;
+}
+
+void OverheadTracker::Reset()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    mCollectors.clear();
+    mLatencies.clear();
+    mMissedTicks.clear();
+    mHaveProcessSample = false;
+    mProcess = collectorOverhead();
+    mPss = Measurement(mPss.GetName());
+    mRss = Measurement(mRss.GetName());
+}
+
+/**
+ * @param[out] latencySamples If set, filled with the "MemCapture Latency" and "MemCapture Missed Ticks" values as
+ * samples. They're plain text in the dataset so can't be published from it like everything else
+ *
+ * @return The "MemCapture Overhead" dataset (cost of each collector, and the whole process, per tick), the
+ * "MemCapture Memory" dataset, the "MemCapture Latency" dataset and the "MemCapture Missed Ticks" dataset
+ */
+std::vector<JsonReportGenerator::dataset> OverheadTracker::GetDatasets(std::vector<DatasetSample> *latencySamples) const
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    std::vector<JsonReportGenerator::dataset> datasets;
+    std::vector<JsonReportGenerator::dataItems> data{};
+
+    for (const auto &collector: mCollectors) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Collector", collector.first),
+                collector.second.CpuTime,
+                collector.second.ReadKb,
+                collector.second.ReadSyscalls,
+                collector.second.FilesOpened
+        });
+    }
+
+    if (mProcess.CpuTime.GetCount() > 0) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Collector", "Total (whole process)"),
+                mProcess.CpuTime,
+                mProcess.ReadKb,
+                mProcess.ReadSyscalls,
+                mProcess.FilesOpened
+        });
+    }
+
+    datasets.emplace_back("MemCapture Overhead", std::move(data));
+    data.clear();
+
+    if (mPss.GetCount() > 0) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Value", "PSS"),
+                mPss
+        });
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Value", "RSS"),
+                mRss
+        });
+    }
+    datasets.emplace_back("MemCapture Memory", std::move(data));
+    data.clear();
+
+    // Percentiles come from the histogram rather than a series of values, so are added as plain columns
+    auto formatMs = [](std::chrono::microseconds us)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.2f", us.count() / 1000.0);
+        return std::string(buffer);
+    };
+
+    for (const auto &latency: mLatencies) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Source", latency.first),
+                std::make_pair("Count", std::to_string(latency.second.GetCount())),
+                std::make_pair("P50_ms", formatMs(latency.second.GetPercentile(50))),
+                std::make_pair("P99_ms", formatMs(latency.second.GetPercentile(99))),
+                std::make_pair("Max_ms", formatMs(latency.second.GetMax()))
+        });
+
+        // The same values as samples, so they can be streamed out live alongside everything else
+        if (latencySamples) {
+            const std::vector<std::pair<std::string, std::string>> labels{{"Source", latency.first}};
+            const auto row = static_cast<uint32_t>(data.size() - 1);
+
+            auto addSample = [&](const std::string &name, uint16_t column, long double value, int8_t decimals)
+            {
+                DatasetLayout layout;
+                layout.row = row;
+                layout.column = column;
+                layout.latestDecimals = decimals;
+                latencySamples->emplace_back(DatasetSample{"MemCapture Latency", labels, name, value, layout});
+            };
+
+            addSample("Count", 1, latency.second.GetCount(), 0);
+            addSample("P50_ms", 2, latency.second.GetPercentile(50).count() / 1000.0L, 2);
+            addSample("P99_ms", 3, latency.second.GetPercentile(99).count() / 1000.0L, 2);
+            addSample("Max_ms", 4, latency.second.GetMax().count() / 1000.0L, 2);
+        }
+    }
+    datasets.emplace_back("MemCapture Latency", std::move(data));
+    data.clear();
+
+    for (const auto &missed: mMissedTicks) {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Source", missed.first),
+                std::make_pair("Count", std::to_string(missed.second))
+        });
+
+        if (latencySamples) {
+            DatasetLayout layout;
+            layout.row = static_cast<uint32_t>(data.size() - 1);
+            layout.column = 1;
+            layout.latestDecimals = 0;
+            latencySamples->emplace_back(DatasetSample{"MemCapture Missed Ticks", {{"Source", missed.first}}, "Count",
+                                                       static_cast<long double>(missed.second), layout});
+        }
+    }
+    datasets.emplace_back("MemCapture Missed Ticks", std::move(data));
+
+    return datasets;
+}
+
+void OverheadTracker::addSample(const std::string &collector, std::chrono::nanoseconds wallTime,
+                                std::chrono::nanoseconds cpuTime, uint64_t readBytes, uint64_t readSyscalls,
+                                uint64_t filesOpened)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    mLatencies[collector].Record(wallTime);
+
+    auto &overhead = mCollectors[collector];
+    overhead.CpuTime.AddDataPoint(std::chrono::duration<long double, std::milli>(cpuTime).count());
+    overhead.ReadKb.AddDataPoint(readBytes / 1024.0L);
+    overhead.ReadSyscalls.AddDataPoint(readSyscalls);
+    overhead.FilesOpened.AddDataPoint(filesOpened);
+}
+
+std::chrono::nanoseconds OverheadTracker::threadCpuTime()
+{
+    struct timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+/**
+ * @brief Read the bytes read and number of read syscalls from a procfs io file
+ *
+ * rchar counts everything read, including from procfs/sysfs which is where nearly all of our reads go (read_bytes
+ * only counts what actually hit the block layer).
+ *
+ * Uses a single read() so the cost of reading the counters is known exactly and can be taken off again
+ *
+ * @param[out] fileSize Number of bytes read from the file
+ */
+bool OverheadTracker::readIoCounters(const std::string &path, uint64_t &readBytes, uint64_t &readSyscalls,
+                                     size_t *fileSize)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    char buffer[512];
+    auto size = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+
+    if (size <= 0) {
+        return false;
+    }
+    buffer[size] = '\0';
+
+    if (fileSize) {
+        *fileSize = size;
+    }
+
+    const char *rchar = strstr(buffer, "rchar:");
+    const char *syscr = strstr(buffer, "syscr:");
+    if (!rchar || !syscr) {
+        return false;
+    }
+
+    readBytes = strtoull(rchar + strlen("rchar:"), nullptr, 10);
+    readSyscalls = strtoull(syscr + strlen("syscr:"), nullptr, 10);
+    return true;
+}
+
+std::string OverheadTracker::threadIoPath()
+{
+    // /proc/thread-self only exists from 3.17, which is newer than some of the kernels we run on
+    return "/proc/self/task/" + std::to_string(syscall(SYS_gettid)) + "/io";
+}
@@ -0,0 +1,123 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ISampleSink.h"
+#include "JsonReportGenerator.h"
+#include "LatencyHistogram.h"
+#include "Measurement.h"
+
+/**
+ * @brief Keeps track of how much MemCapture itself costs the device it's measuring
+ *
+ * Each collector wraps its work in a Scope, which records the CPU time, read I/O and files opened by the calling thread
+ * while it was alive. Since every metric runs on its own thread the numbers aren't polluted by the other collectors.
+ *
+ * The process metric also records MemCapture's own PSS/RSS each tick, as that is excluded from the process list
+ * and the accounting totals.
+ *
+ * How long each collector (and anything else timed with RecordLatency, such as individual smaps reads or how late a
+ * tick started) takes is kept in a histogram so the p50/p99/max can be reported without keeping every value. Ticks a
+ * collector had to skip because the previous one overran are counted with RecordMissedTicks
+ */
+class OverheadTracker
+{
+public:
+    OverheadTracker();
+
+    class Scope
+    {
+    public:
+        Scope(OverheadTracker &tracker, std::string collector);
+
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        OverheadTracker &mTracker;
+        const std::string mCollector;
+
+        std::chrono::steady_clock::time_point mStart;
+        std::chrono::nanoseconds mCpuStart;
+        bool mIoValid;
+        uint64_t mReadBytesStart;
+        uint64_t mReadSyscallsStart;
+        uint64_t mFilesOpenedStart;
+    };
+
+    Scope Track(std::string collector);
+
+    void RecordProcess(long double pssKb, long double rssKb);
+
+    void RecordLatency(const std::string &source, std::chrono::nanoseconds latency);
+
+    void RecordMissedTicks(const std::string &source, uint64_t count);
+
+    void Reset();
+
+    std::vector<JsonReportGenerator::dataset> GetDatasets(std::vector<DatasetSample> *latencySamples = nullptr) const;
+
+private:
+    struct collectorOverhead
+    {
+        collectorOverhead();
+
+        Measurement CpuTime;
+        Measurement ReadKb;
+        Measurement ReadSyscalls;
+        Measurement FilesOpened;
+    };
+
+    void addSample(const std::string &collector, std::chrono::nanoseconds wallTime, std::chrono::nanoseconds cpuTime,
+                   uint64_t readBytes, uint64_t readSyscalls, uint64_t filesOpened);
+
+    static std::chrono::nanoseconds threadCpuTime();
+
+    static bool readIoCounters(const std::string &path, uint64_t &readBytes, uint64_t &readSyscalls,
+                               size_t *fileSize = nullptr);
+
+    static std::string threadIoPath();
+
+private:
+    mutable std::mutex mLock;
+
+    std::map<std::string, collectorOverhead> mCollectors;
+    std::map<std::string, LatencyHistogram> mLatencies;
+    std::map<std::string, uint64_t> mMissedTicks;
+
+    // Whole process, sampled each time the process metric sees us
+    bool mHaveProcessSample;
+    std::chrono::nanoseconds mLastProcessCpu;
+    uint64_t mLastProcessReadBytes;
+    uint64_t mLastProcessReadSyscalls;
+    uint64_t mLastProcessFilesOpened;
+    collectorOverhead mProcess;
+
+    Measurement mPss;
+    Measurement mRss;
+};
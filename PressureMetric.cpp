@@ -0,0 +1,441 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "PressureMetric.h"
+#include "Log.h"
+#include "FileSystem/FileSystem.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+    const std::string kSystemPressure = "/proc/pressure/memory";
+
+    // cgroup v2 puts memory.pressure in each cgroup under the root, kernels with PSI for cgroup v1 put it in the
+    // memory controller hierarchy
+    const std::vector<std::string> kCgroupRoots = {"/sys/fs/cgroup", "/sys/fs/cgroup/memory"};
+
+    // Raise an event if tasks are stalled on memory for more than this percentage of a trigger window. The kernel
+    // raises at most one event per window, so use the shortest one it allows - without CAP_SYS_RESOURCE the window
+    // has to be a multiple of 2 seconds
+    const std::vector<unsigned int> kTriggerWindowsUs = {1000000, 2000000};
+    constexpr unsigned int kSomeThresholdPercent = 10;
+    constexpr unsigned int kFullThresholdPercent = 5;
+
+    std::string formatDouble(double value)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.2f", value);
+        return buffer;
+    }
+}
+
+PressureMetric::PressureMetric(std::shared_ptr<JsonReportGenerator> reportGenerator,
+                               std::shared_ptr<SamplePublisher> samplePublisher,
+                               std::shared_ptr<OverheadTracker> overheadTracker,
+                               bool enableTriggers)
+        : mQuit(false),
+          mCv(),
+          mResetRequested(false),
+          mTriggersEnabled(enableTriggers),
+          mWakeFd(-1),
+          mSnapshot(std::make_shared<Snapshot>()),
+          mReportGenerator(std::move(reportGenerator)),
+          mSamplePublisher(std::move(samplePublisher)),
+          mOverheadTracker(std::move(overheadTracker))
+{
+
+}
+
+PressureMetric::~PressureMetric()
+{
+    if (!mQuit) {
+        StopCollection();
+    }
+}
+
+void PressureMetric::StartCollection(const std::chrono::seconds frequency)
+{
+    mQuit = false;
+    mCollectionThread = std::thread(&PressureMetric::CollectData, this, frequency);
+
+    if (!mTriggersEnabled) {
+        return;
+    }
+
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mWakeFd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to create eventfd");
+        return;
+    }
+
+    if (openTrigger("some", kSomeThresholdPercent) && openTrigger("full", kFullThresholdPercent)) {
+        mTriggerThread = std::thread(&PressureMetric::WatchTriggers, this);
+    } else {
+        LOG_WARN("Memory pressure triggers not supported, short stalls between ticks will not be recorded");
+        closeTriggers();
+    }
+}
+
+void PressureMetric::StopCollection()
+{
+    std::unique_lock<std::mutex> locker(mLock);
+    mQuit = true;
+    mCv.notify_all();
+    locker.unlock();
+
+    if (mCollectionThread.joinable()) {
+        LOG_INFO("Waiting for PressureMetric collection thread to terminate");
+        mCollectionThread.join();
+    }
+
+    if (mTriggerThread.joinable()) {
+        uint64_t wake = 1;
+        if (write(mWakeFd, &wake, sizeof(wake)) < 0) {
+            LOG_SYS_ERROR(errno, "Failed to wake pressure trigger thread");
+        }
+        mTriggerThread.join();
+    }
+
+    closeTriggers();
+}
+
+void PressureMetric::SaveResults()
+{
+    for (const auto &dataset: GetSnapshot()->datasets) {
+        mReportGenerator->addDataset(dataset.first, dataset.second);
+    }
+}
+
+/**
+ * @brief Discard the results collected so far
+ *
+ * The collection thread owns the results, so this just asks it to clear them before the next tick
+ */
+void PressureMetric::ResetResults()
+{
+    mResetRequested = true;
+    std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(std::make_shared<Snapshot>()));
+}
+
+std::shared_ptr<const PressureMetric::Snapshot> PressureMetric::GetSnapshot() const
+{
+    return std::atomic_load(&mSnapshot);
+}
+
+void PressureMetric::CollectData(std::chrono::seconds frequency)
+{
+    while (true) {
+        if (!FileSystem::Get().BeginTick("pressure")) {
+            LOG_INFO("Nothing left to collect");
+            break;
+        }
+
+        if (mResetRequested.exchange(false)) {
+            mMeasurements.clear();
+
+            std::lock_guard<std::mutex> locker(mEventsLock);
+            mEvents.clear();
+        }
+
+        if (mOverheadTracker) {
+            auto overhead = mOverheadTracker->Track("Pressure");
+            collectPressure();
+        } else {
+            collectPressure();
+        }
+
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->timestamp = std::chrono::system_clock::now();
+        snapshot->datasets = buildDatasets();
+        std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+
+        std::unique_lock<std::mutex> lock(mLock);
+        if (mCv.wait_for(lock, frequency, [this]() { return mQuit; })) {
+            break;
+        }
+    }
+
+    LOG_INFO("Collection thread quit");
+}
+
+/**
+ * @brief Wait for the kernel to tell us a trigger threshold has been crossed, and record when
+ */
+void PressureMetric::WatchTriggers()
+{
+    std::vector<struct pollfd> fds;
+    fds.emplace_back(pollfd{mWakeFd, POLLIN, 0});
+    for (const auto &trigger: mTriggers) {
+        fds.emplace_back(pollfd{trigger.fd, POLLPRI, 0});
+    }
+
+    while (true) {
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_SYS_ERROR(errno, "Memory pressure trigger poll failed");
+            break;
+        }
+
+        // Only woken up to quit
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+
+        for (size_t i = 1; i < fds.size(); i++) {
+            const auto &trigger = mTriggers[i - 1];
+
+            if (fds[i].revents & POLLERR) {
+                LOG_WARN("Memory pressure trigger '%s' was removed", trigger.description.c_str());
+                // poll() ignores negative fds
+                fds[i].fd = -1;
+                continue;
+            }
+
+            if (!(fds[i].revents & POLLPRI)) {
+                continue;
+            }
+
+            auto tick = std::make_shared<TickSamples>();
+            tick->timestamp = std::chrono::system_clock::now();
+            tick->source = TickSource::PressureEvents;
+
+            // Read straight from /proc rather than through FileSystem so this doesn't end up in a recording - triggers
+            // can't be replayed
+            std::ifstream pressureFile(kSystemPressure);
+            Psi pressure(pressureFile);
+
+            LOG_DEBUG("Memory pressure event: %s (some avg10 %.2f, full avg10 %.2f)", trigger.description.c_str(),
+                      pressure.Some().avg10, pressure.Full().avg10);
+
+            {
+                std::lock_guard<std::mutex> locker(mEventsLock);
+                mEvents.emplace_back(pressureEvent{tick->timestamp, trigger.description, pressure.Some().avg10,
+                                                   pressure.Full().avg10});
+            }
+
+            if (mSamplePublisher && mSamplePublisher->HasSinks()) {
+                tick->datasets.emplace_back(DatasetSample{"Memory Pressure Events", {{"Trigger", trigger.description}},
+                                                          "Stall", 1, {}});
+                mSamplePublisher->Publish(tick);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sample the pressure of the whole system and each cgroup that reports it
+ */
+void PressureMetric::collectPressure()
+{
+    auto tick = std::make_shared<TickSamples>();
+    tick->timestamp = std::chrono::system_clock::now();
+    tick->source = TickSource::Pressure;
+
+    Psi system(kSystemPressure);
+    if (system.IsValid()) {
+        addSample("System", system, *tick);
+    } else if (mMeasurements.empty()) {
+        LOG_WARN("Failed to read %s - kernel needs CONFIG_PSI", kSystemPressure.c_str());
+    }
+
+    for (const auto &root: kCgroupRoots) {
+        std::vector<IFileSystem::DirectoryEntry> cgroups;
+        if (!FileSystem::Get().ListDirectory(root, cgroups)) {
+            continue;
+        }
+
+        for (const auto &cgroup: cgroups) {
+            if (!cgroup.isDirectory) {
+                continue;
+            }
+
+            Psi pressure(root + "/" + cgroup.name + "/memory.pressure");
+            if (pressure.IsValid()) {
+                addSample(cgroup.name, pressure, *tick);
+            }
+        }
+    }
+
+    if (mSamplePublisher && mSamplePublisher->HasSinks() && !tick->datasets.empty()) {
+        mSamplePublisher->Publish(tick);
+    }
+}
+
+void PressureMetric::addSample(const std::string &source, const Psi &psi, TickSamples &tick)
+{
+    auto itr = mMeasurements.emplace(source, pressureMeasurement()).first;
+    auto &measurements = itr->second;
+
+    // Same position as buildDatasets() gives the row - system first, then each cgroup in order
+    DatasetLayout layout;
+    layout.row = 0;
+    if (source != "System") {
+        layout.row = static_cast<uint32_t>(mMeasurements.count("System"));
+        for (auto other = mMeasurements.begin(); other != itr; ++other) {
+            if (other->first != "System") {
+                layout.row++;
+            }
+        }
+    }
+
+    auto record = [&](Measurement &measurement, uint16_t column, long double value)
+    {
+        measurement.AddDataPoint(value);
+
+        layout.column = column;
+        layout.percentiles = measurement.HasPercentiles();
+        tick.datasets.emplace_back(DatasetSample{"Memory Pressure", {{"Source", source}}, measurement.GetName(),
+                                                 value, layout});
+    };
+
+    // Columns are in the same order as the row in buildDatasets(), after the source
+    record(measurements.SomeAvg10, 1, psi.Some().avg10);
+    record(measurements.SomeAvg60, 2, psi.Some().avg60);
+    if (psi.HasFull()) {
+        record(measurements.FullAvg10, 4, psi.Full().avg10);
+        record(measurements.FullAvg60, 5, psi.Full().avg60);
+    }
+
+    // Totals only go backwards if the cgroup was deleted and recreated
+    if (measurements.hasPrevious) {
+        if (psi.Some().totalUs >= measurements.someTotalUs) {
+            record(measurements.SomeStall, 3, (psi.Some().totalUs - measurements.someTotalUs) / 1000.0L);
+        }
+        if (psi.HasFull() && psi.Full().totalUs >= measurements.fullTotalUs) {
+            record(measurements.FullStall, 6, (psi.Full().totalUs - measurements.fullTotalUs) / 1000.0L);
+        }
+    }
+
+    measurements.hasPrevious = true;
+    measurements.someTotalUs = psi.Some().totalUs;
+    measurements.fullTotalUs = psi.Full().totalUs;
+}
+
+/**
+ * @brief Register a PSI trigger for the whole system
+ *
+ * @param type "some" or "full"
+ * @param thresholdPercent Raise an event when stalled for longer than this percentage of any trigger window
+ */
+bool PressureMetric::openTrigger(const std::string &type, unsigned int thresholdPercent)
+{
+    for (const auto windowUs: kTriggerWindowsUs) {
+        int fd = open(kSystemPressure.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            LOG_SYS_WARN(errno, "Failed to open %s", kSystemPressure.c_str());
+            return false;
+        }
+
+        // The kernel expects the NUL terminator to be written too
+        const unsigned int thresholdUs = windowUs / 100 * thresholdPercent;
+        const std::string config = type + " " + std::to_string(thresholdUs) + " " + std::to_string(windowUs);
+        if (write(fd, config.c_str(), config.size() + 1) < 0) {
+            const int error = errno;
+            close(fd);
+
+            // Window not allowed, try the next one
+            if (error == EINVAL) {
+                continue;
+            }
+
+            LOG_SYS_WARN(error, "Failed to register memory pressure trigger '%s'", config.c_str());
+            return false;
+        }
+
+        const std::string description = type + " > " + std::to_string(thresholdUs / 1000) + "ms/" +
+                                        std::to_string(windowUs / 1000) + "ms";
+        LOG_INFO("Registered memory pressure trigger %s", description.c_str());
+
+        mTriggers.emplace_back(trigger{fd, description});
+        return true;
+    }
+
+    LOG_WARN("Kernel rejected all memory pressure trigger windows");
+    return false;
+}
+
+void PressureMetric::closeTriggers()
+{
+    for (const auto &trigger: mTriggers) {
+        close(trigger.fd);
+    }
+    mTriggers.clear();
+
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+        mWakeFd = -1;
+    }
+}
+
+std::vector<JsonReportGenerator::dataset> PressureMetric::buildDatasets() const
+{
+    std::vector<JsonReportGenerator::dataset> datasets;
+    std::vector<JsonReportGenerator::dataItems> data{};
+
+    auto addRow = [&](const std::string &source, const pressureMeasurement &measurements)
+    {
+        data.emplace_back(JsonReportGenerator::dataItems{
+                std::make_pair("Source", source),
+                measurements.SomeAvg10,
+                measurements.SomeAvg60,
+                measurements.SomeStall,
+                measurements.FullAvg10,
+                measurements.FullAvg60,
+                measurements.FullStall
+        });
+    };
+
+    // System first, then each cgroup
+    auto system = mMeasurements.find("System");
+    if (system != mMeasurements.end()) {
+        addRow(system->first, system->second);
+    }
+    for (const auto &result: mMeasurements) {
+        if (result.first != "System") {
+            addRow(result.first, result.second);
+        }
+    }
+    datasets.emplace_back("Memory Pressure", std::move(data));
+    data.clear();
+
+    if (mTriggersEnabled) {
+        std::lock_guard<std::mutex> locker(mEventsLock);
+        for (const auto &event: mEvents) {
+            data.emplace_back(JsonReportGenerator::dataItems{
+                    std::make_pair("Time", JsonReportGenerator::FormatTimestamp(event.timestamp)),
+                    std::make_pair("Trigger", event.trigger),
+                    std::make_pair("Some_Avg10", formatDouble(event.someAvg10)),
+                    std::make_pair("Full_Avg10", formatDouble(event.fullAvg10))
+            });
+        }
+        datasets.emplace_back("Memory Pressure Events", std::move(data));
+        data.clear();
+    }
+
+    return datasets;
+}
@@ -0,0 +1,138 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "IMetric.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FileParsers/Psi.h"
+#include "JsonReportGenerator.h"
+#include "OverheadTracker.h"
+#include "SamplePublisher.h"
+
+/**
+ * @brief Record memory pressure stall information (PSI) for the system and each cgroup
+ *
+ * As well as sampling the averages every tick, registers PSI triggers with the kernel so that short stalls between
+ * ticks are recorded as events with the exact time they happened, without having to poll quickly
+ */
+class PressureMetric : public IMetric
+{
+public:
+    PressureMetric(std::shared_ptr<JsonReportGenerator> reportGenerator,
+                   std::shared_ptr<SamplePublisher> samplePublisher,
+                   std::shared_ptr<OverheadTracker> overheadTracker,
+                   bool enableTriggers);
+
+    ~PressureMetric();
+
+    void StartCollection(std::chrono::seconds frequency) override;
+
+    void StopCollection() override;
+
+    void SaveResults() override;
+
+    void ResetResults() override;
+
+    /**
+     * @brief Immutable copy of the results collected so far, published by the collection thread after each tick
+     */
+    struct Snapshot
+    {
+        std::chrono::system_clock::time_point timestamp;
+        std::vector<JsonReportGenerator::dataset> datasets;
+    };
+
+    std::shared_ptr<const Snapshot> GetSnapshot() const;
+
+private:
+    struct pressureMeasurement
+    {
+        Measurement SomeAvg10 = Measurement("Some_Avg10");
+        Measurement SomeAvg60 = Measurement("Some_Avg60");
+        Measurement SomeStall = Measurement("Some_Stall_ms", true);
+        Measurement FullAvg10 = Measurement("Full_Avg10");
+        Measurement FullAvg60 = Measurement("Full_Avg60");
+        Measurement FullStall = Measurement("Full_Stall_ms", true);
+
+        // Totals at the previous tick, to work out how long was spent stalled since then
+        bool hasPrevious = false;
+        unsigned long long someTotalUs = 0;
+        unsigned long long fullTotalUs = 0;
+    };
+
+    struct pressureEvent
+    {
+        std::chrono::system_clock::time_point timestamp;
+        std::string trigger;
+        double someAvg10;
+        double fullAvg10;
+    };
+
+    struct trigger
+    {
+        int fd;
+        std::string description;
+    };
+
+    void CollectData(std::chrono::seconds frequency);
+
+    void WatchTriggers();
+
+    void collectPressure();
+
+    void addSample(const std::string &source, const Psi &psi, TickSamples &tick);
+
+    bool openTrigger(const std::string &type, unsigned int thresholdUs);
+
+    void closeTriggers();
+
+    std::vector<JsonReportGenerator::dataset> buildDatasets() const;
+
+private:
+    std::thread mCollectionThread;
+    bool mQuit;
+    std::condition_variable mCv;
+    std::mutex mLock;
+
+    // Only ever touched by the collection thread
+    std::map<std::string, pressureMeasurement> mMeasurements;
+    std::atomic<bool> mResetRequested;
+
+    // Events come in on the trigger thread
+    mutable std::mutex mEventsLock;
+    std::vector<pressureEvent> mEvents;
+
+    const bool mTriggersEnabled;
+    std::thread mTriggerThread;
+    int mWakeFd;
+    std::vector<trigger> mTriggers;
+
+    std::shared_ptr<const Snapshot> mSnapshot;
+
+    const std::shared_ptr<JsonReportGenerator> mReportGenerator;
+    const std::shared_ptr<SamplePublisher> mSamplePublisher;
+    const std::shared_ptr<OverheadTracker> mOverheadTracker;
+};
@@ -20,8 +20,9 @@
 #include "Process.h"
 #include <climits>
 #include "Log.h"
-#include <fstream>
-#include <sys/stat.h>
+#include "FileSystem/FileSystem.h"
+#include <cstring>
+#include <sstream>
 
 Process::Process(pid_t pid) : mPid(pid), mDead(false)
 {
@@ -34,6 +35,21 @@ Process::Process(pid_t pid) : mPid(pid), mDead(false)
     mSystemdService = getSystemdService();
 }
 
+/**
+ * Create a process from previously saved details (e.g. when reading a saved capture) instead of reading them from /proc
+ */
+Process::Process(pid_t pid, pid_t ppid, std::string name, std::string cmdline, std::string systemdService,
+                 std::string container, bool dead)
+        : mPid(pid),
+          mPpid(ppid),
+          mDead(dead),
+          mName(std::move(name)),
+          mCmdline(std::move(cmdline)),
+          mSystemdService(std::move(systemdService)),
+          mContainer(std::move(container))
+{
+}
+
 /**
  *
  * @return Cached PID of the process
@@ -126,53 +142,25 @@ void Process::updateAliveStatus()
         return;
     }
 
-    struct stat s{};
-
     char procDir[PATH_MAX];
     snprintf(procDir, PATH_MAX, "/proc/%d", mPid);
 
-    if (stat(procDir, &s) == -1 && errno == ENOENT) {
-        mDead = true;
-    } else {
-        mDead = false;
-    }
+    mDead = !FileSystem::Get().Exists(procDir);
 }
 
 
 /**
  * Attempt to work out which group the process belongs to, using the provided groupmanager to resolve names -> groups
  *
+ * Processes are shared between threads once published, so nothing is cached here - the group manager caches the
+ * result for each container, name and cmdline
+ *
  * @param groupManager Group manager containing loaded group definitions
  * @return If the group can be resolved, return the name of the group. Otherwise returns nullopt
  */
 std::optional<std::string> Process::group(const std::shared_ptr<GroupManager> &groupManager) const
 {
-    // WARNING:: Container is intentionally prioritised over everything else to allow a "WPEWebProcess" rule to capture JSPP
-    // processes without capturing containerised browsers
-    if (!mContainer.empty()) {
-        auto group = groupManager->getGroup(GroupManager::groupType::CONTAINER, mContainer);
-
-        if (group.has_value()) {
-            return group.value();
-        }
-    }
-
-    auto name = getNameWithoutPath();
-    auto group = groupManager->getGroup(GroupManager::groupType::PROCESS, name);
-
-    if (group.has_value()) {
-        return group.value();
-    }
-
-    // Didn't get group by name or container, try cmdline
-    group = groupManager->getGroup(GroupManager::groupType::PROCESS, mCmdline);
-
-    if (group.has_value()) {
-        return group.value();
-    }
-
-    // Couldn't work out what the group is
-    return std::nullopt;
+    return groupManager->getProcessGroup(mContainer, getNameWithoutPath(), mCmdline);
 }
 
 pid_t Process::getParentPid() const
@@ -180,9 +168,9 @@ pid_t Process::getParentPid() const
     char procPath[PATH_MAX];
     sprintf(procPath, "/proc/%u/status", mPid);
 
-    std::ifstream statusFile(procPath);
+    std::istringstream statusFile;
 
-    if (!statusFile) {
+    if (!FileSystem::Open(procPath, statusFile)) {
         return {};
     }
 
@@ -208,16 +196,11 @@ std::string Process::getName() const
     char procPath[PATH_MAX];
     sprintf(procPath, "/proc/%u/cmdline", mPid);
 
-    std::ifstream cmdFile(procPath);
-
-    if (!cmdFile) {
+    std::string name;
+    if (!FileSystem::Get().ReadFile(procPath, name)) {
         return {};
     }
 
-    std::string name;
-    name.assign((std::istreambuf_iterator<char>(cmdFile)),
-                (std::istreambuf_iterator<char>()));
-
     name.erase(std::find(name.begin(), name.end(), '\0'), name.end());
 
     return name;
@@ -233,16 +216,11 @@ std::string Process::getCmdline() const
     char procPath[PATH_MAX];
     sprintf(procPath, "/proc/%u/cmdline", mPid);
 
-    std::ifstream cmdFile(procPath);
-
-    if (!cmdFile) {
+    std::string cmdline;
+    if (!FileSystem::Get().ReadFile(procPath, cmdline)) {
         return {};
     }
 
-    std::string cmdline;
-    cmdline.assign((std::istreambuf_iterator<char>(cmdFile)),
-                   (std::istreambuf_iterator<char>()));
-
     if (cmdline.empty()) {
         return cmdline;
     }
@@ -300,6 +278,35 @@ std::string Process::getSystemdService()
     return systemdSlice.substr(pos + 13);
 }
 
+/**
+ * Find the cgroup path for the specified cgroup controller in the contents of a /proc/<pid>/cgroup file
+ *
+ * @param stream contents of the cgroup file
+ * @param cgroup_controller name of cgroup controller e.g. 'gpu'
+ * @return path of the cgroup (without the leading /), or an empty string if the controller isn't listed
+ */
+std::string Process::ParseCgroupPath(std::istream &stream, const std::string &cgroup_controller)
+{
+    std::string cgrp_path;
+    std::string cgrp_line;
+    int hierarchy_id;
+    char cgroup_path[128];
+
+    std::string sscanf_format = std::string("%d:") + cgroup_controller + ":/%s";
+
+    // Doesn't feel very efficient (need to memset cgroup_path each time round the loop) but the alternatives are std::string.find (clunky) or std::regex (inefficient).
+    // Besides, the gpu group always appears to be the first line.
+    while (std::getline(stream, cgrp_line)) {
+        memset(cgroup_path, 0, sizeof(cgroup_path));
+        if (sscanf(cgrp_line.c_str(), sscanf_format.c_str(), &hierarchy_id, cgroup_path) == 2) {
+            cgrp_path = cgroup_path;
+            break;
+        }
+    }
+
+    return cgrp_path;
+}
+
 /**
  * Extract cgroup name from /proc/<pid>/cgroup (if any) for specified cgroup_controller and pid and return. Otherwise
  * return empty string.
@@ -347,23 +354,9 @@ std::string Process::GetCgroupPathByCgroupControllerAndPid(const std::string &cg
 
     std::string cgrp_path;
 
-    std::ifstream cgrp_strm(cgroupFilePath);
-    if (cgrp_strm) {
-        std::string cgrp_line;
-        int hierarchy_id;
-        char cgroup_path[128];
-
-        std::string sscanf_format = std::string("%d:") + cgroup_controller + ":/%s";
-
-        // Doesn't feel very efficient (need to memset cgroup_path each time round the loop) but the alternatives are std::string.find (clunky) or std::regex (inefficient).
-        // Besides, the gpu group always appears to be the first line.
-        while (std::getline(cgrp_strm, cgrp_line)) {
-            memset(cgroup_path, 0, sizeof(cgroup_path));
-            if (sscanf(cgrp_line.c_str(), sscanf_format.c_str(), &hierarchy_id, cgroup_path) == 2) {
-                cgrp_path = cgroup_path;
-                break;
-            }
-        }
+    std::istringstream cgrp_strm;
+    if (FileSystem::Open(cgroupFilePath, cgrp_strm)) {
+        cgrp_path = ParseCgroupPath(cgrp_strm, cgroup_controller);
     } else {
         // Expected, process might have died in the meantime
         LOG_DEBUG("Could not open process cgroup file '%s'", cgroupFilePath);
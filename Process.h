@@ -20,6 +20,7 @@
 #pragma once
 
 #include <sys/types.h>
+#include <istream>
 #include <string>
 #include "GroupManager.h"
 #include <memory>
@@ -38,6 +39,9 @@ class Process
 public:
     explicit Process(pid_t pid);
 
+    Process(pid_t pid, pid_t ppid, std::string name, std::string cmdline, std::string systemdService,
+            std::string container, bool dead);
+
     bool operator==(const Process &rhs) const
     {
         // On long captures there is a small chance we loop around PIDs and re-use the same PID again
@@ -62,6 +66,8 @@ public:
 
     void updateAliveStatus();
 
+    static std::string ParseCgroupPath(std::istream &stream, const std::string &cgroup_controller);
+
 private:
     pid_t getParentPid() const;
 
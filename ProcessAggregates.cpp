@@ -0,0 +1,127 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ProcessAggregates.h"
+
+#include <algorithm>
+
+ProcessAggregates::ProcessAggregates(std::optional<std::shared_ptr<GroupManager>> groupManager)
+        : mGroupManager(std::move(groupManager)),
+          mTickCount(0)
+{
+
+}
+
+/**
+ * @brief Add the PSS of a process to the totals for the current tick
+ */
+void ProcessAggregates::AddSample(const Process &process, long double pss)
+{
+    if (mGroupManager.has_value()) {
+        auto group = process.group(mGroupManager.value());
+        if (group.has_value()) {
+            mGroups.tickTotals[group.value()] += pss;
+        }
+    }
+
+    auto service = process.systemdService();
+    if (service.has_value() && !service->empty()) {
+        mServices.tickTotals[service.value()] += pss;
+    }
+
+    auto container = process.container();
+    if (container.has_value() && !container->empty()) {
+        mContainers.tickTotals[container.value()] += pss;
+    }
+}
+
+/**
+ * @brief All processes for this tick have been added, so save the totals
+ */
+void ProcessAggregates::EndTick()
+{
+    endTick(mGroups);
+    endTick(mServices);
+    endTick(mContainers);
+
+    mTickCount++;
+}
+
+/**
+ * @brief Discard all totals collected so far
+ */
+void ProcessAggregates::Reset()
+{
+    mGroups = aggregate();
+    mServices = aggregate();
+    mContainers = aggregate();
+    mTickCount = 0;
+}
+
+void ProcessAggregates::AddToReport(JsonReportGenerator &reportGenerator) const
+{
+    addToReport("PSS by Group", "Group", mGroups, reportGenerator);
+    addToReport("PSS by Systemd Service", "Service", mServices, reportGenerator);
+    addToReport("PSS by Container", "Container", mContainers, reportGenerator);
+}
+
+void ProcessAggregates::endTick(aggregate &aggregate) const
+{
+    for (const auto &total: aggregate.tickTotals) {
+        auto itr = aggregate.measurements.find(total.first);
+        if (itr == aggregate.measurements.end()) {
+            itr = aggregate.measurements.emplace(total.first, Measurement("PSS_KB", true)).first;
+
+            // Nothing in this group was running before now
+            for (int i = 0; i < mTickCount; i++) {
+                itr->second.AddDataPoint(0);
+            }
+        }
+    }
+
+    // Everything in a group may have exited, in which case its total is now 0
+    for (auto &measurement: aggregate.measurements) {
+        auto total = aggregate.tickTotals.find(measurement.first);
+        measurement.second.AddDataPoint(total != aggregate.tickTotals.end() ? total->second : 0);
+    }
+
+    aggregate.tickTotals.clear();
+}
+
+void ProcessAggregates::addToReport(const std::string &name, const std::string &label, const aggregate &aggregate,
+                                    JsonReportGenerator &reportGenerator)
+{
+    // Biggest peak first
+    std::vector<std::pair<std::string, Measurement>> sorted(aggregate.measurements.begin(),
+                                                            aggregate.measurements.end());
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const std::pair<std::string, Measurement> &a, const std::pair<std::string, Measurement> &b)
+                     {
+                         return a.second.GetMax() > b.second.GetMax();
+                     });
+
+    std::vector<JsonReportGenerator::dataItems> data;
+    data.reserve(sorted.size());
+
+    for (const auto &item: sorted) {
+        data.emplace_back(JsonReportGenerator::dataItems{std::make_pair(label, item.first), item.second});
+    }
+
+    reportGenerator.addDataset(name, data);
+}
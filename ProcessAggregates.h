@@ -0,0 +1,72 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "GroupManager.h"
+#include "JsonReportGenerator.h"
+#include "Measurement.h"
+#include "Process.h"
+
+/**
+ * @brief Track the total PSS of each group, systemd service and container over time
+ *
+ * The totals are worked out for every collection tick, so the peak of a group is the highest total the group actually
+ * reached rather than the sum of each member's peak (which may have happened at different times)
+ */
+class ProcessAggregates
+{
+public:
+    explicit ProcessAggregates(std::optional<std::shared_ptr<GroupManager>> groupManager);
+
+    void AddSample(const Process &process, long double pss);
+
+    void EndTick();
+
+    void Reset();
+
+    void AddToReport(JsonReportGenerator &reportGenerator) const;
+
+private:
+    struct aggregate
+    {
+        // Totals for the tick currently being collected
+        std::map<std::string, long double> tickTotals;
+        std::map<std::string, Measurement> measurements;
+    };
+
+    void endTick(aggregate &aggregate) const;
+
+    static void addToReport(const std::string &name, const std::string &label, const aggregate &aggregate,
+                            JsonReportGenerator &reportGenerator);
+
+private:
+    const std::optional<std::shared_ptr<GroupManager>> mGroupManager;
+
+    int mTickCount;
+
+    aggregate mGroups;
+    aggregate mServices;
+    aggregate mContainers;
+};
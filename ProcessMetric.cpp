@@ -18,13 +18,46 @@
 */
 
 #include "ProcessMetric.h"
+#include "FileSystem/FileSystem.h"
 #include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+
+/**
+ * @brief Work out our own PID through the FileSystem so a replay excludes the PID of the MemCapture that recorded it
+ */
+static pid_t selfPid()
+{
+    std::string stat;
+    if (FileSystem::Get().ReadFile("/proc/self/stat", stat)) {
+        pid_t pid = 0;
+        if (sscanf(stat.c_str(), "%d", &pid) == 1 && pid > 0) {
+            return pid;
+        }
+    }
+
+    return getpid();
+}
 
 
-ProcessMetric::ProcessMetric(std::shared_ptr<JsonReportGenerator> reportGenerator)
+ProcessMetric::ProcessMetric(std::shared_ptr<JsonReportGenerator> reportGenerator,
+                             std::shared_ptr<SamplePublisher> samplePublisher,
+                             std::optional<std::shared_ptr<GroupManager>> groupManager,
+                             std::shared_ptr<OverheadTracker> overheadTracker,
+                             std::shared_ptr<CollectionContext> context,
+                             bool keepResults)
         : mQuit(false),
           mCv(),
-          mReportGenerator(std::move(reportGenerator))
+          mKeepResults(keepResults),
+          mAggregates(std::move(groupManager)),
+          mResetRequested(false),
+          mSnapshot(std::make_shared<Snapshot>(mAggregates)),
+          mReportGenerator(std::move(reportGenerator)),
+          mSamplePublisher(std::move(samplePublisher)),
+          mOverheadTracker(std::move(overheadTracker)),
+          mContext(std::move(context)),
+          mProcrank(*mContext, mOverheadTracker),
+          mSelfPid(selfPid())
 {
 
 }
@@ -57,40 +90,133 @@ void ProcessMetric::StopCollection()
 
 void ProcessMetric::SaveResults()
 {
-    DeduplicateData();
-    mReportGenerator->addProcesses(mMeasurements);
+    if (!mKeepResults) {
+        LOG_WARN("Process results weren't kept, so there's nothing to add to the report");
+        return;
+    }
+
+    auto snapshot = GetSnapshot();
+
+    // Deduplication modifies the list, so work on a copy
+    auto processes = snapshot->processes;
+    AddProcessesToReport(processes, *mReportGenerator);
+    snapshot->aggregates.AddToReport(*mReportGenerator);
+}
+
+/**
+ * @brief Discard the results collected so far
+ *
+ * The collection thread owns the results, so this just asks it to clear them before the next tick. Readers see
+ * an empty snapshot straight away
+ */
+void ProcessMetric::ResetResults()
+{
+    mResetRequested = true;
+
+    auto aggregates = GetSnapshot()->aggregates;
+    aggregates.Reset();
+    std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(std::make_shared<Snapshot>(std::move(aggregates))));
+}
+
+/**
+ * @brief Get the results as of the last completed tick
+ *
+ * Safe to call from any thread at any time without blocking collection. The returned snapshot never changes
+ */
+std::shared_ptr<const ProcessMetric::Snapshot> ProcessMetric::GetSnapshot() const
+{
+    return std::atomic_load(&mSnapshot);
+}
+
+void ProcessMetric::publishSnapshot(std::chrono::system_clock::time_point timestamp)
+{
+    auto snapshot = std::make_shared<Snapshot>(mAggregates);
+    snapshot->timestamp = timestamp;
+    snapshot->processes = mMeasurements;
+
+    std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+/**
+ * @brief Add the processes to the report and add their PSS to the grand total
+ *
+ * Static so the same rules apply when rebuilding a report from a saved capture
+ */
+void ProcessMetric::AddProcessesToReport(std::vector<processMeasurement> &measurements,
+                                         JsonReportGenerator &reportGenerator)
+{
+    DeduplicateData(measurements);
+    reportGenerator.addProcesses(measurements);
 
     // Sum all PSS measurements and add to running total of system memory usage
     auto pssSum = 0;
-    std::for_each(mMeasurements.begin(), mMeasurements.end(), [&](const processMeasurement &p)
+    std::for_each(measurements.begin(), measurements.end(), [&](const processMeasurement &p)
     {
         pssSum += p.Pss.GetAverage();
     });
-    mReportGenerator->addToAccumulatedMemoryUsage(pssSum);
+    reportGenerator.addToAccumulatedMemoryUsage(pssSum);
 }
 
 void ProcessMetric::CollectData(const std::chrono::seconds frequency)
 {
-    std::unique_lock<std::mutex> lock(mLock);
+    // Ticks run to a fixed schedule, so a slow tick doesn't push back all the ones after it
+    auto next = std::chrono::steady_clock::now();
+
+    while (true) {
+        if (!FileSystem::Get().BeginTick("process")) {
+            LOG_INFO("Nothing left to collect");
+            break;
+        }
+
+        if (mResetRequested.exchange(false) || !mKeepResults) {
+            mMeasurements.clear();
+            mAggregates.Reset();
+        }
 
-    do {
         // LOG_DEBUG("Collecting process data");
         auto start = std::chrono::high_resolution_clock::now();
+        auto timestamp = std::chrono::system_clock::now();
+
+        std::optional<OverheadTracker::Scope> overhead;
+        if (mOverheadTracker) {
+            overhead.emplace(*mOverheadTracker, "Processes");
+        }
 
         // Use procrank to get the memory usage for all processes in the system at this moment in time
         // Won't capture every spike in memory usage, but over time should smooth out into a decent average
-        Procrank procrank;
+        // Swap usage comes from the memory metric's latest tick, so /proc/meminfo isn't read twice
+        const auto tickValues = mContext->Latest();
 
         // This can take 0.5 - 1 second...
-        auto processMemory = procrank.GetMemoryUsage();
+        auto processMemory = mProcrank.GetMemoryUsage(tickValues);
+
+        // Don't count ourselves - our own usage is reported separately as overhead
+        auto self = std::find_if(processMemory.begin(), processMemory.end(),
+                                 [&](const Procrank::ProcessMemoryUsage &p)
+                                 {
+                                     return p.process.pid() == mSelfPid;
+                                 });
+
+        if (self != processMemory.end()) {
+            if (mOverheadTracker) {
+                mOverheadTracker->RecordProcess(self->pss, self->rss);
+            }
+            processMemory.erase(self);
+        }
 
         for (const auto &procrankMeasurement: processMemory) {
+            if (mKeepResults) {
+                mAggregates.AddSample(procrankMeasurement.process, procrankMeasurement.pss);
+            }
 
-            // Check if we've seen this process before
-            auto itr = std::find_if(mMeasurements.begin(), mMeasurements.end(), [&](const processMeasurement &p)
-            {
-                return p.ProcessInfo == procrankMeasurement.process;
-            });
+            // Check if we've seen this process before. Every process is new if we're only keeping the latest tick
+            auto itr = mMeasurements.end();
+            if (mKeepResults) {
+                itr = std::find_if(mMeasurements.begin(), mMeasurements.end(), [&](const processMeasurement &p)
+                {
+                    return p.ProcessInfo == procrankMeasurement.process;
+                });
+            }
 
             if (itr == mMeasurements.end()) {
                 // This is a new process, add to the list
@@ -121,18 +247,59 @@ void ProcessMetric::CollectData(const std::chrono::seconds frequency)
             }
         }
 
-        // Update process dead/alive flag
-        for (auto &process: mMeasurements) {
-            process.ProcessInfo.updateAliveStatus();
+        if (mKeepResults) {
+            mAggregates.EndTick();
+
+            // Update process dead/alive flag
+            for (auto &process: mMeasurements) {
+                process.ProcessInfo.updateAliveStatus();
+            }
         }
 
+        publishSnapshot(timestamp);
+
+        // Hand the raw values from this tick over to anything streaming them - we're done with them now so no need to copy
+        if (mSamplePublisher && mSamplePublisher->HasSinks()) {
+            auto tick = std::make_shared<TickSamples>();
+            tick->timestamp = timestamp;
+            tick->source = TickSource::Processes;
+            tick->processes = std::move(processMemory);
+            mSamplePublisher->Publish(tick);
+        }
+
+        overhead.reset();
+
         auto end = std::chrono::high_resolution_clock::now();
         LOG_INFO("ProcessMetric completed in %lld ms",
                  (long long) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
 
-        // Wait for period before doing collection again, or until cancelled
-        mCv.wait_for(lock, frequency);
-    } while (!mQuit);
+        // Wait for period before doing collection again, or until cancelled. Only hold the lock while waiting so
+        // nothing is blocked behind a slow collection
+        std::unique_lock<std::mutex> lock(mLock);
+        next += frequency;
+
+        // If collection overran into the next tick, skip the slots that have already passed rather than running
+        // them back to back to catch up
+        const auto now = std::chrono::steady_clock::now();
+        if (frequency.count() > 0 && next < now) {
+            const auto missed = (now - next) / frequency + 1;
+            next += missed * frequency;
+
+            LOG_WARN("ProcessMetric overran, skipping %lld tick(s)", (long long) missed);
+            if (mOverheadTracker) {
+                mOverheadTracker->RecordMissedTicks("Process", missed);
+            }
+        }
+
+        if (mCv.wait_until(lock, next, [this]() { return mQuit; })) {
+            break;
+        }
+
+        // How late this tick started compared to the schedule. There's no schedule when replaying as fast as possible
+        if (mOverheadTracker && frequency.count() > 0) {
+            mOverheadTracker->RecordLatency("Process Tick Jitter", std::chrono::steady_clock::now() - next);
+        }
+    }
 
     LOG_INFO("Collection thread quit");
 }
@@ -146,17 +313,17 @@ void ProcessMetric::CollectData(const std::chrono::seconds frequency)
  * This is really only here to prevent sleep's in some RDK scripts from artificially inflating the results over long runs.
  * In an ideal world we wouldn't need this.
  */
-void ProcessMetric::DeduplicateData()
+void ProcessMetric::DeduplicateData(std::vector<processMeasurement> &measurements)
 {
     // Warning:: This is quite crude. Can be disabled at runtime if you want to handle this manually later on in Excel/similar
     std::map<std::string, std::vector<processMeasurement>> duplicates;
 
-    for (const auto &measurement: mMeasurements) {
+    for (const auto &measurement: measurements) {
         if (!measurement.ProcessInfo.isDead()) {
             continue;
         }
 
-        auto hasDuplicate = std::count_if(mMeasurements.begin(), mMeasurements.end(),
+        auto hasDuplicate = std::count_if(measurements.begin(), measurements.end(),
                                           [&](const processMeasurement &m)
                                           {
                                               // Duplicate processes have the same cmdline and same parent PID (and are dead)
@@ -197,11 +364,11 @@ void ProcessMetric::DeduplicateData()
             LOG_INFO("Removing %zu duplicates for %s", d.size(), duplicate.first.c_str());
 
             for (const auto &toRemove: d) {
-                mMeasurements.erase(
-                        std::remove_if(mMeasurements.begin(), mMeasurements.end(), [&](const processMeasurement &m)
+                measurements.erase(
+                        std::remove_if(measurements.begin(), measurements.end(), [&](const processMeasurement &m)
                         {
                             return m.ProcessInfo == toRemove.ProcessInfo;
-                        }), mMeasurements.end());
+                        }), measurements.end());
             }
         }
     }
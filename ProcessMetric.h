@@ -19,20 +19,30 @@
 #pragma once
 
 #include "IMetric.h"
+#include <atomic>
 #include <thread>
 #include <condition_variable>
 #include <map>
 #include <mutex>
 #include <utility>
+#include "CollectionContext.h"
 #include "GroupManager.h"
 #include "JsonReportGenerator.h"
+#include "OverheadTracker.h"
+#include "ProcessAggregates.h"
 #include "Procrank.h"
 #include "ProcessMeasurement.h"
+#include "SamplePublisher.h"
 
 class ProcessMetric : public IMetric
 {
 public:
-    ProcessMetric(std::shared_ptr<JsonReportGenerator> reportGenerator);
+    ProcessMetric(std::shared_ptr<JsonReportGenerator> reportGenerator,
+                  std::shared_ptr<SamplePublisher> samplePublisher,
+                  std::optional<std::shared_ptr<GroupManager>> groupManager,
+                  std::shared_ptr<OverheadTracker> overheadTracker,
+                  std::shared_ptr<CollectionContext> context,
+                  bool keepResults = true);
 
     ~ProcessMetric();
 
@@ -42,11 +52,36 @@ public:
 
     void SaveResults() override;
 
+    void ResetResults() override;
+
+    static void AddProcessesToReport(std::vector<processMeasurement> &measurements,
+                                     JsonReportGenerator &reportGenerator);
+
+    static void DeduplicateData(std::vector<processMeasurement> &measurements);
+
+    /**
+     * @brief Immutable copy of the results collected so far, published by the collection thread after each tick
+     */
+    struct Snapshot
+    {
+        explicit Snapshot(ProcessAggregates _aggregates)
+                : aggregates(std::move(_aggregates))
+        {
+
+        }
+
+        std::chrono::system_clock::time_point timestamp;
+        std::vector<processMeasurement> processes;
+        ProcessAggregates aggregates;
+    };
+
+    std::shared_ptr<const Snapshot> GetSnapshot() const;
+
 
 private:
     void CollectData(std::chrono::seconds frequency);
 
-    void DeduplicateData();
+    void publishSnapshot(std::chrono::system_clock::time_point timestamp);
 
 private:
     std::thread mCollectionThread;
@@ -54,7 +89,25 @@ private:
     std::condition_variable mCv;
     std::mutex mLock;
 
+    // Only ever touched by the collection thread - everyone else reads the published snapshot. When results aren't
+    // kept, this only holds the processes from the latest tick
+    const bool mKeepResults;
     std::vector<processMeasurement> mMeasurements;
+    ProcessAggregates mAggregates;
+    std::atomic<bool> mResetRequested;
+
+    // Swapped atomically after each tick. Readers keep their copy alive for as long as they hold it, so an old
+    // snapshot is freed by whoever drops the last reference to it
+    std::shared_ptr<const Snapshot> mSnapshot;
 
     const std::shared_ptr<JsonReportGenerator> mReportGenerator;
+    const std::shared_ptr<SamplePublisher> mSamplePublisher;
+    const std::shared_ptr<OverheadTracker> mOverheadTracker;
+
+    // Refreshed by the memory metric every tick
+    const std::shared_ptr<CollectionContext> mContext;
+    const Procrank mProcrank;
+
+    // Our own PID, so we don't count ourselves in the results
+    const pid_t mSelfPid;
 };
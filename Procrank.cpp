@@ -18,11 +18,11 @@
 */
 
 #include "Procrank.h"
-#include "FileParsers/MemInfo.h"
 #include "FileParsers/Smaps.h"
+#include "OverheadTracker.h"
+#include "FileSystem/FileSystem.h"
 
 #include <climits>
-#include <fstream>
 #include <sstream>
 #include <chrono>
 #include <algorithm>
@@ -30,7 +30,9 @@
 #include <inttypes.h>
 #include <set>
 
-Procrank::Procrank() : mSwapEnabled(swapTotalKb() > 0), mZramCompressionRatio(zramCompressionRatio())
+Procrank::Procrank(const CollectionContext &context, std::shared_ptr<OverheadTracker> overheadTracker)
+        : mSmapsRollupSupported(context.SmapsRollupSupported()),
+          mOverheadTracker(std::move(overheadTracker))
 {
 
 }
@@ -42,9 +44,10 @@ Procrank::~Procrank()
 
 /**
  * Get the memory usage for all the processes currently running
+ * @param tickValues System values read for this tick, used to work out how much of a process's swap is in zram
  * @return
  */
-std::vector<Procrank::ProcessMemoryUsage> Procrank::GetMemoryUsage() const
+std::vector<Procrank::ProcessMemoryUsage> Procrank::GetMemoryUsage(const CollectionContext::TickValues &tickValues) const
 {
     // Get running processes
     std::set<pid_t> pids = getRunningProcesses();
@@ -62,74 +65,13 @@ std::vector<Procrank::ProcessMemoryUsage> Procrank::GetMemoryUsage() const
             continue;
         }
 
-        auto usage = getProcessMemoryUsage(process);
+        auto usage = getProcessMemoryUsage(process, tickValues.zramCompressionRatio);
         memoryUsage.emplace_back(usage);
     }
 
     return memoryUsage;
 }
 
-long Procrank::swapTotalKb()
-{
-    MemInfo memInfo;
-    return memInfo.SwapTotal();
-}
-
-/**
- * Work out the current zram compression ratio
- * @return
- */
-double Procrank::zramCompressionRatio()
-{
-    if (!mSwapEnabled) {
-        return 0;
-    }
-
-    // First, work out how much ZRAM memory we have
-    char buffer[PATH_MAX];
-    uint64_t zramTotal = 0;
-
-    constexpr uint32_t maxZramDevices = 256;
-    for (uint32_t i = 0; i < maxZramDevices; i++) {
-        snprintf(buffer, PATH_MAX, "/sys/block/zram%u", i);
-        if (!std::filesystem::exists(buffer)) {
-            // We assume zram devices appear in range 0-255 and appear always in sequence
-            // under /sys/block. So, stop looking for them once we find one is missing.
-            break;
-        }
-
-        std::filesystem::path mmstat(buffer);
-        mmstat /= "mm_stat";
-
-        uint64_t deviceMemoryTotal = 0;
-
-        if (std::filesystem::exists(mmstat)) {
-            std::ifstream mmstatFile(mmstat);
-            if (mmstatFile) {
-                std::string line;
-                std::getline(mmstatFile, line);
-                if (sscanf(line.c_str(), "%*u %*u %" SCNu64, &deviceMemoryTotal) != 1) {
-                    LOG_ERROR("Malformed mm_stat file %s", mmstat.string().c_str());
-                }
-                zramTotal += deviceMemoryTotal;
-            }
-        }
-    }
-
-    if (zramTotal == 0) {
-        return 0;
-    }
-
-    uint64_t zramTotalKb = zramTotal / 1024;
-
-    // Now work out the compression ratio
-    MemInfo systemMemInfo;
-    double compression = static_cast<double>(zramTotalKb) / systemMemInfo.SwapUsed();
-
-    LOG_DEBUG("Zram compression is %f", compression);
-    return compression;
-}
-
 /**
  * Return the pids of all the currently running processes
  * @return
@@ -137,16 +79,17 @@ double Procrank::zramCompressionRatio()
 std::set<pid_t> Procrank::getRunningProcesses() const
 {
     std::set<pid_t> pids;
-    std::filesystem::directory_iterator procDir("/proc");
+    std::vector<IFileSystem::DirectoryEntry> procDir;
+    if (!FileSystem::Get().ListDirectory("/proc", procDir)) {
+        LOG_ERROR("Failed to list /proc");
+        return pids;
+    }
 
-    std::string directoryName;
     pid_t pid;
     for (const auto &entry: procDir) {
-        if (entry.is_directory()) {
+        if (entry.isDirectory) {
             // Get the PID from dir name
-            directoryName = entry.path().filename().string();
-
-            if (parseInt(directoryName, &pid)) {
+            if (parseInt(entry.name, &pid)) {
                 pids.insert(static_cast<pid_t>(pid));
             }
         }
@@ -161,11 +104,17 @@ std::set<pid_t> Procrank::getRunningProcesses() const
  * @param process
  * @return
  */
-Procrank::ProcessMemoryUsage Procrank::getProcessMemoryUsage(Process &process) const
+Procrank::ProcessMemoryUsage Procrank::getProcessMemoryUsage(Process &process, double zramCompressionRatio) const
 {
     ProcessMemoryUsage memoryUsage(process);
 
-    Smaps smapFile(memoryUsage.process.pid());
+    auto start = std::chrono::steady_clock::now();
+    Smaps smapFile(memoryUsage.process.pid(), mSmapsRollupSupported);
+
+    // Cost scales with the number of mappings so can vary a lot between processes
+    if (mOverheadTracker) {
+        mOverheadTracker->RecordLatency("Process smaps", std::chrono::steady_clock::now() - start);
+    }
     memoryUsage.pss = smapFile.Pss();
     memoryUsage.rss = smapFile.Rss();
     memoryUsage.swap = smapFile.Swap();
@@ -173,7 +122,7 @@ Procrank::ProcessMemoryUsage Procrank::getProcessMemoryUsage(Process &process) c
     memoryUsage.locked = smapFile.Locked();
     memoryUsage.vss = smapFile.Vss();
     memoryUsage.uss = smapFile.Uss();
-    memoryUsage.swap_zram = smapFile.SwapPss() * mZramCompressionRatio;
+    memoryUsage.swap_zram = smapFile.SwapPss() * zramCompressionRatio;
 
     return memoryUsage;
 }
@@ -20,13 +20,17 @@
 #pragma once
 
 #include "Log.h"
+#include "CollectionContext.h"
 #include "Measurement.h"
+#include <memory>
 #include <utility>
 #include <vector>
 #include <string>
 #include <set>
 #include "Process.h"
 
+class OverheadTracker;
+
 /**
  * Originally memcapture integrated the Android Procrank library. This is now replaced with a custom implementation of procrank
  * to read the memory values from the smaps/smaps_rollups file for increased performance.
@@ -73,13 +77,12 @@ public:
     };
 
 public:
-    Procrank();
+    explicit Procrank(const CollectionContext &context,
+                      std::shared_ptr<OverheadTracker> overheadTracker = nullptr);
 
     ~Procrank();
 
-    std::vector<ProcessMemoryUsage> GetMemoryUsage() const;
-
-    long swapTotalKb();
+    std::vector<ProcessMemoryUsage> GetMemoryUsage(const CollectionContext::TickValues &tickValues) const;
 
 private:
     template<typename T>
@@ -102,13 +105,12 @@ private:
         return true;
     }
 
-    double zramCompressionRatio();
-
     [[nodiscard]] std::set<pid_t> getRunningProcesses() const;
 
-    ProcessMemoryUsage getProcessMemoryUsage(Process &process) const;
+    ProcessMemoryUsage getProcessMemoryUsage(Process &process, double zramCompressionRatio) const;
 
 private:
-    bool mSwapEnabled;
-    double mZramCompressionRatio;
+    const bool mSmapsRollupSupported;
+
+    const std::shared_ptr<OverheadTracker> mOverheadTracker;
 };
@@ -0,0 +1,62 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "SamplePublisher.h"
+
+#include <algorithm>
+
+void SamplePublisher::AddSink(std::shared_ptr<ISampleSink> sink)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    mSinks.emplace_back(std::move(sink));
+}
+
+void SamplePublisher::RemoveSink(const std::shared_ptr<ISampleSink> &sink)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    mSinks.erase(std::remove(mSinks.begin(), mSinks.end(), sink), mSinks.end());
+}
+
+/**
+ * @return True if anything is listening for samples. Metrics can use this to skip building samples nobody will read
+ */
+bool SamplePublisher::HasSinks() const
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    return !mSinks.empty();
+}
+
+/**
+ * @brief Hand the samples from a completed tick to every sink
+ *
+ * The tick is shared between all the sinks, so must not be modified once published
+ */
+void SamplePublisher::Publish(const std::shared_ptr<const TickSamples> &tick)
+{
+    // Take a copy of the sink list so a slow sink can't block sinks being added/removed
+    std::vector<std::shared_ptr<ISampleSink>> sinks;
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+        sinks = mSinks;
+    }
+
+    for (const auto &sink: sinks) {
+        sink->AddTick(tick);
+    }
+}
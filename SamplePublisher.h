@@ -0,0 +1,47 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ISampleSink.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Distributes the samples from each metric collection tick to all registered sinks
+ */
+class SamplePublisher
+{
+public:
+    SamplePublisher() = default;
+
+    void AddSink(std::shared_ptr<ISampleSink> sink);
+
+    void RemoveSink(const std::shared_ptr<ISampleSink> &sink);
+
+    bool HasSinks() const;
+
+    void Publish(const std::shared_ptr<const TickSamples> &tick);
+
+private:
+    mutable std::mutex mLock;
+    std::vector<std::shared_ptr<ISampleSink>> mSinks;
+};
@@ -0,0 +1,162 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * MemCapture shared memory export format
+ * ======================================
+ *
+ * A POSIX shared memory segment (shm_open) that MemCapture writes every tick into, so processes on the device can
+ * read the latest numbers without any syscalls, locks or parsing. There is a single writer (MemCapture) and any number
+ * of readers, who map the segment read-only.
+ *
+ *  +-------------------+
+ *  | Header            |
+ *  +-------------------+
+ *  | Series table      |  <- seriesCapacity * SeriesEntry
+ *  +-------------------+
+ *  | Slot 0            |  <- SlotHeader + recordCapacity * Record
+ *  | ...               |
+ *  | Slot N-1          |
+ *  +-------------------+
+ *
+ * Series
+ *  Every value MemCapture publishes belongs to a series (e.g. the Pss of a single process), identified by its position
+ *  in the series table. New entries are appended - an entry is fully written before seriesCount is incremented,
+ *  so readers can use any entry below seriesCount. The key describes the series as '\x1f' separated fields:
+ *      <dataset>\x1f<label>=<value>\x1f...\x1f<measurement>
+ *  e.g. "Processes\x1fPID=123\x1fName=foo\x1fContainer=\x1fPss". Keys longer than the entry are truncated.
+ *
+ *  Once the table is full, entries for series that haven't been written in any tick still in the ring (e.g. processes
+ *  that have exited) are reused for new series. Each entry has a generation, which is odd while the key is being
+ *  rewritten and goes up by 2 every time the entry is reused. Records carry the generation of the series they were
+ *  written for, so a reader only trusts a key if the entry's generation is the same as the record's before and after
+ *  copying it.
+ *
+ * Slots
+ *  The slots form a ring buffer of the most recent ticks. Tick N is written into slot N % slotCount. Each slot is
+ *  protected by a seqlock - the writer makes the sequence odd while writing and even once done, so a reader copies the
+ *  slot and then checks the sequence didn't change (and wasn't odd) while it was copying.
+ *
+ *  Each collector (processes, memory, pressure etc) runs on its own schedule and publishes its own ticks, so a slot only
+ *  holds the values from one collector and the latest tick is whichever collector published last. The slot's source
+ *  says which collector wrote it. Readers that want values from several collectors should read back through the
+ *  history until they've seen a tick from each source they need.
+ *
+ *  ticksWritten in the header is incremented after each tick is complete, so the latest complete tick is
+ *  ticksWritten - 1.
+ *
+ *  Values that don't fit in a slot, or in the series table, are dropped. Each slot counts the values dropped from
+ *  that tick, and the dropped counter in the header is the total since the segment was created. The capacities are
+ *  set with MemCapture's --shm-size option.
+ *
+ * All counters are 32 bit so they're lock-free on 32 bit devices too. All values are in native byte order, since the
+ * segment is never shared off the device.
+ */
+namespace ShmFormat
+{
+    constexpr char kMagic[8] = {'M', 'E', 'M', 'C', 'S', 'H', 'M', '\0'};
+    constexpr uint32_t kVersion = 3;
+
+    constexpr size_t kSeriesKeySize = 248;
+    constexpr char kKeySeparator = '\x1f';
+
+    enum class State : uint32_t
+    {
+        Running = 1,
+        // MemCapture has stopped and won't write any more ticks
+        Stopped = 2,
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        // Size of each structure, so readers can check they agree on the layout
+        uint32_t headerSize;
+        uint32_t seriesEntrySize;
+        uint32_t slotHeaderSize;
+        uint32_t recordSize;
+
+        uint32_t seriesCapacity;
+        uint32_t slotCount;
+        uint32_t recordCapacity;
+
+        // Offsets from the start of the segment
+        uint64_t seriesOffset;
+        uint64_t slotsOffset;
+        uint64_t slotSize;
+
+        std::atomic<uint32_t> state;
+        std::atomic<uint32_t> seriesCount;
+        std::atomic<uint32_t> ticksWritten;
+        // Total number of values dropped because they didn't fit in a slot or the series table
+        std::atomic<uint32_t> dropped;
+    };
+
+    struct SeriesEntry
+    {
+        uint32_t keyLength;
+        // Odd while the key is being rewritten for a new series
+        std::atomic<uint32_t> generation;
+        char key[kSeriesKeySize];
+    };
+
+    // Collector that published a tick
+    enum class Source : uint32_t
+    {
+        Unknown = 0,
+        Processes = 1,
+        Memory = 2,
+        Pressure = 3,
+        PressureEvents = 4,
+        MemoryEvents = 5,
+    };
+
+    struct SlotHeader
+    {
+        // Odd while the slot is being written
+        std::atomic<uint32_t> sequence;
+        uint32_t tick;
+        int64_t timestamp;
+        uint32_t recordCount;
+        // Number of values that didn't fit in the slot or the series table
+        uint32_t dropped;
+        Source source;
+        uint32_t reserved;
+    };
+
+    struct Record
+    {
+        uint32_t series;
+        // Generation of the series entry when the value was written
+        uint32_t generation;
+        double value;
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared memory counters must be lock-free");
+    static_assert(sizeof(SeriesEntry) == 256, "SeriesEntry must be packed");
+    static_assert(sizeof(SlotHeader) == 32, "SlotHeader must be packed");
+    static_assert(sizeof(Record) == 16, "Record must be packed");
+}
@@ -0,0 +1,340 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ShmPublisher.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static ShmFormat::Source toShmSource(TickSource source)
+{
+    switch (source) {
+        case TickSource::Processes:
+            return ShmFormat::Source::Processes;
+        case TickSource::Memory:
+            return ShmFormat::Source::Memory;
+        case TickSource::Pressure:
+            return ShmFormat::Source::Pressure;
+        case TickSource::PressureEvents:
+            return ShmFormat::Source::PressureEvents;
+        case TickSource::MemoryEvents:
+            return ShmFormat::Source::MemoryEvents;
+        default:
+            return ShmFormat::Source::Unknown;
+    }
+}
+
+/**
+ * @param name Name of the shared memory segment, e.g. "/memcapture"
+ * @param slotCount Number of ticks to keep
+ * @param recordCapacity Maximum number of values in a single tick
+ * @param seriesCapacity Maximum number of series over the lifetime of the segment
+ */
+ShmPublisher::ShmPublisher(std::string name, uint32_t slotCount, uint32_t recordCapacity, uint32_t seriesCapacity)
+        : mName(std::move(name)),
+          mSlotCount(slotCount),
+          mRecordCapacity(recordCapacity),
+          mSeriesCapacity(seriesCapacity),
+          mSegment(nullptr),
+          mSegmentSize(0),
+          mHeader(nullptr),
+          mRecords(nullptr),
+          mTick(0),
+          mRecordCount(0),
+          mDropped(0),
+          mReclaimed(false)
+{
+    if (mName.empty() || mName[0] != '/') {
+        LOG_ERROR("Shared memory name '%s' must start with '/'", mName.c_str());
+        return;
+    }
+
+    if (!open()) {
+        Stop();
+    }
+}
+
+ShmPublisher::~ShmPublisher()
+{
+    Stop();
+}
+
+bool ShmPublisher::IsOpen() const
+{
+    return mHeader != nullptr;
+}
+
+bool ShmPublisher::open()
+{
+    const size_t slotSize = sizeof(ShmFormat::SlotHeader) + mRecordCapacity * sizeof(ShmFormat::Record);
+    const size_t seriesOffset = sizeof(ShmFormat::Header);
+    const size_t slotsOffset = seriesOffset + mSeriesCapacity * sizeof(ShmFormat::SeriesEntry);
+    mSegmentSize = slotsOffset + mSlotCount * slotSize;
+
+    // Start from scratch every time, readers of an old segment keep their own mapping
+    shm_unlink(mName.c_str());
+
+    int fd = shm_open(mName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_SYS_ERROR(errno, "Failed to create shared memory %s", mName.c_str());
+        return false;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(mSegmentSize)) < 0) {
+        LOG_SYS_ERROR(errno, "Failed to size shared memory %s", mName.c_str());
+        close(fd);
+        return false;
+    }
+
+    mSegment = mmap(nullptr, mSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mSegment == MAP_FAILED) {
+        LOG_SYS_ERROR(errno, "Failed to map shared memory %s", mName.c_str());
+        mSegment = nullptr;
+        return false;
+    }
+
+    // Fresh segment is zero filled, so all slot sequences start at 0 (empty)
+    mHeader = new(mSegment) ShmFormat::Header();
+    memcpy(mHeader->magic, ShmFormat::kMagic, sizeof(mHeader->magic));
+    mHeader->version = ShmFormat::kVersion;
+    mHeader->headerSize = sizeof(ShmFormat::Header);
+    mHeader->seriesEntrySize = sizeof(ShmFormat::SeriesEntry);
+    mHeader->slotHeaderSize = sizeof(ShmFormat::SlotHeader);
+    mHeader->recordSize = sizeof(ShmFormat::Record);
+    mHeader->seriesCapacity = mSeriesCapacity;
+    mHeader->slotCount = mSlotCount;
+    mHeader->recordCapacity = mRecordCapacity;
+    mHeader->seriesOffset = seriesOffset;
+    mHeader->slotsOffset = slotsOffset;
+    mHeader->slotSize = slotSize;
+    mHeader->seriesCount.store(0, std::memory_order_relaxed);
+    mHeader->ticksWritten.store(0, std::memory_order_relaxed);
+    mHeader->dropped.store(0, std::memory_order_relaxed);
+    mHeader->state.store(static_cast<uint32_t>(ShmFormat::State::Running), std::memory_order_release);
+
+    LOG_INFO("Publishing samples to shared memory %s (%zu KB)", mName.c_str(), mSegmentSize / 1024);
+    return true;
+}
+
+/**
+ * @brief Mark the segment as stopped and remove it. Readers that already have it mapped can still read the last ticks
+ */
+void ShmPublisher::Stop()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (mHeader) {
+        mHeader->state.store(static_cast<uint32_t>(ShmFormat::State::Stopped), std::memory_order_release);
+        mHeader = nullptr;
+    }
+
+    if (mSegment) {
+        munmap(mSegment, mSegmentSize);
+        mSegment = nullptr;
+        shm_unlink(mName.c_str());
+    }
+}
+
+void ShmPublisher::AddTick(const std::shared_ptr<const TickSamples> &tick)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    if (!mHeader) {
+        return;
+    }
+
+    const uint32_t tickIndex = mHeader->ticksWritten.load(std::memory_order_relaxed);
+    auto slotHeader = slot(tickIndex);
+
+    // Seqlock write - readers that see an odd sequence, or a different sequence after copying, discard what they read
+    const uint32_t sequence = slotHeader->sequence.load(std::memory_order_relaxed);
+    slotHeader->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mRecords = reinterpret_cast<ShmFormat::Record *>(reinterpret_cast<char *>(slotHeader) +
+                                                     sizeof(ShmFormat::SlotHeader));
+    mTick = tickIndex;
+    mRecordCount = 0;
+    mDropped = 0;
+    mReclaimed = false;
+
+    std::string key;
+    for (const auto &process: tick->processes) {
+        key = "Processes";
+        key += ShmFormat::kKeySeparator;
+        key += "PID=" + std::to_string(process.process.pid());
+        key += ShmFormat::kKeySeparator;
+        key += "Name=" + process.process.name();
+        key += ShmFormat::kKeySeparator;
+        key += "Container=" + process.process.container().value_or("");
+        key += ShmFormat::kKeySeparator;
+        const auto prefixLength = key.size();
+
+        const std::pair<const char *, uint64_t> values[] = {
+                {"Pss",      process.pss},
+                {"Rss",      process.rss},
+                {"Uss",      process.uss},
+                {"Vss",      process.vss},
+                {"Swap",     process.swap},
+                {"SwapPss",  process.swap_pss},
+                {"SwapZram", process.swap_zram},
+                {"Locked",   process.locked}
+        };
+
+        for (const auto &value: values) {
+            key.resize(prefixLength);
+            key += value.first;
+            addRecord(key, value.second);
+        }
+    }
+
+    for (const auto &sample: tick->datasets) {
+        key = sample.dataset;
+        for (const auto &label: sample.labels) {
+            key += ShmFormat::kKeySeparator;
+            key += label.first + "=" + label.second;
+        }
+        key += ShmFormat::kKeySeparator;
+        key += sample.measurement;
+
+        addRecord(key, sample.value);
+    }
+
+    slotHeader->tick = tickIndex;
+    slotHeader->timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            tick->timestamp.time_since_epoch()).count();
+    slotHeader->recordCount = mRecordCount;
+    slotHeader->dropped = mDropped;
+    slotHeader->source = toShmSource(tick->source);
+
+    slotHeader->sequence.store(sequence + 2, std::memory_order_release);
+    mHeader->ticksWritten.store(tickIndex + 1, std::memory_order_release);
+
+    if (mDropped > 0) {
+        mHeader->dropped.fetch_add(mDropped, std::memory_order_release);
+        LOG_WARN("Dropped %u values that didn't fit in shared memory (see --shm-size)", mDropped);
+    }
+}
+
+void ShmPublisher::addRecord(const std::string &key, long double value)
+{
+    auto series = internSeries(key);
+    if (series == UINT32_MAX || mRecordCount >= mRecordCapacity) {
+        mDropped++;
+        return;
+    }
+
+    auto entries = reinterpret_cast<ShmFormat::SeriesEntry *>(static_cast<char *>(mSegment) + mHeader->seriesOffset);
+
+    auto &record = mRecords[mRecordCount++];
+    record.series = series;
+    record.generation = entries[series].generation.load(std::memory_order_relaxed);
+    record.value = static_cast<double>(value);
+}
+
+/**
+ * @return Id of the series, adding it to the series table if it's new. UINT32_MAX if the series table is full
+ */
+uint32_t ShmPublisher::internSeries(const std::string &key)
+{
+    auto itr = mSeries.find(key);
+    if (itr != mSeries.end()) {
+        mSeriesState[itr->second].lastTick = mTick;
+        return itr->second;
+    }
+
+    auto entries = reinterpret_cast<ShmFormat::SeriesEntry *>(static_cast<char *>(mSegment) + mHeader->seriesOffset);
+    const auto keyLength = static_cast<uint32_t>(std::min(key.size(), ShmFormat::kSeriesKeySize));
+
+    uint32_t id = mHeader->seriesCount.load(std::memory_order_relaxed);
+    if (id < mSeriesCapacity) {
+        auto &entry = entries[id];
+        entry.keyLength = keyLength;
+        memcpy(entry.key, key.data(), keyLength);
+
+        // Publish the entry only once it's complete
+        mHeader->seriesCount.store(id + 1, std::memory_order_release);
+        mSeriesState.push_back({key, mTick});
+    } else {
+        if (mFreeSeries.empty()) {
+            reclaimSeries();
+            if (mFreeSeries.empty()) {
+                return UINT32_MAX;
+            }
+        }
+
+        id = mFreeSeries.back();
+        mFreeSeries.pop_back();
+
+        // Same as a seqlock - readers that see an odd generation, or a different generation after copying the key,
+        // discard what they read
+        auto &entry = entries[id];
+        const uint32_t generation = entry.generation.load(std::memory_order_relaxed);
+        entry.generation.store(generation + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        entry.keyLength = keyLength;
+        memcpy(entry.key, key.data(), keyLength);
+
+        entry.generation.store(generation + 2, std::memory_order_release);
+        mSeriesState[id] = {key, mTick};
+    }
+
+    mSeries.emplace(key, id);
+    return id;
+}
+
+/**
+ * @brief Free the entries for series that haven't been written in any tick still in the ring, e.g. processes that
+ * have exited. Only scans the table once per tick, since a second scan in the same tick wouldn't find anything new
+ */
+void ShmPublisher::reclaimSeries()
+{
+    if (mReclaimed) {
+        return;
+    }
+    mReclaimed = true;
+
+    for (uint32_t id = 0; id < mSeriesState.size(); id++) {
+        auto &state = mSeriesState[id];
+        if (state.key.empty() || mTick - state.lastTick < mSlotCount) {
+            continue;
+        }
+
+        mSeries.erase(state.key);
+        state.key.clear();
+        mFreeSeries.push_back(id);
+    }
+
+    if (!mFreeSeries.empty()) {
+        LOG_DEBUG("Reusing %zu shared memory series that are no longer written", mFreeSeries.size());
+    }
+}
+
+ShmFormat::SlotHeader *ShmPublisher::slot(uint32_t tick) const
+{
+    return reinterpret_cast<ShmFormat::SlotHeader *>(static_cast<char *>(mSegment) + mHeader->slotsOffset +
+                                                     (tick % mSlotCount) * mHeader->slotSize);
+}
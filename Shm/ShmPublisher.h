@@ -0,0 +1,91 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ISampleSink.h"
+#include "ShmFormat.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Publishes each tick into a POSIX shared memory ring buffer for other processes to read (see ShmFormat.h)
+ *
+ * Writing a tick is just copying fixed size records into the segment, so it's done straight away on the collection
+ * thread rather than being handed off.
+ */
+class ShmPublisher : public ISampleSink
+{
+public:
+    explicit ShmPublisher(std::string name, uint32_t slotCount = 16, uint32_t recordCapacity = 4096,
+                          uint32_t seriesCapacity = 8192);
+
+    ~ShmPublisher() override;
+
+    bool IsOpen() const;
+
+    void Stop();
+
+    void AddTick(const std::shared_ptr<const TickSamples> &tick) override;
+
+private:
+    bool open();
+
+    uint32_t internSeries(const std::string &key);
+
+    void reclaimSeries();
+
+    void addRecord(const std::string &key, long double value);
+
+    ShmFormat::SlotHeader *slot(uint32_t tick) const;
+
+private:
+    const std::string mName;
+    const uint32_t mSlotCount;
+    const uint32_t mRecordCapacity;
+    const uint32_t mSeriesCapacity;
+
+    void *mSegment;
+    size_t mSegmentSize;
+    ShmFormat::Header *mHeader;
+
+    // Only one tick can be written at a time
+    std::mutex mLock;
+    std::unordered_map<std::string, uint32_t> mSeries;
+
+    // Key and last tick written for each entry in the series table, so entries for series that have gone away can be
+    // reused once no slot refers to them
+    struct SeriesState
+    {
+        std::string key;
+        uint32_t lastTick;
+    };
+    std::vector<SeriesState> mSeriesState;
+    std::vector<uint32_t> mFreeSeries;
+
+    // State of the tick currently being written
+    ShmFormat::Record *mRecords;
+    uint32_t mTick;
+    uint32_t mRecordCount;
+    uint32_t mDropped;
+    bool mReclaimed;
+};
@@ -0,0 +1,256 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ShmReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ShmReader::ShmReader() : mSegment(nullptr), mSegmentSize(0), mHeader(nullptr)
+{
+}
+
+ShmReader::~ShmReader()
+{
+    Close();
+}
+
+/**
+ * @brief Map the shared memory segment read-only and check it's a format we understand
+ *
+ * @param name Name MemCapture was told to publish to, e.g. "/memcapture"
+ */
+bool ShmReader::Open(const std::string &name)
+{
+    Close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(ShmFormat::Header)) {
+        close(fd);
+        return false;
+    }
+
+    mSegmentSize = st.st_size;
+    void *segment = mmap(nullptr, mSegmentSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (segment == MAP_FAILED) {
+        return false;
+    }
+    mSegment = segment;
+
+    auto header = static_cast<const ShmFormat::Header *>(mSegment);
+    const bool valid = memcmp(header->magic, ShmFormat::kMagic, sizeof(header->magic)) == 0 &&
+                       header->version == ShmFormat::kVersion &&
+                       header->headerSize == sizeof(ShmFormat::Header) &&
+                       header->seriesEntrySize == sizeof(ShmFormat::SeriesEntry) &&
+                       header->slotHeaderSize == sizeof(ShmFormat::SlotHeader) &&
+                       header->recordSize == sizeof(ShmFormat::Record) &&
+                       header->slotCount > 0 &&
+                       header->slotsOffset + header->slotCount * header->slotSize <= mSegmentSize &&
+                       header->seriesOffset + header->seriesCapacity * sizeof(ShmFormat::SeriesEntry) <=
+                       header->slotsOffset;
+
+    if (!valid) {
+        Close();
+        return false;
+    }
+
+    mHeader = header;
+    return true;
+}
+
+void ShmReader::Close()
+{
+    if (mSegment) {
+        munmap(const_cast<void *>(mSegment), mSegmentSize);
+    }
+
+    mSegment = nullptr;
+    mSegmentSize = 0;
+    mHeader = nullptr;
+}
+
+/**
+ * @return False once MemCapture has stopped publishing (the last ticks can still be read)
+ */
+bool ShmReader::IsRunning() const
+{
+    return mHeader && mHeader->state.load(std::memory_order_acquire) ==
+                      static_cast<uint32_t>(ShmFormat::State::Running);
+}
+
+/**
+ * @return Number of complete ticks written so far. The latest tick is TicksWritten() - 1
+ */
+uint32_t ShmReader::TicksWritten() const
+{
+    return mHeader ? mHeader->ticksWritten.load(std::memory_order_acquire) : 0;
+}
+
+/**
+ * @return How many ticks of history are kept
+ */
+uint32_t ShmReader::SlotCount() const
+{
+    return mHeader ? mHeader->slotCount : 0;
+}
+
+/**
+ * @brief Copy a tick out of shared memory
+ *
+ * To tail the history, remember the last index read and read each index up to TicksWritten() - 1. If a reader falls
+ * more than SlotCount() ticks behind, the older ticks have been overwritten and this returns false.
+ *
+ * @param index Tick to read
+ * @param[out] tick Copy of the tick. The records vector is reused to avoid allocating on every read
+ * @return False if the tick hasn't been written yet or has already been overwritten
+ */
+bool ShmReader::ReadTick(uint32_t index, Tick &tick) const
+{
+    if (!mHeader || index >= TicksWritten()) {
+        return false;
+    }
+
+    auto slotHeader = slot(index);
+    auto records = reinterpret_cast<const ShmFormat::Record *>(reinterpret_cast<const char *>(slotHeader) +
+                                                               sizeof(ShmFormat::SlotHeader));
+
+    while (true) {
+        const uint32_t before = slotHeader->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            // Writer is part way through this slot. It can only be writing a newer tick than the one we want
+            return false;
+        }
+
+        const uint32_t tickIndex = slotHeader->tick;
+        const uint32_t recordCount = std::min(slotHeader->recordCount, mHeader->recordCapacity);
+
+        tick.index = tickIndex;
+        tick.timestamp = slotHeader->timestamp;
+        tick.dropped = slotHeader->dropped;
+        tick.source = slotHeader->source;
+        tick.records.resize(recordCount);
+        memcpy(tick.records.data(), records, recordCount * sizeof(ShmFormat::Record));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint32_t after = slotHeader->sequence.load(std::memory_order_relaxed);
+
+        if (before == after) {
+            // Slot might have moved on to a newer tick before we started reading
+            return tickIndex == index;
+        }
+    }
+}
+
+/**
+ * @brief Copy the most recent complete tick
+ */
+bool ShmReader::ReadLatest(Tick &tick) const
+{
+    // A new tick might overwrite the slot while we're reading it, in which case try again with the new latest
+    for (int attempt = 0; attempt < 4; attempt++) {
+        const uint32_t written = TicksWritten();
+        if (written == 0) {
+            return false;
+        }
+
+        if (ReadTick(written - 1, tick)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Copy the most recent complete tick published by a particular collector
+ *
+ * @return False if none of the ticks still in the ring came from that collector
+ */
+bool ShmReader::ReadLatest(ShmFormat::Source source, Tick &tick) const
+{
+    const uint32_t written = TicksWritten();
+    const uint32_t oldest = written > SlotCount() ? written - SlotCount() : 0;
+
+    for (uint32_t index = written; index > oldest; index--) {
+        // Skips over any tick that was overwritten while being read, and carries on with the older ones
+        if (ReadTick(index - 1, tick) && tick.source == source) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @return Total number of values MemCapture couldn't fit in shared memory since it started publishing
+ */
+uint32_t ShmReader::Dropped() const
+{
+    return mHeader ? mHeader->dropped.load(std::memory_order_acquire) : 0;
+}
+
+uint32_t ShmReader::SeriesCount() const
+{
+    return mHeader ? mHeader->seriesCount.load(std::memory_order_acquire) : 0;
+}
+
+/**
+ * @brief Copy the key describing the series a record belongs to (see ShmFormat.h)
+ *
+ * @param record Record read from a tick
+ * @param[out] key Key of the series
+ * @return False if the series entry has since been reused for a different series, so the record's key is gone
+ */
+bool ShmReader::SeriesKey(const ShmFormat::Record &record, std::string &key) const
+{
+    if (record.series >= SeriesCount()) {
+        return false;
+    }
+
+    auto entries = reinterpret_cast<const ShmFormat::SeriesEntry *>(static_cast<const char *>(mSegment) +
+                                                                    mHeader->seriesOffset);
+    const auto &entry = entries[record.series];
+
+    const uint32_t before = entry.generation.load(std::memory_order_acquire);
+    if (before != record.generation) {
+        return false;
+    }
+
+    key.assign(entry.key, std::min<size_t>(entry.keyLength, ShmFormat::kSeriesKeySize));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return entry.generation.load(std::memory_order_relaxed) == before;
+}
+
+const ShmFormat::SlotHeader *ShmReader::slot(uint32_t tick) const
+{
+    return reinterpret_cast<const ShmFormat::SlotHeader *>(static_cast<const char *>(mSegment) + mHeader->slotsOffset +
+                                                           (tick % mHeader->slotCount) * mHeader->slotSize);
+}
@@ -0,0 +1,99 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "ShmFormat.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Read the ticks MemCapture publishes to shared memory (see ShmFormat.h)
+ *
+ * Once opened, reading never makes a syscall or takes a lock - ticks are copied out of the mapping and checked against
+ * the slot's sequence, retrying if MemCapture was writing the slot at the same time.
+ *
+ * Every tick holds the values from a single collector, given by its source. ReadLatest() returns whichever collector
+ * published last, so pass a source to get the latest tick from a particular collector instead.
+ *
+ * Example:
+ *      ShmReader reader;
+ *      reader.Open("/memcapture");
+ *
+ *      ShmReader::Tick tick;
+ *      std::string key;
+ *      if (reader.ReadLatest(ShmFormat::Source::Memory, tick)) {
+ *          for (const auto &record: tick.records) {
+ *              if (reader.SeriesKey(record, key)) {
+ *                  printf("%s = %f\n", key.c_str(), record.value);
+ *              }
+ *          }
+ *      }
+ */
+class ShmReader
+{
+public:
+    struct Tick
+    {
+        uint32_t index = 0;
+        int64_t timestamp = 0;
+        uint32_t dropped = 0;
+        ShmFormat::Source source = ShmFormat::Source::Unknown;
+        std::vector<ShmFormat::Record> records;
+    };
+
+    ShmReader();
+
+    ~ShmReader();
+
+    ShmReader(const ShmReader &) = delete;
+
+    ShmReader &operator=(const ShmReader &) = delete;
+
+    bool Open(const std::string &name);
+
+    void Close();
+
+    bool IsRunning() const;
+
+    uint32_t TicksWritten() const;
+
+    uint32_t SlotCount() const;
+
+    bool ReadTick(uint32_t index, Tick &tick) const;
+
+    bool ReadLatest(Tick &tick) const;
+
+    bool ReadLatest(ShmFormat::Source source, Tick &tick) const;
+
+    uint32_t Dropped() const;
+
+    uint32_t SeriesCount() const;
+
+    bool SeriesKey(const ShmFormat::Record &record, std::string &key) const;
+
+private:
+    const ShmFormat::SlotHeader *slot(uint32_t tick) const;
+
+private:
+    const void *mSegment;
+    size_t mSegmentSize;
+    const ShmFormat::Header *mHeader;
+};
@@ -0,0 +1,93 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+/**
+ * Minimal helpers for timing a piece of code in the MemCaptureBench benchmarks
+ */
+namespace Bench
+{
+    /**
+     * Prevent the compiler optimising away a result that is otherwise unused
+     */
+    template<typename T>
+    inline void DoNotOptimise(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * Time running the function the given number of times
+     *
+     * @return Average time per iteration in nanoseconds
+     */
+    template<typename F>
+    double Time(size_t iterations, F &&func)
+    {
+        // Warm up caches before timing
+        func();
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            func();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+    }
+
+    /**
+     * Run the function the given number of times and print the average time per iteration
+     *
+     * @return Average time per iteration in nanoseconds
+     */
+    template<typename F>
+    double Run(const std::string &name, size_t iterations, F &&func)
+    {
+        double nsPerIteration = Time(iterations, func);
+
+        printf("%-50s %12.0f ns/iter (%zu iterations)\n", name.c_str(), nsPerIteration, iterations);
+        return nsPerIteration;
+    }
+
+    /**
+     * Run a parser over some input the given number of times and print the time per line and throughput
+     *
+     * @param bytes Size of the input parsed each iteration
+     * @param lines Number of lines in the input
+     * @return Average time per iteration in nanoseconds
+     */
+    template<typename F>
+    double RunParser(const std::string &name, size_t iterations, size_t bytes, size_t lines, F &&func)
+    {
+        double nsPerIteration = Time(iterations, func);
+
+        double nsPerLine = lines > 0 ? nsPerIteration / static_cast<double>(lines) : 0;
+        double mbPerSecond = (static_cast<double>(bytes) / (1024.0 * 1024.0)) / (nsPerIteration / 1e9);
+
+        printf("%-64s %10.1f ns/line %10.1f MB/s (%zu lines, %zu iterations)\n", name.c_str(), nsPerLine,
+               mbPerSecond, lines, iterations);
+        return nsPerIteration;
+    }
+}
@@ -0,0 +1,214 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "GroupMatcherBench.h"
+#include "Bench.h"
+
+#include "Group.h"
+#include "GroupManager.h"
+
+#include <fstream>
+#include <random>
+
+namespace
+{
+    /**
+     * Generate a groups file in the same format as groups.example.json. Most patterns are plain process names, with
+     * roughly 4 in 10 being a real regex
+     */
+    nlohmann::json generateGroups(size_t ruleCount)
+    {
+        constexpr size_t rulesPerGroup = 5;
+
+        nlohmann::json groups;
+        groups["containers"] = nlohmann::json::array();
+        groups["processes"] = nlohmann::json::array();
+
+        for (size_t rule = 0; rule < ruleCount; rule += rulesPerGroup) {
+            nlohmann::json group;
+            group["group"] = "Group " + std::to_string(rule / rulesPerGroup);
+            group["processes"] = nlohmann::json::array();
+
+            for (size_t i = rule; i < std::min(rule + rulesPerGroup, ruleCount); i++) {
+                // Braced quantifiers have digits that mustn't be mistaken for text the name has to contain
+                const std::string letter(1, static_cast<char>('a' + i % 26));
+                if (i % 10 == 9) {
+                    group["processes"].emplace_back("^worker" + std::to_string(i) + "-[0-9]+$");
+                } else if (i % 10 == 8) {
+                    group["processes"].emplace_back(letter + "b{2,3}c");
+                } else if (i % 10 == 7) {
+                    group["processes"].emplace_back("^" + letter + "\\d{4}$");
+                } else if (i % 10 == 6) {
+                    // Likewise the character codes in escapes like \x2d
+                    group["processes"].emplace_back(letter + "\\x2dd\\u0061emon");
+                } else {
+                    group["processes"].emplace_back("service" + std::to_string(i) + "Mgr");
+                }
+            }
+
+            groups["processes"].emplace_back(group);
+        }
+
+        return groups;
+    }
+
+    /**
+     * Build process names and cmdlines that hit early rules, late rules, regex rules and nothing at all
+     */
+    std::vector<std::string> generateNames(size_t ruleCount, size_t nameCount)
+    {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> ruleDist(0, ruleCount - 1);
+
+        std::vector<std::string> names;
+        names.reserve(nameCount);
+
+        for (size_t i = 0; i < nameCount; i++) {
+            auto rule = ruleDist(rng);
+
+            switch (i % 4) {
+                case 0: {
+                    const std::string letter(1, static_cast<char>('a' + rule % 26));
+                    if (rule % 10 == 9) {
+                        names.emplace_back("worker" + std::to_string(rule) + "-" + std::to_string(i));
+                    } else if (rule % 10 == 8) {
+                        names.emplace_back(letter + "bbc");
+                    } else if (rule % 10 == 7) {
+                        names.emplace_back(letter + "1230");
+                    } else if (rule % 10 == 6) {
+                        names.emplace_back(letter + "-daemon");
+                    } else {
+                        names.emplace_back("service" + std::to_string(rule) + "Mgr");
+                    }
+                    break;
+                }
+                case 1:
+                    names.emplace_back("/usr/bin/service" + std::to_string(rule) + "Mgr --config /etc/service.conf");
+                    break;
+                case 2:
+                    names.emplace_back("kworker/" + std::to_string(i % 8) + ":" + std::to_string(i % 3));
+                    break;
+                default:
+                    names.emplace_back("/usr/libexec/unmatched-daemon-" + std::to_string(i) + " --verbose --no-fork");
+                    break;
+            }
+        }
+
+        return names;
+    }
+
+    /**
+     * The original implementation - run each group's regexes in turn
+     */
+    class NaiveGroups
+    {
+    public:
+        explicit NaiveGroups(const nlohmann::json &groupList)
+        {
+            for (const auto &group: groupList["processes"]) {
+                std::vector<std::regex> regexes;
+                for (const auto &pattern: group["processes"]) {
+                    regexes.emplace_back(pattern.get<std::string>());
+                }
+                mGroups.emplace_back(group["group"].get<std::string>(), regexes);
+            }
+        }
+
+        std::optional<std::string> getGroup(const std::string &name) const
+        {
+            for (const auto &group: mGroups) {
+                if (group.isMatch(name)) {
+                    return group.name();
+                }
+            }
+            return std::nullopt;
+        }
+
+    private:
+        std::vector<Group> mGroups;
+    };
+}
+
+/**
+ * Compare GroupManager's compiled matcher against running std::regex_search over every rule
+ *
+ * @param groupsFile Groups file to benchmark with. If empty, a 500 rule file is generated
+ * @return False if the matchers disagree on any name
+ */
+bool RunGroupMatcherBench(const std::string &groupsFile)
+{
+    constexpr size_t defaultRuleCount = 500;
+    constexpr size_t nameCount = 2000;
+
+    nlohmann::json groupList;
+    size_t ruleCount = defaultRuleCount;
+
+    if (groupsFile.empty()) {
+        groupList = generateGroups(defaultRuleCount);
+    } else {
+        std::ifstream file(groupsFile);
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", groupsFile.c_str());
+            return false;
+        }
+        groupList = nlohmann::json::parse(file);
+
+        ruleCount = 0;
+        for (const auto &group: groupList["processes"]) {
+            ruleCount += group["processes"].size();
+        }
+    }
+
+    printf("== Group matching: %zu rules, %zu names ==\n", ruleCount, nameCount);
+
+    auto names = generateNames(std::max<size_t>(ruleCount, 1), nameCount);
+
+    NaiveGroups naive(groupList);
+    GroupManager groupManager(groupList);
+
+    // Make sure both give the same answer before timing them
+    size_t mismatches = 0;
+    for (const auto &name: names) {
+        if (naive.getGroup(name) != groupManager.getGroup(GroupManager::groupType::PROCESS, name)) {
+            mismatches++;
+        }
+    }
+
+    if (mismatches > 0) {
+        fprintf(stderr, "Compiled matcher disagreed with std::regex on %zu names\n", mismatches);
+        return false;
+    }
+
+    auto naiveNs = Bench::Run("regex_search per rule (all names)", 5, [&]()
+    {
+        for (const auto &name: names) {
+            Bench::DoNotOptimise(naive.getGroup(name));
+        }
+    });
+
+    auto compiledNs = Bench::Run("GroupManager::getGroup (all names)", 50, [&]()
+    {
+        for (const auto &name: names) {
+            Bench::DoNotOptimise(groupManager.getGroup(GroupManager::groupType::PROCESS, name));
+        }
+    });
+
+    printf("Speedup: %.1fx\n\n", naiveNs / compiledNs);
+    return true;
+}
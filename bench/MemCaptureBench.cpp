@@ -0,0 +1,127 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "GroupMatcherBench.h"
+#include "ParserBench.h"
+#include "ReportBench.h"
+
+static std::string gGroupsFile;
+static std::string gFixturesDir = MEMCAPTURE_BENCH_FIXTURES_DIR;
+static std::string gBenchmarks = "groups,parsers,report";
+static size_t gReportProcesses = 10000;
+static size_t gReportTicks = 30000;
+static std::string gSummaryFile;
+
+static void displayUsage()
+{
+    printf("Usage: MemCaptureBench <option(s)>\n");
+    printf("    Benchmarks for the MemCapture internals\n\n");
+    printf("    -h, --help          Print this help and exit\n");
+    printf("    -g, --groups        Groups file to benchmark group matching with. Default generates 500 rules\n");
+    printf("    -f, --fixtures      Directory of procfs/sysfs files to benchmark the parsers with. Default %s\n",
+           MEMCAPTURE_BENCH_FIXTURES_DIR);
+    printf("    -b, --bench         Comma separated benchmarks to run. Default %s\n", gBenchmarks.c_str());
+    printf("    -p, --processes     Number of processes in the report benchmark. Default %zu\n", gReportProcesses);
+    printf("    -t, --ticks         Number of ticks in the report benchmark. Default %zu\n", gReportTicks);
+    printf("    -s, --summary       Save the report benchmark results as JSON to this file\n");
+}
+
+static bool enabled(const std::string &benchmark)
+{
+    return ("," + gBenchmarks + ",").find("," + benchmark + ",") != std::string::npos;
+}
+
+static void parseArgs(const int argc, char **argv)
+{
+    struct option longopts[] = {
+            {"help",   no_argument,       nullptr, (int) 'h'},
+            {"groups", required_argument, nullptr, (int) 'g'},
+            {"fixtures", required_argument, nullptr, (int) 'f'},
+            {"bench",  required_argument, nullptr, (int) 'b'},
+            {"processes", required_argument, nullptr, (int) 'p'},
+            {"ticks",  required_argument, nullptr, (int) 't'},
+            {"summary", required_argument, nullptr, (int) 's'},
+            {nullptr, 0,                  nullptr, 0}
+    };
+
+    opterr = 0;
+
+    int option;
+    int longindex;
+
+    while ((option = getopt_long(argc, argv, "hg:f:b:p:t:s:", longopts, &longindex)) != -1) {
+        switch (option) {
+            case 'h':
+                displayUsage();
+                exit(EXIT_SUCCESS);
+            case 'g':
+                gGroupsFile = std::string(optarg);
+                break;
+            case 'f':
+                gFixturesDir = std::string(optarg);
+                break;
+            case 'b':
+                gBenchmarks = std::string(optarg);
+                break;
+            case 'p':
+                gReportProcesses = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 't':
+                gReportTicks = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 's':
+                gSummaryFile = std::string(optarg);
+                break;
+            case '?':
+                if (optopt == 'g' || optopt == 'f' || optopt == 'b' || optopt == 'p' || optopt == 't' || optopt == 's') {
+                    fprintf(stderr, "Warning: Option '-%c' requires an argument\n", optopt);
+                } else if (isprint(optopt)) {
+                    fprintf(stderr, "Warning: Unknown option '-%c'\n", optopt);
+                } else {
+                    fprintf(stderr, "Warning: Unknown option character '\\x%x'\n", optopt);
+                }
+                exit(EXIT_FAILURE);
+            default:
+                exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    parseArgs(argc, argv);
+
+    bool success = true;
+    if (enabled("groups")) {
+        success &= RunGroupMatcherBench(gGroupsFile);
+    }
+    if (enabled("parsers")) {
+        success &= RunParserBench(gFixturesDir);
+    }
+    if (enabled("report")) {
+        success &= RunReportBench(gReportProcesses, gReportTicks, gSummaryFile);
+    }
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,208 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ParserBench.h"
+#include "Bench.h"
+
+#include "FileParsers/BuddyInfo.h"
+#include "FileParsers/GpuMemory.h"
+#include "FileParsers/MemInfo.h"
+#include "FileParsers/Smaps.h"
+#include "FileParsers/VmStat.h"
+#include "Process.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    // Aim to parse roughly this much data per benchmark so small and large inputs both get a stable result
+    constexpr size_t kBytesPerBenchmark = 64 * 1024 * 1024;
+
+    struct fixture
+    {
+        std::string name;
+        std::string contents;
+    };
+
+    bool loadFixture(const std::string &fixturesDir, const std::string &name, fixture &out)
+    {
+        std::ifstream file(fixturesDir + "/" + name);
+        if (!file) {
+            fprintf(stderr, "Failed to open fixture %s/%s\n", fixturesDir.c_str(), name.c_str());
+            return false;
+        }
+
+        std::stringstream contents;
+        contents << file.rdbuf();
+
+        out.name = name;
+        out.contents = contents.str();
+        return true;
+    }
+
+    /**
+     * Build a pathologically large version of a fixture by repeating its body (everything after the first
+     * headerLines lines) until it has at least the given number of lines
+     */
+    fixture makeLarge(const fixture &small, size_t headerLines, size_t minLines)
+    {
+        size_t bodyStart = 0;
+        for (size_t i = 0; i < headerLines; i++) {
+            bodyStart = small.contents.find('\n', bodyStart) + 1;
+        }
+
+        const auto header = small.contents.substr(0, bodyStart);
+        const auto body = small.contents.substr(bodyStart);
+        const auto bodyLines = std::max<size_t>(1, std::count(body.begin(), body.end(), '\n'));
+
+        fixture large{small.name + " (large)", header};
+        for (size_t lines = 0; lines < minLines; lines += bodyLines) {
+            large.contents += body;
+        }
+
+        return large;
+    }
+
+    /**
+     * Run the parser over the fixture, re-reading the same stream each time so only the parsing is measured
+     */
+    template<typename F>
+    void runParser(const std::string &parser, const fixture &input, F &&parse)
+    {
+        std::istringstream stream(input.contents);
+
+        auto lines = static_cast<size_t>(std::count(input.contents.begin(), input.contents.end(), '\n'));
+        auto iterations = std::clamp<size_t>(kBytesPerBenchmark / std::max<size_t>(1, input.contents.size()), 5,
+                                             200000);
+
+        Bench::RunParser(parser + ": " + input.name, iterations, input.contents.size(), lines, [&]()
+        {
+            stream.clear();
+            stream.seekg(0);
+            parse(stream);
+        });
+    }
+}
+
+/**
+ * Benchmark each of the file parsers against the fixtures in the given directory, and a much larger generated
+ * version of each to show how they scale
+ */
+bool RunParserBench(const std::string &fixturesDir)
+{
+    fixture meminfo, smaps, smapsRollup, buddyinfo, maliAmlogic, maliRealtek, broadcomClient, cgroup, vmstat;
+
+    if (!loadFixture(fixturesDir, "meminfo", meminfo) ||
+        !loadFixture(fixturesDir, "smaps", smaps) ||
+        !loadFixture(fixturesDir, "smaps_rollup", smapsRollup) ||
+        !loadFixture(fixturesDir, "buddyinfo", buddyinfo) ||
+        !loadFixture(fixturesDir, "gpu_memory_amlogic", maliAmlogic) ||
+        !loadFixture(fixturesDir, "gpu_memory_realtek", maliRealtek) ||
+        !loadFixture(fixturesDir, "dri_client_broadcom", broadcomClient) ||
+        !loadFixture(fixturesDir, "cgroup", cgroup) ||
+        !loadFixture(fixturesDir, "vmstat", vmstat)) {
+        return false;
+    }
+
+    printf("== File parsers: %s ==\n", fixturesDir.c_str());
+
+    // Make sure the fixtures are actually being parsed, otherwise the numbers are meaningless
+    {
+        std::istringstream meminfoStream(meminfo.contents);
+        std::istringstream smapsStream(smaps.contents);
+        std::istringstream cgroupStream(cgroup.contents);
+        std::istringstream vmstatStream(vmstat.contents);
+
+        if (MemInfo(meminfoStream).MemTotalKb() == 0 || Smaps(smapsStream, false).Pss() == 0 ||
+            Process::ParseCgroupPath(cgroupStream, "gpu").empty() || VmStat(vmstatStream).Counters().empty()) {
+            fprintf(stderr, "Fixtures in %s did not parse\n", fixturesDir.c_str());
+            return false;
+        }
+    }
+
+    auto smapsLarge = makeLarge(smaps, 0, 500000);
+    // A process with a cgroup line for every controller under the sun and the one we want at the end
+    fixture cgroupLarge{"cgroup (large)", ""};
+    for (int i = 0; i < 500; i++) {
+        cgroupLarge.contents += std::to_string(1000 + i) + ":name=controller" + std::to_string(i) + ":/\n";
+    }
+    cgroupLarge.contents += cgroup.contents;
+
+    runParser("MemInfo", meminfo, [](std::istream &stream)
+    {
+        Bench::DoNotOptimise(MemInfo(stream).MemUsedKb());
+    });
+
+    runParser("VmStat", vmstat, [](std::istream &stream)
+    {
+        Bench::DoNotOptimise(VmStat(stream).Counters().size());
+    });
+
+    for (const auto &input: {smaps, smapsLarge}) {
+        runParser("Smaps", input, [](std::istream &stream)
+        {
+            Bench::DoNotOptimise(Smaps(stream, false).Pss());
+        });
+    }
+
+    runParser("Smaps (rollup)", smapsRollup, [](std::istream &stream)
+    {
+        Bench::DoNotOptimise(Smaps(stream, true).Pss());
+    });
+
+    for (const auto &input: {buddyinfo, makeLarge(buddyinfo, 0, 10000)}) {
+        runParser("BuddyInfo", input, [](std::istream &stream)
+        {
+            Bench::DoNotOptimise(BuddyInfo(stream, 15).Zones().size());
+        });
+    }
+
+    for (const auto &input: {maliAmlogic, makeLarge(maliAmlogic, 1, 10000)}) {
+        runParser("GpuMemory::ParseMali (Amlogic)", input, [](std::istream &stream)
+        {
+            Bench::DoNotOptimise(GpuMemory::ParseMali(stream, GpuMemory::MaliFormat::Amlogic, 4096).size());
+        });
+    }
+
+    for (const auto &input: {maliRealtek, makeLarge(maliRealtek, 1, 10000)}) {
+        runParser("GpuMemory::ParseMali (Realtek)", input, [](std::istream &stream)
+        {
+            Bench::DoNotOptimise(GpuMemory::ParseMali(stream, GpuMemory::MaliFormat::Realtek, 4096).size());
+        });
+    }
+
+    for (const auto &input: {broadcomClient, makeLarge(broadcomClient, 1, 10000)}) {
+        runParser("GpuMemory::ParseBroadcomClient", input, [](std::istream &stream)
+        {
+            Bench::DoNotOptimise(GpuMemory::ParseBroadcomClient(stream).size());
+        });
+    }
+
+    for (const auto &input: {cgroup, cgroupLarge}) {
+        runParser("Process::ParseCgroupPath", input, [](std::istream &stream)
+        {
+            Bench::DoNotOptimise(Process::ParseCgroupPath(stream, "gpu").size());
+        });
+    }
+
+    printf("\n");
+    return true;
+}
@@ -0,0 +1,287 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ReportBench.h"
+#include "Bench.h"
+
+#include "GroupManager.h"
+#include "HtmlReportRenderer.h"
+#include "JsonReportGenerator.h"
+#include "Metadata.h"
+#include "ProcessAggregates.h"
+#include "ProcessMetric.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+/**
+ * Time each stage of generating the report at the end of a long capture of a large number of processes, from copying
+ * the results out of the collector through to rendering the HTML
+ */
+
+namespace
+{
+    constexpr size_t kGroupCount = 100;
+    constexpr size_t kServiceCount = 50;
+    constexpr size_t kContainerCount = 20;
+
+    struct stage
+    {
+        std::string name;
+        double ms;
+        long peakRssKb;
+        long rssDeltaKb;
+    };
+
+    long readStatusKb(const std::string &field)
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+
+        while (std::getline(status, line)) {
+            if (line.compare(0, field.size(), field) == 0 && line.size() > field.size() &&
+                line[field.size()] == ':') {
+                return std::stol(line.substr(field.size() + 1));
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * Reset the peak RSS (VmHWM) so it reflects just the next stage. Needs Linux 4.0 or later, on older kernels the
+     * peak is for the whole run
+     */
+    void resetPeakRss()
+    {
+        std::ofstream clearRefs("/proc/self/clear_refs");
+        clearRefs << "5";
+    }
+
+    template<typename F>
+    stage runStage(const std::string &name, F &&func)
+    {
+        resetPeakRss();
+        const long rssBefore = readStatusKb("VmRSS");
+
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+
+        stage result{name, std::chrono::duration<double, std::milli>(end - start).count(), readStatusKb("VmHWM"),
+                     readStatusKb("VmRSS") - rssBefore};
+
+        printf("%-64s %10.1f ms %10ld KB peak RSS %+10ld KB RSS\n", result.name.c_str(), result.ms, result.peakRssKb,
+               result.rssDeltaKb);
+        return result;
+    }
+
+    nlohmann::json generateGroups()
+    {
+        nlohmann::json groups;
+        groups["containers"] = nlohmann::json::array();
+        groups["processes"] = nlohmann::json::array();
+
+        for (size_t i = 0; i < kGroupCount; i++) {
+            nlohmann::json group;
+            group["group"] = "Group " + std::to_string(i);
+            group["processes"] = nlohmann::json::array({"app" + std::to_string(i) + "d"});
+            groups["processes"].emplace_back(group);
+        }
+
+        return groups;
+    }
+
+    /**
+     * Build processes that look like the end of a long capture. Most are grouped, some run under systemd services
+     * or in containers, and 1 in 10 is a dead short-lived process with the same cmdline as four others so
+     * deduplication has something to do
+     */
+    std::vector<processMeasurement> generateProcesses(size_t processCount, size_t tickCount)
+    {
+        std::vector<processMeasurement> processes;
+        processes.reserve(processCount);
+
+        for (size_t i = 0; i < processCount; i++) {
+            const bool dead = i % 10 == 9;
+            const auto pid = static_cast<pid_t>(1000 + i);
+
+            std::string name = dead ? "short-lived" : (i % 8 == 7 ? "misc" + std::to_string(i)
+                                                                   : "app" + std::to_string(i % kGroupCount) + "d");
+            std::string cmdline = dead ? "/usr/bin/short-lived --job " + std::to_string(i / 50)
+                                       : "/usr/bin/" + name + " --instance " + std::to_string(i);
+            std::string service = i % 3 == 0 ? "service" + std::to_string(i % kServiceCount) + ".service" : "";
+            std::string container = i % 25 == 0 ? "container" + std::to_string(i % kContainerCount) : "";
+
+            processes.emplace_back(Process(pid, dead ? 1 : 1000, name, cmdline, service, container, dead));
+        }
+
+        // Process-major so each measurement's data stays hot while it's filled
+        for (size_t i = 0; i < processes.size(); i++) {
+            auto &process = processes[i];
+            const long double base = 1000 + (i % 997) * 16;
+
+            for (size_t tick = 0; tick < tickCount; tick++) {
+                const long double wobble = tick % 64;
+
+                process.Pss.AddDataPoint(base + wobble);
+                process.Rss.AddDataPoint(base * 2 + wobble);
+                process.Uss.AddDataPoint(base / 2 + wobble);
+                process.Vss.AddDataPoint(base * 8);
+                process.Locked.AddDataPoint(0);
+                process.Swap.AddDataPoint(wobble);
+                process.SwapPss.AddDataPoint(wobble);
+                process.SwapZram.AddDataPoint(wobble / 2);
+            }
+        }
+
+        return processes;
+    }
+
+    /**
+     * Feeding every process into the aggregates for every tick takes far longer than anything being measured, and
+     * only the number of groups and ticks affects the report. Add one process per group, service and container each
+     * tick instead
+     */
+    ProcessAggregates generateAggregates(const std::shared_ptr<GroupManager> &groupManager, size_t tickCount)
+    {
+        ProcessAggregates aggregates(groupManager);
+
+        std::vector<Process> representatives;
+        for (size_t i = 0; i < std::max({kGroupCount, kServiceCount, kContainerCount}); i++) {
+            std::string name = "app" + std::to_string(i % kGroupCount) + "d";
+            representatives.emplace_back(static_cast<pid_t>(i), 1, name, "/usr/bin/" + name,
+                                         i < kServiceCount ? "service" + std::to_string(i) + ".service" : "",
+                                         i < kContainerCount ? "container" + std::to_string(i) : "", false);
+        }
+
+        for (size_t tick = 0; tick < tickCount; tick++) {
+            for (size_t i = 0; i < representatives.size(); i++) {
+                aggregates.AddSample(representatives[i], 10000 + i * 100 + (tick % 128));
+            }
+            aggregates.EndTick();
+        }
+
+        return aggregates;
+    }
+
+    bool saveSummary(const std::string &summaryFile, size_t processCount, size_t tickCount,
+                     const std::vector<stage> &stages)
+    {
+        nlohmann::json summary;
+        summary["benchmark"] = "report";
+        summary["processes"] = processCount;
+        summary["ticks"] = tickCount;
+        summary["stages"] = nlohmann::json::array();
+
+        double totalMs = 0;
+        long peakRssKb = 0;
+        for (const auto &stage: stages) {
+            summary["stages"].emplace_back(nlohmann::json{
+                    {"name",       stage.name},
+                    {"ms",         stage.ms},
+                    {"peakRssKb",  stage.peakRssKb},
+                    {"rssDeltaKb", stage.rssDeltaKb}
+            });
+
+            totalMs += stage.ms;
+            peakRssKb = std::max(peakRssKb, stage.peakRssKb);
+        }
+
+        summary["totalMs"] = totalMs;
+        summary["peakRssKb"] = peakRssKb;
+
+        std::ofstream file(summaryFile, std::ios::trunc);
+        file << summary.dump(4) << std::endl;
+        if (!file) {
+            fprintf(stderr, "Failed to save summary to %s\n", summaryFile.c_str());
+            return false;
+        }
+
+        printf("Saved summary to %s\n", summaryFile.c_str());
+        return true;
+    }
+}
+
+bool RunReportBench(size_t processCount, size_t tickCount, const std::string &summaryFile)
+{
+    printf("== Report generation: %zu processes x %zu ticks ==\n", processCount, tickCount);
+
+    auto groupManager = std::make_shared<GroupManager>(generateGroups());
+    auto metadata = std::make_shared<Metadata>("Bench", "Bench", "00:00:00:00:00:00", false, "", tickCount);
+
+    const auto outputDir = std::filesystem::temp_directory_path() / ("MemCaptureReportBench." + std::to_string(getpid()));
+    std::filesystem::create_directories(outputDir);
+
+    std::vector<stage> stages;
+
+    std::vector<processMeasurement> collected;
+    std::optional<ProcessAggregates> aggregates;
+    stages.emplace_back(runStage("Synthesise measurements", [&]()
+    {
+        collected = generateProcesses(processCount, tickCount);
+        aggregates.emplace(generateAggregates(groupManager, tickCount));
+    }));
+
+    JsonReportGenerator reportGenerator(metadata, groupManager);
+    std::vector<processMeasurement> processes;
+
+    // SaveResults works on a copy of the published snapshot
+    stages.emplace_back(runStage("SaveResults copy", [&]()
+    {
+        processes = collected;
+    }));
+
+    stages.emplace_back(runStage("DeduplicateData", [&]()
+    {
+        ProcessMetric::DeduplicateData(processes);
+    }));
+
+    stages.emplace_back(runStage("JsonReportGenerator::addProcesses", [&]()
+    {
+        reportGenerator.addProcesses(processes);
+    }));
+
+    stages.emplace_back(runStage("ProcessAggregates::AddToReport", [&]()
+    {
+        aggregates->AddToReport(reportGenerator);
+    }));
+
+    stages.emplace_back(runStage("JSON dump(4)", [&]()
+    {
+        std::ofstream outputJson(outputDir / "report.json", std::ios::trunc | std::ios::binary);
+        outputJson << reportGenerator.getJson().dump(4);
+    }));
+
+    bool success = true;
+    stages.emplace_back(runStage("HTML render", [&]()
+    {
+        success = HtmlReportRenderer::Render(reportGenerator, outputDir / "report.html");
+    }));
+
+    std::filesystem::remove_all(outputDir);
+
+    if (!summaryFile.empty()) {
+        success &= saveSummary(summaryFile, processCount, tickCount, stages);
+    }
+
+    return success;
+}
@@ -26,38 +26,60 @@
 
 #include "Platform.h"
 #include "Log.h"
+#include "CollectionContext.h"
 #include "ProcessMetric.h"
+#include "MemoryEventsMetric.h"
 #include "MemoryMetric.h"
+#include "PressureMetric.h"
+#include "OverheadTracker.h"
 #include "Metadata.h"
 #include "GroupManager.h"
 #include "ConditionVariable.h"
-
-#include "inja/inja.hpp"
+#include "SamplePublisher.h"
+#include "Capture/CaptureWriter.h"
+#include "JsonReportGenerator.h"
+#include "MetricsServer.h"
+#include "Shm/ShmPublisher.h"
+#include "Daemon.h"
+#include "FileSystem/FileSystem.h"
+#include "FileSystem/RealFileSystem.h"
+#include "FileSystem/RecordingFileSystem.h"
+#include "FileSystem/ReplayFileSystem.h"
+
+#ifdef ON_DEVICE_REPORT
+#include "HtmlReportRenderer.h"
+#endif
 
 #ifdef USE_BREAKPAD
 #include "breakpad_wrapper.h"
 #endif
 
-#define INCBIN_STYLE INCBIN_STYLE_SNAKE
-#define INCBIN_PREFIX g_
-
-#include <incbin.h>
-
-#include "JsonReportGenerator.h"
-
-INCBIN(templateHtml, "./templates/template.html");
-
 static int gDuration = 30;
 static Platform gPlatform = Platform::AMLOGIC;
 
 // Default to save in current directory if not specified
 static std::filesystem::path gOutputDirectory = std::filesystem::current_path() / "MemCaptureReport";
 
+#ifdef ON_DEVICE_REPORT
 static bool gJson = false;
+static bool gCapture = false;
+#else
+// Reports are generated off the device by MemCaptureRender, so we always need to save a capture
+static bool gCapture = true;
+#endif
 
 bool gEnableGroups = false;
 static std::filesystem::path gGroupsFile;
 
+static std::string gMetricsAddress;
+static std::string gShmName;
+static uint32_t gShmRecords = 4096;
+static uint32_t gShmSeries = 8192;
+static uint32_t gShmSlots = 16;
+static std::filesystem::path gDaemonSocket;
+static std::filesystem::path gRecordFile;
+static std::filesystem::path gReplayFile;
+
 ConditionVariable gStop;
 std::mutex gLock;
 bool gEarlyTermination = false;
@@ -69,9 +91,16 @@ static void displayUsage()
     printf("    -h, --help          Print this help and exit\n");
     printf("    -o, --output-dir    Directory to save results in\n");
     printf("    -j, --json          Save data as JSON in addition to HTML report\n");
-    printf("    -d, --duration      Amount of time (in seconds) to capture data for. Default 30 seconds\n");
+    printf("    -d, --duration      Amount of time (in seconds) to capture data for. Default 30 seconds. 0 to run until stopped\n");
     printf("    -p, --platform      Platform we're running on. Supported options = ['AMLOGIC', 'REALTEK', 'BROADCOM']. Defaults to Amlogic\n");
     printf("    -g, --groups        Path to JSON file containing the group mappings (optional)\n");
+    printf("    -c, --capture       Stream every sample to capture.memcap in the output directory as it is collected\n");
+    printf("    -m, --metrics       Serve the latest values in Prometheus format on a localhost TCP port or Unix socket path\n");
+    printf("    -s, --shm           Publish every tick to the named POSIX shared memory ring buffer (e.g. /memcapture)\n");
+    printf("    -S, --shm-size      Size the shared memory as RECORDS[,SERIES[,SLOTS]] - values per tick, distinct series and ticks kept. Default 4096,8192,16\n");
+    printf("    -D, --daemon        Run until stopped and control capture sessions over the specified Unix socket\n");
+    printf("    -r, --record        Save the raw contents of every file read to the specified file, to replay later\n");
+    printf("    -R, --replay        Read from a file saved with --record instead of the device, as fast as possible until the end of the recording\n");
 }
 
 static void parseArgs(const int argc, char **argv)
@@ -83,6 +112,13 @@ static void parseArgs(const int argc, char **argv)
             {"output-dir", required_argument, nullptr, (int) 'o'},
             {"json",       no_argument,       nullptr, (int) 'j'},
             {"groups",     required_argument, nullptr, (int) 'g'},
+            {"capture",    no_argument,       nullptr, (int) 'c'},
+            {"metrics",    required_argument, nullptr, (int) 'm'},
+            {"shm",        required_argument, nullptr, (int) 's'},
+            {"shm-size",   required_argument, nullptr, (int) 'S'},
+            {"daemon",     required_argument, nullptr, (int) 'D'},
+            {"record",     required_argument, nullptr, (int) 'r'},
+            {"replay",     required_argument, nullptr, (int) 'R'},
             {nullptr, 0,                      nullptr, 0}
     };
 
@@ -91,7 +127,7 @@ static void parseArgs(const int argc, char **argv)
     int option;
     int longindex;
 
-    while ((option = getopt_long(argc, argv, "hd:p:o:jg:", longopts, &longindex)) != -1) {
+    while ((option = getopt_long(argc, argv, "hd:p:o:jg:cm:s:S:D:r:R:", longopts, &longindex)) != -1) {
         switch (option) {
             case 'h':
                 displayUsage();
@@ -100,7 +136,7 @@ static void parseArgs(const int argc, char **argv)
             case 'd':
                 gDuration = std::atoi(optarg);
                 if (gDuration < 0) {
-                    fprintf(stderr, "Error: duration (s) must be > 0\n");
+                    fprintf(stderr, "Error: duration (s) must be >= 0\n");
                     exit(EXIT_FAILURE);
                 }
                 break;
@@ -124,7 +160,11 @@ static void parseArgs(const int argc, char **argv)
                 break;
             }
             case 'j': {
+#ifdef ON_DEVICE_REPORT
                 gJson = true;
+#else
+                fprintf(stderr, "Warning: Reports are not generated on the device in this build, use MemCaptureRender\n");
+#endif
                 break;
             }
             case 'g': {
@@ -132,6 +172,49 @@ static void parseArgs(const int argc, char **argv)
                 gGroupsFile = std::filesystem::path(optarg);
                 break;
             }
+            case 'c': {
+                gCapture = true;
+                break;
+            }
+            case 'm': {
+                gMetricsAddress = std::string(optarg);
+                break;
+            }
+            case 's': {
+                gShmName = std::string(optarg);
+                break;
+            }
+            case 'S': {
+                // Series and slot counts are optional, so don't overwrite the defaults if they're missing
+                unsigned records = 0;
+                unsigned series = gShmSeries;
+                unsigned slots = gShmSlots;
+                if (sscanf(optarg, "%u,%u,%u", &records, &series, &slots) < 1 || records == 0 || series == 0 ||
+                    slots == 0) {
+                    fprintf(stderr, "Error: shared memory size must be RECORDS[,SERIES[,SLOTS]], all > 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                gShmRecords = records;
+                gShmSeries = series;
+                gShmSlots = slots;
+                break;
+            }
+            case 'D': {
+                gDaemonSocket = std::filesystem::path(optarg);
+                // Sessions decide how long to capture for, so keep running until told to quit
+                gDuration = 0;
+                break;
+            }
+            case 'r': {
+                gRecordFile = std::filesystem::path(optarg);
+                break;
+            }
+            case 'R': {
+                gReplayFile = std::filesystem::path(optarg);
+                // Runs until the recording is used up
+                gDuration = 0;
+                break;
+            }
             case '?':
                 if (optopt == 'c')
                     fprintf(stderr, "Warning: Option -%c requires an argument.\n", optopt);
@@ -189,7 +272,37 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    LOG_INFO("** About to start memory capture for %d seconds **", gDuration);
+    if (!gRecordFile.empty() && !gReplayFile.empty()) {
+        LOG_ERROR("Cannot record and replay at the same time");
+        return EXIT_FAILURE;
+    }
+
+    // Swap out where the collectors read from before anything reads from the device
+    std::shared_ptr<ReplayFileSystem> replayFileSystem;
+    if (!gReplayFile.empty()) {
+        replayFileSystem = std::make_shared<ReplayFileSystem>(gReplayFile);
+        if (!replayFileSystem->Open()) {
+            return EXIT_FAILURE;
+        }
+        FileSystem::Set(replayFileSystem);
+        LOG_INFO("Replaying recording %s", gReplayFile.string().c_str());
+    } else if (!gRecordFile.empty()) {
+        auto recordingFileSystem = std::make_shared<RecordingFileSystem>(std::make_shared<RealFileSystem>(),
+                                                                         gRecordFile);
+        if (!recordingFileSystem->Open()) {
+            return EXIT_FAILURE;
+        }
+        FileSystem::Set(recordingFileSystem);
+        LOG_INFO("Recording all reads to %s", gRecordFile.string().c_str());
+    }
+
+    if (replayFileSystem) {
+        LOG_INFO("** About to replay memory capture **");
+    } else if (gDuration == 0) {
+        LOG_INFO("** About to start memory capture until stopped **");
+    } else {
+        LOG_INFO("** About to start memory capture for %d seconds **", gDuration);
+    }
     LOG_INFO("Will save report to %s", gOutputDirectory.string().c_str());
 
     // Load groups JSON if provided
@@ -211,22 +324,113 @@ int main(int argc, char *argv[])
         }
     }
 
-    auto metadata = std::make_shared<Metadata>();
+    // Probe the system once up front (through the recording/replay filesystem) for everything that needs it
+    auto collectionContext = std::make_shared<CollectionContext>();
+
+    auto metadata = std::make_shared<Metadata>(*collectionContext);
     auto reportGenerator = std::make_shared<JsonReportGenerator>(metadata, groupManager);
+    auto samplePublisher = std::make_shared<SamplePublisher>();
+
+    // Stream samples to disk as they're collected so we don't lose everything if we're killed part way through
+    std::shared_ptr<CaptureWriter> captureWriter;
+    if (gCapture) {
+        std::filesystem::path captureFilepath = gOutputDirectory / "capture.memcap";
+        captureWriter = std::make_shared<CaptureWriter>(captureFilepath);
+        if (!captureWriter->IsOpen()) {
+            return EXIT_FAILURE;
+        }
+
+        LOG_INFO("Streaming samples to %s", captureFilepath.string().c_str());
+        captureWriter->AddMetadata("platform", metadata->Platform());
+        captureWriter->AddMetadata("image", metadata->Image());
+        captureWriter->AddMetadata("mac", metadata->Mac());
+        captureWriter->AddMetadata("swapEnabled", metadata->SwapEnabled() ? "true" : "false");
+        captureWriter->Start();
+        samplePublisher->AddSink(captureWriter);
+    }
+
+    std::shared_ptr<MetricsServer> metricsServer;
+    if (!gMetricsAddress.empty()) {
+        metricsServer = std::make_shared<MetricsServer>(gMetricsAddress, groupManager);
+        if (!metricsServer->Start()) {
+            return EXIT_FAILURE;
+        }
+        samplePublisher->AddSink(metricsServer);
+    }
+
+    std::shared_ptr<ShmPublisher> shmPublisher;
+    if (!gShmName.empty()) {
+        shmPublisher = std::make_shared<ShmPublisher>(gShmName, gShmSlots, gShmRecords, gShmSeries);
+        if (!shmPublisher->IsOpen()) {
+            return EXIT_FAILURE;
+        }
+        samplePublisher->AddSink(shmPublisher);
+    }
 
     // Create all our metrics
-    ProcessMetric processMetric(reportGenerator);
-    MemoryMetric memoryMetric(gPlatform, reportGenerator);
+    auto overheadTracker = std::make_shared<OverheadTracker>();
+#ifdef ON_DEVICE_REPORT
+    // Daemon sessions build their reports from the samples, so the full history is only needed for our own report
+    const bool keepResults = gDaemonSocket.empty();
+#else
+    const bool keepResults = false;
+#endif
+    auto processMetric = std::make_shared<ProcessMetric>(reportGenerator, samplePublisher, groupManager,
+                                                         overheadTracker, collectionContext, keepResults);
+    auto memoryMetric = std::make_shared<MemoryMetric>(gPlatform, reportGenerator, samplePublisher,
+                                                       overheadTracker, collectionContext);
+    // PSI triggers are events from the running kernel, so there's nothing to watch when replaying
+    auto pressureMetric = std::make_shared<PressureMetric>(reportGenerator, samplePublisher, overheadTracker,
+                                                           !replayFileSystem);
+    auto memoryEventsMetric = std::make_shared<MemoryEventsMetric>(reportGenerator, samplePublisher, processMetric);
+
+    // Start data collection. When replaying there's no reason to wait between ticks
+    const auto frequency = replayFileSystem ? std::chrono::seconds(0) : std::chrono::seconds(3);
+    processMetric->StartCollection(frequency);
+    memoryMetric->StartCollection(frequency);
+    pressureMetric->StartCollection(frequency);
+    // Same for memory events, and there's nothing to collect every tick so they don't need the daemon to control them
+    if (!replayFileSystem) {
+        memoryEventsMetric->StartCollection(frequency);
+    }
 
-    // Start data collection
-    processMetric.StartCollection(std::chrono::seconds(3));
-    memoryMetric.StartCollection(std::chrono::seconds(3));
+    std::unique_ptr<Daemon> daemon;
+    if (!gDaemonSocket.empty()) {
+        std::map<std::string, std::shared_ptr<IMetric>> metrics = {
+                {"process", processMetric},
+                {"memory",  memoryMetric},
+                {"pressure", pressureMetric}
+        };
+
+        daemon = std::make_unique<Daemon>(gDaemonSocket, gOutputDirectory, metrics, samplePublisher, metadata,
+                                          groupManager, []()
+                                          {
+                                              std::lock_guard<std::mutex> locker(gLock);
+                                              gEarlyTermination = true;
+                                              gStop.notify_all();
+                                          });
+        if (!daemon->Start()) {
+            return EXIT_FAILURE;
+        }
+    }
 
     // Block main thread for the collection duration or until SIGTERM
     std::unique_lock<std::mutex> locker(gLock);
-    gStop.wait_for(locker, std::chrono::seconds(gDuration));
+    if (replayFileSystem) {
+        while (!gEarlyTermination && !replayFileSystem->IsExhausted()) {
+            gStop.wait_for(locker, std::chrono::milliseconds(100));
+        }
+    } else if (gDuration == 0) {
+        while (!gEarlyTermination) {
+            gStop.wait(locker);
+        }
+    } else {
+        gStop.wait_for(locker, std::chrono::seconds(gDuration));
+    }
 
-    if (!gEarlyTermination) {
+    if (replayFileSystem && !gEarlyTermination) {
+        LOG_INFO("Reached the end of the recording");
+    } else if (!gEarlyTermination) {
         LOG_INFO("Stopping after %d seconds - completed full capture", gDuration);
     }
 
@@ -234,55 +438,47 @@ int main(int argc, char *argv[])
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
     metadata->SetDuration(duration);
 
+    locker.unlock();
+
+    // Save any sessions still running before collection stops
+    if (daemon) {
+        daemon->Stop();
+    }
+
     // Done! Stop data collection
-    processMetric.StopCollection();
-    memoryMetric.StopCollection();
+    processMetric->StopCollection();
+    memoryMetric->StopCollection();
+    pressureMetric->StopCollection();
+    memoryEventsMetric->StopCollection();
+
+    if (shmPublisher) {
+        samplePublisher->RemoveSink(shmPublisher);
+        shmPublisher->Stop();
+    }
 
-    // Save results
-    processMetric.SaveResults();
-    memoryMetric.SaveResults();
-
-    // Build report
-    inja::Environment env;
-    // Make the output a bit tidier
-    env.set_trim_blocks(true);
-    env.set_lstrip_blocks(true);
-
-    // Convert the values in an object into an array that we can loop over (used for generating rows)
-    // Order the values using the _columnOrder data given in the second argument
-    env.add_callback("objectToArray", 2, [](inja::Arguments &args)
-    {
-        std::vector<nlohmann::json> values;
-
-        assert(args.at(0)->is_object());
-        assert(args.at(1)->is_array());
-
-        std::map<std::string, nlohmann::json> flattenedData;
-
-        // Flatten the data (one level deep only)
-        for (const auto &element: args.at(0)->items()) {
-            if (element.value().is_object()) {
-                // This is a very janky way to handle min/max/average & column ordering. The key name corresponds to "<Measurement Name> (Min/Max/Average)"
-                // which matches the _columnOrder values set in JsonReportGenerator
-                for (const auto &child: element.value().items()) {
-                    std::string keyName = element.key() + " (" + child.key() + ")";
-                    flattenedData.emplace(keyName, child.value());
-                }
-            } else {
-                values.emplace_back(element.value());
-                flattenedData.emplace(element.key(), element.value());
-            }
-        }
+    if (metricsServer) {
+        samplePublisher->RemoveSink(metricsServer);
+        metricsServer->Stop();
+    }
 
-        // Put the data into the order specified by _columnOrder
-        std::vector<nlohmann::json> ordered;
-        for (const auto& column : args.at(1)->items()) {
-            auto item = flattenedData.at(column.value());
-            ordered.emplace_back(item);
-        }
+    if (captureWriter) {
+        samplePublisher->RemoveSink(captureWriter);
+        captureWriter->AddMetadata("duration", std::to_string(duration));
+        captureWriter->AddMetadata("timestamp", metadata->ReportTimestamp());
+        captureWriter->Stop();
+    }
 
-        return ordered;
-    });
+    // Each daemon session saves its own report
+    if (daemon) {
+        return EXIT_SUCCESS;
+    }
+
+#ifdef ON_DEVICE_REPORT
+    // Save results
+    processMetric->SaveResults();
+    memoryMetric->SaveResults();
+    pressureMetric->SaveResults();
+    memoryEventsMetric->SaveResults();
 
     // Write the JSON first - this is safer and is the report automation need, so if we crash
     // after this point we'll still get some data
@@ -294,19 +490,10 @@ int main(int argc, char *argv[])
         LOG_INFO("Saved JSON data to %s", jsonFilepath.string().c_str());
     }
 
-    try {
-        auto htmlTemplateString = std::string(g_templateHtml_data, g_templateHtml_data + g_templateHtml_size);
-        std::string result = env.render(htmlTemplateString, reportGenerator->getJson());
-
-        std::filesystem::path htmlFilepath = gOutputDirectory / "report.html";
-        std::ofstream outputHtml(htmlFilepath, std::ios::trunc | std::ios::binary);
-        outputHtml << result;
-
-        LOG_INFO("Saved report to %s", htmlFilepath.string().c_str());
-    } catch (const std::exception& e) {
-        LOG_ERROR("Failed to save HTML report with exception %s", e.what());
-        throw;
+    if (!HtmlReportRenderer::Render(*reportGenerator, gOutputDirectory / "report.html")) {
+        return EXIT_FAILURE;
     }
+#endif
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,394 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <getopt.h>
+#include <algorithm>
+#include <cctype>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "Log.h"
+
+/**
+ * Create a synthetic population of processes with a controllable memory layout, so we can see how MemCapture behaves
+ * with far more processes, mappings or process churn than a normal test device has.
+ *
+ * Every worker gets its own anonymous memory split over a number of VMAs, a private mapping of a file shared by all
+ * workers and a share of an anonymous MAP_SHARED region created before forking. Workers can optionally grow every
+ * second, and short-lived processes can be spawned continuously to simulate churn.
+ */
+
+static size_t gProcessCount = 100;
+static size_t gAnonKb = 1024;
+static size_t gFileKb = 1024;
+static size_t gSharedKb = 512;
+static size_t gVmaCount = 16;
+static size_t gHeavyVmaCount = 0;
+static size_t gGrowthKb = 0;
+static double gChurnRate = 0;
+static int gChurnLifetimeMs = 1000;
+static int gDuration = 0;
+
+static volatile sig_atomic_t gQuit = 0;
+
+struct layout
+{
+    int fileFd;
+    size_t fileSize;
+    void *sharedRegion;
+    size_t sharedSize;
+};
+
+static void displayUsage()
+{
+    printf("Usage: MemCaptureLoadGen <option(s)>\n");
+    printf("    Create a synthetic population of processes for testing MemCapture at scale\n\n");
+    printf("    -h, --help              Print this help and exit\n");
+    printf("    -n, --processes         Number of long-lived worker processes (default 100)\n");
+    printf("    -a, --anon-kb           Anonymous memory per worker in KB (default 1024)\n");
+    printf("    -f, --file-kb           Size of the file mapped privately by every worker in KB (default 1024)\n");
+    printf("    -s, --shared-kb         Size of the anonymous shared region mapped by every worker in KB (default 512)\n");
+    printf("    -v, --vmas              Number of VMAs to split each worker's anonymous memory over (default 16)\n");
+    printf("    -V, --heavy-vmas        Add one extra worker with this many VMAs (default 0 - disabled)\n");
+    printf("    -g, --growth-kb         Anonymous memory each worker adds every second in KB (default 0)\n");
+    printf("    -c, --churn             Number of short-lived processes to spawn per second (default 0)\n");
+    printf("    -l, --churn-lifetime    How long each short-lived process lives in ms (default 1000)\n");
+    printf("    -d, --duration          Seconds to run for, or 0 to run until interrupted (default 0)\n");
+}
+
+static void parseArgs(const int argc, char **argv)
+{
+    struct option longopts[] = {
+            {"help",           no_argument,       nullptr, (int) 'h'},
+            {"processes",      required_argument, nullptr, (int) 'n'},
+            {"anon-kb",        required_argument, nullptr, (int) 'a'},
+            {"file-kb",        required_argument, nullptr, (int) 'f'},
+            {"shared-kb",      required_argument, nullptr, (int) 's'},
+            {"vmas",           required_argument, nullptr, (int) 'v'},
+            {"heavy-vmas",     required_argument, nullptr, (int) 'V'},
+            {"growth-kb",      required_argument, nullptr, (int) 'g'},
+            {"churn",          required_argument, nullptr, (int) 'c'},
+            {"churn-lifetime", required_argument, nullptr, (int) 'l'},
+            {"duration",       required_argument, nullptr, (int) 'd'},
+            {nullptr, 0,                          nullptr, 0}
+    };
+
+    opterr = 0;
+
+    int option;
+    int longindex;
+
+    while ((option = getopt_long(argc, argv, "hn:a:f:s:v:V:g:c:l:d:", longopts, &longindex)) != -1) {
+        switch (option) {
+            case 'h':
+                displayUsage();
+                exit(EXIT_SUCCESS);
+                break;
+            case 'n':
+                gProcessCount = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'a':
+                gAnonKb = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'f':
+                gFileKb = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 's':
+                gSharedKb = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'v':
+                gVmaCount = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'V':
+                gHeavyVmaCount = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'g':
+                gGrowthKb = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'c':
+                gChurnRate = std::strtod(optarg, nullptr);
+                break;
+            case 'l':
+                gChurnLifetimeMs = std::atoi(optarg);
+                break;
+            case 'd':
+                gDuration = std::atoi(optarg);
+                break;
+            case '?':
+                if (isprint(optopt))
+                    fprintf(stderr, "Warning: Unknown option `-%c'.\n", optopt);
+                else
+                    fprintf(stderr, "Warning: Unknown option character `\\x%x'.\n", optopt);
+
+                exit(EXIT_FAILURE);
+                break;
+            default:
+                exit(EXIT_FAILURE);
+                break;
+        }
+    }
+}
+
+static void signalHandler(int signal __attribute__((unused)))
+{
+    gQuit = 1;
+}
+
+/**
+ * @brief Write to every page so the memory is actually resident
+ */
+static void touch(void *region, size_t size)
+{
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto *bytes = static_cast<volatile char *>(region);
+
+    for (size_t offset = 0; offset < size; offset += pageSize) {
+        bytes[offset] = 1;
+    }
+}
+
+/**
+ * @brief Map and populate anonymous memory split over the given number of VMAs
+ *
+ * The memory is a single mapping, with MADV_NOHUGEPAGE set on every other region. Adjacent regions then have different
+ * flags, so the kernel has to keep them as separate VMAs
+ */
+static bool mapAnonymous(size_t sizeKb, size_t vmaCount)
+{
+    if (sizeKb == 0 || vmaCount == 0) {
+        return true;
+    }
+
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t pagesPerVma = std::max<size_t>(1, (sizeKb * 1024) / pageSize / vmaCount);
+    const size_t regionSize = pagesPerVma * pageSize;
+    const size_t size = regionSize * vmaCount;
+
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        LOG_SYS_ERROR(errno, "Failed to map %zu bytes of anonymous memory", size);
+        return false;
+    }
+
+    for (size_t i = 1; i < vmaCount; i += 2) {
+        if (madvise(static_cast<char *>(memory) + (i * regionSize), regionSize, MADV_NOHUGEPAGE) != 0) {
+            LOG_SYS_WARN(errno, "Failed to split anonymous memory into %zu VMAs", vmaCount);
+            break;
+        }
+    }
+
+    touch(memory, size);
+    return true;
+}
+
+/**
+ * @brief Create the file and shared region that all workers map
+ */
+static bool createLayout(layout &out)
+{
+    out.fileFd = -1;
+    out.fileSize = gFileKb * 1024;
+    out.sharedRegion = nullptr;
+    out.sharedSize = gSharedKb * 1024;
+
+    if (out.fileSize > 0) {
+        char path[] = "/tmp/MemCaptureLoadGen.XXXXXX";
+        out.fileFd = mkstemp(path);
+        if (out.fileFd < 0) {
+            LOG_SYS_ERROR(errno, "Failed to create file to map");
+            return false;
+        }
+
+        // Workers keep the file alive through the fd, so nothing is left behind once we're done
+        unlink(path);
+
+        std::vector<char> block(64 * 1024, 'x');
+        size_t written = 0;
+        while (written < out.fileSize) {
+            const auto toWrite = std::min(block.size(), out.fileSize - written);
+            const auto ret = write(out.fileFd, block.data(), toWrite);
+            if (ret <= 0) {
+                LOG_SYS_ERROR(errno, "Failed to write file to map");
+                return false;
+            }
+            written += ret;
+        }
+    }
+
+    if (out.sharedSize > 0) {
+        out.sharedRegion = mmap(nullptr, out.sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (out.sharedRegion == MAP_FAILED) {
+            LOG_SYS_ERROR(errno, "Failed to map %zu bytes of shared memory", out.sharedSize);
+            return false;
+        }
+
+        touch(out.sharedRegion, out.sharedSize);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Body of each forked process. Never returns
+ *
+ * @param lifetime How long to live for, or zero to live until the parent tells us to stop
+ */
+[[noreturn]] static void runWorker(const layout &layout, const char *name, size_t vmaCount,
+                                   std::chrono::milliseconds lifetime)
+{
+    // Don't outlive the load generator if it is killed
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    prctl(PR_SET_NAME, name);
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+
+    if (!mapAnonymous(gAnonKb, vmaCount)) {
+        _exit(EXIT_FAILURE);
+    }
+
+    if (layout.fileFd >= 0) {
+        void *file = mmap(nullptr, layout.fileSize, PROT_READ, MAP_PRIVATE, layout.fileFd, 0);
+        if (file != MAP_FAILED) {
+            const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            volatile char sum = 0;
+            for (size_t offset = 0; offset < layout.fileSize; offset += pageSize) {
+                sum += static_cast<const char *>(file)[offset];
+            }
+        }
+    }
+
+    // The shared region is inherited from the parent, we just need to touch it to have it count towards our RSS
+    if (layout.sharedRegion) {
+        auto *shared = static_cast<volatile char *>(layout.sharedRegion);
+        volatile char sum = 0;
+        for (size_t offset = 0; offset < layout.sharedSize; offset += static_cast<size_t>(sysconf(_SC_PAGESIZE))) {
+            sum += shared[offset];
+        }
+    }
+
+    if (lifetime.count() > 0) {
+        std::this_thread::sleep_for(lifetime);
+        _exit(EXIT_SUCCESS);
+    }
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        mapAnonymous(gGrowthKb, 1);
+    }
+}
+
+static pid_t spawn(const layout &layout, const char *name, size_t vmaCount, std::chrono::milliseconds lifetime)
+{
+    const pid_t pid = fork();
+    if (pid < 0) {
+        LOG_SYS_ERROR(errno, "Failed to fork");
+    } else if (pid == 0) {
+        runWorker(layout, name, vmaCount, lifetime);
+    }
+
+    return pid;
+}
+
+int main(int argc, char *argv[])
+{
+    parseArgs(argc, argv);
+
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    layout layout = {};
+    if (!createLayout(layout)) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<pid_t> workers;
+    workers.reserve(gProcessCount + 1);
+
+    for (size_t i = 0; i < gProcessCount && !gQuit; i++) {
+        const pid_t pid = spawn(layout, "loadgen-worker", gVmaCount, std::chrono::milliseconds(0));
+        if (pid < 0) {
+            break;
+        }
+        workers.emplace_back(pid);
+    }
+
+    if (gHeavyVmaCount > 0) {
+        const pid_t pid = spawn(layout, "loadgen-heavy", gHeavyVmaCount, std::chrono::milliseconds(0));
+        if (pid > 0) {
+            workers.emplace_back(pid);
+        }
+    }
+
+    LOG_INFO("Started %zu workers (%zu KB anon over %zu VMAs, %zu KB file, %zu KB shared, growing %zu KB/s)",
+             workers.size(), gAnonKb, gVmaCount, gFileKb, gSharedKb, gGrowthKb);
+
+    if (gChurnRate > 0) {
+        LOG_INFO("Spawning %.1f processes/s living for %d ms", gChurnRate, gChurnLifetimeMs);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto churnInterval = gChurnRate > 0 ? std::chrono::duration<double>(1.0 / gChurnRate)
+                                              : std::chrono::duration<double>(0);
+    auto nextChurn = start;
+    size_t churnCount = 0;
+
+    while (!gQuit) {
+        const auto now = std::chrono::steady_clock::now();
+        if (gDuration > 0 && now - start >= std::chrono::seconds(gDuration)) {
+            break;
+        }
+
+        if (gChurnRate > 0) {
+            while (nextChurn <= now) {
+                if (spawn(layout, "loadgen-churn", 1, std::chrono::milliseconds(gChurnLifetimeMs)) > 0) {
+                    churnCount++;
+                }
+                nextChurn += std::chrono::duration_cast<std::chrono::steady_clock::duration>(churnInterval);
+            }
+        }
+
+        // Reap anything that has exited, which will be the short-lived processes unless something has gone wrong
+        int status;
+        while (waitpid(-1, &status, WNOHANG) > 0) {
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    LOG_INFO("Stopping %zu workers (spawned %zu short-lived processes)", workers.size(), churnCount);
+
+    for (const auto pid: workers) {
+        kill(pid, SIGTERM);
+    }
+
+    while (wait(nullptr) > 0) {
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2023 Stephen Foulds
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <getopt.h>
+#include <fstream>
+#include <optional>
+
+#include "Log.h"
+#include "GroupManager.h"
+#include "JsonReportGenerator.h"
+#include "HtmlReportRenderer.h"
+#include "Capture/CaptureReader.h"
+#include "Capture/CaptureImporter.h"
+
+/**
+ * Generate the MemCapture report from a capture saved on the device with --capture, so the rendering work (and the
+ * memory it needs) happens on a workstation instead of the device being measured
+ */
+
+static std::filesystem::path gCaptureFile;
+static std::filesystem::path gOutputDirectory = std::filesystem::current_path() / "MemCaptureReport";
+static bool gJson = false;
+static std::optional<std::filesystem::path> gGroupsFile;
+
+static void displayUsage()
+{
+    printf("Usage: MemCaptureRender <option(s)> <capture file>\n");
+    printf("    Generate the MemCapture report from a saved capture\n\n");
+    printf("    -h, --help          Print this help and exit\n");
+    printf("    -o, --output-dir    Directory to save the report in\n");
+    printf("    -j, --json          Save data as JSON in addition to HTML report\n");
+    printf("    -g, --groups        Path to JSON file containing the group mappings (optional)\n");
+}
+
+static void parseArgs(const int argc, char **argv)
+{
+    struct option longopts[] = {
+            {"help",       no_argument,       nullptr, (int) 'h'},
+            {"output-dir", required_argument, nullptr, (int) 'o'},
+            {"json",       no_argument,       nullptr, (int) 'j'},
+            {"groups",     required_argument, nullptr, (int) 'g'},
+            {nullptr, 0,                      nullptr, 0}
+    };
+
+    opterr = 0;
+
+    int option;
+    int longindex;
+
+    while ((option = getopt_long(argc, argv, "ho:jg:", longopts, &longindex)) != -1) {
+        switch (option) {
+            case 'h':
+                displayUsage();
+                exit(EXIT_SUCCESS);
+                break;
+            case 'o':
+                gOutputDirectory = std::filesystem::path(optarg);
+                break;
+            case 'j':
+                gJson = true;
+                break;
+            case 'g':
+                gGroupsFile = std::filesystem::path(optarg);
+                break;
+            case '?':
+                if (isprint(optopt))
+                    fprintf(stderr, "Warning: Unknown option `-%c'.\n", optopt);
+                else
+                    fprintf(stderr, "Warning: Unknown option character `\\x%x'.\n", optopt);
+
+                exit(EXIT_FAILURE);
+                break;
+            default:
+                exit(EXIT_FAILURE);
+                break;
+        }
+    }
+
+    if (optind >= argc) {
+        displayUsage();
+        exit(EXIT_FAILURE);
+    }
+
+    gCaptureFile = std::filesystem::path(argv[optind]);
+}
+
+int main(int argc, char *argv[])
+{
+    parseArgs(argc, argv);
+
+    CaptureReader reader(gCaptureFile);
+    if (!reader.IsOpen()) {
+        return EXIT_FAILURE;
+    }
+
+    LOG_INFO("Loaded capture %s (%zu series)", gCaptureFile.string().c_str(), reader.AllSeries().size());
+
+    try {
+        std::filesystem::create_directories(gOutputDirectory);
+    } catch (std::filesystem::filesystem_error &e) {
+        LOG_ERROR("Failed to create directory %s to save results in: '%s'", gOutputDirectory.string().c_str(),
+                  e.what());
+        return EXIT_FAILURE;
+    }
+
+    std::optional<std::shared_ptr<GroupManager>> groupManager = std::nullopt;
+    if (gGroupsFile.has_value()) {
+        std::ifstream groupsFile(gGroupsFile.value());
+        if (!groupsFile) {
+            LOG_ERROR("Invalid groups file %s", gGroupsFile->string().c_str());
+            return EXIT_FAILURE;
+        }
+
+        try {
+            groupManager = std::make_shared<GroupManager>(nlohmann::json::parse(groupsFile));
+        } catch (nlohmann::json::exception &e) {
+            LOG_ERROR("Failed to parse groups JSON with error %s", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    CaptureImporter importer(reader);
+    JsonReportGenerator reportGenerator(importer.GetMetadata(), groupManager);
+    importer.AddToReport(reportGenerator, groupManager);
+
+    if (gJson) {
+        std::filesystem::path jsonFilepath = gOutputDirectory / "report.json";
+        std::ofstream outputJson(jsonFilepath, std::ios::trunc | std::ios::binary);
+        outputJson << reportGenerator.getJson().dump(4);
+
+        LOG_INFO("Saved JSON data to %s", jsonFilepath.string().c_str());
+    }
+
+    if (!HtmlReportRenderer::Render(reportGenerator, gOutputDirectory / "report.html")) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
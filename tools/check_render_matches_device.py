@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+#
+# If not stated otherwise in this file or this component's LICENSE file the
+# following copyright and licenses apply:
+#
+# Copyright 2023 Stephen Foulds
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Run a short capture on this machine, then check the report MemCaptureRender builds from the saved capture is the same as
+the one MemCapture generated on the device.
+
+Datasets are compared by name since the capture doesn't record the order the metrics added them in. Event logs (memory
+pressure triggers, OOMs) aren't rebuilt from the capture so are skipped.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+EVENT_DATASETS = {"Memory Pressure Events", "Memory Events", "Memory Event Processes"}
+
+
+def load_report(path):
+    with open(path) as f:
+        report = json.load(f)
+
+    datasets = {dataset["name"]: dataset for dataset in report.pop("data", [])
+                if dataset["name"] not in EVENT_DATASETS}
+    return report, datasets
+
+
+def compare(device_path, offline_path):
+    device, device_datasets = load_report(device_path)
+    offline, offline_datasets = load_report(offline_path)
+
+    differences = []
+    for key in sorted(set(device) | set(offline)):
+        if device.get(key) != offline.get(key):
+            differences.append("'{}' differs".format(key))
+
+    for name in sorted(set(device_datasets) | set(offline_datasets)):
+        if name not in offline_datasets:
+            differences.append("Dataset '{}' missing from the offline report".format(name))
+        elif name not in device_datasets:
+            differences.append("Dataset '{}' only in the offline report".format(name))
+        elif device_datasets[name].get("_columnOrder") != offline_datasets[name].get("_columnOrder"):
+            differences.append("Dataset '{}' columns differ: {} vs {}".format(
+                name, device_datasets[name].get("_columnOrder"), offline_datasets[name].get("_columnOrder")))
+        elif device_datasets[name] != offline_datasets[name]:
+            for device_row, offline_row in zip(device_datasets[name]["data"], offline_datasets[name]["data"]):
+                if device_row != offline_row:
+                    differences.append("Dataset '{}' rows differ: {} vs {}".format(name, device_row, offline_row))
+                    break
+            else:
+                differences.append("Dataset '{}' has {} rows on the device and {} offline".format(
+                    name, len(device_datasets[name]["data"]), len(offline_datasets[name]["data"])))
+
+    return differences
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--build-dir", required=True, help="Directory containing MemCapture and MemCaptureRender")
+    parser.add_argument("--duration", type=int, default=10, help="Seconds to capture for")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        device_dir = os.path.join(tmp, "device")
+        offline_dir = os.path.join(tmp, "offline")
+
+        subprocess.run([os.path.join(args.build_dir, "MemCapture"), "-d", str(args.duration), "-j", "-c",
+                        "-o", device_dir], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, check=True)
+        subprocess.run([os.path.join(args.build_dir, "MemCaptureRender"), "-j", "-o", offline_dir,
+                        os.path.join(device_dir, "capture.memcap")],
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, check=True)
+
+        differences = compare(os.path.join(device_dir, "report.json"), os.path.join(offline_dir, "report.json"))
+
+    for difference in differences:
+        print(difference)
+
+    if differences:
+        return 1
+
+    print("Offline report matches the device report")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
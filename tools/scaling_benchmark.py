@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#
+# If not stated otherwise in this file or this component's LICENSE file the
+# following copyright and licenses apply:
+#
+# Copyright 2023 Stephen Foulds
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Run MemCapture against increasingly large synthetic process populations from MemCaptureLoadGen and report how the
+process collection tick latency and MemCapture's own RSS scale with the number of processes.
+
+Needs to run as root so MemCapture can read the smaps of the load generator's processes.
+"""
+
+import argparse
+import json
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def latency_row(report, source):
+    for dataset in report.get("data", []):
+        if dataset["name"] != "MemCapture Latency":
+            continue
+        for row in dataset["data"]:
+            if row["Source"] == source:
+                return row
+    return None
+
+
+def memcapture_rss_kb(report):
+    for dataset in report.get("data", []):
+        if dataset["name"] != "MemCapture Memory":
+            continue
+        for row in dataset["data"]:
+            if row["Value"] == "RSS":
+                return row["Value_KB"]["Max"]
+    return None
+
+
+def run(args, population):
+    loadgen_cmd = [os.path.join(args.build_dir, "MemCaptureLoadGen"), "-n", str(population)] + args.loadgen_args
+    loadgen = subprocess.Popen(loadgen_cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    try:
+        time.sleep(args.settle)
+
+        with tempfile.TemporaryDirectory() as output_dir:
+            memcapture_cmd = [os.path.join(args.build_dir, "MemCapture"), "-d", str(args.duration), "-j", "-o",
+                              output_dir]
+            subprocess.run(memcapture_cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, check=True)
+
+            with open(os.path.join(output_dir, "report.json")) as f:
+                report = json.load(f)
+    finally:
+        loadgen.send_signal(signal.SIGTERM)
+        loadgen.wait()
+
+    tick = latency_row(report, "Processes") or {}
+    return {
+        "population": population,
+        "processes": len(report.get("processes", [])),
+        "ticks": int(tick.get("Count", 0)),
+        "tick_p50_ms": float(tick.get("P50_ms", 0)),
+        "tick_p99_ms": float(tick.get("P99_ms", 0)),
+        "tick_max_ms": float(tick.get("Max_ms", 0)),
+        "memcapture_rss_kb": memcapture_rss_kb(report),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-b", "--build-dir", default="build",
+                        help="Directory containing the MemCapture and MemCaptureLoadGen binaries")
+    parser.add_argument("-p", "--populations", default="100,500,1000,2000,5000",
+                        help="Comma separated list of process counts to test")
+    parser.add_argument("-d", "--duration", type=int, default=30, help="Seconds to run MemCapture for at each size")
+    parser.add_argument("-s", "--settle", type=float, default=2,
+                        help="Seconds to wait after starting the load generator before capturing")
+    parser.add_argument("-o", "--output", help="Save the results as JSON to this file")
+    parser.add_argument("loadgen_args", nargs=argparse.REMAINDER,
+                        help="Extra arguments for MemCaptureLoadGen, after --")
+    args = parser.parse_args()
+
+    if args.loadgen_args and args.loadgen_args[0] == "--":
+        args.loadgen_args = args.loadgen_args[1:]
+
+    if os.geteuid() != 0:
+        print("Warning: not running as root, MemCapture will not be able to read most processes", file=sys.stderr)
+
+    results = []
+    print("%10s %10s %6s %12s %12s %12s %16s" % (
+        "Population", "Processes", "Ticks", "Tick P50 ms", "Tick P99 ms", "Tick Max ms", "MemCapture RSS KB"))
+
+    for population in [int(p) for p in args.populations.split(",")]:
+        result = run(args, population)
+        results.append(result)
+        print("%10d %10d %6d %12.2f %12.2f %12.2f %16s" % (
+            result["population"], result["processes"], result["ticks"], result["tick_p50_ms"],
+            result["tick_p99_ms"], result["tick_max_ms"], result["memcapture_rss_kb"]), flush=True)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=4)
+
+
+if __name__ == "__main__":
+    main()